@@ -0,0 +1,131 @@
+#ifndef COVE_BENCH_H
+#define COVE_BENCH_H
+
+/*
+ * Microbenchmark harness for cove_bench.
+ *
+ * Every suite sweeps the working set from cache resident to far beyond the
+ * last level cache, repeats each measurement and reports the fastest run,
+ * which is the least disturbed by the rest of the system.  Keys come from
+ * a fixed-seed generator so that runs are comparable across builds.
+ *
+ * Results are written to stdout as one record per measurement, either as
+ * a JSON array or as CSV:
+ *
+ *   suite, name, variant, size, threads, ops, ns, ns_per_op, mops
+ *
+ * where @size is the number of elements in the structure (or operations
+ * per thread for suites that do not build one), @ops the number of timed
+ * operations and @ns the total time they took.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "compiler.h"
+
+enum bench_format {
+    BENCH_FMT_JSON,
+    BENCH_FMT_CSV,
+};
+
+struct bench_ctx {
+    size_t min_size;
+    size_t max_size;
+    unsigned int max_threads;
+    unsigned int reps;
+    const char *filter;
+    enum bench_format format;
+    unsigned long nr_results;
+};
+
+struct bench_suite {
+    const char *name;
+    void (*run)(struct bench_ctx *ctx);
+};
+
+extern void bench_rbtree(struct bench_ctx *ctx);
+extern void bench_list(struct bench_ctx *ctx);
+extern void bench_hashtable(struct bench_ctx *ctx);
+extern void bench_refcount(struct bench_ctx *ctx);
+extern void bench_bptree(struct bench_ctx *ctx);
+extern void bench_timer(struct bench_ctx *ctx);
+extern void bench_heap(struct bench_ctx *ctx);
+extern void bench_llist(struct bench_ctx *ctx);
+extern void bench_ring(struct bench_ctx *ctx);
+extern void bench_parallel(struct bench_ctx *ctx);
+
+/* Sizes grow by 4x per step between ctx->min_size and ctx->max_size */
+#define bench_for_each_size(ctx, n) \
+    for (n = (ctx)->min_size; n <= (ctx)->max_size; n *= 4)
+
+/* Thread counts double from 1 up to ctx->max_threads */
+#define bench_for_each_threads(ctx, t) \
+    for (t = 1; t <= (ctx)->max_threads; t *= 2)
+
+/*
+ * Run @body ctx->reps times and store the fastest run, in ns, in @best.
+ * @setup and @teardown run around every repetition, outside the timed part.
+ */
+#define bench_measure(ctx, best, setup, body, teardown)     \
+    do {                                                    \
+        unsigned int __rep;                                 \
+        uint64_t __t;                                       \
+                                                            \
+        (best) = UINT64_MAX;                                \
+        for (__rep = 0; __rep < (ctx)->reps; __rep++) {     \
+            setup;                                          \
+            __t = bench_now_ns();                           \
+            body;                                           \
+            __t = bench_now_ns() - __t;                     \
+            if (__t < (best))                               \
+                (best) = __t;                               \
+            teardown;                                       \
+        }                                                   \
+    } while (0)
+
+extern uint64_t bench_now_ns(void);
+extern bool bench_enabled(
+    const struct bench_ctx *ctx,
+    const char *suite,
+    const char *name
+);
+extern void bench_report(
+    struct bench_ctx *ctx,
+    const char *suite,
+    const char *name,
+    const char *variant,
+    size_t size,
+    unsigned int threads,
+    uint64_t ops,
+    uint64_t ns
+);
+
+/* splitmix64: fast, fixed-seed and good enough to scatter keys */
+static inline uint64_t bench_rand(uint64_t *state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/* Fisher-Yates shuffle of an index permutation, used for access orders */
+static inline void bench_shuffle(size_t *idx, size_t n, uint64_t *state) {
+    size_t i, j, tmp;
+
+    for (i = n; i > 1; i--) {
+        j = bench_rand(state) % i;
+        tmp = idx[i - 1];
+        idx[i - 1] = idx[j];
+        idx[j] = tmp;
+    }
+}
+
+/* Keep the compiler from discarding a computed value */
+static __always_inline void bench_keep(const void *p) {
+    __asm__ __volatile__("" : : "r"(p) : "memory");
+}
+
+#endif  // COVE_BENCH_H
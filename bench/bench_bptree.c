@@ -0,0 +1,185 @@
+#include <errno.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "bptree.h"
+#include "rbtree.h"
+
+#define SUITE "bptree"
+
+/* Keys visited per range scan, on average */
+#define SCAN_LEN 64
+
+struct bench_node {
+    struct rb_node rb;
+    uint64_t key;
+};
+
+static inline bool node_less(struct rb_node *a, const struct rb_node *b) {
+    return rb_entry(a, struct bench_node, rb)->key <
+           rb_entry(b, struct bench_node, rb)->key;
+}
+
+static inline int key_cmp(const void *key, const struct rb_node *b) {
+    uint64_t ka = *(const uint64_t *) key;
+    uint64_t kb = rb_entry(b, struct bench_node, rb)->key;
+
+    return ka < kb ? -1 : ka > kb;
+}
+
+static void fill(struct bptree *tree, struct bench_node *nodes, size_t n) {
+    size_t i;
+
+    bptree_init(tree);
+    for (i = 0; i < n; i++)
+        if (bptree_insert(tree, nodes[i].key, &nodes[i]) == -ENOMEM)
+            abort();
+}
+
+static void fill_rb(struct rb_root *root, struct bench_node *nodes, size_t n) {
+    size_t i;
+
+    *root = RB_ROOT;
+    for (i = 0; i < n; i++)
+        rb_add(&nodes[i].rb, root, node_less);
+}
+
+/* Upper bound of a scan from @lo that covers about SCAN_LEN random keys */
+static uint64_t scan_end(uint64_t lo, size_t n) {
+    uint64_t width = UINT64_MAX / n * SCAN_LEN;
+
+    return lo > UINT64_MAX - width ? UINT64_MAX : lo + width;
+}
+
+static void scan(
+    struct bptree *tree,
+    struct bench_node *nodes,
+    size_t *order,
+    size_t n
+) {
+    struct bptree_iter iter;
+    uint64_t lo, hi;
+    size_t i;
+
+    for (i = 0; i < n; i += SCAN_LEN) {
+        lo = nodes[order[i]].key;
+        hi = scan_end(lo, n);
+        bptree_for_each_range(&iter, tree, lo, hi)
+            bench_keep(bptree_iter_val(&iter));
+    }
+}
+
+static void scan_rb(
+    struct rb_root *root,
+    struct bench_node *nodes,
+    size_t *order,
+    size_t n
+) {
+    struct rb_node *rb;
+    uint64_t lo, hi;
+    size_t i;
+
+    for (i = 0; i < n; i += SCAN_LEN) {
+        lo = nodes[order[i]].key;
+        hi = scan_end(lo, n);
+        rb_for_each_range(rb, &lo, &hi, root, key_cmp)
+            bench_keep(rb);
+    }
+}
+
+static void run_size(struct bench_ctx *ctx, size_t n) {
+    struct bench_node *nodes;
+    struct bptree tree;
+    struct rb_root root;
+    uint64_t seed = n, best;
+    size_t i, *order, nr_scans = (n + SCAN_LEN - 1) / SCAN_LEN;
+
+    nodes = malloc(sizeof(*nodes) * n);
+    order = malloc(sizeof(*order) * n);
+    if (!nodes || !order)
+        abort();
+
+    for (i = 0; i < n; i++) {
+        nodes[i].key = bench_rand(&seed);
+        order[i] = i;
+    }
+    bench_shuffle(order, n, &seed);
+
+    if (bench_enabled(ctx, SUITE, "insert")) {
+        bench_measure(
+            ctx,
+            best,
+            ,
+            fill(&tree, nodes, n),
+            bptree_destroy(&tree)
+        );
+        bench_report(ctx, SUITE, "insert", "bptree", n, 1, n, best);
+
+        bench_measure(ctx, best, , fill_rb(&root, nodes, n), );
+        bench_report(ctx, SUITE, "insert", "rbtree", n, 1, n, best);
+    }
+
+    if (bench_enabled(ctx, SUITE, "find")) {
+        fill(&tree, nodes, n);
+        bench_measure(
+            ctx,
+            best,
+            ,
+            for (i = 0; i < n; i++)
+                bench_keep(bptree_find(&tree, nodes[order[i]].key)),
+        );
+        bench_report(ctx, SUITE, "find", "bptree", n, 1, n, best);
+        bptree_destroy(&tree);
+
+        fill_rb(&root, nodes, n);
+        bench_measure(
+            ctx,
+            best,
+            ,
+            for (i = 0; i < n; i++) bench_keep(
+                rb_find(&nodes[order[i]].key, &root, key_cmp)
+            ),
+        );
+        bench_report(ctx, SUITE, "find", "rbtree", n, 1, n, best);
+    }
+
+    if (bench_enabled(ctx, SUITE, "scan")) {
+        fill(&tree, nodes, n);
+        bench_measure(ctx, best, , scan(&tree, nodes, order, n), );
+        bench_report(ctx, SUITE, "scan", "bptree", n, 1, nr_scans, best);
+        bptree_destroy(&tree);
+
+        fill_rb(&root, nodes, n);
+        bench_measure(ctx, best, , scan_rb(&root, nodes, order, n), );
+        bench_report(ctx, SUITE, "scan", "rbtree", n, 1, nr_scans, best);
+    }
+
+    if (bench_enabled(ctx, SUITE, "remove")) {
+        bench_measure(
+            ctx,
+            best,
+            fill(&tree, nodes, n),
+            for (i = 0; i < n; i++)
+                bench_keep(bptree_remove(&tree, nodes[order[i]].key)),
+        );
+        bench_report(ctx, SUITE, "remove", "bptree", n, 1, n, best);
+
+        bench_measure(
+            ctx,
+            best,
+            fill_rb(&root, nodes, n),
+            for (i = 0; i < n; i++) rb_erase(&nodes[order[i]].rb, &root),
+        );
+        bench_report(ctx, SUITE, "remove", "rbtree", n, 1, n, best);
+    }
+
+    free(order);
+    free(nodes);
+}
+
+void bench_bptree(struct bench_ctx *ctx) {
+    size_t n;
+
+    bench_for_each_size(ctx, n)
+        run_size(ctx, n);
+}
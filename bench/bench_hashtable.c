@@ -0,0 +1,321 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "dhashtable.h"
+#include "hashtable.h"
+#include "rhashtable.h"
+
+#define SUITE "hashtable"
+
+struct bench_obj {
+    struct hlist_node hnode;
+    struct dhash_node dnode;
+    struct rhash_head rnode;
+    uint64_t key;
+};
+
+/*
+ * Statically sized table as hashtable.h builds it, with the bucket count
+ * chosen per run to hit a given load factor.  hash_add() and friends need
+ * an array whose size is known at compile time, so this open codes them on
+ * a heap allocated bucket array with the same hash_min() indexing.
+ */
+struct fixed_table {
+    struct hlist_head *buckets;
+    unsigned int bits;
+};
+
+static struct hlist_head *fixed_bucket(struct fixed_table *t, uint64_t key) {
+    return &t->buckets[hash_min(key, t->bits)];
+}
+
+static struct bench_obj *fixed_find(struct fixed_table *t, uint64_t key) {
+    struct bench_obj *obj;
+
+    hlist_for_each_entry(obj, fixed_bucket(t, key), hnode)
+        if (obj->key == key)
+            return obj;
+    return NULL;
+}
+
+static void fixed_fill(struct fixed_table *t, struct bench_obj *o, size_t n) {
+    size_t i;
+
+    __hash_init(t->buckets, 1U << t->bits);
+    for (i = 0; i < n; i++)
+        hlist_add_head(&o[i].hnode, fixed_bucket(t, o[i].key));
+}
+
+/* load factors are expressed in quarters: 1 = 0.25 ... 16 = 4.0 */
+static const unsigned int load_quarters[] = { 1, 4, 16 };
+
+static void run_fixed(
+    struct bench_ctx *ctx,
+    struct bench_obj *objs,
+    uint64_t *misses,
+    size_t *order,
+    size_t n
+) {
+    struct fixed_table t;
+    char variant[32];
+    uint64_t best;
+    size_t i, k, nr_buckets;
+
+    for (k = 0; k < sizeof(load_quarters) / sizeof(load_quarters[0]); k++) {
+        nr_buckets = n * 4 / load_quarters[k];
+        t.bits = nr_buckets > 1 ? ilog2(nr_buckets) : 0;
+        t.buckets = malloc(sizeof(*t.buckets) << t.bits);
+        if (!t.buckets)
+            abort();
+        snprintf(
+            variant,
+            sizeof(variant),
+            "hashtable:load=%.2f",
+            (double) n / (1UL << t.bits)
+        );
+
+        if (bench_enabled(ctx, SUITE, "add")) {
+            bench_measure(ctx, best, , fixed_fill(&t, objs, n), );
+            bench_report(ctx, SUITE, "add", variant, n, 1, n, best);
+        }
+
+        if (bench_enabled(ctx, SUITE, "lookup")) {
+            fixed_fill(&t, objs, n);
+            bench_measure(
+                ctx,
+                best,
+                ,
+                for (i = 0; i < n; i++)
+                    bench_keep(fixed_find(&t, objs[order[i]].key)),
+            );
+            bench_report(ctx, SUITE, "lookup_hit", variant, n, 1, n, best);
+
+            bench_measure(
+                ctx,
+                best,
+                ,
+                for (i = 0; i < n; i++) bench_keep(fixed_find(&t, misses[i])),
+            );
+            bench_report(ctx, SUITE, "lookup_miss", variant, n, 1, n, best);
+        }
+
+        if (bench_enabled(ctx, SUITE, "del")) {
+            bench_measure(
+                ctx,
+                best,
+                fixed_fill(&t, objs, n),
+                for (i = 0; i < n; i++) hash_del(&objs[order[i]].hnode),
+            );
+            bench_report(ctx, SUITE, "del", variant, n, 1, n, best);
+        }
+
+        free(t.buckets);
+    }
+}
+
+static void dhash_fill(struct dhashtable *ht, struct bench_obj *o, size_t n) {
+    size_t i;
+
+    if (dhash_init(ht, DHASH_MIN_BITS))
+        abort();
+    for (i = 0; i < n; i++)
+        dhash_add(ht, &o[i].dnode, o[i].key);
+}
+
+static void run_dhash(
+    struct bench_ctx *ctx,
+    struct bench_obj *objs,
+    uint64_t *misses,
+    size_t *order,
+    size_t n
+) {
+    struct dhashtable ht;
+    struct dhash_node **out;
+    uint64_t best, *keys;
+    size_t i;
+
+    if (bench_enabled(ctx, SUITE, "add")) {
+        bench_measure(
+            ctx,
+            best,
+            ,
+            dhash_fill(&ht, objs, n),
+            dhash_destroy(&ht)
+        );
+        bench_report(ctx, SUITE, "add", "dhashtable", n, 1, n, best);
+    }
+
+    if (bench_enabled(ctx, SUITE, "lookup")) {
+        dhash_fill(&ht, objs, n);
+        dhash_rehash_finish(&ht);
+        bench_measure(
+            ctx,
+            best,
+            ,
+            for (i = 0; i < n; i++)
+                bench_keep(dhash_find(&ht, objs[order[i]].key)),
+        );
+        bench_report(ctx, SUITE, "lookup_hit", "dhashtable", n, 1, n, best);
+
+        bench_measure(
+            ctx,
+            best,
+            ,
+            for (i = 0; i < n; i++) bench_keep(dhash_find(&ht, misses[i])),
+        );
+        bench_report(ctx, SUITE, "lookup_miss", "dhashtable", n, 1, n, best);
+
+        keys = malloc(sizeof(*keys) * n);
+        out = malloc(sizeof(*out) * n);
+        if (!keys || !out)
+            abort();
+        for (i = 0; i < n; i++)
+            keys[i] = objs[order[i]].key;
+        bench_measure(ctx, best, , dhash_find_batch(&ht, keys, n, out), );
+        bench_report(
+            ctx,
+            SUITE,
+            "lookup_hit",
+            "dhashtable:batch",
+            n,
+            1,
+            n,
+            best
+        );
+
+        bench_measure(ctx, best, , dhash_find_batch(&ht, misses, n, out), );
+        bench_report(
+            ctx,
+            SUITE,
+            "lookup_miss",
+            "dhashtable:batch",
+            n,
+            1,
+            n,
+            best
+        );
+        free(out);
+        free(keys);
+        dhash_destroy(&ht);
+    }
+
+    if (bench_enabled(ctx, SUITE, "del")) {
+        bench_measure(
+            ctx,
+            best,
+            dhash_fill(&ht, objs, n),
+            for (i = 0; i < n; i++) dhash_del(&ht, &objs[order[i]].dnode),
+            dhash_destroy(&ht)
+        );
+        bench_report(ctx, SUITE, "del", "dhashtable", n, 1, n, best);
+    }
+}
+
+static void rhash_fill(struct rhashtable *ht, struct bench_obj *o, size_t n) {
+    size_t i;
+
+    if (rhashtable_init(ht, RHT_MIN_BITS))
+        abort();
+    for (i = 0; i < n; i++)
+        rhashtable_insert(ht, &o[i].rnode, o[i].key);
+}
+
+static void rhash_destroy(struct rhashtable *ht) {
+    rcu_barrier();
+    rhashtable_destroy(ht);
+}
+
+static void run_rhash(
+    struct bench_ctx *ctx,
+    struct bench_obj *objs,
+    uint64_t *misses,
+    size_t *order,
+    size_t n
+) {
+    struct rhashtable ht;
+    uint64_t best;
+    size_t i;
+
+    if (bench_enabled(ctx, SUITE, "add")) {
+        bench_measure(
+            ctx,
+            best,
+            ,
+            rhash_fill(&ht, objs, n),
+            rhash_destroy(&ht)
+        );
+        bench_report(ctx, SUITE, "add", "rhashtable", n, 1, n, best);
+    }
+
+    if (bench_enabled(ctx, SUITE, "lookup")) {
+        rhash_fill(&ht, objs, n);
+        bench_measure(
+            ctx,
+            best,
+            rcu_read_lock(),
+            for (i = 0; i < n; i++)
+                bench_keep(rhashtable_lookup(&ht, objs[order[i]].key)),
+            rcu_read_unlock()
+        );
+        bench_report(ctx, SUITE, "lookup_hit", "rhashtable", n, 1, n, best);
+
+        bench_measure(
+            ctx,
+            best,
+            rcu_read_lock(),
+            for (i = 0; i < n; i++)
+                bench_keep(rhashtable_lookup(&ht, misses[i])),
+            rcu_read_unlock()
+        );
+        bench_report(ctx, SUITE, "lookup_miss", "rhashtable", n, 1, n, best);
+        rhash_destroy(&ht);
+    }
+
+    if (bench_enabled(ctx, SUITE, "del")) {
+        bench_measure(
+            ctx,
+            best,
+            rhash_fill(&ht, objs, n),
+            for (i = 0; i < n; i++)
+                rhashtable_remove(&ht, &objs[order[i]].rnode),
+            rhash_destroy(&ht)
+        );
+        bench_report(ctx, SUITE, "del", "rhashtable", n, 1, n, best);
+    }
+}
+
+static void run_size(struct bench_ctx *ctx, size_t n) {
+    struct bench_obj *objs;
+    uint64_t seed = n, *misses;
+    size_t i, *order;
+
+    objs = malloc(sizeof(*objs) * n);
+    misses = malloc(sizeof(*misses) * n);
+    order = malloc(sizeof(*order) * n);
+    if (!objs || !misses || !order)
+        abort();
+
+    /* even keys are present, odd keys are misses */
+    for (i = 0; i < n; i++) {
+        objs[i].key = bench_rand(&seed) & ~1ULL;
+        misses[i] = bench_rand(&seed) | 1;
+        order[i] = i;
+    }
+    bench_shuffle(order, n, &seed);
+
+    run_fixed(ctx, objs, misses, order, n);
+    run_dhash(ctx, objs, misses, order, n);
+    run_rhash(ctx, objs, misses, order, n);
+
+    free(order);
+    free(misses);
+    free(objs);
+}
+
+void bench_hashtable(struct bench_ctx *ctx) {
+    size_t n;
+
+    bench_for_each_size(ctx, n)
+        run_size(ctx, n);
+}
@@ -0,0 +1,276 @@
+#include <stdlib.h>
+
+#include "bench.h"
+#include "dheap.h"
+#include "pairing_heap.h"
+#include "rbtree.h"
+
+#define SUITE "heap"
+
+/* A scheduler job, queued in one structure at a time */
+struct bench_job {
+    uint64_t key;
+    struct rb_node rb;
+    struct pheap_node ph;
+    struct dheap_node dh;
+    struct list_head list;
+};
+
+static inline bool rb_less(struct rb_node *a, const struct rb_node *b) {
+    return rb_entry(a, struct bench_job, rb)->key <
+           rb_entry(b, struct bench_job, rb)->key;
+}
+
+static inline bool ph_less(struct pheap_node *a, const struct pheap_node *b) {
+    return pheap_entry(a, struct bench_job, ph)->key <
+           pheap_entry(b, struct bench_job, ph)->key;
+}
+
+static inline bool dh_less(struct dheap_node *a, const struct dheap_node *b) {
+    return dheap_entry(a, struct bench_job, dh)->key <
+           dheap_entry(b, struct bench_job, dh)->key;
+}
+
+static void fill_rb(
+    struct rb_root_cached *root,
+    struct bench_job *jobs,
+    size_t n
+) {
+    size_t i;
+
+    *root = RB_ROOT_CACHED;
+    for (i = 0; i < n; i++)
+        rb_add_cached(&jobs[i].rb, root, rb_less);
+}
+
+static void fill_ph(struct pheap_root *root, struct bench_job *jobs, size_t n) {
+    size_t i;
+
+    *root = PHEAP_ROOT;
+    for (i = 0; i < n; i++)
+        pheap_add(&jobs[i].ph, root, ph_less);
+}
+
+static void fill_dh(struct dheap *heap, struct bench_job *jobs, size_t n) {
+    size_t i;
+
+    heap->nr = 0;
+    for (i = 0; i < n; i++)
+        if (dheap_push(heap, &jobs[i].dh, dh_less))
+            abort();
+}
+
+static void reset_keys(struct bench_job *jobs, size_t n, uint64_t seed) {
+    size_t i;
+
+    for (i = 0; i < n; i++)
+        jobs[i].key = bench_rand(&seed) >> 2;
+}
+
+/*
+ * The hold model of a scheduler: dequeue the earliest job and queue it
+ * again a random distance later.
+ */
+static void hold_rb(struct rb_root_cached *root, size_t n, uint64_t seed) {
+    struct bench_job *job;
+    struct rb_node *rb;
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        rb = rb_first_cached(root);
+        rb_erase_cached(rb, root);
+        job = rb_entry(rb, struct bench_job, rb);
+        job->key += bench_rand(&seed) >> 4;
+        rb_add_cached(rb, root, rb_less);
+    }
+}
+
+static void hold_ph(struct pheap_root *root, size_t n, uint64_t seed) {
+    struct bench_job *job;
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        job = pheap_entry(pheap_pop(root, ph_less), struct bench_job, ph);
+        job->key += bench_rand(&seed) >> 4;
+        pheap_add(&job->ph, root, ph_less);
+    }
+}
+
+static void hold_dh(struct dheap *heap, size_t n, uint64_t seed) {
+    struct bench_job *job;
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        job = dheap_entry(dheap_first(heap), struct bench_job, dh);
+        job->key += bench_rand(&seed) >> 4;
+        dheap_update(heap, &job->dh, dh_less);
+    }
+}
+
+static void run_size(struct bench_ctx *ctx, size_t n) {
+    struct rb_root_cached rb_root;
+    struct pheap_root ph_root;
+    struct dheap heap = DHEAP_INIT;
+    struct bench_job *jobs, *job;
+    uint64_t seed = n, best;
+    size_t i, *order;
+    LIST_HEAD(list);
+
+    jobs = malloc(sizeof(*jobs) * n);
+    order = malloc(sizeof(*order) * n);
+    if (!jobs || !order || dheap_reserve(&heap, n))
+        abort();
+    for (i = 0; i < n; i++)
+        order[i] = i;
+    bench_shuffle(order, n, &seed);
+
+    if (bench_enabled(ctx, SUITE, "hold")) {
+        bench_measure(
+            ctx,
+            best,
+            reset_keys(jobs, n, seed);
+            fill_rb(&rb_root, jobs, n),
+            hold_rb(&rb_root, n, seed),
+        );
+        bench_report(ctx, SUITE, "hold", "rbtree", n, 1, n, best);
+
+        bench_measure(
+            ctx,
+            best,
+            reset_keys(jobs, n, seed);
+            fill_ph(&ph_root, jobs, n),
+            hold_ph(&ph_root, n, seed),
+        );
+        bench_report(ctx, SUITE, "hold", "pairing", n, 1, n, best);
+
+        bench_measure(
+            ctx,
+            best,
+            reset_keys(jobs, n, seed);
+            fill_dh(&heap, jobs, n),
+            hold_dh(&heap, n, seed),
+        );
+        bench_report(ctx, SUITE, "hold", "dheap", n, 1, n, best);
+    }
+
+    if (bench_enabled(ctx, SUITE, "decrease")) {
+        bench_measure(
+            ctx,
+            best,
+            reset_keys(jobs, n, seed);
+            fill_rb(&rb_root, jobs, n),
+            for (i = 0; i < n; i++) {
+                job = &jobs[order[i]];
+                rb_erase_cached(&job->rb, &rb_root);
+                job->key >>= 1;
+                rb_add_cached(&job->rb, &rb_root, rb_less);
+            },
+        );
+        bench_report(ctx, SUITE, "decrease", "rbtree", n, 1, n, best);
+
+        bench_measure(
+            ctx,
+            best,
+            reset_keys(jobs, n, seed);
+            fill_ph(&ph_root, jobs, n),
+            for (i = 0; i < n; i++) {
+                job = &jobs[order[i]];
+                job->key >>= 1;
+                pheap_decrease(&job->ph, &ph_root, ph_less);
+            },
+        );
+        bench_report(ctx, SUITE, "decrease", "pairing", n, 1, n, best);
+
+        bench_measure(
+            ctx,
+            best,
+            reset_keys(jobs, n, seed);
+            fill_dh(&heap, jobs, n),
+            for (i = 0; i < n; i++) {
+                job = &jobs[order[i]];
+                job->key >>= 1;
+                dheap_decrease(&heap, &job->dh, dh_less);
+            },
+        );
+        bench_report(ctx, SUITE, "decrease", "dheap", n, 1, n, best);
+    }
+
+    /* a queue is built to be used: include its first pop */
+    if (bench_enabled(ctx, SUITE, "build")) {
+        reset_keys(jobs, n, seed);
+        INIT_LIST_HEAD(&list);
+        for (i = 0; i < n; i++)
+            list_add_tail(&jobs[i].list, &list);
+
+        bench_measure(
+            ctx,
+            best,
+            ,
+            fill_rb(&rb_root, jobs, n);
+            rb_erase_cached(rb_first_cached(&rb_root), &rb_root),
+        );
+        bench_report(ctx, SUITE, "build", "rbtree", n, 1, n, best);
+
+        bench_measure(
+            ctx,
+            best,
+            ,
+            fill_ph(&ph_root, jobs, n);
+            pheap_pop(&ph_root, ph_less),
+        );
+        bench_report(ctx, SUITE, "build", "pairing", n, 1, n, best);
+
+        bench_measure(
+            ctx,
+            best,
+            ph_root = PHEAP_ROOT,
+            pheap_build_list(
+                &list,
+                &ph_root,
+                struct bench_job,
+                list,
+                ph,
+                ph_less
+            );
+            pheap_pop(&ph_root, ph_less),
+        );
+        bench_report(ctx, SUITE, "build", "pairing_list", n, 1, n, best);
+
+        bench_measure(
+            ctx,
+            best,
+            ,
+            fill_dh(&heap, jobs, n);
+            dheap_pop(&heap, dh_less),
+        );
+        bench_report(ctx, SUITE, "build", "dheap", n, 1, n, best);
+
+        bench_measure(
+            ctx,
+            best,
+            heap.nr = 0,
+            if (dheap_heapify_list(
+                    &heap,
+                    &list,
+                    struct bench_job,
+                    list,
+                    dh,
+                    dh_less
+                ))
+                abort();
+            dheap_pop(&heap, dh_less),
+        );
+        bench_report(ctx, SUITE, "build", "dheap_list", n, 1, n, best);
+    }
+
+    dheap_destroy(&heap);
+    free(order);
+    free(jobs);
+}
+
+void bench_heap(struct bench_ctx *ctx) {
+    size_t n;
+
+    bench_for_each_size(ctx, n)
+        run_size(ctx, n);
+}
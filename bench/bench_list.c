@@ -0,0 +1,138 @@
+#include <stdlib.h>
+
+#include "bench.h"
+#include "list.h"
+#include "list_sort.h"
+
+#define SUITE "list"
+
+struct bench_entry {
+    struct list_head list;
+    struct hlist_node hnode;
+    uint64_t key;
+};
+
+static int entry_cmp(
+    void *priv,
+    const struct list_head *a,
+    const struct list_head *b
+) {
+    (void) priv;
+    return list_entry(a, struct bench_entry, list)->key >
+           list_entry(b, struct bench_entry, list)->key;
+}
+
+static void fill(struct list_head *head, struct bench_entry *e, size_t n) {
+    size_t i;
+
+    INIT_LIST_HEAD(head);
+    for (i = 0; i < n; i++)
+        list_add_tail(&e[i].list, head);
+}
+
+static void fill_hlist(
+    struct hlist_head *head,
+    struct bench_entry *e,
+    size_t n
+) {
+    size_t i;
+
+    INIT_HLIST_HEAD(head);
+    for (i = 0; i < n; i++)
+        hlist_add_head(&e[i].hnode, head);
+}
+
+static void run_size(struct bench_ctx *ctx, size_t n) {
+    struct bench_entry *entries, *pos;
+    struct hlist_head hhead;
+    LIST_HEAD(head);
+    uint64_t seed = n, best, sum;
+    size_t i, *order;
+
+    entries = malloc(sizeof(*entries) * n);
+    order = malloc(sizeof(*order) * n);
+    if (!entries || !order)
+        abort();
+    for (i = 0; i < n; i++) {
+        entries[i].key = bench_rand(&seed);
+        order[i] = i;
+    }
+    bench_shuffle(order, n, &seed);
+
+    if (bench_enabled(ctx, SUITE, "add")) {
+        bench_measure(ctx, best, , fill(&head, entries, n), );
+        bench_report(ctx, SUITE, "add", "list_add_tail", n, 1, n, best);
+
+        bench_measure(ctx, best, , fill_hlist(&hhead, entries, n), );
+        bench_report(ctx, SUITE, "add", "hlist_add_head", n, 1, n, best);
+    }
+
+    if (bench_enabled(ctx, SUITE, "iterate")) {
+        /* link in random order so that the walk chases cache misses */
+        INIT_LIST_HEAD(&head);
+        for (i = 0; i < n; i++)
+            list_add_tail(&entries[order[i]].list, &head);
+        bench_measure(
+            ctx,
+            best,
+            sum = 0,
+            list_for_each_entry(pos, &head, list) sum += pos->key,
+            bench_keep(&sum)
+        );
+        bench_report(ctx, SUITE, "iterate", "list", n, 1, n, best);
+
+        INIT_HLIST_HEAD(&hhead);
+        for (i = 0; i < n; i++)
+            hlist_add_head(&entries[order[i]].hnode, &hhead);
+        bench_measure(
+            ctx,
+            best,
+            sum = 0,
+            hlist_for_each_entry(pos, &hhead, hnode) sum += pos->key,
+            bench_keep(&sum)
+        );
+        bench_report(ctx, SUITE, "iterate", "hlist", n, 1, n, best);
+    }
+
+    if (bench_enabled(ctx, SUITE, "del")) {
+        bench_measure(
+            ctx,
+            best,
+            fill(&head, entries, n),
+            for (i = 0; i < n; i++) list_del(&entries[order[i]].list),
+        );
+        bench_report(ctx, SUITE, "del", "list_del", n, 1, n, best);
+
+        bench_measure(
+            ctx,
+            best,
+            fill_hlist(&hhead, entries, n),
+            for (i = 0; i < n; i++) hlist_del(&entries[order[i]].hnode),
+        );
+        bench_report(ctx, SUITE, "del", "hlist_del", n, 1, n, best);
+    }
+
+    if (bench_enabled(ctx, SUITE, "sort")) {
+        bench_measure(
+            ctx,
+            best,
+            fill(&head, entries, n),
+            list_sort(NULL, &head, entry_cmp),
+        );
+        bench_report(ctx, SUITE, "sort", "random", n, 1, n, best);
+
+        /* the list is sorted now, sort it again */
+        bench_measure(ctx, best, , list_sort(NULL, &head, entry_cmp), );
+        bench_report(ctx, SUITE, "sort", "sorted", n, 1, n, best);
+    }
+
+    free(order);
+    free(entries);
+}
+
+void bench_list(struct bench_ctx *ctx) {
+    size_t n;
+
+    bench_for_each_size(ctx, n)
+        run_size(ctx, n);
+}
@@ -0,0 +1,176 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "list.h"
+#include "llist.h"
+
+#define SUITE "llist"
+
+enum handoff_kind {
+    HANDOFF_MUTEX_LIST,
+    HANDOFF_LLIST,
+};
+
+static const char *const handoff_kind_names[] = {
+    [HANDOFF_MUTEX_LIST] = "mutex_list",
+    [HANDOFF_LLIST] = "llist",
+};
+
+struct work_item {
+    struct list_head list;
+    struct llist_node lnode;
+    uint64_t payload;
+};
+
+/* Producers hand work items to the one consumer, the calling thread */
+struct handoff_bench {
+    enum handoff_kind kind;
+    size_t per_producer;
+    pthread_barrier_t start;
+    pthread_mutex_t lock;
+    struct list_head queue;
+    struct llist_head lqueue;
+};
+
+struct handoff_producer {
+    struct handoff_bench *hb;
+    struct work_item *items;
+    pthread_t thread;
+};
+
+static void *producer_fn(void *arg) {
+    struct handoff_producer *p = arg;
+    struct handoff_bench *hb = p->hb;
+    size_t i;
+
+    pthread_barrier_wait(&hb->start);
+    for (i = 0; i < hb->per_producer; i++) {
+        if (hb->kind == HANDOFF_LLIST) {
+            llist_add(&p->items[i].lnode, &hb->lqueue);
+            continue;
+        }
+        pthread_mutex_lock(&hb->lock);
+        list_add_tail(&p->items[i].list, &hb->queue);
+        pthread_mutex_unlock(&hb->lock);
+    }
+    return NULL;
+}
+
+/* Take whatever was queued, oldest first, and return how many items */
+static size_t consume(struct handoff_bench *hb) {
+    struct work_item *pos;
+    struct llist_node *first;
+    uint64_t sum = 0;
+    size_t nr = 0;
+    LIST_HEAD(batch);
+
+    if (hb->kind == HANDOFF_LLIST) {
+        first = llist_reverse_order(llist_del_all(&hb->lqueue));
+        llist_for_each_entry(pos, first, lnode) {
+            sum += pos->payload;
+            nr++;
+        }
+    } else {
+        pthread_mutex_lock(&hb->lock);
+        list_splice_init(&hb->queue, &batch);
+        pthread_mutex_unlock(&hb->lock);
+        list_for_each_entry(pos, &batch, list) {
+            sum += pos->payload;
+            nr++;
+        }
+    }
+    bench_keep(&sum);
+    return nr;
+}
+
+/*
+ * Time @nr_threads producers queueing ->per_producer items each until the
+ * consumer has taken all of them.
+ */
+static uint64_t run_handoff(
+    struct handoff_bench *hb,
+    struct handoff_producer *producers,
+    unsigned int nr_threads
+) {
+    size_t left = hb->per_producer * nr_threads;
+    unsigned int i;
+    uint64_t t;
+
+    INIT_LIST_HEAD(&hb->queue);
+    init_llist_head(&hb->lqueue);
+    pthread_barrier_init(&hb->start, NULL, nr_threads + 1);
+    for (i = 0; i < nr_threads; i++) {
+        producers[i].hb = hb;
+        pthread_create(&producers[i].thread, NULL, producer_fn, &producers[i]);
+    }
+
+    pthread_barrier_wait(&hb->start);
+    t = bench_now_ns();
+    while (left)
+        left -= consume(hb);
+    t = bench_now_ns() - t;
+
+    for (i = 0; i < nr_threads; i++)
+        pthread_join(producers[i].thread, NULL);
+    pthread_barrier_destroy(&hb->start);
+    return t;
+}
+
+static void run_kind(
+    struct bench_ctx *ctx,
+    enum handoff_kind kind,
+    size_t total,
+    unsigned int nr_threads
+) {
+    struct handoff_producer *producers;
+    struct handoff_bench hb;
+    struct work_item *items;
+    uint64_t best, t;
+    unsigned int i;
+    size_t j;
+
+    hb.kind = kind;
+    hb.per_producer = total / nr_threads;
+    pthread_mutex_init(&hb.lock, NULL);
+    producers = calloc(nr_threads, sizeof(*producers));
+    items = malloc(sizeof(*items) * hb.per_producer * nr_threads);
+    if (!producers || !items)
+        abort();
+    for (j = 0; j < hb.per_producer * nr_threads; j++)
+        items[j].payload = j;
+    for (i = 0; i < nr_threads; i++)
+        producers[i].items = items + hb.per_producer * i;
+
+    best = UINT64_MAX;
+    for (i = 0; i < ctx->reps; i++) {
+        t = run_handoff(&hb, producers, nr_threads);
+        if (t < best)
+            best = t;
+    }
+    bench_report(
+        ctx,
+        SUITE,
+        "handoff",
+        handoff_kind_names[kind],
+        total,
+        nr_threads,
+        hb.per_producer * nr_threads,
+        best
+    );
+
+    pthread_mutex_destroy(&hb.lock);
+    free(items);
+    free(producers);
+}
+
+void bench_llist(struct bench_ctx *ctx) {
+    enum handoff_kind kind;
+    unsigned int t;
+
+    if (bench_enabled(ctx, SUITE, "handoff"))
+        for (kind = HANDOFF_MUTEX_LIST; kind <= HANDOFF_LLIST; kind++)
+            bench_for_each_threads(ctx, t)
+                run_kind(ctx, kind, ctx->max_size, t);
+}
@@ -0,0 +1,132 @@
+#include <stdlib.h>
+
+#include "bench.h"
+#include "hash.h"
+#include "list_sort.h"
+#include "parallel.h"
+
+#define SUITE "parallel"
+
+/*
+ * Every op runs serially (a NULL pool) at one thread and on a pool of
+ * @threads workers above, so the threads=1 rows are the baseline.
+ */
+struct par_item {
+    struct hlist_node hnode;
+    struct rb_node rb;
+    struct list_head list;
+    uint64_t key;
+    uint64_t val;
+};
+
+/* A few cycles of work per node, enough not to time the walk alone */
+static inline void touch(struct par_item *item) {
+    uint64_t state = item->key;
+
+    item->val = bench_rand(&state);
+}
+
+static void visit_hnode(struct hlist_node *node, void *arg) {
+    (void) arg;
+    touch(hlist_entry(node, struct par_item, hnode));
+}
+
+static void visit_rb(struct rb_node *node, void *arg) {
+    (void) arg;
+    touch(rb_entry(node, struct par_item, rb));
+}
+
+static bool par_less(struct rb_node *a, const struct rb_node *b) {
+    return rb_entry(a, struct par_item, rb)->key <
+           rb_entry(b, struct par_item, rb)->key;
+}
+
+static int par_cmp(
+    void *priv,
+    const struct list_head *a,
+    const struct list_head *b
+) {
+    (void) priv;
+    return list_entry(a, struct par_item, list)->key >
+           list_entry(b, struct par_item, list)->key;
+}
+
+static const char *variant(struct thread_pool *pool) {
+    return pool ? "pool" : "serial";
+}
+
+static void run_size(struct bench_ctx *ctx, size_t n, unsigned int nr) {
+    struct thread_pool pool, *p = NULL;
+    struct hlist_head *ht;
+    struct par_item *items;
+    struct rb_root root = RB_ROOT;
+    unsigned int bits;
+    uint64_t best, state = 42;
+    size_t i;
+    LIST_HEAD(head);
+
+    if (nr > 1) {
+        if (thread_pool_init(&pool, nr))
+            abort();
+        p = &pool;
+    }
+    for (bits = 1; (1UL << bits) < n; bits++)
+        ;
+    ht = malloc(sizeof(*ht) << bits);
+    items = malloc(sizeof(*items) * n);
+    if (!ht || !items)
+        abort();
+    __hash_init(ht, 1U << bits);
+    for (i = 0; i < n; i++) {
+        items[i].key = bench_rand(&state);
+        hlist_add_head(&items[i].hnode, &ht[hash_64(items[i].key, bits)]);
+        rb_add(&items[i].rb, &root, par_less);
+    }
+
+    if (bench_enabled(ctx, SUITE, "hash_for_each")) {
+        bench_measure(
+            ctx,
+            best,
+            ,
+            __hash_for_each_parallel(p, ht, 1U << bits, visit_hnode, NULL),
+        );
+        bench_report(ctx, SUITE, "hash_for_each", variant(p), n, nr, n, best);
+    }
+
+    if (bench_enabled(ctx, SUITE, "postorder")) {
+        bench_measure(
+            ctx,
+            best,
+            ,
+            rb_postorder_parallel(p, &root, visit_rb, NULL),
+        );
+        bench_report(ctx, SUITE, "postorder", variant(p), n, nr, n, best);
+    }
+
+    /* the same random input every repetition */
+    if (bench_enabled(ctx, SUITE, "list_sort")) {
+        bench_measure(
+            ctx,
+            best,
+            INIT_LIST_HEAD(&head);
+            for (i = 0; i < n; i++)
+                list_add_tail(&items[i].list, &head),
+            list_sort_parallel(p, NULL, &head, par_cmp),
+        );
+        bench_report(ctx, SUITE, "list_sort", variant(p), n, nr, n, best);
+    }
+
+    free(items);
+    free(ht);
+    if (p)
+        thread_pool_destroy(p);
+}
+
+void bench_parallel(struct bench_ctx *ctx) {
+    unsigned int t;
+    size_t n;
+
+    bench_for_each_size(ctx, n)
+        bench_for_each_threads(ctx, t)
+            run_size(ctx, n, t);
+}
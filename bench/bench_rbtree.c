@@ -0,0 +1,330 @@
+#include <stdlib.h>
+
+#include "bench.h"
+#include "rbtree.h"
+#include "rbtree_augmented.h"
+#include "rbtree_frozen.h"
+
+#define SUITE "rbtree"
+
+struct bench_node {
+    struct rb_node rb;
+    uint64_t key;
+    uint64_t val;
+    uint64_t max;
+};
+
+#define NODE_VAL(node) ((node)->val)
+
+RB_DECLARE_CALLBACKS_MAX(
+    static,
+    bench_augment_cb,
+    struct bench_node,
+    rb,
+    uint64_t,
+    max,
+    NODE_VAL
+)
+
+static inline bool node_less(struct rb_node *a, const struct rb_node *b) {
+    return rb_entry(a, struct bench_node, rb)->key <
+           rb_entry(b, struct bench_node, rb)->key;
+}
+
+static inline int key_cmp(const void *key, const struct rb_node *b) {
+    uint64_t ka = *(const uint64_t *) key;
+    uint64_t kb = rb_entry(b, struct bench_node, rb)->key;
+
+    return ka < kb ? -1 : ka > kb;
+}
+
+static uint64_t node_key(const struct rb_node *rb) {
+    return rb_entry(rb, struct bench_node, rb)->key;
+}
+
+static int bench_node_cmp(const void *a, const void *b) {
+    uint64_t ka = ((const struct bench_node *) a)->key;
+    uint64_t kb = ((const struct bench_node *) b)->key;
+
+    return ka < kb ? -1 : ka > kb;
+}
+
+static void fill(struct rb_root *root, struct bench_node *nodes, size_t n) {
+    size_t i;
+
+    *root = RB_ROOT;
+    for (i = 0; i < n; i++)
+        rb_add(&nodes[i].rb, root, node_less);
+}
+
+static void fill_cached(
+    struct rb_root_cached *root,
+    struct bench_node *nodes,
+    size_t n
+) {
+    size_t i;
+
+    *root = RB_ROOT_CACHED;
+    for (i = 0; i < n; i++)
+        rb_add_cached(&nodes[i].rb, root, node_less);
+}
+
+static void fill_augmented(
+    struct rb_root_cached *root,
+    struct bench_node *nodes,
+    size_t n
+) {
+    size_t i;
+
+    *root = RB_ROOT_CACHED;
+    for (i = 0; i < n; i++)
+        rb_add_augmented_cached(
+            &nodes[i].rb,
+            root,
+            node_less,
+            &bench_augment_cb
+        );
+}
+
+static void fill_hint(
+    struct rb_root *root,
+    struct bench_node *nodes,
+    size_t n
+) {
+    struct rb_node *hint = NULL;
+    size_t i;
+
+    *root = RB_ROOT;
+    for (i = 0; i < n; i++) {
+        rb_add_hint(&nodes[i].rb, hint, root, node_less);
+        hint = &nodes[i].rb;
+    }
+}
+
+static void fill_rcached(
+    struct rb_root_rcached *root,
+    struct bench_node *nodes,
+    size_t n
+) {
+    size_t i;
+
+    *root = RB_ROOT_RCACHED;
+    for (i = 0; i < n; i++)
+        rb_add_rcached(&nodes[i].rb, root, node_less);
+}
+
+/* Sorted @nodes, then every key moved back or forth by up to 8 places */
+static void near_sorted(struct bench_node *nodes, size_t n, uint64_t *seed) {
+    struct bench_node tmp;
+    size_t i, j;
+
+    qsort(nodes, n, sizeof(*nodes), bench_node_cmp);
+    for (i = 0; i + 1 < n; i++) {
+        j = i + bench_rand(seed) % 8;
+        if (j >= n)
+            j = n - 1;
+        tmp = nodes[i];
+        nodes[i] = nodes[j];
+        nodes[j] = tmp;
+    }
+}
+
+static void run_size(struct bench_ctx *ctx, size_t n) {
+    struct rb_root_cached croot;
+    struct rb_root_rcached rroot;
+    struct rb_frozen frozen;
+    struct rb_root root;
+    struct bench_node *nodes, *sorted;
+    struct rb_node **array, *rb;
+    const void **keys;
+    uint64_t seed = n, best;
+    size_t i, *order;
+
+    nodes = malloc(sizeof(*nodes) * n);
+    sorted = malloc(sizeof(*sorted) * n);
+    array = malloc(sizeof(*array) * n);
+    order = malloc(sizeof(*order) * n);
+    keys = malloc(sizeof(*keys) * n);
+    if (!nodes || !sorted || !array || !order || !keys)
+        abort();
+
+    for (i = 0; i < n; i++) {
+        nodes[i].key = bench_rand(&seed);
+        nodes[i].val = bench_rand(&seed);
+        order[i] = i;
+    }
+    bench_shuffle(order, n, &seed);
+
+    if (bench_enabled(ctx, SUITE, "insert")) {
+        bench_measure(ctx, best, , fill(&root, nodes, n), );
+        bench_report(ctx, SUITE, "insert", "random", n, 1, n, best);
+    }
+
+    if (bench_enabled(ctx, SUITE, "insert_cached")) {
+        bench_measure(ctx, best, , fill_cached(&croot, nodes, n), );
+        bench_report(ctx, SUITE, "insert_cached", "random", n, 1, n, best);
+    }
+
+    if (bench_enabled(ctx, SUITE, "insert_augmented")) {
+        bench_measure(ctx, best, , fill_augmented(&croot, nodes, n), );
+        bench_report(ctx, SUITE, "insert_augmented", "random", n, 1, n, best);
+    }
+
+    if (bench_enabled(ctx, SUITE, "append")) {
+        for (i = 0; i < n; i++)
+            sorted[i] = nodes[i];
+        qsort(sorted, n, sizeof(*sorted), bench_node_cmp);
+
+        bench_measure(ctx, best, , fill(&root, sorted, n), );
+        bench_report(ctx, SUITE, "append", "sorted", n, 1, n, best);
+        bench_measure(ctx, best, , fill_hint(&root, sorted, n), );
+        bench_report(ctx, SUITE, "append", "sorted_hint", n, 1, n, best);
+        bench_measure(ctx, best, , fill_rcached(&rroot, sorted, n), );
+        bench_report(ctx, SUITE, "append", "sorted_rcached", n, 1, n, best);
+
+        near_sorted(sorted, n, &seed);
+        bench_measure(ctx, best, , fill(&root, sorted, n), );
+        bench_report(ctx, SUITE, "append", "near", n, 1, n, best);
+        bench_measure(ctx, best, , fill_hint(&root, sorted, n), );
+        bench_report(ctx, SUITE, "append", "near_hint", n, 1, n, best);
+        bench_measure(ctx, best, , fill_rcached(&rroot, sorted, n), );
+        bench_report(ctx, SUITE, "append", "near_rcached", n, 1, n, best);
+    }
+
+    if (bench_enabled(ctx, SUITE, "find")) {
+        fill(&root, nodes, n);
+        bench_measure(
+            ctx,
+            best,
+            ,
+            for (i = 0; i < n; i++) bench_keep(
+                rb_find(&nodes[order[i]].key, &root, key_cmp)
+            ),
+        );
+        bench_report(ctx, SUITE, "find", "hit", n, 1, n, best);
+
+        for (i = 0; i < n; i++)
+            keys[i] = &nodes[order[i]].key;
+        bench_measure(
+            ctx,
+            best,
+            ,
+            rb_find_batch(keys, n, &root, key_cmp, array),
+        );
+        bench_report(ctx, SUITE, "find", "hit_batch", n, 1, n, best);
+
+        if (rb_freeze(&frozen, &root, node_key))
+            abort();
+        bench_measure(
+            ctx,
+            best,
+            ,
+            for (i = 0; i < n; i++) bench_keep(
+                rb_frozen_find(&frozen, nodes[order[i]].key)
+            ),
+        );
+        bench_report(ctx, SUITE, "find", "hit_frozen", n, 1, n, best);
+        rb_frozen_destroy(&frozen);
+    }
+
+    if (bench_enabled(ctx, SUITE, "iterate")) {
+        fill(&root, nodes, n);
+        bench_measure(
+            ctx,
+            best,
+            ,
+            for (rb = rb_first(&root); rb; rb = rb_next(rb)) bench_keep(rb),
+        );
+        bench_report(ctx, SUITE, "iterate", "inorder", n, 1, n, best);
+
+        bench_measure(
+            ctx,
+            best,
+            ,
+            for (rb = rb_first_postorder(&root); rb;
+                 rb = rb_next_postorder(rb)) bench_keep(rb),
+        );
+        bench_report(ctx, SUITE, "iterate", "postorder", n, 1, n, best);
+    }
+
+    if (bench_enabled(ctx, SUITE, "first")) {
+        fill_cached(&croot, nodes, n);
+        bench_measure(
+            ctx,
+            best,
+            ,
+            for (i = 0; i < n; i++) bench_keep(rb_first(&croot.rb_root)),
+        );
+        bench_report(ctx, SUITE, "first", "uncached", n, 1, n, best);
+
+        bench_measure(
+            ctx,
+            best,
+            ,
+            for (i = 0; i < n; i++) bench_keep(rb_first_cached(&croot)),
+        );
+        bench_report(ctx, SUITE, "first", "cached", n, 1, n, best);
+    }
+
+    if (bench_enabled(ctx, SUITE, "erase")) {
+        bench_measure(
+            ctx,
+            best,
+            fill(&root, nodes, n),
+            for (i = 0; i < n; i++) rb_erase(&nodes[order[i]].rb, &root),
+        );
+        bench_report(ctx, SUITE, "erase", "random", n, 1, n, best);
+    }
+
+    if (bench_enabled(ctx, SUITE, "erase_cached")) {
+        bench_measure(
+            ctx,
+            best,
+            fill_cached(&croot, nodes, n),
+            for (i = 0; i < n; i++)
+                rb_erase_cached(&nodes[order[i]].rb, &croot),
+        );
+        bench_report(ctx, SUITE, "erase_cached", "random", n, 1, n, best);
+    }
+
+    if (bench_enabled(ctx, SUITE, "erase_augmented")) {
+        bench_measure(
+            ctx,
+            best,
+            fill_augmented(&croot, nodes, n),
+            for (i = 0; i < n; i++) rb_erase_augmented_cached(
+                &nodes[order[i]].rb,
+                &croot,
+                &bench_augment_cb
+            ),
+        );
+        bench_report(ctx, SUITE, "erase_augmented", "random", n, 1, n, best);
+    }
+
+    if (bench_enabled(ctx, SUITE, "build")) {
+        for (i = 0; i < n; i++)
+            sorted[i] = nodes[i];
+        qsort(sorted, n, sizeof(*sorted), bench_node_cmp);
+        for (i = 0; i < n; i++)
+            array[i] = &sorted[i].rb;
+
+        bench_measure(ctx, best, , rb_build(array, n, &root), );
+        bench_report(ctx, SUITE, "build", "rb_build", n, 1, n, best);
+
+        bench_measure(ctx, best, , fill(&root, sorted, n), );
+        bench_report(ctx, SUITE, "build", "sorted_insert", n, 1, n, best);
+    }
+
+    free(keys);
+    free(order);
+    free(array);
+    free(sorted);
+    free(nodes);
+}
+
+void bench_rbtree(struct bench_ctx *ctx) {
+    size_t n;
+
+    bench_for_each_size(ctx, n)
+        run_size(ctx, n);
+}
@@ -0,0 +1,191 @@
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "cache.h"
+#include "percpu_ref.h"
+#include "refcount.h"
+
+#define SUITE "refcount"
+
+enum ref_kind {
+    REF_ARC_SHARED,
+    REF_ARC_PRIVATE,
+    REF_PERCPU,
+};
+
+static const char *const ref_kind_names[] = {
+    [REF_ARC_SHARED] = "arc_shared",
+    [REF_ARC_PRIVATE] = "arc_private",
+    [REF_PERCPU] = "percpu_ref",
+};
+
+struct padded_arc {
+    struct arc arc;
+} ____cacheline_aligned;
+
+struct ref_bench {
+    enum ref_kind kind;
+    size_t loops;
+    pthread_barrier_t start;
+    struct padded_arc shared;
+    struct padded_arc *private;
+    struct percpu_ref pref;
+};
+
+struct ref_worker {
+    struct ref_bench *rb;
+    unsigned int id;
+    pthread_t thread;
+    uint64_t start_ns;
+    uint64_t end_ns;
+};
+
+static void percpu_release(struct percpu_ref *ref) {
+    (void) ref;
+}
+
+static void *ref_worker_fn(void *arg) {
+    struct ref_worker *w = arg;
+    struct ref_bench *rb = w->rb;
+    struct arc *arc;
+    size_t i;
+
+    pthread_barrier_wait(&rb->start);
+    w->start_ns = bench_now_ns();
+    switch (rb->kind) {
+    case REF_ARC_SHARED:
+    case REF_ARC_PRIVATE:
+        arc = rb->kind == REF_ARC_SHARED ? &rb->shared.arc
+                                         : &rb->private[w->id].arc;
+        for (i = 0; i < rb->loops; i++) {
+            arc_inc(arc);
+            arc_dec(arc);
+        }
+        break;
+    case REF_PERCPU:
+        for (i = 0; i < rb->loops; i++) {
+            percpu_ref_get(&rb->pref);
+            percpu_ref_put(&rb->pref);
+        }
+        break;
+    }
+    w->end_ns = bench_now_ns();
+    return NULL;
+}
+
+/*
+ * Time @nr_threads threads doing @loops get/put pairs each, from the first
+ * thread starting to the last one finishing.
+ */
+static uint64_t run_threads(
+    struct ref_bench *rb,
+    struct ref_worker *workers,
+    unsigned int nr_threads
+) {
+    uint64_t start = UINT64_MAX, end = 0;
+    unsigned int i;
+
+    pthread_barrier_init(&rb->start, NULL, nr_threads + 1);
+    for (i = 0; i < nr_threads; i++) {
+        workers[i].rb = rb;
+        workers[i].id = i;
+        pthread_create(&workers[i].thread, NULL, ref_worker_fn, &workers[i]);
+    }
+
+    pthread_barrier_wait(&rb->start);
+
+    for (i = 0; i < nr_threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+        if (workers[i].start_ns < start)
+            start = workers[i].start_ns;
+        if (workers[i].end_ns > end)
+            end = workers[i].end_ns;
+    }
+    pthread_barrier_destroy(&rb->start);
+    return end - start;
+}
+
+static void run_kind(
+    struct bench_ctx *ctx,
+    enum ref_kind kind,
+    size_t loops,
+    unsigned int nr_threads
+) {
+    struct ref_worker *workers;
+    struct ref_bench *rb;
+    uint64_t best;
+    unsigned int i;
+
+    rb = aligned_alloc(SMP_CACHE_BYTES, sizeof(*rb));
+    workers = calloc(nr_threads, sizeof(*workers));
+    rb->private = aligned_alloc(
+        SMP_CACHE_BYTES,
+        sizeof(*rb->private) * nr_threads
+    );
+    if (!rb || !workers || !rb->private)
+        abort();
+
+    rb->kind = kind;
+    rb->loops = loops;
+    arc_init(&rb->shared.arc);
+    arc_inc(&rb->shared.arc);
+    for (i = 0; i < nr_threads; i++) {
+        arc_init(&rb->private[i].arc);
+        arc_inc(&rb->private[i].arc);
+    }
+    if (percpu_ref_init(&rb->pref, percpu_release, 0))
+        abort();
+
+    best = UINT64_MAX;
+    for (i = 0; i < ctx->reps; i++) {
+        uint64_t t = run_threads(rb, workers, nr_threads);
+
+        if (t < best)
+            best = t;
+    }
+    bench_report(
+        ctx,
+        SUITE,
+        "get_put",
+        ref_kind_names[kind],
+        loops,
+        nr_threads,
+        (uint64_t) loops * nr_threads,
+        best
+    );
+
+    percpu_ref_kill(&rb->pref);
+    percpu_ref_exit(&rb->pref);
+    free(rb->private);
+    free(workers);
+    free(rb);
+}
+
+void bench_refcount(struct bench_ctx *ctx) {
+    struct rc rc;
+    uint64_t best;
+    size_t i, loops = ctx->max_size;
+    unsigned int t;
+    enum ref_kind kind;
+
+    if (bench_enabled(ctx, SUITE, "get_put")) {
+        rc_init(&rc);
+        rc_inc(&rc);
+        bench_measure(
+            ctx,
+            best,
+            ,
+            for (i = 0; i < loops; i++) {
+                rc_inc(&rc);
+                bench_keep(&rc);
+                rc_dec(&rc);
+            },
+        );
+        bench_report(ctx, SUITE, "get_put", "rc", loops, 1, loops, best);
+
+        for (kind = REF_ARC_SHARED; kind <= REF_PERCPU; kind++)
+            bench_for_each_threads(ctx, t)
+                run_kind(ctx, kind, loops, t);
+    }
+}
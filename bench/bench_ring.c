@@ -0,0 +1,273 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "list.h"
+#include "ring.h"
+
+#define SUITE "ring"
+
+#define RING_SIZE 1024
+#define BATCH 32
+
+enum ring_kind {
+    RING_SPSC,
+    RING_SPSC_BATCH,
+    RING_MPMC,
+    RING_MPMC_BATCH,
+};
+
+static const char *const ring_kind_names[] = {
+    [RING_SPSC] = "spsc",
+    [RING_SPSC_BATCH] = "spsc_x32",
+    [RING_MPMC] = "mpmc",
+    [RING_MPMC_BATCH] = "mpmc_x32",
+};
+
+struct ring_bench {
+    enum ring_kind kind;
+    size_t per_producer;
+    pthread_barrier_t start;
+    struct spsc_ring spsc;
+    struct mpmc_ring mpmc;
+};
+
+struct ring_producer {
+    struct ring_bench *rb;
+    pthread_t thread;
+};
+
+/* Objects are never dereferenced: pass small integers */
+static void fill_objs(void **objs, uintptr_t first, unsigned int n) {
+    unsigned int i;
+
+    for (i = 0; i < n; i++)
+        objs[i] = (void *) (first + i);
+}
+
+/* Move up to @n objects in or out in the way of @kind */
+static __always_inline unsigned int ring_enqueue(
+    struct ring_bench *rb,
+    void *const *objs,
+    unsigned int n
+) {
+    switch (rb->kind) {
+    case RING_SPSC:
+        return spsc_ring_push(&rb->spsc, objs[0]);
+    case RING_SPSC_BATCH:
+        return spsc_ring_enqueue_burst(&rb->spsc, objs, n);
+    case RING_MPMC:
+        return mpmc_ring_push(&rb->mpmc, objs[0]);
+    default:
+        return mpmc_ring_enqueue_burst(&rb->mpmc, objs, n);
+    }
+}
+
+static __always_inline unsigned int ring_dequeue(
+    struct ring_bench *rb,
+    void **objs,
+    unsigned int n
+) {
+    switch (rb->kind) {
+    case RING_SPSC:
+        return spsc_ring_pop(&rb->spsc, objs);
+    case RING_SPSC_BATCH:
+        return spsc_ring_dequeue_burst(&rb->spsc, objs, n);
+    case RING_MPMC:
+        return mpmc_ring_pop(&rb->mpmc, objs);
+    default:
+        return mpmc_ring_dequeue_burst(&rb->mpmc, objs, n);
+    }
+}
+
+static void *producer_fn(void *arg) {
+    struct ring_producer *p = arg;
+    struct ring_bench *rb = p->rb;
+    size_t left = rb->per_producer;
+    void *objs[BATCH];
+    unsigned int n;
+
+    fill_objs(objs, 1, BATCH);
+    pthread_barrier_wait(&rb->start);
+    while (left) {
+        n = ring_enqueue(rb, objs, left < BATCH ? left : BATCH);
+        if (!n)
+            sched_yield();
+        left -= n;
+    }
+    return NULL;
+}
+
+/*
+ * Time @nr_threads producers pushing ->per_producer objects each through
+ * the ring until the consumer, the calling thread, has taken all of them.
+ * Both sides yield on a full or empty ring rather than spin.
+ */
+static uint64_t run_pipeline(
+    struct ring_bench *rb,
+    struct ring_producer *producers,
+    unsigned int nr_threads
+) {
+    size_t left = rb->per_producer * nr_threads;
+    void *objs[BATCH];
+    unsigned int i, n;
+    uint64_t t;
+
+    pthread_barrier_init(&rb->start, NULL, nr_threads + 1);
+    for (i = 0; i < nr_threads; i++) {
+        producers[i].rb = rb;
+        pthread_create(&producers[i].thread, NULL, producer_fn, &producers[i]);
+    }
+
+    pthread_barrier_wait(&rb->start);
+    t = bench_now_ns();
+    while (left) {
+        n = ring_dequeue(rb, objs, BATCH);
+        if (!n)
+            sched_yield();
+        bench_keep(objs[0]);
+        left -= n;
+    }
+    t = bench_now_ns() - t;
+
+    for (i = 0; i < nr_threads; i++)
+        pthread_join(producers[i].thread, NULL);
+    pthread_barrier_destroy(&rb->start);
+    return t;
+}
+
+static void run_kind(
+    struct bench_ctx *ctx,
+    enum ring_kind kind,
+    size_t total,
+    unsigned int nr_threads
+) {
+    struct ring_producer *producers;
+    struct ring_bench *rb;
+    uint64_t best, t;
+    unsigned int i;
+
+    rb = aligned_alloc(SMP_CACHE_BYTES, sizeof(*rb));
+    producers = calloc(nr_threads, sizeof(*producers));
+    if (!rb || !producers || spsc_ring_init(&rb->spsc, RING_SIZE) ||
+        mpmc_ring_init(&rb->mpmc, RING_SIZE))
+        abort();
+    rb->kind = kind;
+    rb->per_producer = total / nr_threads;
+
+    best = UINT64_MAX;
+    for (i = 0; i < ctx->reps; i++) {
+        t = run_pipeline(rb, producers, nr_threads);
+        if (t < best)
+            best = t;
+    }
+    bench_report(
+        ctx,
+        SUITE,
+        "pipeline",
+        ring_kind_names[kind],
+        total,
+        nr_threads,
+        rb->per_producer * nr_threads,
+        best
+    );
+
+    mpmc_ring_destroy(&rb->mpmc);
+    spsc_ring_destroy(&rb->spsc);
+    free(producers);
+    free(rb);
+}
+
+/* The same traffic through a mutex-protected list_head, one node each */
+struct list_item {
+    struct list_head list;
+};
+
+static void run_single(struct bench_ctx *ctx, size_t total) {
+    struct list_item *items;
+    pthread_mutex_t lock;
+    struct ring_bench *rb;
+    void *objs[BATCH];
+    enum ring_kind kind;
+    uint64_t best;
+    size_t done;
+    unsigned int n, i;
+    LIST_HEAD(queue);
+
+    rb = aligned_alloc(SMP_CACHE_BYTES, sizeof(*rb));
+    items = malloc(sizeof(*items) * BATCH);
+    if (!rb || !items || spsc_ring_init(&rb->spsc, RING_SIZE) ||
+        mpmc_ring_init(&rb->mpmc, RING_SIZE))
+        abort();
+    fill_objs(objs, 1, BATCH);
+
+    /* enqueue a batch, then dequeue it, from one thread */
+    for (kind = RING_SPSC; kind <= RING_MPMC_BATCH; kind++) {
+        rb->kind = kind;
+        bench_measure(
+            ctx,
+            best,
+            ,
+            for (done = 0; done < total; done += BATCH) {
+                for (i = 0; i < BATCH; i += n)
+                    n = ring_enqueue(rb, objs + i, BATCH - i);
+                for (i = 0; i < BATCH; i += n)
+                    n = ring_dequeue(rb, objs + i, BATCH - i);
+            },
+        );
+        bench_report(
+            ctx,
+            SUITE,
+            "single",
+            ring_kind_names[kind],
+            total,
+            1,
+            total,
+            best
+        );
+    }
+
+    pthread_mutex_init(&lock, NULL);
+    bench_measure(
+        ctx,
+        best,
+        ,
+        for (done = 0; done < total; done += BATCH) {
+            for (i = 0; i < BATCH; i++) {
+                pthread_mutex_lock(&lock);
+                list_add_tail(&items[i].list, &queue);
+                pthread_mutex_unlock(&lock);
+            }
+            for (i = 0; i < BATCH; i++) {
+                pthread_mutex_lock(&lock);
+                list_del(queue.next);
+                pthread_mutex_unlock(&lock);
+            }
+        },
+    );
+    bench_report(ctx, SUITE, "single", "mutex_list", total, 1, total, best);
+    pthread_mutex_destroy(&lock);
+
+    mpmc_ring_destroy(&rb->mpmc);
+    spsc_ring_destroy(&rb->spsc);
+    free(items);
+    free(rb);
+}
+
+void bench_ring(struct bench_ctx *ctx) {
+    enum ring_kind kind;
+    unsigned int t;
+
+    if (bench_enabled(ctx, SUITE, "single"))
+        run_single(ctx, ctx->max_size);
+
+    /* the spsc ring takes a single producer */
+    if (bench_enabled(ctx, SUITE, "pipeline"))
+        for (kind = RING_SPSC; kind <= RING_MPMC_BATCH; kind++)
+            bench_for_each_threads(ctx, t) {
+                if (t > 1 && kind <= RING_SPSC_BATCH)
+                    break;
+                run_kind(ctx, kind, ctx->max_size, t);
+            }
+}
@@ -0,0 +1,225 @@
+#include <stdlib.h>
+
+#include "bench.h"
+#include "rbtree.h"
+#include "timer_wheel.h"
+
+#define SUITE "timer"
+
+/* Timeouts are spread over this many ticks, about a minute at 1ms */
+#define TIMEOUT (1U << 16)
+
+/* Ticks advance once per this many re-arms */
+#define REARMS_PER_TICK 64
+
+/* The rb_root_cached pattern the wheel replaces */
+struct rb_timer {
+    struct rb_node rb;
+    uint64_t expires;
+};
+
+struct rb_timers {
+    struct rb_root_cached root;
+    uint64_t now;
+};
+
+static inline bool rb_timer_less(struct rb_node *a, const struct rb_node *b) {
+    return rb_entry(a, struct rb_timer, rb)->expires <
+           rb_entry(b, struct rb_timer, rb)->expires;
+}
+
+static inline void rb_timer_add(
+    struct rb_timers *timers,
+    struct rb_timer *timer,
+    uint64_t expires
+) {
+    timer->expires = expires;
+    rb_add_cached(&timer->rb, &timers->root, rb_timer_less);
+}
+
+static unsigned long rb_timer_advance(struct rb_timers *timers, uint64_t now) {
+    unsigned long fired = 0;
+    struct rb_node *rb;
+
+    while ((rb = rb_first_cached(&timers->root)) &&
+           rb_entry(rb, struct rb_timer, rb)->expires <= now) {
+        rb_erase_cached(rb, &timers->root);
+        RB_CLEAR_NODE(rb);
+        bench_keep(rb);
+        fired++;
+    }
+    timers->now = now;
+    return fired;
+}
+
+static void tw_expire(struct tw_timer *timer, void *priv) {
+    (void) priv;
+    bench_keep(timer);
+}
+
+static void arm_rb(
+    struct rb_timers *timers,
+    struct rb_timer *rbt,
+    const uint64_t *delay,
+    size_t n
+) {
+    size_t i;
+
+    timers->root = RB_ROOT_CACHED;
+    timers->now = 0;
+    for (i = 0; i < n; i++)
+        rb_timer_add(timers, &rbt[i], delay[i]);
+}
+
+static void arm_wheel(
+    struct timer_wheel *wheel,
+    struct tw_timer *twt,
+    const uint64_t *delay,
+    size_t n
+) {
+    size_t i;
+
+    timer_wheel_init(wheel, 0);
+    for (i = 0; i < n; i++) {
+        tw_timer_init(&twt[i]);
+        timer_wheel_add(wheel, &twt[i], delay[i]);
+    }
+}
+
+/*
+ * Connection timeouts: every re-arm pushes a timer TIMEOUT ticks past the
+ * current tick, and expiry is checked as time goes by.
+ */
+static void rearm_rb(
+    struct rb_timers *timers,
+    struct rb_timer *rbt,
+    const size_t *order,
+    size_t n
+) {
+    struct rb_timer *timer;
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        if (i % REARMS_PER_TICK == 0)
+            rb_timer_advance(timers, timers->now + 1);
+        timer = &rbt[order[i]];
+        if (!RB_EMPTY_NODE(&timer->rb))
+            rb_erase_cached(&timer->rb, &timers->root);
+        rb_timer_add(timers, timer, timers->now + TIMEOUT);
+    }
+}
+
+static void rearm_wheel(
+    struct timer_wheel *wheel,
+    struct tw_timer *twt,
+    const size_t *order,
+    size_t n
+) {
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        if (i % REARMS_PER_TICK == 0)
+            timer_wheel_advance(wheel, wheel->now, tw_expire, NULL);
+        timer_wheel_mod(wheel, &twt[order[i]], wheel->now + TIMEOUT);
+    }
+}
+
+static void run_size(
+    struct bench_ctx *ctx,
+    struct timer_wheel *wheel,
+    size_t n
+) {
+    struct rb_timers timers;
+    struct rb_timer *rbt;
+    struct tw_timer *twt;
+    uint64_t seed = n, best, *delay;
+    size_t i, *order;
+
+    rbt = malloc(sizeof(*rbt) * n);
+    twt = malloc(sizeof(*twt) * n);
+    delay = malloc(sizeof(*delay) * n);
+    order = malloc(sizeof(*order) * n);
+    if (!rbt || !twt || !delay || !order)
+        abort();
+
+    for (i = 0; i < n; i++) {
+        delay[i] = TIMEOUT / 2 + bench_rand(&seed) % (TIMEOUT / 2);
+        order[i] = i;
+    }
+    bench_shuffle(order, n, &seed);
+
+    if (bench_enabled(ctx, SUITE, "arm_cancel")) {
+        bench_measure(
+            ctx,
+            best,
+            ,
+            arm_rb(&timers, rbt, delay, n);
+            for (i = 0; i < n; i++)
+                rb_erase_cached(&rbt[order[i]].rb, &timers.root),
+        );
+        bench_report(ctx, SUITE, "arm_cancel", "rbtree", n, 1, n, best);
+
+        bench_measure(
+            ctx,
+            best,
+            ,
+            arm_wheel(wheel, twt, delay, n);
+            for (i = 0; i < n; i++) timer_wheel_del(wheel, &twt[order[i]]),
+        );
+        bench_report(ctx, SUITE, "arm_cancel", "wheel", n, 1, n, best);
+    }
+
+    if (bench_enabled(ctx, SUITE, "rearm")) {
+        bench_measure(
+            ctx,
+            best,
+            arm_rb(&timers, rbt, delay, n),
+            rearm_rb(&timers, rbt, order, n),
+        );
+        bench_report(ctx, SUITE, "rearm", "rbtree", n, 1, n, best);
+
+        bench_measure(
+            ctx,
+            best,
+            arm_wheel(wheel, twt, delay, n),
+            rearm_wheel(wheel, twt, order, n),
+        );
+        bench_report(ctx, SUITE, "rearm", "wheel", n, 1, n, best);
+    }
+
+    if (bench_enabled(ctx, SUITE, "expire")) {
+        bench_measure(
+            ctx,
+            best,
+            arm_rb(&timers, rbt, delay, n),
+            for (i = 0; i < TIMEOUT; i++) rb_timer_advance(&timers, i),
+        );
+        bench_report(ctx, SUITE, "expire", "rbtree", n, 1, n, best);
+
+        bench_measure(
+            ctx,
+            best,
+            arm_wheel(wheel, twt, delay, n),
+            for (i = 0; i < TIMEOUT; i++)
+                timer_wheel_advance(wheel, i, tw_expire, NULL),
+        );
+        bench_report(ctx, SUITE, "expire", "wheel", n, 1, n, best);
+    }
+
+    free(order);
+    free(delay);
+    free(twt);
+    free(rbt);
+}
+
+void bench_timer(struct bench_ctx *ctx) {
+    struct timer_wheel *wheel;
+    size_t n;
+
+    wheel = malloc(sizeof(*wheel));
+    if (!wheel)
+        abort();
+    bench_for_each_size(ctx, n)
+        run_size(ctx, wheel, n);
+    free(wheel);
+}
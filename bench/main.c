@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "urcu.h"
+
+static const struct bench_suite suites[] = {
+    { "rbtree", bench_rbtree },
+    { "list", bench_list },
+    { "hashtable", bench_hashtable },
+    { "refcount", bench_refcount },
+    { "bptree", bench_bptree },
+    { "timer", bench_timer },
+    { "heap", bench_heap },
+    { "llist", bench_llist },
+    { "ring", bench_ring },
+    { "parallel", bench_parallel },
+};
+
+uint64_t bench_now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* --filter matches on "suite/name" as a plain substring */
+bool bench_enabled(
+    const struct bench_ctx *ctx,
+    const char *suite,
+    const char *name
+) {
+    char buf[128];
+
+    if (!ctx->filter)
+        return true;
+    snprintf(buf, sizeof(buf), "%s/%s", suite, name);
+    return strstr(buf, ctx->filter) != NULL;
+}
+
+void bench_report(
+    struct bench_ctx *ctx,
+    const char *suite,
+    const char *name,
+    const char *variant,
+    size_t size,
+    unsigned int threads,
+    uint64_t ops,
+    uint64_t ns
+) {
+    double ns_per_op = ops ? (double) ns / ops : 0;
+    double mops = ns ? ops * 1e3 / ns : 0;
+
+    if (ctx->format == BENCH_FMT_CSV) {
+        printf(
+            "%s,%s,%s,%zu,%u,%llu,%llu,%.3f,%.3f\n",
+            suite,
+            name,
+            variant ? variant : "",
+            size,
+            threads,
+            (unsigned long long) ops,
+            (unsigned long long) ns,
+            ns_per_op,
+            mops
+        );
+    } else {
+        printf(
+            "%s  {\"suite\": \"%s\", \"name\": \"%s\", \"variant\": \"%s\", "
+            "\"size\": %zu, \"threads\": %u, \"ops\": %llu, \"ns\": %llu, "
+            "\"ns_per_op\": %.3f, \"mops\": %.3f}",
+            ctx->nr_results ? ",\n" : "",
+            suite,
+            name,
+            variant ? variant : "",
+            size,
+            threads,
+            (unsigned long long) ops,
+            (unsigned long long) ns,
+            ns_per_op,
+            mops
+        );
+    }
+    fflush(stdout);
+    ctx->nr_results++;
+}
+
+static void usage(const char *prog) {
+    fprintf(
+        stderr,
+        "usage: %s [options]\n"
+        "  --format=json|csv   output format (default json)\n"
+        "  --filter=STR        only run benchmarks whose suite/name "
+        "contains STR\n"
+        "  --min-size=N        smallest working set (default 256)\n"
+        "  --max-size=N        largest working set (default 4194304)\n"
+        "  --threads=N         largest thread count (default: online CPUs)\n"
+        "  --reps=N            repetitions per measurement (default 3)\n"
+        "  --quick             small sizes and one repetition\n",
+        prog
+    );
+}
+
+static size_t parse_size(const char *arg) {
+    char *end;
+    unsigned long long val = strtoull(arg, &end, 0);
+
+    if (*end == 'k' || *end == 'K')
+        val <<= 10;
+    else if (*end == 'm' || *end == 'M')
+        val <<= 20;
+    return val;
+}
+
+int main(int argc, char **argv) {
+    long nr_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    struct bench_ctx ctx = {
+        .min_size = 256,
+        .max_size = 4 << 20,
+        .max_threads = nr_cpus > 0 ? nr_cpus : 1,
+        .reps = 3,
+        .format = BENCH_FMT_JSON,
+    };
+    size_t i;
+    int arg;
+
+    for (arg = 1; arg < argc; arg++) {
+        const char *a = argv[arg];
+
+        if (!strcmp(a, "--format=json"))
+            ctx.format = BENCH_FMT_JSON;
+        else if (!strcmp(a, "--format=csv"))
+            ctx.format = BENCH_FMT_CSV;
+        else if (!strncmp(a, "--filter=", 9))
+            ctx.filter = a + 9;
+        else if (!strncmp(a, "--min-size=", 11))
+            ctx.min_size = parse_size(a + 11);
+        else if (!strncmp(a, "--max-size=", 11))
+            ctx.max_size = parse_size(a + 11);
+        else if (!strncmp(a, "--threads=", 10))
+            ctx.max_threads = strtoul(a + 10, NULL, 0);
+        else if (!strncmp(a, "--reps=", 7))
+            ctx.reps = strtoul(a + 7, NULL, 0);
+        else if (!strcmp(a, "--quick")) {
+            ctx.max_size = 16 << 10;
+            ctx.reps = 1;
+        } else {
+            usage(argv[0]);
+            return strcmp(a, "--help") ? EXIT_FAILURE : EXIT_SUCCESS;
+        }
+    }
+    if (!ctx.min_size || ctx.min_size > ctx.max_size || !ctx.reps ||
+        !ctx.max_threads) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    rcu_register_thread();
+
+    if (ctx.format == BENCH_FMT_CSV)
+        printf("suite,name,variant,size,threads,ops,ns,ns_per_op,mops\n");
+    else
+        printf("[\n");
+
+    /* each suite checks bench_enabled() for its own benchmarks */
+    for (i = 0; i < sizeof(suites) / sizeof(suites[0]); i++)
+        suites[i].run(&ctx);
+
+    if (ctx.format == BENCH_FMT_JSON)
+        printf("\n]\n");
+
+    rcu_unregister_thread();
+    return EXIT_SUCCESS;
+}
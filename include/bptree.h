@@ -0,0 +1,277 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Cache-conscious B+trees with 64-bit keys
+ *
+ * A struct rb_node costs three words and a cache miss per level for every
+ * element.  A B+tree instead packs BPTREE_SLOTS sorted keys into each node,
+ * so a lookup touches about log_{BPTREE_SLOTS}(n) nodes, and the keys of a
+ * node are searched with SIMD compares when the compiler targets SSE4.2 or
+ * AVX2.  Values live in the leaves only, and the leaves are linked in key
+ * order, so range scans are a sequential walk that never goes back up the
+ * tree.
+ *
+ * The tree maps unique uint64_t keys to non-NULL pointers.  It is not
+ * intrusive: nodes are allocated by bptree_insert() and freed by
+ * bptree_remove(), so insertion can fail with -ENOMEM.  Lookups and scans
+ * mirror the rbtree.h helpers:
+ *
+ *	rb_find()		bptree_find()
+ *	rb_find_ge()		bptree_iter_seek()
+ *	rb_for_each_range()	bptree_for_each_range()
+ *
+ * There is no internal locking; readers and writers must be serialized by
+ * the caller.
+ */
+
+#ifndef _LIBCOVE_BPTREE_H
+#define _LIBCOVE_BPTREE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cache.h"
+#include "compiler.h"
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#elif defined(__SSE4_2__)
+    #include <nmmintrin.h>
+#endif
+
+/*
+ * Keys per node.  The default of 16 makes a node five cache lines, the key
+ * array alone two.  Must be a multiple of 4 between 4 and 64; larger values
+ * trade update cost for shallower trees.
+ */
+#ifndef BPTREE_SLOTS
+    #define BPTREE_SLOTS 16
+#endif
+
+/* Every node but the root is kept at least half full */
+#define BPTREE_MIN_SLOTS (BPTREE_SLOTS / 2)
+
+struct bptree_node {
+    uint64_t keys[BPTREE_SLOTS];
+    /* children of inner nodes, values of leaves */
+    void *slots[BPTREE_SLOTS];
+    /* next leaf in key order, NULL for inner nodes and the last leaf */
+    struct bptree_node *next;
+    unsigned int nr;
+    /* height above the leaves, 0 for leaves */
+    unsigned int level;
+} ____cacheline_aligned;
+
+struct bptree {
+    struct bptree_node *root;
+    unsigned long nr;
+};
+
+#define BPTREE_INIT {.root = NULL, .nr = 0}
+
+struct bptree_iter {
+    struct bptree_node *leaf;
+    unsigned int pos;
+};
+
+extern int bptree_insert(struct bptree *tree, uint64_t key, void *val);
+extern void *bptree_remove(struct bptree *tree, uint64_t key);
+extern void bptree_destroy(struct bptree *tree);
+
+static inline void bptree_init(struct bptree *tree) {
+    tree->root = NULL;
+    tree->nr = 0;
+}
+
+/**
+ * bptree_count - number of keys in the tree
+ * @tree: tree to check
+ */
+static inline unsigned long bptree_count(const struct bptree *tree) {
+    return tree->nr;
+}
+
+/**
+ * bptree_empty - check whether the tree is empty
+ * @tree: tree to check
+ */
+static inline bool bptree_empty(const struct bptree *tree) {
+    return !tree->root;
+}
+
+/*
+ * Number of keys of @node that are less than @key.  Keys are unsigned, and
+ * the SIMD compares are signed, so both sides get their sign bit flipped.
+ * Slots past @node->nr are compared as well and masked out afterwards.
+ */
+static __always_inline unsigned int __bptree_rank(
+    const struct bptree_node *node,
+    uint64_t key
+) {
+#if defined(__AVX2__)
+    const __m256i bias = _mm256_set1_epi64x(INT64_MIN);
+    const __m256i k = _mm256_xor_si256(_mm256_set1_epi64x(key), bias);
+    uint64_t mask = 0;
+    unsigned int i;
+
+    for (i = 0; i < BPTREE_SLOTS; i += 4) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) &node->keys[i]);
+        __m256i gt = _mm256_cmpgt_epi64(k, _mm256_xor_si256(v, bias));
+
+        mask |= (uint64_t) _mm256_movemask_pd(_mm256_castsi256_pd(gt)) << i;
+    }
+    if (node->nr < 64)
+        mask &= (UINT64_C(1) << node->nr) - 1;
+    return __builtin_popcountll(mask);
+#elif defined(__SSE4_2__)
+    const __m128i bias = _mm_set1_epi64x(INT64_MIN);
+    const __m128i k = _mm_xor_si128(_mm_set1_epi64x(key), bias);
+    uint64_t mask = 0;
+    unsigned int i;
+
+    for (i = 0; i < BPTREE_SLOTS; i += 2) {
+        __m128i v = _mm_loadu_si128((const __m128i *) &node->keys[i]);
+        __m128i gt = _mm_cmpgt_epi64(k, _mm_xor_si128(v, bias));
+
+        mask |= (uint64_t) _mm_movemask_pd(_mm_castsi128_pd(gt)) << i;
+    }
+    if (node->nr < 64)
+        mask &= (UINT64_C(1) << node->nr) - 1;
+    return __builtin_popcountll(mask);
+#else
+    unsigned int i, rank = 0;
+
+    /* branchless: the keys are sorted, so this is a count, not a search */
+    for (i = 0; i < node->nr; i++)
+        rank += node->keys[i] < key;
+    return rank;
+#endif
+}
+
+/*
+ * Child of inner @node that covers @key: the last one whose lower bound is
+ * not above @key.  Keys below every bound go to the first child.
+ */
+static __always_inline unsigned int __bptree_child(
+    const struct bptree_node *node,
+    uint64_t key
+) {
+    unsigned int i = __bptree_rank(node, key);
+
+    if (i < node->nr && node->keys[i] == key)
+        return i;
+    return i ? i - 1 : 0;
+}
+
+static __always_inline struct bptree_node *__bptree_leaf(
+    const struct bptree *tree,
+    uint64_t key
+) {
+    struct bptree_node *node = tree->root;
+
+    while (node && node->level)
+        node = node->slots[__bptree_child(node, key)];
+    return node;
+}
+
+/**
+ * bptree_find - look up @key
+ * @tree: tree to search
+ * @key: key to look for
+ *
+ * Returns the value stored with @key, or NULL.
+ */
+static inline void *bptree_find(const struct bptree *tree, uint64_t key) {
+    struct bptree_node *leaf = __bptree_leaf(tree, key);
+    unsigned int i;
+
+    if (!leaf)
+        return NULL;
+    i = __bptree_rank(leaf, key);
+    if (i < leaf->nr && leaf->keys[i] == key)
+        return leaf->slots[i];
+    return NULL;
+}
+
+/**
+ * bptree_iter_valid - check whether @iter points at a key
+ * @iter: iterator to check
+ */
+static inline bool bptree_iter_valid(const struct bptree_iter *iter) {
+    return iter->leaf != NULL;
+}
+
+static inline uint64_t bptree_iter_key(const struct bptree_iter *iter) {
+    return iter->leaf->keys[iter->pos];
+}
+
+static inline void *bptree_iter_val(const struct bptree_iter *iter) {
+    return iter->leaf->slots[iter->pos];
+}
+
+/* step to the next leaf once @iter ran off the end of the current one */
+static inline void __bptree_iter_fixup(struct bptree_iter *iter) {
+    while (iter->leaf && iter->pos >= iter->leaf->nr) {
+        iter->leaf = iter->leaf->next;
+        iter->pos = 0;
+    }
+}
+
+/**
+ * bptree_iter_seek - point @iter at the first key not below @key
+ * @iter: iterator to position
+ * @tree: tree to search
+ * @key: lower bound
+ *
+ * Returns whether there is such a key.  Like rb_find_ge().
+ */
+static inline bool bptree_iter_seek(
+    struct bptree_iter *iter,
+    const struct bptree *tree,
+    uint64_t key
+) {
+    iter->leaf = __bptree_leaf(tree, key);
+    iter->pos = iter->leaf ? __bptree_rank(iter->leaf, key) : 0;
+    __bptree_iter_fixup(iter);
+    return bptree_iter_valid(iter);
+}
+
+/**
+ * bptree_iter_next - advance @iter to the next key
+ * @iter: valid iterator
+ *
+ * Returns whether there is a next key.
+ */
+static inline bool bptree_iter_next(struct bptree_iter *iter) {
+    iter->pos++;
+    __bptree_iter_fixup(iter);
+    return bptree_iter_valid(iter);
+}
+
+/**
+ * bptree_for_each - iterate over all keys in ascending order
+ * @iter: &struct bptree_iter to use as a loop cursor
+ * @tree: tree to iterate
+ *
+ * The tree must not be modified while iterating.
+ */
+#define bptree_for_each(iter, tree)                                    \
+    for (bptree_iter_seek((iter), (tree), 0); bptree_iter_valid(iter); \
+         bptree_iter_next(iter))
+
+/**
+ * bptree_for_each_range - iterate over the keys within [@lo, @hi)
+ * @iter: &struct bptree_iter to use as a loop cursor
+ * @tree: tree to iterate
+ * @lo: lower bound, inclusive
+ * @hi: upper bound, exclusive
+ *
+ * Visits the keys in order, in O(log n + k) for k keys in range.  The tree
+ * must not be modified while iterating.
+ */
+#define bptree_for_each_range(iter, tree, lo, hi)                 \
+    for (bptree_iter_seek((iter), (tree), (lo));                  \
+         bptree_iter_valid(iter) && bptree_iter_key(iter) < (hi); \
+         bptree_iter_next(iter))
+
+#endif /* _LIBCOVE_BPTREE_H */
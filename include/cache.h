@@ -0,0 +1,23 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef __LINUX_CACHE_H
+#define __LINUX_CACHE_H
+
+#include "compiler.h"
+
+/*
+ * Assume 64-byte cache lines, which holds on current x86-64 and most arm64
+ * parts.  Data written by different threads should sit on different lines
+ * to avoid false sharing.
+ */
+#define L1_CACHE_SHIFT 6
+#define L1_CACHE_BYTES (1 << L1_CACHE_SHIFT)
+
+#ifndef SMP_CACHE_BYTES
+    #define SMP_CACHE_BYTES L1_CACHE_BYTES
+#endif
+
+#ifndef ____cacheline_aligned
+    #define ____cacheline_aligned __aligned(SMP_CACHE_BYTES)
+#endif
+
+#endif /* __LINUX_CACHE_H */
@@ -0,0 +1,263 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Dynamically sized hash table with incremental rehashing
+ *
+ * Unlike DEFINE_HASHTABLE(), whose bucket count is fixed at compile time,
+ * a dhashtable owns a heap allocated bucket array that is grown when the
+ * load factor exceeds DHASH_GROW_LOAD and shrunk when it drops below
+ * 1/DHASH_SHRINK_DIV.  Resizing never rehashes the whole table at once:
+ * a second bucket array is allocated and every subsequent update migrates
+ * at most DHASH_REHASH_STEP old buckets into it, so the cost of a resize is
+ * spread over the following operations.
+ *
+ * While a resize is in progress old bucket i has been migrated iff
+ * i < rehash_idx.  A key therefore lives in exactly one bucket at any time
+ * (see dhash_bucket()), which keeps lookups down to a single chain walk.
+ */
+
+#ifndef _LIBCOVE_DHASHTABLE_H
+#define _LIBCOVE_DHASHTABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hashtable.h"
+
+#define DHASH_MIN_BITS 1
+#define DHASH_MAX_BITS 31
+
+/* Grow once there is more than one entry per bucket */
+#define DHASH_GROW_LOAD 1
+/* Shrink once fewer than one in DHASH_SHRINK_DIV buckets is in use */
+#define DHASH_SHRINK_DIV 8
+/* Non-empty old buckets migrated per update while resizing */
+#define DHASH_REHASH_STEP 4
+/* Lookups dhash_find_batch() keeps in flight */
+#define DHASH_FIND_BATCH 16
+
+struct dhash_node {
+    struct hlist_node node;
+    uint64_t key;
+};
+
+struct dhash_table {
+    struct hlist_head *buckets;
+    unsigned int bits;
+};
+
+/*
+ * tbl[0] is the table being drained, tbl[1] the resize target.  When no
+ * resize is in progress tbl[1].buckets is NULL.
+ */
+struct dhashtable {
+    struct dhash_table tbl[2];
+    unsigned long rehash_idx;
+    unsigned long nelems;
+    unsigned int min_bits;
+};
+
+extern int dhash_init(struct dhashtable *ht, unsigned int bits);
+extern void dhash_destroy(struct dhashtable *ht);
+extern bool dhash_rehash_step(struct dhashtable *ht, unsigned int n);
+extern void dhash_rehash_finish(struct dhashtable *ht);
+extern void __dhash_maintain(struct dhashtable *ht);
+extern void dhash_find_batch(
+    const struct dhashtable *ht,
+    const uint64_t *keys,
+    size_t nr,
+    struct dhash_node **out
+);
+
+static inline unsigned long dhash_size(const struct dhash_table *tbl) {
+    return tbl->buckets ? 1UL << tbl->bits : 0;
+}
+
+/**
+ * dhash_rehashing - check whether a resize is in progress
+ * @ht: table to check
+ */
+static inline bool dhash_rehashing(const struct dhashtable *ht) {
+    return ht->tbl[1].buckets != NULL;
+}
+
+/**
+ * dhash_count - number of entries in the table
+ * @ht: table to check
+ */
+static inline unsigned long dhash_count(const struct dhashtable *ht) {
+    return ht->nelems;
+}
+
+/**
+ * dhash_empty - check whether the table is empty
+ * @ht: table to check
+ */
+static inline bool dhash_empty(const struct dhashtable *ht) {
+    return !ht->nelems;
+}
+
+/**
+ * dhash_bucket - get the bucket @key currently hashes to
+ * @ht: table to look up
+ * @key: key to hash
+ */
+static inline struct hlist_head *dhash_bucket(
+    const struct dhashtable *ht,
+    uint64_t key
+) {
+    unsigned long idx = hash_min(key, ht->tbl[0].bits);
+
+    if (unlikely(dhash_rehashing(ht)) && idx < ht->rehash_idx)
+        return &ht->tbl[1].buckets[hash_min(key, ht->tbl[1].bits)];
+    return &ht->tbl[0].buckets[idx];
+}
+
+static inline bool dhash_needs_resize(const struct dhashtable *ht) {
+    unsigned long size = 1UL << ht->tbl[0].bits;
+
+    if (ht->nelems > size * DHASH_GROW_LOAD)
+        return ht->tbl[0].bits < DHASH_MAX_BITS;
+    return ht->nelems < size / DHASH_SHRINK_DIV
+        && ht->tbl[0].bits > ht->min_bits;
+}
+
+/*
+ * Do the bounded amount of resize work owed by one update: either migrate
+ * the next few buckets of a running resize or start a new one.
+ */
+static inline void dhash_maintain(struct dhashtable *ht) {
+    if (unlikely(dhash_rehashing(ht) || dhash_needs_resize(ht)))
+        __dhash_maintain(ht);
+}
+
+/**
+ * dhash_add - add an object to a dhashtable
+ * @ht: table to add to
+ * @node: the &struct dhash_node of the object to be added
+ * @key: the key of the object to be added
+ */
+static inline void dhash_add(
+    struct dhashtable *ht,
+    struct dhash_node *node,
+    uint64_t key
+) {
+    node->key = key;
+    hlist_add_head(&node->node, dhash_bucket(ht, key));
+    ht->nelems++;
+    dhash_maintain(ht);
+}
+
+/**
+ * __dhash_del - remove an object without doing any resize work
+ * @ht: table to remove from
+ * @node: &struct dhash_node of the object to remove
+ *
+ * Bucket contents are left where they are, which makes this safe to call
+ * on the current entry of dhash_for_each_safe().
+ */
+static inline void __dhash_del(struct dhashtable *ht, struct dhash_node *node) {
+    hlist_del_init(&node->node);
+    ht->nelems--;
+}
+
+/**
+ * dhash_del - remove an object from a dhashtable
+ * @ht: table to remove from
+ * @node: &struct dhash_node of the object to remove
+ */
+static inline void dhash_del(struct dhashtable *ht, struct dhash_node *node) {
+    __dhash_del(ht, node);
+    dhash_maintain(ht);
+}
+
+/**
+ * dhash_hashed - check whether an object is in any dhashtable
+ * @node: the &struct dhash_node of the object to be checked
+ */
+static inline bool dhash_hashed(const struct dhash_node *node) {
+    return !hlist_unhashed(&node->node);
+}
+
+/**
+ * dhash_find - find the first object with @key
+ * @ht: table to search
+ * @key: the key to look for
+ *
+ * Returns the matching &struct dhash_node, or NULL.
+ */
+static inline struct dhash_node *dhash_find(
+    const struct dhashtable *ht,
+    uint64_t key
+) {
+    struct hlist_node *pos;
+
+    hlist_for_each(pos, dhash_bucket(ht, key)) {
+        struct dhash_node *node = hlist_entry(pos, struct dhash_node, node);
+
+        if (node->key == key)
+            return node;
+    }
+    return NULL;
+}
+
+static inline unsigned long dhash_nr_buckets(const struct dhashtable *ht) {
+    return dhash_size(&ht->tbl[0]) + dhash_size(&ht->tbl[1]);
+}
+
+/* Bucket @i of the concatenation of both tables, for full iteration */
+static inline struct hlist_head *dhash_bucket_at(
+    const struct dhashtable *ht,
+    unsigned long i
+) {
+    unsigned long size = dhash_size(&ht->tbl[0]);
+
+    if (i < size)
+        return &ht->tbl[0].buckets[i];
+    return &ht->tbl[1].buckets[i - size];
+}
+
+/**
+ * dhash_for_each - iterate over a dhashtable
+ * @ht: &struct dhashtable to iterate
+ * @bkt: unsigned long to use as bucket loop cursor
+ * @obj: the type * to use as a loop cursor for each entry
+ * @member: the name of the dhash_node within the struct
+ */
+#define dhash_for_each(ht, bkt, obj, member)                           \
+    for ((bkt) = 0, obj = NULL;                                        \
+         obj == NULL && (bkt) < dhash_nr_buckets(ht);                  \
+         (bkt)++)                                                      \
+    hlist_for_each_entry(obj, dhash_bucket_at(ht, bkt), member.node)
+
+/**
+ * dhash_for_each_safe - iterate over a dhashtable safe against removal of
+ * the current entry with __dhash_del()
+ * @ht: &struct dhashtable to iterate
+ * @bkt: unsigned long to use as bucket loop cursor
+ * @tmp: a &struct hlist_node used for temporary storage
+ * @obj: the type * to use as a loop cursor for each entry
+ * @member: the name of the dhash_node within the struct
+ */
+#define dhash_for_each_safe(ht, bkt, tmp, obj, member) \
+    for ((bkt) = 0, obj = NULL;                         \
+         obj == NULL && (bkt) < dhash_nr_buckets(ht);   \
+         (bkt)++)                                       \
+    hlist_for_each_entry_safe(                          \
+        obj,                                            \
+        tmp,                                            \
+        dhash_bucket_at(ht, bkt),                       \
+        member.node                                     \
+    )
+
+/**
+ * dhash_for_each_possible - iterate over all possible objects hashing to the
+ * same bucket
+ * @ht: &struct dhashtable to iterate
+ * @obj: the type * to use as a loop cursor for each entry
+ * @member: the name of the dhash_node within the struct
+ * @key: the key of the objects to iterate over
+ */
+#define dhash_for_each_possible(ht, obj, member, key) \
+    hlist_for_each_entry(obj, dhash_bucket(ht, key), member.node)
+
+#endif /* _LIBCOVE_DHASHTABLE_H */
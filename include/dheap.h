@@ -0,0 +1,283 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Array-backed d-ary min-heaps
+ *
+ * The heap is an array of pointers to struct dheap_node, each embedded in
+ * the user's object and holding its own index in the array, so that
+ * decrease-key and delete find it in O(1) and only sift it from there.
+ * Each level has DHEAP_ARITY times the nodes of the one above: with the
+ * default of 4 the tree is half as deep as a binary heap, and the children
+ * of a node are four adjacent pointers.  The array is laid out so that they
+ * always fall within one cache line.
+ *
+ * Pushing may have to grow the array, so it can fail with -ENOMEM;
+ * dheap_reserve() makes room up front.  As with struct rb_node, all
+ * operations take a less() callback on nodes.
+ */
+
+#ifndef _LIBCOVE_DHEAP_H
+#define _LIBCOVE_DHEAP_H
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "compiler.h"
+#include "container_of.h"
+#include "list.h"
+
+#ifndef DHEAP_ARITY
+    #define DHEAP_ARITY 4
+#endif
+
+struct dheap_node {
+    /* position in dheap->nodes */
+    unsigned int idx;
+};
+
+struct dheap {
+    struct dheap_node **nodes;
+    unsigned int nr;
+    unsigned int size;
+};
+
+#define DHEAP_INIT {.nodes = NULL, .nr = 0, .size = 0}
+
+#define dheap_entry(ptr, type, member) container_of(ptr, type, member)
+
+extern int dheap_reserve(struct dheap *heap, unsigned int nr);
+extern void dheap_destroy(struct dheap *heap);
+
+static inline void dheap_init(struct dheap *heap) {
+    heap->nodes = NULL;
+    heap->nr = 0;
+    heap->size = 0;
+}
+
+static inline unsigned int dheap_count(const struct dheap *heap) {
+    return heap->nr;
+}
+
+/**
+ * dheap_first - the minimum node of @heap, NULL if empty
+ * @heap: heap to look at
+ */
+static inline struct dheap_node *dheap_first(const struct dheap *heap) {
+    return heap->nr ? heap->nodes[0] : NULL;
+}
+
+static __always_inline void __dheap_set(
+    struct dheap *heap,
+    unsigned int idx,
+    struct dheap_node *node
+) {
+    heap->nodes[idx] = node;
+    node->idx = idx;
+}
+
+/* Move @node up from the hole at @idx to where it belongs */
+static __always_inline void __dheap_sift_up(
+    struct dheap *heap,
+    struct dheap_node *node,
+    unsigned int idx,
+    bool (*less)(struct dheap_node *, const struct dheap_node *)
+) {
+    struct dheap_node *parent;
+
+    while (idx) {
+        parent = heap->nodes[(idx - 1) / DHEAP_ARITY];
+        if (!less(node, parent))
+            break;
+        __dheap_set(heap, idx, parent);
+        idx = (idx - 1) / DHEAP_ARITY;
+    }
+    __dheap_set(heap, idx, node);
+}
+
+/* Move @node down from the hole at @idx to where it belongs */
+static __always_inline void __dheap_sift_down(
+    struct dheap *heap,
+    struct dheap_node *node,
+    unsigned int idx,
+    bool (*less)(struct dheap_node *, const struct dheap_node *)
+) {
+    struct dheap_node **nodes = heap->nodes;
+    unsigned int child, end, min;
+
+    while ((child = idx * DHEAP_ARITY + 1) < heap->nr) {
+        end = child + DHEAP_ARITY;
+        if (end > heap->nr)
+            end = heap->nr;
+        for (min = child++; child < end; child++)
+            if (less(nodes[child], nodes[min]))
+                min = child;
+        if (!less(nodes[min], node))
+            break;
+        __dheap_set(heap, idx, nodes[min]);
+        idx = min;
+    }
+    __dheap_set(heap, idx, node);
+}
+
+/* Put @node, which replaced a node at @idx, back in order */
+static __always_inline void __dheap_fix(
+    struct dheap *heap,
+    struct dheap_node *node,
+    unsigned int idx,
+    bool (*less)(struct dheap_node *, const struct dheap_node *)
+) {
+    if (idx && less(node, heap->nodes[(idx - 1) / DHEAP_ARITY]))
+        __dheap_sift_up(heap, node, idx, less);
+    else
+        __dheap_sift_down(heap, node, idx, less);
+}
+
+/**
+ * dheap_push - insert @node into @heap
+ * @heap: heap to insert @node into
+ * @node: node to insert
+ * @less: operator defining the node order
+ *
+ * Returns 0, or -ENOMEM if the array could not grow.
+ */
+static __always_inline int dheap_push(
+    struct dheap *heap,
+    struct dheap_node *node,
+    bool (*less)(struct dheap_node *, const struct dheap_node *)
+) {
+    if (unlikely(heap->nr == heap->size) && dheap_reserve(heap, heap->nr + 1))
+        return -ENOMEM;
+    __dheap_sift_up(heap, node, heap->nr++, less);
+    return 0;
+}
+
+/**
+ * dheap_pop - remove and return the minimum node of @heap
+ * @heap: heap to pop from
+ * @less: operator defining the node order
+ *
+ * Returns NULL if @heap is empty.
+ */
+static __always_inline struct dheap_node *dheap_pop(
+    struct dheap *heap,
+    bool (*less)(struct dheap_node *, const struct dheap_node *)
+) {
+    struct dheap_node *node;
+
+    if (!heap->nr)
+        return NULL;
+    node = heap->nodes[0];
+    if (--heap->nr)
+        __dheap_sift_down(heap, heap->nodes[heap->nr], 0, less);
+    return node;
+}
+
+/**
+ * dheap_del - remove @node from @heap
+ * @heap: heap @node is in
+ * @node: node to remove
+ * @less: operator defining the node order
+ */
+static __always_inline void dheap_del(
+    struct dheap *heap,
+    struct dheap_node *node,
+    bool (*less)(struct dheap_node *, const struct dheap_node *)
+) {
+    struct dheap_node *last = heap->nodes[--heap->nr];
+
+    if (last != node)
+        __dheap_fix(heap, last, node->idx, less);
+}
+
+/**
+ * dheap_decrease - restore the heap order after the key of @node decreased
+ * @heap: heap @node is in
+ * @node: node whose key decreased
+ * @less: operator defining the node order
+ */
+static __always_inline void dheap_decrease(
+    struct dheap *heap,
+    struct dheap_node *node,
+    bool (*less)(struct dheap_node *, const struct dheap_node *)
+) {
+    __dheap_sift_up(heap, node, node->idx, less);
+}
+
+/**
+ * dheap_update - restore the heap order after the key of @node changed
+ * @heap: heap @node is in
+ * @node: node whose key changed, in either direction
+ * @less: operator defining the node order
+ */
+static __always_inline void dheap_update(
+    struct dheap *heap,
+    struct dheap_node *node,
+    bool (*less)(struct dheap_node *, const struct dheap_node *)
+) {
+    __dheap_fix(heap, node, node->idx, less);
+}
+
+/*
+ * Floyd's bottom-up construction: sift down every inner node, last first.
+ * O(n), against O(n log n) for pushing one node at a time.
+ */
+static __always_inline void __dheap_heapify(
+    struct dheap *heap,
+    bool (*less)(struct dheap_node *, const struct dheap_node *)
+) {
+    unsigned int idx;
+
+    if (heap->nr < 2)
+        return;
+    idx = (heap->nr - 2) / DHEAP_ARITY + 1;
+    while (idx--)
+        __dheap_sift_down(heap, heap->nodes[idx], idx, less);
+}
+
+static __always_inline int __dheap_heapify_list(
+    struct dheap *heap,
+    struct list_head *head,
+    ptrdiff_t offset,
+    bool (*less)(struct dheap_node *, const struct dheap_node *)
+) {
+    unsigned int nr = heap->nr;
+    struct dheap_node *node;
+    struct list_head *pos;
+
+    for (pos = head->next; pos != head; pos = pos->next) {
+        if (unlikely(nr == heap->size) && dheap_reserve(heap, nr + 1))
+            return -ENOMEM;
+        /* past heap->nr, so that failing leaves the heap as it was */
+        node = (struct dheap_node *) ((char *) pos + offset);
+        __dheap_set(heap, nr++, node);
+    }
+    heap->nr = nr;
+    __dheap_heapify(heap, less);
+    return 0;
+}
+
+#define __dheap_offset(type, list_member, heap_member) \
+    ((ptrdiff_t) offsetof(type, heap_member) -         \
+     (ptrdiff_t) offsetof(type, list_member))
+
+/**
+ * dheap_heapify_list - add every object of a list to a heap in linear time
+ * @heap: heap to add them to
+ * @head: list of objects, in any order
+ * @type: the type of the objects
+ * @list_member: the name of the list_head within the struct
+ * @heap_member: the name of the dheap_node within the struct
+ * @less: operator defining the node order
+ *
+ * The objects stay on @head; the list is only read.  Returns 0, or -ENOMEM
+ * with @heap unchanged.
+ */
+#define dheap_heapify_list(heap, head, type, list_member, heap_member, less) \
+    __dheap_heapify_list(                                                    \
+        heap,                                                                \
+        head,                                                                \
+        __dheap_offset(type, list_member, heap_member),                      \
+        less                                                                 \
+    )
+
+#endif /* _LIBCOVE_DHEAP_H */
@@ -9,6 +9,8 @@
 
 #include "hash.h"
 #include "list.h"
+#include "rculist.h"
+#include "rculist_nulls.h"
 
 static inline int ilog2(uint32_t x) {
     return 31 - __builtin_clz(x);
@@ -59,6 +61,34 @@ static inline void __hash_init(struct hlist_head *ht, unsigned int sz) {
  */
 #define hash_init(hashtable) __hash_init(hashtable, HASH_SIZE(hashtable))
 
+static inline void __hash_init_nulls(
+    struct hlist_nulls_head *ht,
+    unsigned int sz
+) {
+    unsigned int i;
+
+    for (i = 0; i < sz; i++)
+        INIT_HLIST_NULLS_HEAD(&ht[i], i);
+}
+
+/**
+ * hash_init_nulls - initialize a nulls hash table
+ * @hashtable: array of &struct hlist_nulls_head to be initialized
+ *
+ * Every bucket's chain is terminated by a nulls marker holding the bucket
+ * index, which lockless readers compare against hash_nulls_slot() to notice
+ * that they were moved onto another chain.
+ */
+#define hash_init_nulls(hashtable) \
+    __hash_init_nulls(hashtable, HASH_SIZE(hashtable))
+
+/**
+ * hash_nulls_slot - bucket index of @key in a nulls hash table
+ * @hashtable: hashtable the key belongs to
+ * @key: the key to look up
+ */
+#define hash_nulls_slot(hashtable, key) hash_min(key, HASH_BITS(hashtable))
+
 /**
  * hash_add - add an object to a hashtable
  * @hashtable: hashtable to add to
@@ -68,6 +98,27 @@ static inline void __hash_init(struct hlist_head *ht, unsigned int sz) {
 #define hash_add(hashtable, node, key) \
     hlist_add_head(node, &hashtable[hash_min(key, HASH_BITS(hashtable))])
 
+/**
+ * hash_add_rcu - add an object to a rcu enabled hashtable
+ * @hashtable: hashtable to add to
+ * @node: the &struct hlist_node of the object to be added
+ * @key: the key of the object to be added
+ */
+#define hash_add_rcu(hashtable, node, key) \
+    hlist_add_head_rcu(node, &hashtable[hash_min(key, HASH_BITS(hashtable))])
+
+/**
+ * hash_add_nulls_rcu - add an object to a rcu enabled nulls hashtable
+ * @hashtable: hashtable to add to
+ * @node: the &struct hlist_nulls_node of the object to be added
+ * @key: the key of the object to be added
+ */
+#define hash_add_nulls_rcu(hashtable, node, key)    \
+    hlist_nulls_add_head_rcu(                       \
+        node,                                       \
+        &hashtable[hash_nulls_slot(hashtable, key)] \
+    )
+
 /**
  * hash_hashed - check whether an object is in any hashtable
  * @node: the &struct hlist_node of the object to be checked
@@ -103,6 +154,25 @@ static inline void hash_del(struct hlist_node *node) {
     hlist_del_init(node);
 }
 
+/**
+ * hash_del_rcu - remove an object from a rcu enabled hashtable
+ * @node: &struct hlist_node of the object to remove
+ */
+static inline void hash_del_rcu(struct hlist_node *node) {
+    hlist_del_init_rcu(node);
+}
+
+/**
+ * hash_del_nulls_rcu - remove an object from a rcu enabled nulls hashtable
+ * @node: &struct hlist_nulls_node of the object to remove
+ *
+ * The object may be reinserted, into this or any other bucket, without
+ * waiting for a grace period; readers detect this by the nulls marker.
+ */
+static inline void hash_del_nulls_rcu(struct hlist_nulls_node *node) {
+    hlist_nulls_del_init_rcu(node);
+}
+
 /**
  * hash_for_each - iterate over a hashtable
  * @name: hashtable to iterate
@@ -115,6 +185,18 @@ static inline void hash_del(struct hlist_node *node) {
          (bkt)++)                                                       \
     hlist_for_each_entry(obj, &name[bkt], member)
 
+/**
+ * hash_for_each_rcu - iterate over a rcu enabled hashtable
+ * @name: hashtable to iterate
+ * @bkt: integer to use as bucket loop cursor
+ * @obj: the type * to use as a loop cursor for each entry
+ * @member: the name of the hlist_node within the struct
+ */
+#define hash_for_each_rcu(name, bkt, obj, member)                       \
+    for ((bkt) = 0, obj = NULL; obj == NULL && (bkt) < HASH_SIZE(name); \
+         (bkt)++)                                                       \
+    hlist_for_each_entry_rcu(obj, &name[bkt], member)
+
 /**
  * hash_for_each_safe - iterate over a hashtable safe against removal of
  * hash entry
@@ -140,6 +222,51 @@ static inline void hash_del(struct hlist_node *node) {
 #define hash_for_each_possible(name, obj, member, key) \
     hlist_for_each_entry(obj, &name[hash_min(key, HASH_BITS(name))], member)
 
+/**
+ * hash_for_each_possible_rcu - iterate over all possible objects hashing to the
+ * same bucket in an rcu enabled hashtable
+ * @name: hashtable to iterate
+ * @obj: the type * to use as a loop cursor for each entry
+ * @member: the name of the hlist_node within the struct
+ * @key: the key of the objects to iterate over
+ */
+#define hash_for_each_possible_rcu(name, obj, member, key) \
+    hlist_for_each_entry_rcu(                              \
+        obj,                                               \
+        &name[hash_min(key, HASH_BITS(name))],             \
+        member                                             \
+    )
+
+/**
+ * hash_for_each_possible_nulls_rcu - iterate over all possible objects hashing
+ * to the same bucket in an rcu enabled nulls hashtable
+ * @name: hashtable to iterate
+ * @obj: the type * to use as a loop cursor for each entry
+ * @pos: the &struct hlist_nulls_node to use as a loop cursor
+ * @member: the name of the hlist_nulls_node within the struct
+ * @key: the key of the objects to iterate over
+ *
+ * When the loop ends without a match, @pos holds the terminating nulls
+ * marker: if hash_nulls_retry() is true for it the walk strayed onto another
+ * chain and the lookup must be restarted.
+ */
+#define hash_for_each_possible_nulls_rcu(name, obj, pos, member, key) \
+    hlist_nulls_for_each_entry_rcu(                                   \
+        obj,                                                          \
+        pos,                                                          \
+        &name[hash_nulls_slot(name, key)],                            \
+        member                                                        \
+    )
+
+/**
+ * hash_nulls_retry - check whether a nulls lookup ended on a foreign chain
+ * @name: hashtable that was searched
+ * @pos: the &struct hlist_nulls_node cursor after the walk completed
+ * @key: the key that was searched for
+ */
+#define hash_nulls_retry(name, pos, key) \
+    (get_nulls_value(pos) != hash_nulls_slot(name, key))
+
 /**
  * hash_for_each_possible_safe - iterate over all possible objects hashing to
  * the same bucket safe against removals
@@ -0,0 +1,51 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _LINUX_INTERVAL_TREE_H
+#define _LINUX_INTERVAL_TREE_H
+
+#include "rbtree.h"
+
+struct interval_tree_node {
+    struct rb_node rb;
+    unsigned long start; /* Start of interval */
+    unsigned long last;  /* Last location _in_ interval */
+    unsigned long __subtree_last;
+};
+
+extern void interval_tree_insert(
+    struct interval_tree_node *node,
+    struct rb_root_cached *root
+);
+
+extern void interval_tree_remove(
+    struct interval_tree_node *node,
+    struct rb_root_cached *root
+);
+
+extern struct interval_tree_node *interval_tree_iter_first(
+    struct rb_root_cached *root,
+    unsigned long start,
+    unsigned long last
+);
+
+extern struct interval_tree_node *interval_tree_iter_next(
+    struct interval_tree_node *node,
+    unsigned long start,
+    unsigned long last
+);
+
+/**
+ * interval_tree_for_each_overlap - iterate over intervals overlapping a range
+ * @node: the &struct interval_tree_node to use as a loop cursor
+ * @root: the tree to search
+ * @start: first location of the range
+ * @last: last location of the range
+ *
+ * Visits every interval intersecting [@start, @last] in ascending order of
+ * their start, in O(log n + k) for k matches.  A stabbing query for a point
+ * p is simply @start == @last == p.
+ */
+#define interval_tree_for_each_overlap(node, root, start, last)    \
+    for (node = interval_tree_iter_first(root, start, last); node; \
+         node = interval_tree_iter_next(node, start, last))
+
+#endif /* _LINUX_INTERVAL_TREE_H */
@@ -0,0 +1,23 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _LINUX_LIST_SORT_H
+#define _LINUX_LIST_SORT_H
+
+#include "list.h"
+
+typedef int (*list_cmp_func_t)(
+    void *,
+    const struct list_head *,
+    const struct list_head *
+);
+
+struct thread_pool;
+
+extern void list_sort(void *priv, struct list_head *head, list_cmp_func_t cmp);
+extern void list_sort_parallel(
+    struct thread_pool *pool,
+    void *priv,
+    struct list_head *head,
+    list_cmp_func_t cmp
+);
+
+#endif
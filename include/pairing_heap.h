@@ -0,0 +1,294 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Intrusive pairing heaps
+ *
+ * A priority queue for users that only need insert, pop-min, decrease-key
+ * and delete.  Compared to an rb_root_cached it never rotates: insert and
+ * meld are a single comparison and decrease-key a cut and a comparison,
+ * while pop-min pairs up the children of the old minimum, O(log n)
+ * amortized.
+ *
+ * Like struct rb_node, struct pheap_node is embedded in the user's object
+ * and every operation takes a less() callback on nodes:
+ *
+ *	static bool job_less(struct pheap_node *a, const struct pheap_node *b)
+ *	{
+ *		return pheap_entry(a, struct job, node)->deadline <
+ *		       pheap_entry(b, struct job, node)->deadline;
+ *	}
+ *
+ *	pheap_add(&job->node, &queue, job_less);
+ *	job = pheap_entry_safe(pheap_pop(&queue, job_less), struct job, node);
+ *
+ * Each node is the root of a tree kept in child/sibling form: @child points
+ * to its first child, @next to its next sibling, and @prev to its previous
+ * sibling, or to its parent if it is a first child.  Nodes of equal keys
+ * come out in no particular order.
+ */
+
+#ifndef _LIBCOVE_PAIRING_HEAP_H
+#define _LIBCOVE_PAIRING_HEAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "compiler.h"
+#include "container_of.h"
+#include "list.h"
+
+struct pheap_node {
+    struct pheap_node *child;
+    struct pheap_node *next;
+    struct pheap_node *prev;
+};
+
+struct pheap_root {
+    struct pheap_node *node;
+};
+
+#define PHEAP_ROOT        \
+    (struct pheap_root) { \
+        NULL,             \
+    }
+
+#define pheap_entry(ptr, type, member) container_of(ptr, type, member)
+
+#define pheap_entry_safe(ptr, type, member)                  \
+    ({                                                       \
+        typeof(ptr) ____ptr = (ptr);                         \
+        ____ptr ? pheap_entry(____ptr, type, member) : NULL; \
+    })
+
+#define PHEAP_EMPTY_ROOT(root) ((root)->node == NULL)
+
+/**
+ * pheap_first - the minimum node of @root, NULL if empty
+ * @root: heap to look at
+ */
+static inline struct pheap_node *pheap_first(const struct pheap_root *root) {
+    return root->node;
+}
+
+/*
+ * Make the greater of two roots the first child of the other, and return
+ * the new root.  Neither may have siblings.
+ */
+static __always_inline struct pheap_node *__pheap_link(
+    struct pheap_node *a,
+    struct pheap_node *b,
+    bool (*less)(struct pheap_node *, const struct pheap_node *)
+) {
+    struct pheap_node *tmp;
+
+    if (less(b, a)) {
+        tmp = a;
+        a = b;
+        b = tmp;
+    }
+    b->next = a->child;
+    if (b->next)
+        b->next->prev = b;
+    b->prev = a;
+    a->child = b;
+    return a;
+}
+
+/*
+ * Merge a list of sibling trees into one: link them in pairs from left to
+ * right, then fold the pairs into one from right to left.
+ */
+static __always_inline struct pheap_node *__pheap_merge_pairs(
+    struct pheap_node *first,
+    bool (*less)(struct pheap_node *, const struct pheap_node *)
+) {
+    struct pheap_node *a, *b, *next, *stack = NULL;
+
+    while (first) {
+        a = first;
+        b = a->next;
+        if (b) {
+            next = b->next;
+            a = __pheap_link(a, b, less);
+        } else {
+            next = NULL;
+        }
+        /* the pairs are stacked up through @next, last pair on top */
+        a->next = stack;
+        stack = a;
+        first = next;
+    }
+
+    a = stack;
+    for (stack = stack->next; stack; stack = next) {
+        next = stack->next;
+        a = __pheap_link(a, stack, less);
+    }
+    a->next = a->prev = NULL;
+    return a;
+}
+
+/* Take the subtree of @node, which is not the root, out of its tree */
+static inline void __pheap_cut(struct pheap_node *node) {
+    if (node->prev->child == node)
+        node->prev->child = node->next;
+    else
+        node->prev->next = node->next;
+    if (node->next)
+        node->next->prev = node->prev;
+    node->next = node->prev = NULL;
+}
+
+/* Meld the tree of @node, which has no siblings, into @root */
+static __always_inline void __pheap_meld_node(
+    struct pheap_node *node,
+    struct pheap_root *root,
+    bool (*less)(struct pheap_node *, const struct pheap_node *)
+) {
+    if (root->node) {
+        node = __pheap_link(root->node, node, less);
+        node->next = node->prev = NULL;
+    }
+    root->node = node;
+}
+
+/**
+ * pheap_add - insert @node into @root in O(1)
+ * @node: node to insert
+ * @root: heap to insert @node into
+ * @less: operator defining the node order
+ */
+static __always_inline void pheap_add(
+    struct pheap_node *node,
+    struct pheap_root *root,
+    bool (*less)(struct pheap_node *, const struct pheap_node *)
+) {
+    node->child = node->next = node->prev = NULL;
+    __pheap_meld_node(node, root, less);
+}
+
+/**
+ * pheap_meld - move every node of @from into @root in O(1)
+ * @root: heap to meld into
+ * @from: heap to take the nodes from, empty afterwards
+ * @less: operator defining the node order
+ */
+static __always_inline void pheap_meld(
+    struct pheap_root *root,
+    struct pheap_root *from,
+    bool (*less)(struct pheap_node *, const struct pheap_node *)
+) {
+    if (from->node)
+        __pheap_meld_node(from->node, root, less);
+    from->node = NULL;
+}
+
+/**
+ * pheap_pop - remove and return the minimum node of @root
+ * @root: heap to pop from
+ * @less: operator defining the node order
+ *
+ * Returns NULL if @root is empty.
+ */
+static __always_inline struct pheap_node *pheap_pop(
+    struct pheap_root *root,
+    bool (*less)(struct pheap_node *, const struct pheap_node *)
+) {
+    struct pheap_node *node = root->node;
+
+    if (node)
+        root->node =
+            node->child ? __pheap_merge_pairs(node->child, less) : NULL;
+    return node;
+}
+
+/**
+ * pheap_decrease - restore the heap order after the key of @node decreased
+ * @node: node whose key decreased
+ * @root: heap @node is in
+ * @less: operator defining the node order
+ *
+ * O(1): the subtree of @node is cut out and melded back at the root.
+ */
+static __always_inline void pheap_decrease(
+    struct pheap_node *node,
+    struct pheap_root *root,
+    bool (*less)(struct pheap_node *, const struct pheap_node *)
+) {
+    if (node == root->node)
+        return;
+    __pheap_cut(node);
+    __pheap_meld_node(node, root, less);
+}
+
+/**
+ * pheap_del - remove @node from @root
+ * @node: node to remove
+ * @root: heap @node is in
+ * @less: operator defining the node order
+ */
+static __always_inline void pheap_del(
+    struct pheap_node *node,
+    struct pheap_root *root,
+    bool (*less)(struct pheap_node *, const struct pheap_node *)
+) {
+    if (node == root->node) {
+        pheap_pop(root, less);
+        return;
+    }
+    __pheap_cut(node);
+    if (node->child)
+        __pheap_meld_node(__pheap_merge_pairs(node->child, less), root, less);
+}
+
+/**
+ * pheap_update - restore the heap order after the key of @node changed
+ * @node: node whose key changed, in either direction
+ * @root: heap @node is in
+ * @less: operator defining the node order
+ */
+static __always_inline void pheap_update(
+    struct pheap_node *node,
+    struct pheap_root *root,
+    bool (*less)(struct pheap_node *, const struct pheap_node *)
+) {
+    pheap_del(node, root, less);
+    pheap_add(node, root, less);
+}
+
+static __always_inline void __pheap_build_list(
+    struct list_head *head,
+    ptrdiff_t offset,
+    struct pheap_root *root,
+    bool (*less)(struct pheap_node *, const struct pheap_node *)
+) {
+    struct list_head *pos;
+
+    for (pos = head->next; pos != head; pos = pos->next)
+        pheap_add((struct pheap_node *) ((char *) pos + offset), root, less);
+}
+
+#define __pheap_build_offset(type, list_member, heap_member) \
+    ((ptrdiff_t) offsetof(type, heap_member) -               \
+     (ptrdiff_t) offsetof(type, list_member))
+
+/**
+ * pheap_build_list - add every object of a list to a heap in linear time
+ * @head: list of objects, in any order
+ * @root: heap to add them to
+ * @type: the type of the objects
+ * @list_member: the name of the list_head within the struct
+ * @heap_member: the name of the pheap_node within the struct
+ * @less: operator defining the node order
+ *
+ * Each object costs one comparison; sorting them out is left to the pops,
+ * as for pheap_add().  The objects stay on @head; the list is only read.
+ */
+#define pheap_build_list(head, root, type, list_member, heap_member, less) \
+    __pheap_build_list(                                                    \
+        head,                                                              \
+        __pheap_build_offset(type, list_member, heap_member),              \
+        root,                                                              \
+        less                                                               \
+    )
+
+#endif /* _LIBCOVE_PAIRING_HEAP_H */
@@ -0,0 +1,44 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Parallel traversals of the containers, on a fork-join thread pool
+ *
+ * Each walk cuts the container into pieces that no two threads share and
+ * calls back on every node, in no particular order across pieces.  The
+ * callback may change or free the node it is given, and nothing else of
+ * the container.  A NULL pool runs the walk serially on the caller.
+ */
+
+#ifndef _LIBCOVE_PARALLEL_H
+#define _LIBCOVE_PARALLEL_H
+
+#include "hashtable.h"
+#include "rbtree.h"
+#include "thread_pool.h"
+
+extern void __hash_for_each_parallel(
+    struct thread_pool *pool,
+    struct hlist_head *ht,
+    unsigned int sz,
+    void (*fn)(struct hlist_node *node, void *arg),
+    void *arg
+);
+extern void rb_postorder_parallel(
+    struct thread_pool *pool,
+    struct rb_root *root,
+    void (*fn)(struct rb_node *node, void *arg),
+    void *arg
+);
+
+/**
+ * hash_for_each_parallel - call @fn on every entry, buckets split by range
+ * @pool: pool to run on, or NULL
+ * @name: hashtable to iterate
+ * @fn: called with each entry's hlist_node and @arg; may unhash or free it
+ * @arg: passed to @fn
+ *
+ * Entries of a bucket are visited in order, by one thread.
+ */
+#define hash_for_each_parallel(pool, name, fn, arg) \
+    __hash_for_each_parallel(pool, name, HASH_SIZE(name), fn, arg)
+
+#endif /* _LIBCOVE_PARALLEL_H */
@@ -0,0 +1,323 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Percpu refcounts:
+ * (C) 2012 Google, Inc.
+ * Author: Kent Overstreet <koverstreet@google.com>
+ *
+ * This implements a refcount with similar semantics to struct arc, but
+ * get and put scale with the number of threads: the count is split into
+ * cache line sized shards and every thread only touches the one it was
+ * handed out, so gets and puts from different threads never contend.
+ *
+ * The catch is that the shards cannot be summed without stopping them, so
+ * the count cannot drop to zero while sharded.  Only the owner can end the
+ * sharded ("percpu") mode, by calling percpu_ref_kill() when it begins
+ * teardown.  This folds the shards into a single atomic counter, after
+ * which the ref behaves exactly like an arc and calls the release function
+ * once the last reference is gone.
+ *
+ * The initial reference is dropped by percpu_ref_kill().  Until then the
+ * count is guaranteed to be nonzero, so percpu_ref_get() is valid for anyone
+ * that can reach the object, e.g. from a lookup structure the object is
+ * removed from before it is killed.
+ *
+ * Example:
+ *
+ *	percpu_ref_init(&obj->ref, obj_release, 0);
+ *	...
+ *	percpu_ref_get(&obj->ref);	// fast, scales
+ *	...
+ *	percpu_ref_put(&obj->ref);	// fast, scales
+ *	...
+ *	unpublish(obj);
+ *	percpu_ref_kill(&obj->ref);	// obj_release() runs at zero
+ *
+ * Unlike the kernel version, which relies on RCU to make the mode switch
+ * atomic, a shard is retired by swapping in a "dead" value.  A get or put
+ * racing with the switch sees the dead value returned by its own atomic
+ * operation and redoes itself on the atomic counter instead, so the fast
+ * path needs neither RCU registration nor a read-side critical section.
+ */
+
+#ifndef _LINUX_PERCPU_REFCOUNT_H
+#define _LINUX_PERCPU_REFCOUNT_H
+
+#include <limits.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#include "cache.h"
+#include "compiler.h"
+
+struct percpu_ref;
+typedef void(percpu_ref_func_t)(struct percpu_ref *);
+
+/* Upper bound on the number of shards of a single ref */
+#define PERCPU_REF_MAX_SHARDS 256
+
+/*
+ * Added to the atomic counter while the shards are live, so that gets and
+ * puts redirected to it during the switch can never make it reach zero.
+ */
+#define PERCPU_COUNT_BIAS (1L << (sizeof(long) * CHAR_BIT - 2))
+
+/*
+ * Value of a retired shard.  Gets and puts that land on it are redone on
+ * the atomic counter without being undone on the shard: it is far enough
+ * from zero that no amount of them can make it look live again, and
+ * undoing could corrupt a shard revived in the meantime.
+ */
+#define PERCPU_SHARD_DEAD (LONG_MIN / 2)
+
+/* flags set in ref->flags */
+enum {
+    __PERCPU_REF_ATOMIC = 1LU << 0, /* operating in atomic mode */
+    __PERCPU_REF_DEAD = 1LU << 1,   /* (being) killed */
+};
+
+/* @flags for percpu_ref_init() */
+enum {
+    /*
+     * Start w/ ref == 1 in atomic mode.  Can be switched to percpu
+     * operation using percpu_ref_switch_to_percpu().
+     */
+    PERCPU_REF_INIT_ATOMIC = 1 << 0,
+};
+
+struct percpu_ref_shard {
+    atomic_long count;
+} ____cacheline_aligned;
+
+struct percpu_ref {
+    /* the counter in atomic mode, PERCPU_COUNT_BIAS + 1 while sharded */
+    atomic_long count ____cacheline_aligned;
+    atomic_uint flags;
+    unsigned int shard_mask;
+    struct percpu_ref_shard *shards;
+    percpu_ref_func_t *release;
+};
+
+/*
+ * Shard hint of the calling thread, handed out round-robin on first use so
+ * that concurrent threads land on different shards.  0 means unassigned.
+ */
+extern _Thread_local unsigned int percpu_ref_shard_hint;
+extern unsigned int __percpu_ref_assign_shard_hint(void);
+
+extern int percpu_ref_init(
+    struct percpu_ref *ref,
+    percpu_ref_func_t *release,
+    unsigned int flags
+);
+extern void percpu_ref_exit(struct percpu_ref *ref);
+extern void percpu_ref_switch_to_atomic(struct percpu_ref *ref);
+extern void percpu_ref_switch_to_percpu(struct percpu_ref *ref);
+extern void percpu_ref_kill(struct percpu_ref *ref);
+extern bool percpu_ref_is_zero(struct percpu_ref *ref);
+
+static __always_inline atomic_long *__percpu_ref_shard(struct percpu_ref *ref
+) {
+    unsigned int hint = percpu_ref_shard_hint;
+
+    if (unlikely(!hint))
+        hint = __percpu_ref_assign_shard_hint();
+    return &ref->shards[hint & ref->shard_mask].count;
+}
+
+static __always_inline bool __ref_is_percpu(struct percpu_ref *ref) {
+    return !(
+        atomic_load_explicit(&ref->flags, memory_order_relaxed) &
+        __PERCPU_REF_ATOMIC
+    );
+}
+
+static __always_inline bool __shard_is_dead(long count) {
+    return count < PERCPU_SHARD_DEAD / 2;
+}
+
+static __always_inline bool __percpu_ref_tryget_atomic(
+    struct percpu_ref *ref,
+    unsigned long nr
+) {
+    long old;
+
+    old = atomic_load_explicit(&ref->count, memory_order_relaxed);
+    do {
+        if (!old)
+            return false;
+    } while (!atomic_compare_exchange_weak_explicit(
+        &ref->count,
+        &old,
+        old + nr,
+        memory_order_relaxed,
+        memory_order_relaxed
+    ));
+    return true;
+}
+
+/**
+ * percpu_ref_get_many - increment a percpu refcount
+ * @ref: percpu_ref to get
+ * @nr: number of references to get
+ *
+ * Analogous to arc_inc().
+ *
+ * This function is safe to call as long as @ref is between init and exit.
+ */
+static inline void percpu_ref_get_many(
+    struct percpu_ref *ref,
+    unsigned long nr
+) {
+    atomic_long *shard;
+    long old;
+
+    if (likely(__ref_is_percpu(ref))) {
+        shard = __percpu_ref_shard(ref);
+        old = atomic_fetch_add_explicit(shard, nr, memory_order_relaxed);
+        if (likely(!__shard_is_dead(old)))
+            return;
+        /* lost the race against the switch, count centrally instead */
+    }
+    atomic_fetch_add_explicit(&ref->count, nr, memory_order_relaxed);
+}
+
+/**
+ * percpu_ref_get - increment a percpu refcount
+ * @ref: percpu_ref to get
+ *
+ * Analogous to arc_inc().
+ *
+ * This function is safe to call as long as @ref is between init and exit.
+ */
+static inline void percpu_ref_get(struct percpu_ref *ref) {
+    percpu_ref_get_many(ref, 1);
+}
+
+/**
+ * percpu_ref_tryget_many - try to increment a percpu refcount
+ * @ref: percpu_ref to try-get
+ * @nr: number of references to get
+ *
+ * Increment a percpu refcount by @nr unless its count already reached zero.
+ * Returns %true on success; %false on failure.
+ *
+ * This function is safe to call as long as @ref is between init and exit.
+ */
+static inline bool percpu_ref_tryget_many(
+    struct percpu_ref *ref,
+    unsigned long nr
+) {
+    atomic_long *shard;
+    long old;
+
+    if (likely(__ref_is_percpu(ref))) {
+        shard = __percpu_ref_shard(ref);
+        old = atomic_fetch_add_explicit(shard, nr, memory_order_relaxed);
+        if (likely(!__shard_is_dead(old)))
+            return true;
+    }
+    return __percpu_ref_tryget_atomic(ref, nr);
+}
+
+/**
+ * percpu_ref_tryget - try to increment a percpu refcount
+ * @ref: percpu_ref to try-get
+ *
+ * Increment a percpu refcount unless its count already reached zero.
+ * Returns %true on success; %false on failure.
+ *
+ * This function is safe to call as long as @ref is between init and exit.
+ */
+static inline bool percpu_ref_tryget(struct percpu_ref *ref) {
+    return percpu_ref_tryget_many(ref, 1);
+}
+
+/**
+ * percpu_ref_tryget_live - try to increment a live percpu refcount
+ * @ref: percpu_ref to try-get
+ *
+ * Increment a percpu refcount unless it has already been killed.  Returns
+ * %true on success; %false on failure.
+ *
+ * A call that overlaps percpu_ref_kill() may still succeed, but one that
+ * starts after percpu_ref_kill() has returned is guaranteed to fail.
+ *
+ * This function is safe to call as long as @ref is between init and exit.
+ */
+static inline bool percpu_ref_tryget_live(struct percpu_ref *ref) {
+    atomic_long *shard;
+    long old;
+
+    if (likely(__ref_is_percpu(ref))) {
+        shard = __percpu_ref_shard(ref);
+        old = atomic_fetch_add_explicit(shard, 1, memory_order_relaxed);
+        if (likely(!__shard_is_dead(old)))
+            return true;
+        /* pairs with the shard retirement to make DEAD visible */
+        atomic_thread_fence(memory_order_acquire);
+    }
+
+    if (atomic_load_explicit(&ref->flags, memory_order_acquire) &
+        __PERCPU_REF_DEAD)
+        return false;
+    return __percpu_ref_tryget_atomic(ref, 1);
+}
+
+/**
+ * percpu_ref_put_many - decrement a percpu refcount
+ * @ref: percpu_ref to put
+ * @nr: number of references to put
+ *
+ * Decrement the refcount, and if 0, call the release function (which was
+ * passed to percpu_ref_init())
+ *
+ * This function is safe to call as long as @ref is between init and exit.
+ */
+static inline void percpu_ref_put_many(
+    struct percpu_ref *ref,
+    unsigned long nr
+) {
+    atomic_long *shard;
+    long old;
+
+    if (likely(__ref_is_percpu(ref))) {
+        shard = __percpu_ref_shard(ref);
+        old = atomic_fetch_sub_explicit(shard, nr, memory_order_release);
+        if (likely(!__shard_is_dead(old)))
+            return;
+    }
+
+    old = atomic_fetch_sub_explicit(&ref->count, nr, memory_order_release);
+    if (unlikely(old == (long) nr)) {
+        atomic_thread_fence(memory_order_acquire);
+        ref->release(ref);
+    }
+}
+
+/**
+ * percpu_ref_put - decrement a percpu refcount
+ * @ref: percpu_ref to put
+ *
+ * Decrement the refcount, and if 0, call the release function (which was
+ * passed to percpu_ref_init())
+ *
+ * This function is safe to call as long as @ref is between init and exit.
+ */
+static inline void percpu_ref_put(struct percpu_ref *ref) {
+    percpu_ref_put_many(ref, 1);
+}
+
+/**
+ * percpu_ref_is_dying - test whether a percpu refcount is dying or dead
+ * @ref: percpu_ref to test
+ *
+ * Returns %true if @ref is dying or dead.
+ *
+ * This function is safe to call as long as @ref is between init and exit.
+ */
+static inline bool percpu_ref_is_dying(struct percpu_ref *ref) {
+    return atomic_load_explicit(&ref->flags, memory_order_relaxed) &
+           __PERCPU_REF_DEAD;
+}
+
+#endif /* _LINUX_PERCPU_REFCOUNT_H */
@@ -0,0 +1,40 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ *  Generic cache management functions. Everything is arch-specific,
+ *  but this header exists to make sure the defines/functions can be
+ *  used in a generic way.
+ *
+ *  2000-11-13  Arjan van de Ven   <arjan@fenrus.demon.nl>
+ *
+ */
+
+#ifndef _LINUX_PREFETCH_H
+#define _LINUX_PREFETCH_H
+
+#include <stddef.h>
+
+#include "cache.h"
+
+/*
+ * prefetch(x) attempts to pre-emptively get the memory pointed to
+ * by address "x" into the CPU L1 cache.
+ * prefetch(x) should not cause any kind of exception, prefetch(0) is
+ * specifically ok.
+ *
+ * prefetchw(x) prefetches the cacheline at "x" for write.
+ *
+ * prefetch_range(addr, len) prefetches every cacheline of the range.
+ */
+
+#define prefetch(x) __builtin_prefetch(x)
+#define prefetchw(x) __builtin_prefetch(x, 1)
+
+static inline void prefetch_range(void *addr, size_t len) {
+    char *cp;
+    char *end = (char *) addr + len;
+
+    for (cp = addr; cp < end; cp += L1_CACHE_BYTES)
+        prefetch(cp);
+}
+
+#endif /* _LINUX_PREFETCH_H */
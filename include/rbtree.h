@@ -20,6 +20,7 @@
 #include "rbtree_types.h"
 #include "urcu.h"
 #include "container_of.h"
+#include "prefetch.h"
 
 #include <stddef.h>
 
@@ -153,6 +154,242 @@ static inline void rb_replace_node_cached(
     rb_replace_node(victim, new, &root->rb_root);
 }
 
+/* Same as rb_last(), but O(1) */
+#define rb_last_rcached(root) (root)->rb_rightmost
+
+static inline void rb_insert_color_rcached(
+    struct rb_node *node,
+    struct rb_root_rcached *root,
+    bool rightmost
+) {
+    if (rightmost)
+        root->rb_rightmost = node;
+    rb_insert_color(node, &root->rb_root);
+}
+
+static inline struct rb_node *rb_erase_rcached(
+    struct rb_node *node,
+    struct rb_root_rcached *root
+) {
+    struct rb_node *rightmost = NULL;
+
+    if (root->rb_rightmost == node)
+        rightmost = root->rb_rightmost = rb_prev(node);
+
+    rb_erase(node, &root->rb_root);
+
+    return rightmost;
+}
+
+static inline void rb_replace_node_rcached(
+    struct rb_node *victim,
+    struct rb_node *new,
+    struct rb_root_rcached *root
+) {
+    if (root->rb_rightmost == victim)
+        root->rb_rightmost = new;
+    rb_replace_node(victim, new, &root->rb_root);
+}
+
+struct list_head;
+struct rb_augment_callbacks;
+
+/*
+ * Bulk construction from sorted input: link already ordered nodes into a
+ * balanced, correctly colored tree in O(n), without comparisons or
+ * rebalancing.  Whatever @root held before is discarded.
+ */
+extern void rb_build(struct rb_node **nodes, size_t nr, struct rb_root *root);
+extern void __rb_build_list(
+    struct list_head *head,
+    ptrdiff_t offset,
+    struct rb_root *root,
+    const struct rb_augment_callbacks *augment
+);
+
+static inline void rb_build_cached(
+    struct rb_node **nodes,
+    size_t nr,
+    struct rb_root_cached *root
+) {
+    rb_build(nodes, nr, &root->rb_root);
+    root->rb_leftmost = nr ? nodes[0] : NULL;
+}
+
+#define __rb_build_offset(type, list_member, rb_member) \
+    ((ptrdiff_t) offsetof(type, rb_member) -            \
+     (ptrdiff_t) offsetof(type, list_member))
+
+/**
+ * rb_build_list - build a tree from a sorted list in linear time
+ * @head: list of objects, in ascending order
+ * @root: tree to build
+ * @type: the type of the objects
+ * @list_member: the name of the list_head within the struct
+ * @rb_member: the name of the rb_node within the struct
+ *
+ * The objects stay on @head; the list is only read.
+ */
+#define rb_build_list(head, root, type, list_member, rb_member) \
+    __rb_build_list(                                            \
+        head,                                                   \
+        __rb_build_offset(type, list_member, rb_member),        \
+        root,                                                   \
+        NULL                                                    \
+    )
+
+#define rb_build_list_cached(head, root, type, list_member, rb_member) \
+    do {                                                               \
+        struct rb_root_cached *__root = (root);                        \
+        rb_build_list(                                                 \
+            head,                                                      \
+            &__root->rb_root,                                          \
+            type,                                                      \
+            list_member,                                               \
+            rb_member                                                  \
+        );                                                             \
+        __root->rb_leftmost = rb_first(&__root->rb_root);              \
+    } while (0)
+
+/*
+ * Join-based bulk operations, in time logarithmic in the tree sizes rather
+ * than linear as with node-by-node insertion.  The set operations expect
+ * the keys within each tree to be unique.  They consume @b and leave the
+ * result in @a, keeping the nodes of @a where both trees hold a key; every
+ * node that ends up in neither tree is handed to @dispose, which may free
+ * it, but must not touch the trees.  @dispose may be NULL.
+ *
+ * The plain variants below pass a NULL @augment; see rbtree_augmented.h for
+ * augmented trees.  None of these maintain rb_leftmost, and none are safe
+ * against concurrent RCU readers.
+ */
+extern void __rb_join(
+    struct rb_root *left,
+    struct rb_node *pivot,
+    struct rb_root *right,
+    const struct rb_augment_callbacks *augment
+);
+extern void __rb_split(
+    struct rb_root *tree,
+    const void *key,
+    struct rb_root *right,
+    int (*cmp)(const void *key, const struct rb_node *),
+    const struct rb_augment_callbacks *augment
+);
+extern void __rb_union(
+    struct rb_root *a,
+    struct rb_root *b,
+    int (*cmp)(struct rb_node *, const struct rb_node *),
+    void (*dispose)(struct rb_node *, void *),
+    void *priv,
+    const struct rb_augment_callbacks *augment
+);
+extern void __rb_intersect(
+    struct rb_root *a,
+    struct rb_root *b,
+    int (*cmp)(struct rb_node *, const struct rb_node *),
+    void (*dispose)(struct rb_node *, void *),
+    void *priv,
+    const struct rb_augment_callbacks *augment
+);
+extern void __rb_difference(
+    struct rb_root *a,
+    struct rb_root *b,
+    int (*cmp)(struct rb_node *, const struct rb_node *),
+    void (*dispose)(struct rb_node *, void *),
+    void *priv,
+    const struct rb_augment_callbacks *augment
+);
+
+/**
+ * rb_join - concatenate two trees
+ * @left: tree whose nodes all order before @right, receives the result
+ * @pivot: unlinked node that orders between @left and @right, or NULL
+ * @right: tree to append, emptied
+ *
+ * With a @pivot this costs the difference of the tree heights, without one
+ * O(log n).
+ */
+static inline void rb_join(
+    struct rb_root *left,
+    struct rb_node *pivot,
+    struct rb_root *right
+) {
+    __rb_join(left, pivot, right, NULL);
+}
+
+/**
+ * rb_split - split a tree at a key
+ * @tree: tree to split, keeps the nodes ordered before @key
+ * @key: key to split at
+ * @right: receives the nodes ordered at or after @key
+ * @cmp: comparison of @key against a node, as for rb_find()
+ *
+ * O(log n); the previous contents of @right are discarded.
+ */
+static inline void rb_split(
+    struct rb_root *tree,
+    const void *key,
+    struct rb_root *right,
+    int (*cmp)(const void *key, const struct rb_node *)
+) {
+    __rb_split(tree, key, right, cmp, NULL);
+}
+
+/**
+ * rb_union - merge @b into @a
+ * @a: first tree, receives the union
+ * @b: second tree, emptied
+ * @cmp: comparison of two nodes, as for rb_find_add()
+ * @dispose: called for the nodes of @b whose key is already in @a, or NULL
+ * @priv: passed to @dispose
+ */
+static inline void rb_union(
+    struct rb_root *a,
+    struct rb_root *b,
+    int (*cmp)(struct rb_node *, const struct rb_node *),
+    void (*dispose)(struct rb_node *, void *),
+    void *priv
+) {
+    __rb_union(a, b, cmp, dispose, priv, NULL);
+}
+
+/**
+ * rb_intersect - keep the nodes of @a whose key is also in @b
+ * @a: first tree, receives the intersection
+ * @b: second tree, emptied
+ * @cmp: comparison of two nodes, as for rb_find_add()
+ * @dispose: called for the nodes dropped from @a and for all of @b, or NULL
+ * @priv: passed to @dispose
+ */
+static inline void rb_intersect(
+    struct rb_root *a,
+    struct rb_root *b,
+    int (*cmp)(struct rb_node *, const struct rb_node *),
+    void (*dispose)(struct rb_node *, void *),
+    void *priv
+) {
+    __rb_intersect(a, b, cmp, dispose, priv, NULL);
+}
+
+/**
+ * rb_difference - drop the nodes of @a whose key is in @b
+ * @a: first tree, receives the difference
+ * @b: second tree, emptied
+ * @cmp: comparison of two nodes, as for rb_find_add()
+ * @dispose: called for the nodes dropped from @a and for all of @b, or NULL
+ * @priv: passed to @dispose
+ */
+static inline void rb_difference(
+    struct rb_root *a,
+    struct rb_root *b,
+    int (*cmp)(struct rb_node *, const struct rb_node *),
+    void (*dispose)(struct rb_node *, void *),
+    void *priv
+) {
+    __rb_difference(a, b, cmp, dispose, priv, NULL);
+}
+
 /*
  * The below helper functions use 2 operators with 3 different
  * calling conventions. The operators are related like:
@@ -228,6 +465,134 @@ static __always_inline void rb_add(
     rb_insert_color(node, tree);
 }
 
+/*
+ * Finger search for the link of @node, starting from @hint: if @node orders
+ * right before or after @hint, it is linked next to it after comparing with
+ * the neighbor on that side.  Otherwise climb until an ancestor on the far
+ * side of @node turns up, comparing only where the path turns, and keep as
+ * @top the last node passed that orders on the near side.  Nothing orders
+ * between @top and the subtree of its far child, so the descent starts
+ * there rather than at the root.  Equal nodes are kept in insertion order,
+ * as by rb_add().
+ */
+static __always_inline struct rb_node **__rb_hint_link(
+    struct rb_node *node,
+    struct rb_node *hint,
+    struct rb_node **parent,
+    bool (*less)(struct rb_node *, const struct rb_node *)
+) {
+    struct rb_node *cur, *up, *top = hint, **link;
+
+    if (!less(node, hint)) {
+        /* the successor is the leftmost node on the right, if any */
+        if ((cur = hint->rb_right)) {
+            while (cur->rb_left)
+                cur = cur->rb_left;
+            if (less(node, cur)) {
+                *parent = cur;
+                return &cur->rb_left;
+            }
+            top = cur;
+        }
+        /* else the first ancestor reached from the left */
+        for (cur = top; (up = rb_parent(cur)); cur = up) {
+            if (cur == up->rb_left) {
+                if (less(node, up))
+                    break;
+                top = up;
+            }
+        }
+        link = &top->rb_right;
+    } else {
+        if ((cur = hint->rb_left)) {
+            while (cur->rb_right)
+                cur = cur->rb_right;
+            if (!less(node, cur)) {
+                *parent = cur;
+                return &cur->rb_right;
+            }
+            top = cur;
+        }
+        for (cur = top; (up = rb_parent(cur)); cur = up) {
+            if (cur == up->rb_right) {
+                if (!less(node, up))
+                    break;
+                top = up;
+            }
+        }
+        link = &top->rb_left;
+    }
+
+    *parent = top;
+    while ((cur = *link)) {
+        *parent = cur;
+        link = less(node, cur) ? &cur->rb_left : &cur->rb_right;
+    }
+    return link;
+}
+
+/**
+ * rb_add_hint() - insert @node into @tree, starting next to @hint
+ * @node: node to insert
+ * @hint: node of @tree expected to be close to @node, or NULL
+ * @tree: tree to insert @node into
+ * @less: operator defining the (partial) node order
+ *
+ * For nearly sorted input, with the previously inserted node as @hint, the
+ * comparisons grow with how far @node lands from @hint rather than with the
+ * size of the tree: one or two when they end up adjacent, and never more
+ * than a descent from the root would take.  Telling that no node orders
+ * after @hint still means climbing its ancestors, though, so the pointer
+ * chasing is O(depth) and appending past the maximum stays O(log n); use
+ * rb_add_rcached() for O(1) appends.  Without a @hint this is rb_add().
+ */
+static __always_inline void rb_add_hint(
+    struct rb_node *node,
+    struct rb_node *hint,
+    struct rb_root *tree,
+    bool (*less)(struct rb_node *, const struct rb_node *)
+) {
+    struct rb_node **link, *parent;
+
+    if (!hint) {
+        rb_add(node, tree, less);
+        return;
+    }
+
+    link = __rb_hint_link(node, hint, &parent, less);
+    rb_link_node(node, parent, link);
+    rb_insert_color(node, tree);
+}
+
+/**
+ * rb_add_rcached() - insert @node into the rightmost cached tree @tree
+ * @node: node to insert
+ * @tree: rightmost cached tree to insert @node into
+ * @less: operator defining the (partial) node order
+ *
+ * Appending is O(1) amortized, and nodes that order shortly before the
+ * rightmost one are placed with rb_add_hint().
+ *
+ * Returns @node when it is the new rightmost, or NULL.
+ */
+static __always_inline struct rb_node *rb_add_rcached(
+    struct rb_node *node,
+    struct rb_root_rcached *tree,
+    bool (*less)(struct rb_node *, const struct rb_node *)
+) {
+    struct rb_node *last = tree->rb_rightmost;
+
+    if (last && less(node, last)) {
+        rb_add_hint(node, last, &tree->rb_root, less);
+        return NULL;
+    }
+
+    rb_link_node(node, last, last ? &last->rb_right : &tree->rb_root.rb_node);
+    rb_insert_color_rcached(node, tree, true);
+
+    return node;
+}
+
 /**
  * rb_find_add() - find equivalent @node in @tree, or add @node
  * @node: node to look-for / insert
@@ -329,6 +694,71 @@ static __always_inline struct rb_node *rb_find(
     return NULL;
 }
 
+/* Number of descents rb_find_batch() keeps in flight */
+#define RB_FIND_BATCH 16
+
+/**
+ * rb_find_batch() - find many keys in tree @tree at once
+ * @keys: keys to match
+ * @nr: number of entries in @keys
+ * @tree: tree to search
+ * @cmp: operator defining the node order
+ * @out: receives the rb_node matching each key, or NULL
+ *
+ * Same as calling rb_find() for every key, but the descents of up to
+ * RB_FIND_BATCH keys advance in lockstep, one level at a time, and the next
+ * node of each is prefetched before the others are compared.  The cache
+ * misses of independent lookups thus overlap instead of being paid one after
+ * the other, which pays off once the tree no longer fits in the cache.  The
+ * prefetch covers the line holding the rb_node, so keys should live next to
+ * it.
+ */
+static __always_inline void rb_find_batch(
+    const void *const *keys,
+    size_t nr,
+    const struct rb_root *tree,
+    int (*cmp)(const void *key, const struct rb_node *),
+    struct rb_node **out
+) {
+    struct rb_node *cur[RB_FIND_BATCH];
+    size_t base, i, n, active;
+
+    for (base = 0; base < nr; base += n) {
+        n = nr - base < RB_FIND_BATCH ? nr - base : RB_FIND_BATCH;
+        for (i = 0; i < n; i++) {
+            cur[i] = tree->rb_node;
+            out[base + i] = NULL;
+        }
+
+        do {
+            active = 0;
+            for (i = 0; i < n; i++) {
+                struct rb_node *node = cur[i];
+                int c;
+
+                if (!node)
+                    continue;
+
+                c = cmp(keys[base + i], node);
+                if (c < 0) {
+                    node = node->rb_left;
+                } else if (c > 0) {
+                    node = node->rb_right;
+                } else {
+                    out[base + i] = node;
+                    node = NULL;
+                }
+
+                if (node) {
+                    prefetch(node);
+                    active++;
+                }
+                cur[i] = node;
+            }
+        } while (active);
+    }
+}
+
 /**
  * rb_find_rcu() - find @key in tree @tree
  * @key: key to match
@@ -336,29 +766,35 @@ static __always_inline struct rb_node *rb_find(
  * @cmp: operator defining the node order
  *
  * Notably, tree descent vs concurrent tree rotations is unsound and can result
- * in false-negatives.
+ * in false-negatives.  A returned node is always a correct match, but NULL
+ * does not prove that @key is absent; use a latch tree (rbtree_latch.h) when
+ * lookups must not miss.
+ *
+ * Must be called under rcu_read_lock(), with updaters using the _rcu link
+ * helpers.
  *
  * Returns the rb_node matching @key or NULL.
  */
-/*static __always_inline struct rb_node **/
-/*rb_find_rcu(const void *key, const struct rb_root *tree,*/
-/*	    int (*cmp)(const void *key, const struct rb_node *))*/
-/*{*/
-/*	struct rb_node *node = tree->rb_node;*/
-/**/
-/*	while (node) {*/
-/*		int c = cmp(key, node);*/
-/**/
-/*		if (c < 0)*/
-/*			node = rcu_dereference_raw(node->rb_left);*/
-/*		else if (c > 0)*/
-/*			node = rcu_dereference_raw(node->rb_right);*/
-/*		else*/
-/*			return node;*/
-/*	}*/
-/**/
-/*	return NULL;*/
-/*}*/
+static __always_inline struct rb_node *rb_find_rcu(
+    const void *key,
+    const struct rb_root *tree,
+    int (*cmp)(const void *key, const struct rb_node *)
+) {
+    struct rb_node *node = rcu_dereference(tree->rb_node);
+
+    while (node) {
+        int c = cmp(key, node);
+
+        if (c < 0)
+            node = rcu_dereference(node->rb_left);
+        else if (c > 0)
+            node = rcu_dereference(node->rb_right);
+        else
+            return node;
+    }
+
+    return NULL;
+}
 
 /**
  * rb_find_first() - find the first @key in @tree
@@ -421,4 +857,172 @@ static __always_inline struct rb_node *rb_next_match(
     for ((node) = rb_find_first((key), (tree), (cmp)); (node); \
          (node) = rb_next_match((key), (node), (cmp)))
 
+/**
+ * rb_find_ge() - find the first node not ordered before @key
+ * @key: lower bound
+ * @tree: tree to search
+ * @cmp: operator defining node order
+ *
+ * Returns the leftmost node comparing greater than or equal to @key, or NULL.
+ */
+static __always_inline struct rb_node *rb_find_ge(
+    const void *key,
+    const struct rb_root *tree,
+    int (*cmp)(const void *key, const struct rb_node *)
+) {
+    struct rb_node *node = tree->rb_node;
+    struct rb_node *match = NULL;
+
+    while (node) {
+        if (cmp(key, node) <= 0) {
+            match = node;
+            node = node->rb_left;
+        } else {
+            node = node->rb_right;
+        }
+    }
+
+    return match;
+}
+
+/**
+ * rb_find_gt() - find the first node ordered after @key
+ * @key: strict lower bound
+ * @tree: tree to search
+ * @cmp: operator defining node order
+ *
+ * Returns the leftmost node comparing greater than @key, or NULL.
+ */
+static __always_inline struct rb_node *rb_find_gt(
+    const void *key,
+    const struct rb_root *tree,
+    int (*cmp)(const void *key, const struct rb_node *)
+) {
+    struct rb_node *node = tree->rb_node;
+    struct rb_node *match = NULL;
+
+    while (node) {
+        if (cmp(key, node) < 0) {
+            match = node;
+            node = node->rb_left;
+        } else {
+            node = node->rb_right;
+        }
+    }
+
+    return match;
+}
+
+/**
+ * rb_find_le() - find the last node not ordered after @key
+ * @key: upper bound
+ * @tree: tree to search
+ * @cmp: operator defining node order
+ *
+ * Returns the rightmost node comparing less than or equal to @key, or NULL.
+ */
+static __always_inline struct rb_node *rb_find_le(
+    const void *key,
+    const struct rb_root *tree,
+    int (*cmp)(const void *key, const struct rb_node *)
+) {
+    struct rb_node *node = tree->rb_node;
+    struct rb_node *match = NULL;
+
+    while (node) {
+        if (cmp(key, node) >= 0) {
+            match = node;
+            node = node->rb_right;
+        } else {
+            node = node->rb_left;
+        }
+    }
+
+    return match;
+}
+
+/**
+ * rb_find_lt() - find the last node ordered before @key
+ * @key: strict upper bound
+ * @tree: tree to search
+ * @cmp: operator defining node order
+ *
+ * Returns the rightmost node comparing less than @key, or NULL.
+ */
+static __always_inline struct rb_node *rb_find_lt(
+    const void *key,
+    const struct rb_root *tree,
+    int (*cmp)(const void *key, const struct rb_node *)
+) {
+    struct rb_node *node = tree->rb_node;
+    struct rb_node *match = NULL;
+
+    while (node) {
+        if (cmp(key, node) > 0) {
+            match = node;
+            node = node->rb_right;
+        } else {
+            node = node->rb_left;
+        }
+    }
+
+    return match;
+}
+
+/**
+ * rb_find_range() - find the first node within [@lo, @hi)
+ * @lo: lower bound, inclusive
+ * @hi: upper bound, exclusive
+ * @tree: tree to search
+ * @cmp: operator defining node order
+ *
+ * Returns the leftmost node comparing greater than or equal to @lo and less
+ * than @hi, or NULL.
+ */
+static __always_inline struct rb_node *rb_find_range(
+    const void *lo,
+    const void *hi,
+    const struct rb_root *tree,
+    int (*cmp)(const void *key, const struct rb_node *)
+) {
+    struct rb_node *node = rb_find_ge(lo, tree, cmp);
+
+    if (node && cmp(hi, node) <= 0)
+        node = NULL;
+    return node;
+}
+
+/**
+ * rb_next_before() - find the next node ordered before @hi
+ * @hi: upper bound, exclusive
+ * @node: current node
+ * @cmp: operator defining node order
+ *
+ * Returns the successor of @node if it compares less than @hi, or NULL.
+ */
+static __always_inline struct rb_node *rb_next_before(
+    const void *hi,
+    struct rb_node *node,
+    int (*cmp)(const void *key, const struct rb_node *)
+) {
+    node = rb_next(node);
+    if (node && cmp(hi, node) <= 0)
+        node = NULL;
+    return node;
+}
+
+/**
+ * rb_for_each_range() - iterates the nodes within [@lo, @hi)
+ * @node: iterator
+ * @lo: lower bound, inclusive
+ * @hi: upper bound, exclusive
+ * @tree: tree to search
+ * @cmp: operator defining node order
+ *
+ * Visits the nodes in order, in O(log n + k) for k nodes in range.
+ */
+#define rb_for_each_range(node, lo, hi, tree, cmp)                  \
+    for ((node) = rb_find_range((lo), (hi), (tree), (cmp)); (node); \
+         (node) = rb_next_before((hi), (node), (cmp)))
+
 #endif /* _LINUX_RBTREE_H */
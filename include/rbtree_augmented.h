@@ -63,6 +63,94 @@ static inline void rb_insert_augmented_cached(
     rb_insert_augmented(node, &root->rb_root, augment);
 }
 
+/*
+ * Bulk construction of an augmented tree from sorted input, see rb_build().
+ * The augmented value of every node is computed through @augment->propagate
+ * once both of its subtrees are complete, so this is O(n) as well.
+ */
+extern void rb_build_augmented(
+    struct rb_node **nodes,
+    size_t nr,
+    struct rb_root *root,
+    const struct rb_augment_callbacks *augment
+);
+
+static inline void rb_build_augmented_cached(
+    struct rb_node **nodes,
+    size_t nr,
+    struct rb_root_cached *root,
+    const struct rb_augment_callbacks *augment
+) {
+    rb_build_augmented(nodes, nr, &root->rb_root, augment);
+    root->rb_leftmost = nr ? nodes[0] : NULL;
+}
+
+#define rb_build_list_augmented(head, root, type, list_member, rb_member, aug) \
+    __rb_build_list(                                                          \
+        head,                                                                 \
+        __rb_build_offset(type, list_member, rb_member),                      \
+        root,                                                                 \
+        aug                                                                   \
+    )
+
+/*
+ * Join-based bulk operations on augmented trees, see rb_join() and friends
+ * in rbtree.h.  Every node whose subtree changes is recomputed through
+ * @augment, and rotations go through @augment->rotate, so the augmented
+ * values stay correct at the same asymptotic cost.
+ */
+static inline void rb_join_augmented(
+    struct rb_root *left,
+    struct rb_node *pivot,
+    struct rb_root *right,
+    const struct rb_augment_callbacks *augment
+) {
+    __rb_join(left, pivot, right, augment);
+}
+
+static inline void rb_split_augmented(
+    struct rb_root *tree,
+    const void *key,
+    struct rb_root *right,
+    int (*cmp)(const void *key, const struct rb_node *),
+    const struct rb_augment_callbacks *augment
+) {
+    __rb_split(tree, key, right, cmp, augment);
+}
+
+static inline void rb_union_augmented(
+    struct rb_root *a,
+    struct rb_root *b,
+    int (*cmp)(struct rb_node *, const struct rb_node *),
+    void (*dispose)(struct rb_node *, void *),
+    void *priv,
+    const struct rb_augment_callbacks *augment
+) {
+    __rb_union(a, b, cmp, dispose, priv, augment);
+}
+
+static inline void rb_intersect_augmented(
+    struct rb_root *a,
+    struct rb_root *b,
+    int (*cmp)(struct rb_node *, const struct rb_node *),
+    void (*dispose)(struct rb_node *, void *),
+    void *priv,
+    const struct rb_augment_callbacks *augment
+) {
+    __rb_intersect(a, b, cmp, dispose, priv, augment);
+}
+
+static inline void rb_difference_augmented(
+    struct rb_root *a,
+    struct rb_root *b,
+    int (*cmp)(struct rb_node *, const struct rb_node *),
+    void (*dispose)(struct rb_node *, void *),
+    void *priv,
+    const struct rb_augment_callbacks *augment
+) {
+    __rb_difference(a, b, cmp, dispose, priv, augment);
+}
+
 static __always_inline struct rb_node *rb_add_augmented_cached(
     struct rb_node *node,
     struct rb_root_cached *tree,
@@ -246,108 +334,30 @@ extern void __rb_erase_color(
     void (*augment_rotate)(struct rb_node *old, struct rb_node *new)
 );
 
-static __always_inline struct rb_node *__rb_erase_augmented(
-    struct rb_node *node,
-    struct rb_root *root,
-    const struct rb_augment_callbacks *augment
-) {
-    struct rb_node *child = node->rb_right;
-    struct rb_node *tmp = node->rb_left;
-    struct rb_node *parent, *rebalance;
-    unsigned long pc;
-
-    if (!tmp) {
-        /*
-         * Case 1: node to erase has no more than 1 child (easy!)
-         *
-         * Note that if there is one child it must be red due to 5)
-         * and node must be black due to 4). We adjust colors locally
-         * so as to bypass __rb_erase_color() later on.
-         */
-        pc = node->__rb_parent_color;
-        parent = __rb_parent(pc);
-        __rb_change_child(node, child, parent, root);
-        if (child) {
-            child->__rb_parent_color = pc;
-            rebalance = NULL;
-        } else
-            rebalance = __rb_is_black(pc) ? parent : NULL;
-        tmp = parent;
-    } else if (!child) {
-        /* Still case 1, but this time the child is node->rb_left */
-        tmp->__rb_parent_color = pc = node->__rb_parent_color;
-        parent = __rb_parent(pc);
-        __rb_change_child(node, tmp, parent, root);
-        rebalance = NULL;
-        tmp = parent;
-    } else {
-        struct rb_node *successor = child, *child2;
-
-        tmp = child->rb_left;
-        if (!tmp) {
-            /*
-             * Case 2: node's successor is its right child
-             *
-             *    (n)          (s)
-             *    / \          / \
-             *  (x) (s)  ->  (x) (c)
-             *        \
-             *        (c)
-             */
-            parent = successor;
-            child2 = successor->rb_right;
-
-            augment->copy(node, successor);
-        } else {
-            /*
-             * Case 3: node's successor is leftmost under
-             * node's right child subtree
-             *
-             *    (n)          (s)
-             *    / \          / \
-             *  (x) (y)  ->  (x) (y)
-             *      /            /
-             *    (p)          (p)
-             *    /            /
-             *  (s)          (c)
-             *    \
-             *    (c)
-             */
-            do {
-                parent = successor;
-                successor = tmp;
-                tmp = tmp->rb_left;
-            } while (tmp);
-            child2 = successor->rb_right;
-            WRITE_ONCE(parent->rb_left, child2);
-            WRITE_ONCE(successor->rb_right, child);
-            rb_set_parent(child, successor);
-
-            augment->copy(node, successor);
-            augment->propagate(parent, successor);
-        }
-
-        tmp = node->rb_left;
-        WRITE_ONCE(successor->rb_left, tmp);
-        rb_set_parent(tmp, successor);
-
-        pc = node->__rb_parent_color;
-        tmp = __rb_parent(pc);
-        __rb_change_child(node, successor, tmp, root);
-
-        if (child2) {
-            rb_set_parent_color(child2, parent, RB_BLACK);
-            rebalance = NULL;
-        } else {
-            rebalance = rb_is_black(successor) ? parent : NULL;
-        }
-        successor->__rb_parent_color = pc;
-        tmp = successor;
-    }
-
-    augment->propagate(tmp, NULL);
-    return rebalance;
-}
+/*
+ * __rb_insert(), ____rb_erase_color() and __rb_erase_augmented(), for
+ * struct rb_node with WRITE_ONCE() child stores as the lockless lookups
+ * expect.  rbtree.c instantiates them with dummy callbacks, and the
+ * augmented trees below with their own.
+ */
+#define RBT_REF struct rb_node *
+#define RBT_NIL NULL
+#define RBT_ROOT struct rb_root
+#define RBT_CTX
+#define RBT_NODE(ref) (ref)
+#define RBT_PC_PARENT(pc) __rb_parent(pc)
+#define RBT_PC_MAKE(p, color) ((unsigned long) (p) + (color))
+#define RBT_STORE(x, v) WRITE_ONCE(x, v)
+#define RBT_AUGMENT_ROTATE \
+    , void (*augment_rotate)(struct rb_node *old, struct rb_node *new)
+#define RBT_ROTATE(old, new) augment_rotate(old, new)
+#define RBT_AUGMENT , const struct rb_augment_callbacks *augment
+#define RBT_COPY(old, new) augment->copy(old, new)
+#define RBT_PROPAGATE(node, stop) augment->propagate(node, stop)
+#define RBT_INSERT __rb_insert
+#define RBT_ERASE_COLOR ____rb_erase_color
+#define RBT_ERASE __rb_erase_augmented
+#include "rbtree_fixup.h"
 
 static __always_inline void rb_erase_augmented(
     struct rb_node *node,
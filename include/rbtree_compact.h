@@ -0,0 +1,176 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Compact red-black trees
+ *
+ * struct rb_node is three pointers, 24 bytes per element on 64-bit.  When
+ * all elements of a tree live in one pool, struct rb_cnode links them by
+ * 32-bit index into that pool instead, with the color in the low bit of the
+ * parent index, for 12 bytes.  Nothing in the tree is a pointer, so a pool
+ * can be moved, written out or mmap()ed with its trees intact; only the
+ * base address in struct rb_cpool changes.
+ *
+ * Indices are 1-based so that RB_CNIL (0) can be the empty link, and the
+ * parent field limits a pool to RB_CMAX nodes.  The operations mirror their
+ * rbtree.h counterparts with an extra pool argument.  There are no augmented
+ * or RCU variants.
+ */
+
+#ifndef _LIBCOVE_RBTREE_COMPACT_H
+#define _LIBCOVE_RBTREE_COMPACT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "compiler.h"
+#include "container_of.h"
+
+struct rb_cnode {
+    uint32_t __rb_parent_color;
+    uint32_t rb_right;
+    uint32_t rb_left;
+};
+
+struct rb_croot {
+    uint32_t rb_node;
+};
+
+/*
+ * Where the nodes of a pool live: index i is the struct rb_cnode at @offset
+ * within the (i - 1)-th element of @stride bytes from @base.
+ */
+struct rb_cpool {
+    void *base;
+    size_t stride;
+    size_t offset;
+};
+
+#define RB_CNIL 0
+#define RB_CMAX (UINT32_MAX >> 1)
+
+#define RB_CROOT        \
+    (struct rb_croot) { \
+        RB_CNIL,        \
+    }
+
+#define RB_CPOOL(array, type, member)                             \
+    (struct rb_cpool) {                                           \
+        .base = (array), .stride = sizeof(type),                  \
+        .offset = offsetof(type, member),                         \
+    }
+
+#define RB_CEMPTY_ROOT(root) ((root)->rb_node == RB_CNIL)
+
+#define rb_cparent(node) ((node)->__rb_parent_color >> 1)
+
+static inline struct rb_cnode *rb_cnode(
+    const struct rb_cpool *pool,
+    uint32_t idx
+) {
+    return (struct rb_cnode *) ((char *) pool->base +
+                                (size_t) (idx - 1) * pool->stride +
+                                pool->offset);
+}
+
+#define rb_centry(pool, idx, type, member) \
+    container_of(rb_cnode(pool, idx), type, member)
+
+extern void rb_cinsert_color(
+    const struct rb_cpool *pool,
+    uint32_t node,
+    struct rb_croot *root
+);
+extern void rb_cerase(
+    const struct rb_cpool *pool,
+    uint32_t node,
+    struct rb_croot *root
+);
+
+/* Find logical next and previous nodes in a tree, RB_CNIL at either end */
+extern uint32_t rb_cnext(const struct rb_cpool *pool, uint32_t node);
+extern uint32_t rb_cprev(const struct rb_cpool *pool, uint32_t node);
+extern uint32_t rb_cfirst(
+    const struct rb_cpool *pool,
+    const struct rb_croot *root
+);
+extern uint32_t rb_clast(
+    const struct rb_cpool *pool,
+    const struct rb_croot *root
+);
+
+static inline void rb_clink_node(
+    const struct rb_cpool *pool,
+    uint32_t node,
+    uint32_t parent,
+    uint32_t *link
+) {
+    struct rb_cnode *n = rb_cnode(pool, node);
+
+    n->__rb_parent_color = parent << 1;
+    n->rb_left = n->rb_right = RB_CNIL;
+    *link = node;
+}
+
+/**
+ * rb_cadd() - insert node @node into @tree
+ * @pool: pool of the tree
+ * @node: index of the node to insert
+ * @tree: tree to insert @node into
+ * @less: operator defining the (partial) node order
+ */
+static __always_inline void rb_cadd(
+    const struct rb_cpool *pool,
+    uint32_t node,
+    struct rb_croot *tree,
+    bool (*less)(struct rb_cnode *, const struct rb_cnode *)
+) {
+    struct rb_cnode *n = rb_cnode(pool, node), *p;
+    uint32_t *link = &tree->rb_node, parent = RB_CNIL;
+
+    while (*link) {
+        parent = *link;
+        p = rb_cnode(pool, parent);
+        if (less(n, p))
+            link = &p->rb_left;
+        else
+            link = &p->rb_right;
+    }
+
+    rb_clink_node(pool, node, parent, link);
+    rb_cinsert_color(pool, node, tree);
+}
+
+/**
+ * rb_cfind() - find @key in @tree
+ * @pool: pool of the tree
+ * @key: key to match
+ * @tree: tree to search
+ * @cmp: operator defining the node order
+ *
+ * Returns the index of a node matching @key, or RB_CNIL.
+ */
+static __always_inline uint32_t rb_cfind(
+    const struct rb_cpool *pool,
+    const void *key,
+    const struct rb_croot *tree,
+    int (*cmp)(const void *key, const struct rb_cnode *)
+) {
+    uint32_t node = tree->rb_node;
+    struct rb_cnode *n;
+    int c;
+
+    while (node) {
+        n = rb_cnode(pool, node);
+        c = cmp(key, n);
+        if (c < 0)
+            node = n->rb_left;
+        else if (c > 0)
+            node = n->rb_right;
+        else
+            return node;
+    }
+
+    return RB_CNIL;
+}
+
+#endif /* _LIBCOVE_RBTREE_COMPACT_H */
@@ -0,0 +1,562 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+  Red Black Trees
+  (C) 1999  Andrea Arcangeli <andrea@suse.de>
+  (C) 2002  David Woodhouse <dwmw2@infradead.org>
+  (C) 2012  Michel Lespinasse <walken@google.com>
+
+
+  linux/lib/rbtree.c
+*/
+
+/*
+ * Template for the red-black rebalancing, over any kind of node reference
+ *
+ * Included once per node layout: by rbtree_augmented.h for struct rb_node,
+ * and by rbtree_compact.c for the pool-indexed struct rb_cnode.  Both node
+ * structs have __rb_parent_color, rb_left and rb_right members, and keep
+ * the color in bit 0 of __rb_parent_color.
+ *
+ * RBT_REF:               type of a node reference, false when empty
+ * RBT_NIL:               the empty reference
+ * RBT_ROOT:              struct type of the root, with an RBT_REF rb_node
+ * RBT_CTX:               extra leading parameter, with its comma, or empty
+ * RBT_NODE(ref):         pointer to the node struct @ref designates
+ * RBT_PC_PARENT(pc):     parent reference held in a __rb_parent_color value
+ * RBT_PC_MAKE(p, color): __rb_parent_color value for parent @p and @color
+ * RBT_STORE(x, v):       store to a child link or to the root
+ * RBT_AUGMENT_ROTATE:    trailing rotate callback parameter, or empty
+ * RBT_ROTATE(old, new):  rotate callback invocation
+ * RBT_AUGMENT:           trailing augment callbacks parameter, or empty
+ * RBT_COPY(old, new):    copy callback invocation
+ * RBT_PROPAGATE(n, stop): propagate callback invocation
+ * RBT_INSERT:            name of the insert fixup to define
+ * RBT_ERASE_COLOR:       name of the erase fixup to define
+ * RBT_ERASE:             name of the unlinking half of erase to define
+ *
+ * All of them are #undef'd at the end, ready for the next instantiation.
+ */
+
+/*
+ * red-black trees properties:  https://en.wikipedia.org/wiki/Rbtree
+ *
+ *  1) A node is either red or black
+ *  2) The root is black
+ *  3) All leaves (NULL) are black
+ *  4) Both children of every red node are black
+ *  5) Every simple path from root to leaves contains the same number
+ *     of black nodes.
+ *
+ *  4 and 5 give the O(log n) guarantee, since 4 implies you cannot have two
+ *  consecutive red nodes in a path and every red node is therefore followed by
+ *  a black. So if B is the number of black nodes on every simple path (as per
+ *  5), then the longest possible path due to 4 is 2B.
+ *
+ *  We shall indicate color with case, where black nodes are uppercase and red
+ *  nodes will be lowercase. Unknown color nodes shall be drawn as red within
+ *  parentheses and have some accompanying text comment.
+ */
+
+#define __RBT_PC(ref) (RBT_NODE(ref)->__rb_parent_color)
+#define __RBT_LEFT(ref) (RBT_NODE(ref)->rb_left)
+#define __RBT_RIGHT(ref) (RBT_NODE(ref)->rb_right)
+#define __RBT_PARENT(ref) RBT_PC_PARENT(__RBT_PC(ref))
+#define __RBT_IS_BLACK(ref) (__RBT_PC(ref) & RB_BLACK)
+#define __RBT_IS_RED(ref) (!__RBT_IS_BLACK(ref))
+#define __RBT_SET_BLACK(ref) (__RBT_PC(ref) += RB_BLACK)
+#define __RBT_SET_PARENT_COLOR(ref, p, color) \
+    (__RBT_PC(ref) = RBT_PC_MAKE(p, color))
+#define __RBT_SET_PARENT(ref, p) \
+    __RBT_SET_PARENT_COLOR(ref, p, __RBT_PC(ref) & RB_BLACK)
+
+#define __RBT_CHANGE_CHILD(old, new, parent)            \
+    do {                                                \
+        if (parent) {                                   \
+            if (__RBT_LEFT(parent) == (old))            \
+                RBT_STORE(__RBT_LEFT(parent), new);     \
+            else                                        \
+                RBT_STORE(__RBT_RIGHT(parent), new);    \
+        } else                                          \
+            RBT_STORE(root->rb_node, new);              \
+    } while (0)
+
+/*
+ * Helper for rotations:
+ * - old's parent and color get assigned to new
+ * - old gets assigned new as a parent and 'color' as a color.
+ */
+#define __RBT_ROTATE_SET_PARENTS(old, new, color)       \
+    do {                                                \
+        RBT_REF __parent = __RBT_PARENT(old);           \
+        __RBT_PC(new) = __RBT_PC(old);                  \
+        __RBT_SET_PARENT_COLOR(old, new, color);        \
+        __RBT_CHANGE_CHILD(old, new, __parent);         \
+    } while (0)
+
+/*
+ * Returns true if the fixup ended by blackening a red root, i.e. when the
+ * black height of the tree grew by one.
+ */
+static __always_inline bool RBT_INSERT(
+    RBT_CTX
+    RBT_REF node,
+    RBT_ROOT *root
+    RBT_AUGMENT_ROTATE
+) {
+    RBT_REF parent = __RBT_PARENT(node);
+    RBT_REF gparent;
+    RBT_REF tmp;
+
+    while (true) {
+        /*
+         * Loop invariant: node is red.
+         */
+        if (unlikely(!parent)) {
+            /*
+             * The inserted node is root. Either this is the
+             * first node, or we recursed at Case 1 below and
+             * are no longer violating 4).
+             */
+            __RBT_SET_PARENT_COLOR(node, RBT_NIL, RB_BLACK);
+            return true;
+        }
+
+        /*
+         * If there is a black parent, we are done.
+         * Otherwise, take some corrective action as,
+         * per 4), we don't want a red root or two
+         * consecutive red nodes.
+         */
+        if (__RBT_IS_BLACK(parent))
+            break;
+
+        gparent = __RBT_PARENT(parent);
+
+        tmp = __RBT_RIGHT(gparent);
+        if (parent != tmp) { /* parent == gparent->rb_left */
+            if (tmp && __RBT_IS_RED(tmp)) {
+                /*
+                 * Case 1 - node's uncle is red (color flips).
+                 *
+                 *       G            g
+                 *      / \          / \
+                 *     p   u  -->   P   U
+                 *    /            /
+                 *   n            n
+                 *
+                 * However, since g's parent might be red, and
+                 * 4) does not allow this, we need to recurse
+                 * at g.
+                 */
+                __RBT_SET_PARENT_COLOR(tmp, gparent, RB_BLACK);
+                __RBT_SET_PARENT_COLOR(parent, gparent, RB_BLACK);
+                node = gparent;
+                parent = __RBT_PARENT(node);
+                __RBT_SET_PARENT_COLOR(node, parent, RB_RED);
+                continue;
+            }
+
+            tmp = __RBT_RIGHT(parent);
+            if (node == tmp) {
+                /*
+                 * Case 2 - node's uncle is black and node is
+                 * the parent's right child (left rotate at parent).
+                 *
+                 *      G             G
+                 *     / \           / \
+                 *    p   U  -->    n   U
+                 *     \           /
+                 *      n         p
+                 *
+                 * This still leaves us in violation of 4), the
+                 * continuation into Case 3 will fix that.
+                 */
+                tmp = __RBT_LEFT(node);
+                RBT_STORE(__RBT_RIGHT(parent), tmp);
+                RBT_STORE(__RBT_LEFT(node), parent);
+                if (tmp)
+                    __RBT_SET_PARENT_COLOR(tmp, parent, RB_BLACK);
+                __RBT_SET_PARENT_COLOR(parent, node, RB_RED);
+                RBT_ROTATE(parent, node);
+                parent = node;
+                tmp = __RBT_RIGHT(node);
+            }
+
+            /*
+             * Case 3 - node's uncle is black and node is
+             * the parent's left child (right rotate at gparent).
+             *
+             *        G           P
+             *       / \         / \
+             *      p   U  -->  n   g
+             *     /                 \
+             *    n                   U
+             */
+            RBT_STORE(__RBT_LEFT(gparent), tmp); /* == parent->rb_right */
+            RBT_STORE(__RBT_RIGHT(parent), gparent);
+            if (tmp)
+                __RBT_SET_PARENT_COLOR(tmp, gparent, RB_BLACK);
+            __RBT_ROTATE_SET_PARENTS(gparent, parent, RB_RED);
+            RBT_ROTATE(gparent, parent);
+            break;
+        } else {
+            tmp = __RBT_LEFT(gparent);
+            if (tmp && __RBT_IS_RED(tmp)) {
+                /* Case 1 - color flips */
+                __RBT_SET_PARENT_COLOR(tmp, gparent, RB_BLACK);
+                __RBT_SET_PARENT_COLOR(parent, gparent, RB_BLACK);
+                node = gparent;
+                parent = __RBT_PARENT(node);
+                __RBT_SET_PARENT_COLOR(node, parent, RB_RED);
+                continue;
+            }
+
+            tmp = __RBT_LEFT(parent);
+            if (node == tmp) {
+                /* Case 2 - right rotate at parent */
+                tmp = __RBT_RIGHT(node);
+                RBT_STORE(__RBT_LEFT(parent), tmp);
+                RBT_STORE(__RBT_RIGHT(node), parent);
+                if (tmp)
+                    __RBT_SET_PARENT_COLOR(tmp, parent, RB_BLACK);
+                __RBT_SET_PARENT_COLOR(parent, node, RB_RED);
+                RBT_ROTATE(parent, node);
+                parent = node;
+                tmp = __RBT_LEFT(node);
+            }
+
+            /* Case 3 - left rotate at gparent */
+            RBT_STORE(__RBT_RIGHT(gparent), tmp); /* == parent->rb_left */
+            RBT_STORE(__RBT_LEFT(parent), gparent);
+            if (tmp)
+                __RBT_SET_PARENT_COLOR(tmp, gparent, RB_BLACK);
+            __RBT_ROTATE_SET_PARENTS(gparent, parent, RB_RED);
+            RBT_ROTATE(gparent, parent);
+            break;
+        }
+    }
+    return false;
+}
+
+/*
+ * Inline for rb_erase() use - we want to be able to inline and eliminate
+ * the dummy rotate callback there
+ */
+static __always_inline void RBT_ERASE_COLOR(
+    RBT_CTX
+    RBT_REF parent,
+    RBT_ROOT *root
+    RBT_AUGMENT_ROTATE
+) {
+    RBT_REF node = RBT_NIL;
+    RBT_REF sibling;
+    RBT_REF tmp1;
+    RBT_REF tmp2;
+
+    while (true) {
+        /*
+         * Loop invariants:
+         * - node is black (or NULL on first iteration)
+         * - node is not the root (parent is not NULL)
+         * - All leaf paths going through parent and node have a
+         *   black node count that is 1 lower than other leaf paths.
+         */
+        sibling = __RBT_RIGHT(parent);
+        if (node != sibling) { /* node == parent->rb_left */
+            if (__RBT_IS_RED(sibling)) {
+                /*
+                 * Case 1 - left rotate at parent
+                 *
+                 *     P               S
+                 *    / \             / \
+                 *   N   s    -->    p   Sr
+                 *      / \         / \
+                 *     Sl  Sr      N   Sl
+                 */
+                tmp1 = __RBT_LEFT(sibling);
+                RBT_STORE(__RBT_RIGHT(parent), tmp1);
+                RBT_STORE(__RBT_LEFT(sibling), parent);
+                __RBT_SET_PARENT_COLOR(tmp1, parent, RB_BLACK);
+                __RBT_ROTATE_SET_PARENTS(parent, sibling, RB_RED);
+                RBT_ROTATE(parent, sibling);
+                sibling = tmp1;
+            }
+            tmp1 = __RBT_RIGHT(sibling);
+            if (!tmp1 || __RBT_IS_BLACK(tmp1)) {
+                tmp2 = __RBT_LEFT(sibling);
+                if (!tmp2 || __RBT_IS_BLACK(tmp2)) {
+                    /*
+                     * Case 2 - sibling color flip
+                     * (p could be either color here)
+                     *
+                     *    (p)           (p)
+                     *    / \           / \
+                     *   N   S    -->  N   s
+                     *      / \           / \
+                     *     Sl  Sr        Sl  Sr
+                     *
+                     * This leaves us violating 5) which
+                     * can be fixed by flipping p to black
+                     * if it was red, or by recursing at p.
+                     * p is red when coming from Case 1.
+                     */
+                    __RBT_SET_PARENT_COLOR(sibling, parent, RB_RED);
+                    if (__RBT_IS_RED(parent))
+                        __RBT_SET_BLACK(parent);
+                    else {
+                        node = parent;
+                        parent = __RBT_PARENT(node);
+                        if (parent)
+                            continue;
+                    }
+                    break;
+                }
+                /*
+                 * Case 3 - right rotate at sibling
+                 * (p could be either color here)
+                 *
+                 *   (p)           (p)
+                 *   / \           / \
+                 *  N   S    -->  N   sl
+                 *     / \             \
+                 *    sl  sr            S
+                 *                       \
+                 *                        sr
+                 *
+                 * Note: p might be red, and then both
+                 * p and sl are red after rotation(which
+                 * breaks property 4). This is fixed in
+                 * Case 4 (in __RBT_ROTATE_SET_PARENTS()
+                 *         which set sl the color of p
+                 *         and set p RB_BLACK)
+                 *
+                 *   (p)            (sl)
+                 *   / \            /  \
+                 *  N   sl   -->   P    S
+                 *       \        /      \
+                 *        S      N        sr
+                 *         \
+                 *          sr
+                 */
+                tmp1 = __RBT_RIGHT(tmp2);
+                RBT_STORE(__RBT_LEFT(sibling), tmp1);
+                RBT_STORE(__RBT_RIGHT(tmp2), sibling);
+                RBT_STORE(__RBT_RIGHT(parent), tmp2);
+                if (tmp1)
+                    __RBT_SET_PARENT_COLOR(tmp1, sibling, RB_BLACK);
+                RBT_ROTATE(sibling, tmp2);
+                tmp1 = sibling;
+                sibling = tmp2;
+            }
+            /*
+             * Case 4 - left rotate at parent + color flips
+             * (p and sl could be either color here.
+             *  After rotation, p becomes black, s acquires
+             *  p's color, and sl keeps its color)
+             *
+             *      (p)             (s)
+             *      / \             / \
+             *     N   S     -->   P   Sr
+             *        / \         / \
+             *      (sl) sr      N  (sl)
+             */
+            tmp2 = __RBT_LEFT(sibling);
+            RBT_STORE(__RBT_RIGHT(parent), tmp2);
+            RBT_STORE(__RBT_LEFT(sibling), parent);
+            __RBT_SET_PARENT_COLOR(tmp1, sibling, RB_BLACK);
+            if (tmp2)
+                __RBT_SET_PARENT(tmp2, parent);
+            __RBT_ROTATE_SET_PARENTS(parent, sibling, RB_BLACK);
+            RBT_ROTATE(parent, sibling);
+            break;
+        } else {
+            sibling = __RBT_LEFT(parent);
+            if (__RBT_IS_RED(sibling)) {
+                /* Case 1 - right rotate at parent */
+                tmp1 = __RBT_RIGHT(sibling);
+                RBT_STORE(__RBT_LEFT(parent), tmp1);
+                RBT_STORE(__RBT_RIGHT(sibling), parent);
+                __RBT_SET_PARENT_COLOR(tmp1, parent, RB_BLACK);
+                __RBT_ROTATE_SET_PARENTS(parent, sibling, RB_RED);
+                RBT_ROTATE(parent, sibling);
+                sibling = tmp1;
+            }
+            tmp1 = __RBT_LEFT(sibling);
+            if (!tmp1 || __RBT_IS_BLACK(tmp1)) {
+                tmp2 = __RBT_RIGHT(sibling);
+                if (!tmp2 || __RBT_IS_BLACK(tmp2)) {
+                    /* Case 2 - sibling color flip */
+                    __RBT_SET_PARENT_COLOR(sibling, parent, RB_RED);
+                    if (__RBT_IS_RED(parent))
+                        __RBT_SET_BLACK(parent);
+                    else {
+                        node = parent;
+                        parent = __RBT_PARENT(node);
+                        if (parent)
+                            continue;
+                    }
+                    break;
+                }
+                /* Case 3 - left rotate at sibling */
+                tmp1 = __RBT_LEFT(tmp2);
+                RBT_STORE(__RBT_RIGHT(sibling), tmp1);
+                RBT_STORE(__RBT_LEFT(tmp2), sibling);
+                RBT_STORE(__RBT_LEFT(parent), tmp2);
+                if (tmp1)
+                    __RBT_SET_PARENT_COLOR(tmp1, sibling, RB_BLACK);
+                RBT_ROTATE(sibling, tmp2);
+                tmp1 = sibling;
+                sibling = tmp2;
+            }
+            /* Case 4 - right rotate at parent + color flips */
+            tmp2 = __RBT_RIGHT(sibling);
+            RBT_STORE(__RBT_LEFT(parent), tmp2);
+            RBT_STORE(__RBT_RIGHT(sibling), parent);
+            __RBT_SET_PARENT_COLOR(tmp1, sibling, RB_BLACK);
+            if (tmp2)
+                __RBT_SET_PARENT(tmp2, parent);
+            __RBT_ROTATE_SET_PARENTS(parent, sibling, RB_BLACK);
+            RBT_ROTATE(parent, sibling);
+            break;
+        }
+    }
+}
+
+/*
+ * Unlinks @node, and returns the parent at which RBT_ERASE_COLOR() has to
+ * restore the black height, or RBT_NIL when the colors were fixed locally.
+ */
+static __always_inline RBT_REF RBT_ERASE(
+    RBT_CTX
+    RBT_REF node,
+    RBT_ROOT *root
+    RBT_AUGMENT
+) {
+    RBT_REF child = __RBT_RIGHT(node);
+    RBT_REF tmp = __RBT_LEFT(node);
+    RBT_REF parent;
+    RBT_REF rebalance;
+    __typeof__(__RBT_PC(node)) pc;
+
+    if (!tmp) {
+        /*
+         * Case 1: node to erase has no more than 1 child (easy!)
+         *
+         * Note that if there is one child it must be red due to 5)
+         * and node must be black due to 4). We adjust colors locally
+         * so as to bypass __rb_erase_color() later on.
+         */
+        pc = __RBT_PC(node);
+        parent = RBT_PC_PARENT(pc);
+        __RBT_CHANGE_CHILD(node, child, parent);
+        if (child) {
+            __RBT_PC(child) = pc;
+            rebalance = RBT_NIL;
+        } else
+            rebalance = (pc & RB_BLACK) ? parent : RBT_NIL;
+        tmp = parent;
+    } else if (!child) {
+        /* Still case 1, but this time the child is node->rb_left */
+        __RBT_PC(tmp) = pc = __RBT_PC(node);
+        parent = RBT_PC_PARENT(pc);
+        __RBT_CHANGE_CHILD(node, tmp, parent);
+        rebalance = RBT_NIL;
+        tmp = parent;
+    } else {
+        RBT_REF successor = child;
+        RBT_REF child2;
+
+        tmp = __RBT_LEFT(child);
+        if (!tmp) {
+            /*
+             * Case 2: node's successor is its right child
+             *
+             *    (n)          (s)
+             *    / \          / \
+             *  (x) (s)  ->  (x) (c)
+             *        \
+             *        (c)
+             */
+            parent = successor;
+            child2 = __RBT_RIGHT(successor);
+
+            RBT_COPY(node, successor);
+        } else {
+            /*
+             * Case 3: node's successor is leftmost under
+             * node's right child subtree
+             *
+             *    (n)          (s)
+             *    / \          / \
+             *  (x) (y)  ->  (x) (y)
+             *      /            /
+             *    (p)          (p)
+             *    /            /
+             *  (s)          (c)
+             *    \
+             *    (c)
+             */
+            do {
+                parent = successor;
+                successor = tmp;
+                tmp = __RBT_LEFT(tmp);
+            } while (tmp);
+            child2 = __RBT_RIGHT(successor);
+            RBT_STORE(__RBT_LEFT(parent), child2);
+            RBT_STORE(__RBT_RIGHT(successor), child);
+            __RBT_SET_PARENT(child, successor);
+
+            RBT_COPY(node, successor);
+            RBT_PROPAGATE(parent, successor);
+        }
+
+        tmp = __RBT_LEFT(node);
+        RBT_STORE(__RBT_LEFT(successor), tmp);
+        __RBT_SET_PARENT(tmp, successor);
+
+        pc = __RBT_PC(node);
+        tmp = RBT_PC_PARENT(pc);
+        __RBT_CHANGE_CHILD(node, successor, tmp);
+
+        if (child2) {
+            __RBT_SET_PARENT_COLOR(child2, parent, RB_BLACK);
+            rebalance = RBT_NIL;
+        } else {
+            rebalance = __RBT_IS_BLACK(successor) ? parent : RBT_NIL;
+        }
+        __RBT_PC(successor) = pc;
+        tmp = successor;
+    }
+
+    RBT_PROPAGATE(tmp, RBT_NIL);
+    return rebalance;
+}
+
+#undef __RBT_ROTATE_SET_PARENTS
+#undef __RBT_CHANGE_CHILD
+#undef __RBT_SET_PARENT
+#undef __RBT_SET_PARENT_COLOR
+#undef __RBT_SET_BLACK
+#undef __RBT_IS_RED
+#undef __RBT_IS_BLACK
+#undef __RBT_PARENT
+#undef __RBT_RIGHT
+#undef __RBT_LEFT
+#undef __RBT_PC
+
+#undef RBT_REF
+#undef RBT_NIL
+#undef RBT_ROOT
+#undef RBT_CTX
+#undef RBT_NODE
+#undef RBT_PC_PARENT
+#undef RBT_PC_MAKE
+#undef RBT_STORE
+#undef RBT_AUGMENT_ROTATE
+#undef RBT_ROTATE
+#undef RBT_AUGMENT
+#undef RBT_COPY
+#undef RBT_PROPAGATE
+#undef RBT_INSERT
+#undef RBT_ERASE_COLOR
+#undef RBT_ERASE
@@ -0,0 +1,96 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Frozen rbtree snapshots
+ *
+ * A tree that is built once and then only searched pays for its flexibility
+ * on every lookup: each level is a dependent load from a node somewhere in
+ * memory, and the comparator decides a hard to predict branch.
+ * rb_freeze() copies the keys of an rbtree into a single array in
+ * Eytzinger (BFS) order, the implicit layout of a complete binary search
+ * tree where the children of slot k are slots 2k and 2k + 1.  A search
+ * then compiles to a branchless loop over one contiguous array, and as the
+ * 8 descendants three levels below slot k share a cache line, they are
+ * prefetched while the next levels are still being compared.
+ *
+ * Keys are uint64_t, extracted once per node by the callback passed to
+ * rb_freeze().  Besides the keys, the snapshot holds one pointer per node,
+ * to the node itself, so that a lookup returns the struct rb_node as
+ * rb_find() does: 16 bytes per node and no child links.
+ *
+ * The snapshot does not track later changes to the tree.  Nodes that were
+ * erased or freed must not be looked up through it; rebuild the snapshot
+ * with rb_freeze() after modifying the tree.
+ */
+
+#ifndef _LINUX_RBTREE_FROZEN_H
+#define _LINUX_RBTREE_FROZEN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rbtree.h"
+
+struct rb_frozen {
+    /* 1-based: slot 0 is unused, and nodes[0] is NULL */
+    uint64_t *keys;
+    struct rb_node **nodes;
+    size_t nr;
+};
+
+extern int rb_freeze(
+    struct rb_frozen *frozen,
+    const struct rb_root *root,
+    uint64_t (*key)(const struct rb_node *)
+);
+extern void rb_frozen_destroy(struct rb_frozen *frozen);
+
+/* Slot of the first key not below @key, or 0 if there is none */
+static __always_inline size_t __rb_frozen_lower_bound(
+    const struct rb_frozen *frozen,
+    uint64_t key
+) {
+    const uint64_t *keys = frozen->keys;
+    size_t k = 1;
+
+    while (k <= frozen->nr) {
+        /* integer arithmetic, the address may lie past the array */
+        prefetch((const void *) ((uintptr_t) keys + 8 * k * sizeof(*keys)));
+        k = 2 * k + (keys[k] < key);
+    }
+
+    /* undo the right turns taken after the last left turn */
+    return k >> __builtin_ffsll(~(long long) k);
+}
+
+/**
+ * rb_frozen_find_ge() - find the first node not ordered before @key
+ * @frozen: snapshot to search
+ * @key: lower bound
+ *
+ * Returns the leftmost node whose key is greater than or equal to @key, or
+ * NULL.  Like rb_find_ge().
+ */
+static inline struct rb_node *rb_frozen_find_ge(
+    const struct rb_frozen *frozen,
+    uint64_t key
+) {
+    return frozen->nodes[__rb_frozen_lower_bound(frozen, key)];
+}
+
+/**
+ * rb_frozen_find() - find @key in snapshot @frozen
+ * @frozen: snapshot to search
+ * @key: key to match
+ *
+ * Returns the leftmost node matching @key, or NULL.
+ */
+static inline struct rb_node *rb_frozen_find(
+    const struct rb_frozen *frozen,
+    uint64_t key
+) {
+    size_t k = __rb_frozen_lower_bound(frozen, key);
+
+    return k && frozen->keys[k] == key ? frozen->nodes[k] : NULL;
+}
+
+#endif /* _LINUX_RBTREE_FROZEN_H */
@@ -0,0 +1,176 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Order-statistic red-black trees
+ *
+ * Every node carries the number of nodes in its subtree, which turns the
+ * positional queries below into a single root-to-leaf walk:
+ *
+ *	rb_select(root, k)	the k-th smallest node (0-based)
+ *	rb_rank(node)		number of nodes before @node
+ *	rb_count_range(...)	number of nodes between two keys
+ *
+ * Nodes embed a struct rb_ost_node instead of a bare struct rb_node, and the
+ * tree must only be modified with rb_ost_add() and rb_ost_erase() (or their
+ * _cached variants), which keep the subtree sizes up to date.  Insertion
+ * bumps the sizes on the way down; rebalancing fixes up the two nodes of
+ * every rotation in O(1), so no second pass over the path is needed.  Trees
+ * can also be built in bulk with rb_build_augmented() and rb_ost_callbacks.
+ *
+ * Everything else, iteration and rb_find() included, works on the embedded
+ * struct rb_node as usual.
+ */
+
+#ifndef _LINUX_RBTREE_OST_H
+#define _LINUX_RBTREE_OST_H
+
+#include <stddef.h>
+
+#include "rbtree_augmented.h"
+
+struct rb_ost_node {
+    struct rb_node rb;
+    size_t size; /* number of nodes in the subtree rooted here */
+};
+
+#define rb_ost_entry(ptr) rb_entry(ptr, struct rb_ost_node, rb)
+
+extern const struct rb_augment_callbacks rb_ost_callbacks;
+
+extern struct rb_node *rb_select(const struct rb_root *root, size_t k);
+extern size_t rb_rank(const struct rb_node *node);
+extern void rb_ost_erase(struct rb_node *node, struct rb_root *root);
+
+static __always_inline size_t __rb_ost_size(const struct rb_node *node) {
+    return node ? rb_ost_entry(node)->size : 0;
+}
+
+/**
+ * rb_ost_count() - number of nodes in @root
+ * @root: order-statistic tree
+ */
+static inline size_t rb_ost_count(const struct rb_root *root) {
+    return __rb_ost_size(root->rb_node);
+}
+
+/**
+ * rb_ost_add() - insert @node into the order-statistic tree @tree
+ * @node: node to insert, embedded in a struct rb_ost_node
+ * @tree: tree to insert @node into
+ * @less: operator defining the (partial) node order
+ */
+static __always_inline void rb_ost_add(
+    struct rb_node *node,
+    struct rb_root *tree,
+    bool (*less)(struct rb_node *, const struct rb_node *)
+) {
+    struct rb_node **link = &tree->rb_node;
+    struct rb_node *parent = NULL;
+
+    while (*link) {
+        parent = *link;
+        rb_ost_entry(parent)->size++;
+        if (less(node, parent))
+            link = &parent->rb_left;
+        else
+            link = &parent->rb_right;
+    }
+
+    rb_ost_entry(node)->size = 1;
+    rb_link_node(node, parent, link);
+    rb_insert_augmented(node, tree, &rb_ost_callbacks);
+}
+
+/**
+ * rb_ost_add_cached() - insert @node into the leftmost cached tree @tree
+ * @node: node to insert, embedded in a struct rb_ost_node
+ * @tree: leftmost cached tree to insert @node into
+ * @less: operator defining the (partial) node order
+ *
+ * Returns @node when it is the new leftmost, or NULL.
+ */
+static __always_inline struct rb_node *rb_ost_add_cached(
+    struct rb_node *node,
+    struct rb_root_cached *tree,
+    bool (*less)(struct rb_node *, const struct rb_node *)
+) {
+    struct rb_node **link = &tree->rb_root.rb_node;
+    struct rb_node *parent = NULL;
+    bool leftmost = true;
+
+    while (*link) {
+        parent = *link;
+        rb_ost_entry(parent)->size++;
+        if (less(node, parent)) {
+            link = &parent->rb_left;
+        } else {
+            link = &parent->rb_right;
+            leftmost = false;
+        }
+    }
+
+    rb_ost_entry(node)->size = 1;
+    rb_link_node(node, parent, link);
+    rb_insert_augmented_cached(node, tree, leftmost, &rb_ost_callbacks);
+
+    return leftmost ? node : NULL;
+}
+
+static inline void rb_ost_erase_cached(
+    struct rb_node *node,
+    struct rb_root_cached *root
+) {
+    if (root->rb_leftmost == node)
+        root->rb_leftmost = rb_next(node);
+    rb_ost_erase(node, &root->rb_root);
+}
+
+/*
+ * Number of nodes ordered before @key, or before-or-equal to it when
+ * @inclusive is set.
+ */
+static __always_inline size_t __rb_count_before(
+    const void *key,
+    const struct rb_root *tree,
+    int (*cmp)(const void *key, const struct rb_node *),
+    bool inclusive
+) {
+    struct rb_node *node = tree->rb_node;
+    size_t count = 0;
+
+    while (node) {
+        int c = cmp(key, node);
+
+        if (c > 0 || (inclusive && !c)) {
+            count += __rb_ost_size(node->rb_left) + 1;
+            node = node->rb_right;
+        } else {
+            node = node->rb_left;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * rb_count_range() - count the nodes of @tree within [@lo, @hi]
+ * @lo: lowest key to count
+ * @hi: highest key to count
+ * @tree: order-statistic tree to search
+ * @cmp: operator defining the node order
+ *
+ * Returns the number of nodes comparing greater than or equal to @lo and
+ * less than or equal to @hi, or 0 if @hi is ordered before @lo.
+ */
+static __always_inline size_t rb_count_range(
+    const void *lo,
+    const void *hi,
+    const struct rb_root *tree,
+    int (*cmp)(const void *key, const struct rb_node *)
+) {
+    size_t le = __rb_count_before(hi, tree, cmp, true);
+    size_t lt = __rb_count_before(lo, tree, cmp, false);
+
+    return le > lt ? le - lt : 0;
+}
+
+#endif /* _LINUX_RBTREE_OST_H */
@@ -0,0 +1,184 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Persistent red-black trees
+ *
+ * A struct prbtree is one version of an ordered map from unique uint64_t
+ * keys to non-NULL pointers.  Nodes are shared between versions and counted
+ * with struct arc: prbtree_snapshot() just takes another reference on the
+ * root, and an update copies only the nodes it has to change and that some
+ * other version still uses, i.e. the search path and the few siblings the
+ * rebalancing recolors.  Nodes used by a single version are updated in
+ * place, so a tree without snapshots costs about as much as a plain rbtree,
+ * and memory grows with the changes made while snapshots are held.
+ *
+ * Updates to one version, including taking a snapshot of it, must be
+ * serialized by the caller.  Different versions may be read and updated by
+ * different threads without locking: nodes reachable from more than one
+ * version are never written, and the last version to drop a node frees it.
+ *
+ * The values are not touched; a value that was removed from one version may
+ * still be reachable through a snapshot.
+ */
+
+#ifndef _LIBCOVE_RBTREE_PERSISTENT_H
+#define _LIBCOVE_RBTREE_PERSISTENT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "compiler.h"
+#include "refcount.h"
+
+/* No rbtree with less than 2^64 nodes is any deeper */
+#define PRBTREE_MAX_DEPTH 128
+
+struct prb_node {
+    struct prb_node *left;
+    struct prb_node *right;
+    uint64_t key;
+    void *val;
+    /* versions and parent nodes pointing here */
+    struct arc ref;
+    bool red;
+};
+
+struct prbtree {
+    struct prb_node *root;
+    unsigned long nr;
+    /* preallocated nodes, so that an update cannot fail halfway */
+    struct prb_node *spare;
+    unsigned int nr_spare;
+};
+
+#define PRBTREE_INIT {.root = NULL, .nr = 0, .spare = NULL, .nr_spare = 0}
+
+struct prbtree_iter {
+    struct prb_node *stack[PRBTREE_MAX_DEPTH];
+    unsigned int depth;
+};
+
+extern int prbtree_insert(struct prbtree *tree, uint64_t key, void *val);
+extern int prbtree_remove(struct prbtree *tree, uint64_t key, void **val);
+extern void prbtree_snapshot(struct prbtree *snap, const struct prbtree *tree);
+extern void prbtree_destroy(struct prbtree *tree);
+
+static inline void prbtree_init(struct prbtree *tree) {
+    tree->root = NULL;
+    tree->nr = 0;
+    tree->spare = NULL;
+    tree->nr_spare = 0;
+}
+
+/**
+ * prbtree_count - number of keys in this version
+ * @tree: version to check
+ */
+static inline unsigned long prbtree_count(const struct prbtree *tree) {
+    return tree->nr;
+}
+
+/**
+ * prbtree_find - look up @key
+ * @tree: version to search
+ * @key: key to look for
+ *
+ * Returns the value stored with @key, or NULL.
+ */
+static inline void *prbtree_find(const struct prbtree *tree, uint64_t key) {
+    const struct prb_node *node = tree->root;
+
+    while (node) {
+        if (key < node->key)
+            node = node->left;
+        else if (key > node->key)
+            node = node->right;
+        else
+            return node->val;
+    }
+    return NULL;
+}
+
+/**
+ * prbtree_iter_valid - check whether @iter points at a key
+ * @iter: iterator to check
+ */
+static inline bool prbtree_iter_valid(const struct prbtree_iter *iter) {
+    return iter->depth != 0;
+}
+
+static inline uint64_t prbtree_iter_key(const struct prbtree_iter *iter) {
+    return iter->stack[iter->depth - 1]->key;
+}
+
+static inline void *prbtree_iter_val(const struct prbtree_iter *iter) {
+    return iter->stack[iter->depth - 1]->val;
+}
+
+/**
+ * prbtree_iter_seek - point @iter at the first key not below @key
+ * @iter: iterator to position
+ * @tree: version to iterate
+ * @key: lower bound
+ *
+ * The nodes have no parent pointers, so @iter keeps the path to its current
+ * node.  Returns whether there is such a key.
+ */
+static inline bool prbtree_iter_seek(
+    struct prbtree_iter *iter,
+    const struct prbtree *tree,
+    uint64_t key
+) {
+    struct prb_node *node = tree->root;
+    unsigned int depth = 0, last = 0;
+
+    while (node) {
+        iter->stack[depth++] = node;
+        if (key <= node->key) {
+            last = depth;
+            node = node->left;
+        } else {
+            node = node->right;
+        }
+    }
+    /* the path to the last node we went left from */
+    iter->depth = last;
+    return prbtree_iter_valid(iter);
+}
+
+/**
+ * prbtree_iter_next - advance @iter to the next key
+ * @iter: valid iterator
+ *
+ * Returns whether there is a next key.
+ */
+static inline bool prbtree_iter_next(struct prbtree_iter *iter) {
+    struct prb_node *node = iter->stack[iter->depth - 1], *child;
+
+    if (node->right) {
+        node = node->right;
+        do {
+            iter->stack[iter->depth++] = node;
+        } while ((node = node->left));
+        return true;
+    }
+
+    /* climb until we come up from a left child */
+    do {
+        child = iter->stack[--iter->depth];
+    } while (iter->depth && iter->stack[iter->depth - 1]->right == child);
+    return prbtree_iter_valid(iter);
+}
+
+/**
+ * prbtree_for_each - iterate over all keys of a version in ascending order
+ * @iter: &struct prbtree_iter to use as a loop cursor
+ * @tree: version to iterate
+ *
+ * The version must not be modified while iterating, but other versions may.
+ */
+#define prbtree_for_each(iter, tree)                                     \
+    for (prbtree_iter_seek((iter), (tree), 0); prbtree_iter_valid(iter); \
+         prbtree_iter_next(iter))
+
+#endif /* _LIBCOVE_RBTREE_PERSISTENT_H */
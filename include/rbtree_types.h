@@ -30,6 +30,16 @@ struct rb_root_cached {
     struct rb_node *rb_leftmost;
 };
 
+/*
+ * Rightmost-cached rbtrees, for trees that mostly grow at the end, such as
+ * ones keyed by timestamps or sequence numbers: rb_add_rcached() appends in
+ * O(1) amortized instead of descending from the root.
+ */
+struct rb_root_rcached {
+    struct rb_root rb_root;
+    struct rb_node *rb_rightmost;
+};
+
 #define RB_ROOT        \
     (struct rb_root) { \
         NULL,          \
@@ -41,5 +51,12 @@ struct rb_root_cached {
         },                    \
             NULL              \
     }
+#define RB_ROOT_RCACHED        \
+    (struct rb_root_rcached) { \
+        {                      \
+            NULL,              \
+        },                     \
+            NULL               \
+    }
 
 #endif
@@ -1,10 +1,13 @@
 #ifndef LIBCOVE_RC_H
 #define LIBCOVE_RC_H
 
+#include <pthread.h>
 #include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "compiler.h"
+
 struct rc {
     uint32_t ref;
 };
@@ -13,18 +16,150 @@ struct arc {
     atomic_uint ref;
 };
 
+/*
+ * Overflow and underflow saturate instead of aborting: once the count has
+ * left the valid range it is pinned to REFCOUNT_SATURATED, which no number
+ * of further increments or decrements can bring back to zero.  The object
+ * is leaked rather than freed while still in use.  Any count with the top
+ * bit set is considered saturated.
+ */
+#define REFCOUNT_SATURATED (UINT32_C(3) << 30)
+
+static __always_inline bool __refcount_saturated(uint32_t val) {
+    return val & (UINT32_C(1) << 31);
+}
+
 // ref count for single thread
-void rc_init(struct rc *refcount);
-void rc_inc(struct rc *refcount);
-bool rc_dec(struct rc *refcount);
-bool rc_cmp(const struct rc *refcount, const uint32_t val);
+static inline void rc_init(struct rc *refcount) {
+    if (!refcount)
+        return;
+    refcount->ref = 0;
+}
+
+static inline void rc_inc(struct rc *refcount) {
+    if (!refcount)
+        return;
+    if (unlikely(__refcount_saturated(++refcount->ref)))
+        refcount->ref = REFCOUNT_SATURATED;
+}
+
+// return whether rc reach 0, i.e., no ref to specific object
+static inline bool rc_dec(struct rc *refcount) {
+    if (!refcount)
+        return false;
+    __auto_type old_val = refcount->ref;
+    if (unlikely(!old_val || __refcount_saturated(old_val))) {
+        refcount->ref = REFCOUNT_SATURATED;
+        return false;
+    }
+    refcount->ref = old_val - 1;
+    return old_val == 1;
+}
+
+static inline bool rc_cmp(const struct rc *refcount, const uint32_t val) {
+    if (!refcount)
+        return false;
+    return refcount->ref == val;
+}
 
 // atomic ref count for multi-thread
-void arc_init(struct arc *refcount);
-void arc_inc(struct arc *refcount);
-bool arc_dec(struct arc *refcount);
-bool arc_cmp(const struct arc *refcount, const uint32_t val);
 
-#endif  // LIBCOVE_RC_H
+// init operation is multi-entry
+static inline void arc_init(struct arc *refcount) {
+    if (!refcount)
+        return;
+    atomic_store_explicit(&refcount->ref, 0, memory_order_relaxed);
+}
 
+/*
+ * Taking a reference needs no ordering: the caller already holds one (or
+ * the lock protecting the lookup), which keeps the object alive.
+ */
+static inline void arc_inc(struct arc *refcount) {
+    if (!refcount)
+        return;
+    const __auto_type old_val =
+        atomic_fetch_add_explicit(&refcount->ref, 1, memory_order_relaxed);
+    if (unlikely(__refcount_saturated(old_val + 1)))
+        atomic_store_explicit(
+            &refcount->ref,
+            REFCOUNT_SATURATED,
+            memory_order_relaxed
+        );
+}
 
+// take a reference unless the count already dropped to 0
+static inline bool arc_inc_not_zero(struct arc *refcount) {
+    if (!refcount)
+        return false;
+    __auto_type old_val =
+        atomic_load_explicit(&refcount->ref, memory_order_relaxed);
+    do {
+        if (!old_val)
+            return false;
+        if (unlikely(__refcount_saturated(old_val)))
+            return true;
+    } while (!atomic_compare_exchange_weak_explicit(
+        &refcount->ref,
+        &old_val,
+        old_val + 1,
+        memory_order_relaxed,
+        memory_order_relaxed
+    ));
+    return true;
+}
+
+/*
+ * Dropping a reference must publish the caller's accesses to the object
+ * (release), and whoever drops the last one must see everybody else's
+ * before tearing it down (acquire, paid only on the final drop).
+ */
+static inline bool arc_dec(struct arc *refcount) {
+    if (!refcount)
+        return false;
+    const __auto_type old_val =
+        atomic_fetch_sub_explicit(&refcount->ref, 1, memory_order_release);
+    if (old_val == 1) {
+        atomic_thread_fence(memory_order_acquire);
+        return true;
+    }
+    if (unlikely(!old_val || __refcount_saturated(old_val)))
+        atomic_store_explicit(
+            &refcount->ref,
+            REFCOUNT_SATURATED,
+            memory_order_relaxed
+        );
+    return false;
+}
+
+// drop a reference unless it is the last one; return whether it was dropped
+static inline bool arc_dec_not_one(struct arc *refcount) {
+    if (!refcount)
+        return false;
+    __auto_type old_val =
+        atomic_load_explicit(&refcount->ref, memory_order_relaxed);
+    do {
+        if (unlikely(!old_val || __refcount_saturated(old_val)))
+            return true;
+        if (old_val == 1)
+            return false;
+    } while (!atomic_compare_exchange_weak_explicit(
+        &refcount->ref,
+        &old_val,
+        old_val - 1,
+        memory_order_release,
+        memory_order_relaxed
+    ));
+    return true;
+}
+
+// drop a reference; if it was the last one return true with @lock held
+extern bool arc_dec_and_lock(struct arc *refcount, pthread_mutex_t *lock);
+
+static inline bool arc_cmp(const struct arc *refcount, const uint32_t val) {
+    if (!refcount)
+        return false;
+    return atomic_load_explicit(&refcount->ref, memory_order_acquire) == val;
+}
+
+#endif  // LIBCOVE_RC_H
@@ -0,0 +1,181 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Resizable, Scalable, Concurrent Hash Table
+ *
+ * Lookups are lock-free and run under rcu_read_lock().  Inserts and removals
+ * serialize on a per-bucket lock, and the table resizes itself when it
+ * grows above 75% or shrinks below 30% load.
+ *
+ * A resize allocates a new bucket table, links it from the old one as
+ * future_tbl and then moves the entries bucket by bucket.  One triggered by
+ * the load factor is carried out RHT_RESIZE_BATCH buckets at a time by the
+ * inserts and removals that follow, first initializing the new buckets and
+ * then moving the old ones, so that no single update pays for the whole
+ * table.  rhashtable_resize() does it all at once instead.  Readers keep
+ * walking whichever table they started on: every chain is terminated by a
+ * "nulls" marker identifying its bucket, so a reader that got carried onto
+ * another chain by a concurrent move notices and restarts, and a reader
+ * that does not find a key in the old table retries in future_tbl.  The old
+ * table is freed after a grace period.
+ *
+ * All callers must be registered with RCU (rcu_register_thread()).
+ *
+ * Based on the Linux kernel's lib/rhashtable.c by Thomas Graf.
+ */
+
+#ifndef _LINUX_RHASHTABLE_H
+#define _LINUX_RHASHTABLE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "compiler.h"
+#include "hash.h"
+#include "urcu.h"
+
+#define RHT_MIN_BITS 2
+#define RHT_MAX_BITS 30
+/* Upper bound on the number of bucket locks per table */
+#define RHT_LOCKS_MAX 1024
+/* Buckets initialized or moved by each update helping a resize along */
+#define RHT_RESIZE_BATCH 64
+
+struct rhash_head {
+    struct rhash_head *next;
+    uint64_t key;
+};
+
+struct bucket_table {
+    unsigned int size;
+    unsigned int bits;
+    unsigned int locks_mask;
+    pthread_spinlock_t *locks;
+    struct bucket_table *future_tbl;
+    struct rcu_head rcu;
+    struct rhash_head *buckets[];
+};
+
+struct rhashtable {
+    struct bucket_table *tbl;
+    atomic_ulong nelems;
+    unsigned int min_bits;
+    pthread_mutex_t mutex;
+
+    /*
+     * Resize in progress, under @mutex: the table being filled, not yet
+     * tbl->future_tbl while its buckets are initialized, and the next bucket
+     * to initialize or to move.  @resizing tells updates, without the mutex,
+     * to help.
+     */
+    struct bucket_table *new_tbl;
+    unsigned int rehash;
+    atomic_bool resizing;
+};
+
+/*
+ * The end of every chain points to a marker derived from the address of its
+ * bucket, with the lowest bit set to tell it apart from a real entry.
+ */
+#define RHT_NULLS_MARKER(ptr) \
+    ((struct rhash_head *) (1UL | (unsigned long) (ptr)))
+
+static inline bool rht_is_a_nulls(const struct rhash_head *ptr) {
+    return ((unsigned long) ptr & 1);
+}
+
+static inline unsigned int rht_bucket_index(
+    const struct bucket_table *tbl,
+    uint64_t key
+) {
+    return hash_64(key, tbl->bits);
+}
+
+extern int rhashtable_init(struct rhashtable *ht, unsigned int bits);
+extern void rhashtable_destroy(struct rhashtable *ht);
+extern void rhashtable_free_and_destroy(
+    struct rhashtable *ht,
+    void (*free_fn)(struct rhash_head *obj, void *arg),
+    void *arg
+);
+extern int rhashtable_insert(
+    struct rhashtable *ht,
+    struct rhash_head *obj,
+    uint64_t key
+);
+extern int rhashtable_remove(struct rhashtable *ht, struct rhash_head *obj);
+extern int rhashtable_resize(struct rhashtable *ht, unsigned int bits);
+
+/**
+ * rhashtable_lookup - search hash table
+ * @ht: hash table
+ * @key: the key to search for
+ *
+ * Must be called under rcu_read_lock(); the returned object is only
+ * guaranteed to stay around until the matching rcu_read_unlock().
+ *
+ * Returns the first entry with @key, or NULL if none was found.
+ */
+static inline struct rhash_head *rhashtable_lookup(
+    struct rhashtable *ht,
+    uint64_t key
+) {
+    struct bucket_table *tbl = rcu_dereference(ht->tbl);
+    struct rhash_head *he;
+    unsigned int hash;
+
+restart:
+    hash = rht_bucket_index(tbl, key);
+    do {
+        for (he = rcu_dereference(tbl->buckets[hash]); !rht_is_a_nulls(he);
+             he = rcu_dereference(he->next)) {
+            if (he->key == key)
+                return he;
+        }
+        /*
+         * An object might have been moved to a different hash chain
+         * while we walked along it - better check and retry.
+         */
+    } while (he != RHT_NULLS_MARKER(&tbl->buckets[hash]));
+
+    /* Ensure we see any new tables. */
+    cmm_smp_rmb();
+
+    tbl = rcu_dereference(tbl->future_tbl);
+    if (unlikely(tbl))
+        goto restart;
+
+    return NULL;
+}
+
+/**
+ * rhashtable_lookup_fast - search hash table, without RCU read lock held
+ * @ht: hash table
+ * @key: the key to search for
+ *
+ * Only use this function when the caller guarantees the returned object
+ * cannot be freed, e.g. because it holds a reference to it.
+ */
+static inline struct rhash_head *rhashtable_lookup_fast(
+    struct rhashtable *ht,
+    uint64_t key
+) {
+    struct rhash_head *he;
+
+    rcu_read_lock();
+    he = rhashtable_lookup(ht, key);
+    rcu_read_unlock();
+
+    return he;
+}
+
+/**
+ * rhashtable_count - number of entries in the table
+ * @ht: hash table
+ */
+static inline unsigned long rhashtable_count(struct rhashtable *ht) {
+    return atomic_load_explicit(&ht->nelems, memory_order_relaxed);
+}
+
+#endif /* _LINUX_RHASHTABLE_H */
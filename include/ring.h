@@ -0,0 +1,412 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Bounded lock-free ring buffers of pointers
+ *
+ * Both rings hold a power-of-two number of void * slots in one array, so
+ * that queueing an object touches no per-object node and no lock.  Indices
+ * run freely and are masked on access; they never need resetting.
+ *
+ * struct spsc_ring is for exactly one producer and one consumer thread.
+ * Each side owns its index on a cache line of its own, next to a cached
+ * copy of the other side's index: the other line is only read when the
+ * cached copy says the ring looks full (or empty), so in steady state the
+ * two threads only share the slots themselves.
+ *
+ * struct mpmc_ring takes any number of producers and consumers.  Each slot
+ * carries a sequence number telling which lap of the ring it is ready for,
+ * and a thread claims slots with one cmpxchg on the shared index.  Slots
+ * are then filled or emptied without further atomics on shared data, but
+ * a thread preempted between the two steps holds up the other side at its
+ * slot: the ring is non-blocking for claiming, not for completion.
+ *
+ * Each side comes in three forms:
+ *
+ * - push/pop move one object and return whether they did;
+ * - _bulk moves all @n objects or none;
+ * - _burst moves as many as it can, up to @n.
+ *
+ * The bulk and burst forms pay for the shared index once per call rather
+ * than once per object, which is where the throughput comes from.
+ */
+
+#ifndef _LIBCOVE_RING_H
+#define _LIBCOVE_RING_H
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "cache.h"
+#include "compiler.h"
+
+struct spsc_ring {
+    void **slots;
+    unsigned int mask;
+
+    /* written by the producer only */
+    atomic_uint tail ____cacheline_aligned;
+    unsigned int head_cache;
+
+    /* written by the consumer only */
+    atomic_uint head ____cacheline_aligned;
+    unsigned int tail_cache;
+};
+
+struct mpmc_ring_slot {
+    /* index this slot is ready for: to fill if equal, to empty if one more */
+    atomic_ulong seq;
+    void *obj;
+};
+
+struct mpmc_ring {
+    struct mpmc_ring_slot *slots;
+    unsigned long mask;
+
+    atomic_ulong tail ____cacheline_aligned;
+    atomic_ulong head ____cacheline_aligned;
+};
+
+extern int spsc_ring_init(struct spsc_ring *ring, unsigned int size);
+extern void spsc_ring_destroy(struct spsc_ring *ring);
+extern int mpmc_ring_init(struct mpmc_ring *ring, unsigned long size);
+extern void mpmc_ring_destroy(struct mpmc_ring *ring);
+
+/**
+ * spsc_ring_count - number of objects in @ring
+ * @ring: ring to look at
+ *
+ * Exact when called by the producer or consumer with the other side idle,
+ * a snapshot otherwise.
+ */
+static inline unsigned int spsc_ring_count(const struct spsc_ring *ring) {
+    unsigned int head;
+
+    /* head first: the tail read after it can only be further along */
+    head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    return atomic_load_explicit(&ring->tail, memory_order_acquire) - head;
+}
+
+static inline unsigned int spsc_ring_size(const struct spsc_ring *ring) {
+    return ring->mask + 1;
+}
+
+static __always_inline unsigned int __spsc_ring_enqueue(
+    struct spsc_ring *ring,
+    void *const *objs,
+    unsigned int n,
+    bool bulk
+) {
+    unsigned int tail, room, i;
+
+    tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    room = ring->mask + 1 - (tail - ring->head_cache);
+    if (room < n) {
+        /* acquire: the consumer is done reading the slots it freed */
+        ring->head_cache =
+            atomic_load_explicit(&ring->head, memory_order_acquire);
+        room = ring->mask + 1 - (tail - ring->head_cache);
+        if (room < n) {
+            if (bulk)
+                return 0;
+            n = room;
+        }
+    }
+    for (i = 0; i < n; i++)
+        ring->slots[(tail + i) & ring->mask] = objs[i];
+    atomic_store_explicit(&ring->tail, tail + n, memory_order_release);
+    return n;
+}
+
+static __always_inline unsigned int __spsc_ring_dequeue(
+    struct spsc_ring *ring,
+    void **objs,
+    unsigned int n,
+    bool bulk
+) {
+    unsigned int head, avail, i;
+
+    head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    avail = ring->tail_cache - head;
+    if (avail < n) {
+        /* acquire: the producer is done writing the slots it filled */
+        ring->tail_cache =
+            atomic_load_explicit(&ring->tail, memory_order_acquire);
+        avail = ring->tail_cache - head;
+        if (avail < n) {
+            if (bulk)
+                return 0;
+            n = avail;
+        }
+    }
+    for (i = 0; i < n; i++)
+        objs[i] = ring->slots[(head + i) & ring->mask];
+    atomic_store_explicit(&ring->head, head + n, memory_order_release);
+    return n;
+}
+
+/**
+ * spsc_ring_enqueue_bulk - queue all of @objs or none of them
+ * @ring: ring to queue into
+ * @objs: objects to queue, in order
+ * @n: number of objects
+ *
+ * Returns @n, or 0 if there was no room for all of them.
+ */
+static __always_inline unsigned int spsc_ring_enqueue_bulk(
+    struct spsc_ring *ring,
+    void *const *objs,
+    unsigned int n
+) {
+    return __spsc_ring_enqueue(ring, objs, n, true);
+}
+
+/**
+ * spsc_ring_enqueue_burst - queue as many of @objs as there is room for
+ * @ring: ring to queue into
+ * @objs: objects to queue, in order
+ * @n: maximum number of objects
+ *
+ * Returns the number of objects queued, from the start of @objs.
+ */
+static __always_inline unsigned int spsc_ring_enqueue_burst(
+    struct spsc_ring *ring,
+    void *const *objs,
+    unsigned int n
+) {
+    return __spsc_ring_enqueue(ring, objs, n, false);
+}
+
+/**
+ * spsc_ring_dequeue_bulk - take exactly @n objects or none
+ * @ring: ring to take from
+ * @objs: array to store them into, oldest first
+ * @n: number of objects
+ *
+ * Returns @n, or 0 if fewer were queued.
+ */
+static __always_inline unsigned int spsc_ring_dequeue_bulk(
+    struct spsc_ring *ring,
+    void **objs,
+    unsigned int n
+) {
+    return __spsc_ring_dequeue(ring, objs, n, true);
+}
+
+/**
+ * spsc_ring_dequeue_burst - take up to @n objects
+ * @ring: ring to take from
+ * @objs: array to store them into, oldest first
+ * @n: maximum number of objects
+ *
+ * Returns the number of objects taken.
+ */
+static __always_inline unsigned int spsc_ring_dequeue_burst(
+    struct spsc_ring *ring,
+    void **objs,
+    unsigned int n
+) {
+    return __spsc_ring_dequeue(ring, objs, n, false);
+}
+
+static __always_inline bool spsc_ring_push(struct spsc_ring *ring, void *obj) {
+    return __spsc_ring_enqueue(ring, &obj, 1, true);
+}
+
+static __always_inline bool spsc_ring_pop(struct spsc_ring *ring, void **obj) {
+    return __spsc_ring_dequeue(ring, obj, 1, true);
+}
+
+/**
+ * mpmc_ring_count - number of objects in @ring, a snapshot
+ * @ring: ring to look at
+ *
+ * Counts the slots claimed by producers but not yet by consumers, which
+ * includes those still being filled or emptied.
+ */
+static inline unsigned long mpmc_ring_count(const struct mpmc_ring *ring) {
+    unsigned long head, tail;
+
+    head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    return (long) (tail - head) > 0 ? tail - head : 0;
+}
+
+static inline unsigned long mpmc_ring_size(const struct mpmc_ring *ring) {
+    return ring->mask + 1;
+}
+
+/*
+ * Claim up to @n consecutive slots at @index, each of which must hold
+ * sequence number @index + i + @ready.  Returns how many were claimed, with
+ * the first one in *@first; 0 if the ring was full (enqueue) or empty
+ * (dequeue), or if @bulk and fewer than @n were there.
+ *
+ * The slots are checked before the cmpxchg on @index: only a thread that
+ * moves @index past a slot can change its sequence number, so they stay
+ * valid as long as the cmpxchg succeeds.
+ */
+static __always_inline unsigned int __mpmc_ring_claim(
+    struct mpmc_ring *ring,
+    atomic_ulong *index,
+    unsigned long ready,
+    unsigned int n,
+    bool bulk,
+    unsigned long *first
+) {
+    unsigned long pos, seq;
+    unsigned int i;
+    long diff;
+
+    if (unlikely(!n))
+        return 0;
+    pos = atomic_load_explicit(index, memory_order_relaxed);
+    for (;;) {
+        diff = 0;
+        for (i = 0; i < n; i++) {
+            /* acquire: the other side is done with the slot */
+            seq = atomic_load_explicit(
+                &ring->slots[(pos + i) & ring->mask].seq,
+                memory_order_acquire
+            );
+            diff = (long) (seq - (pos + i + ready));
+            if (diff)
+                break;
+        }
+        /* a slot one lap behind: the ring is full, or empty */
+        if (diff < 0 && (!i || bulk))
+            return 0;
+        if (i && (i == n || !bulk) &&
+            atomic_compare_exchange_weak_explicit(
+                index,
+                &pos,
+                pos + i,
+                memory_order_relaxed,
+                memory_order_relaxed
+            ))
+            break;
+        /* another thread claimed the slots first */
+        if (diff > 0)
+            pos = atomic_load_explicit(index, memory_order_relaxed);
+    }
+    *first = pos;
+    return i;
+}
+
+static __always_inline unsigned int __mpmc_ring_enqueue(
+    struct mpmc_ring *ring,
+    void *const *objs,
+    unsigned int n,
+    bool bulk
+) {
+    struct mpmc_ring_slot *slot;
+    unsigned long pos;
+    unsigned int i;
+
+    n = __mpmc_ring_claim(ring, &ring->tail, 0, n, bulk, &pos);
+    for (i = 0; i < n; i++) {
+        slot = &ring->slots[(pos + i) & ring->mask];
+        slot->obj = objs[i];
+        atomic_store_explicit(&slot->seq, pos + i + 1, memory_order_release);
+    }
+    return n;
+}
+
+static __always_inline unsigned int __mpmc_ring_dequeue(
+    struct mpmc_ring *ring,
+    void **objs,
+    unsigned int n,
+    bool bulk
+) {
+    struct mpmc_ring_slot *slot;
+    unsigned long pos;
+    unsigned int i;
+
+    n = __mpmc_ring_claim(ring, &ring->head, 1, n, bulk, &pos);
+    for (i = 0; i < n; i++) {
+        slot = &ring->slots[(pos + i) & ring->mask];
+        objs[i] = slot->obj;
+        /* ready for the producer of the next lap */
+        atomic_store_explicit(
+            &slot->seq,
+            pos + i + ring->mask + 1,
+            memory_order_release
+        );
+    }
+    return n;
+}
+
+/**
+ * mpmc_ring_enqueue_bulk - queue all of @objs or none of them
+ * @ring: ring to queue into
+ * @objs: objects to queue, in order
+ * @n: number of objects
+ *
+ * Returns @n, or 0 if there was no room for all of them.  The objects take
+ * consecutive slots, so no other producer's objects come between them.
+ */
+static __always_inline unsigned int mpmc_ring_enqueue_bulk(
+    struct mpmc_ring *ring,
+    void *const *objs,
+    unsigned int n
+) {
+    return __mpmc_ring_enqueue(ring, objs, n, true);
+}
+
+/**
+ * mpmc_ring_enqueue_burst - queue as many of @objs as there is room for
+ * @ring: ring to queue into
+ * @objs: objects to queue, in order
+ * @n: maximum number of objects
+ *
+ * Returns the number of objects queued, from the start of @objs.
+ */
+static __always_inline unsigned int mpmc_ring_enqueue_burst(
+    struct mpmc_ring *ring,
+    void *const *objs,
+    unsigned int n
+) {
+    return __mpmc_ring_enqueue(ring, objs, n, false);
+}
+
+/**
+ * mpmc_ring_dequeue_bulk - take exactly @n objects or none
+ * @ring: ring to take from
+ * @objs: array to store them into, oldest first
+ * @n: number of objects
+ *
+ * Returns @n, or 0 if fewer were ready.
+ */
+static __always_inline unsigned int mpmc_ring_dequeue_bulk(
+    struct mpmc_ring *ring,
+    void **objs,
+    unsigned int n
+) {
+    return __mpmc_ring_dequeue(ring, objs, n, true);
+}
+
+/**
+ * mpmc_ring_dequeue_burst - take up to @n objects
+ * @ring: ring to take from
+ * @objs: array to store them into, oldest first
+ * @n: maximum number of objects
+ *
+ * Returns the number of objects taken.
+ */
+static __always_inline unsigned int mpmc_ring_dequeue_burst(
+    struct mpmc_ring *ring,
+    void **objs,
+    unsigned int n
+) {
+    return __mpmc_ring_dequeue(ring, objs, n, false);
+}
+
+static __always_inline bool mpmc_ring_push(struct mpmc_ring *ring, void *obj) {
+    return __mpmc_ring_enqueue(ring, &obj, 1, true);
+}
+
+static __always_inline bool mpmc_ring_pop(struct mpmc_ring *ring, void **obj) {
+    return __mpmc_ring_dequeue(ring, obj, 1, true);
+}
+
+#endif /* _LIBCOVE_RING_H */
@@ -0,0 +1,73 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef __LINUX_SEQLOCK_H
+#define __LINUX_SEQLOCK_H
+
+/*
+ * seqcount_latch_t - sequence counter for multiversion concurrency control
+ *
+ * The latch technique lets readers make progress while a writer modifies
+ * the data, by keeping two copies of it.  The writer bumps the counter
+ * before updating each copy, so an odd sequence steers readers to copy 1
+ * while copy 0 is modified and an even one steers them back to copy 0.
+ * A reader picks its copy from the sequence it read first and retries if
+ * the sequence moved on while it was looking.
+ *
+ * Writers must be serialized externally.  See rbtree_latch.h for a user.
+ *
+ * Based on the Linux kernel's include/linux/seqlock.h.
+ */
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+typedef struct {
+    atomic_uint sequence;
+} seqcount_latch_t;
+
+#define SEQCNT_LATCH_ZERO { .sequence = 0 }
+
+static inline void seqcount_latch_init(seqcount_latch_t *s) {
+    atomic_init(&s->sequence, 0);
+}
+
+/**
+ * raw_read_seqcount_latch() - pick even/odd latch data copy
+ * @s: Pointer to seqcount_latch_t
+ *
+ * Returns the sequence number to pass to read_seqcount_latch_retry(); its
+ * lowest bit selects the data copy to read.
+ */
+static inline unsigned int raw_read_seqcount_latch(const seqcount_latch_t *s) {
+    return atomic_load_explicit(&s->sequence, memory_order_acquire);
+}
+
+/**
+ * read_seqcount_latch_retry() - end a seqcount_latch_t read section
+ * @s: Pointer to seqcount_latch_t
+ * @start: count, from raw_read_seqcount_latch()
+ *
+ * Returns true if a read section retry is required, else false.
+ */
+static inline bool read_seqcount_latch_retry(
+    const seqcount_latch_t *s,
+    unsigned int start
+) {
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&s->sequence, memory_order_relaxed) != start;
+}
+
+/**
+ * raw_write_seqcount_latch() - redirect latch readers to even/odd copy
+ * @s: Pointer to seqcount_latch_t
+ *
+ * Called before modifying each of the two copies: all stores to the other
+ * copy are ordered before the switch, and the switch before any store to
+ * the copy about to be modified.
+ */
+static inline void raw_write_seqcount_latch(seqcount_latch_t *s) {
+    atomic_thread_fence(memory_order_release);
+    atomic_fetch_add_explicit(&s->sequence, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+}
+
+#endif /* __LINUX_SEQLOCK_H */
@@ -0,0 +1,111 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Fork-join thread pools
+ *
+ * A pool runs one fork-join computation at a time.  Inside it, a task
+ * forks subtasks with tp_fork(), which pushes them on the calling worker's
+ * work-stealing deque, and waits for them with tp_join(), which runs other
+ * tasks in the meantime: its own if nobody stole them, stolen ones if they
+ * are still running elsewhere.  Idle workers steal from random victims.
+ *
+ *	struct sum_task {
+ *		struct tp_task task;
+ *		const long *v;
+ *		size_t n;
+ *		long sum;
+ *	};
+ *
+ *	static void sum_fn(struct tp_task *task)
+ *	{
+ *		struct sum_task *t = container_of(task, struct sum_task, task);
+ *		struct sum_task left = {.v = t->v, .n = t->n / 2};
+ *		struct sum_task right = {.v = t->v + left.n, .n = t->n - left.n};
+ *
+ *		if (t->n < 4096) {
+ *			t->sum = serial_sum(t->v, t->n);
+ *			return;
+ *		}
+ *		tp_task_init(&left.task, sum_fn);
+ *		tp_task_init(&right.task, sum_fn);
+ *		tp_fork(&left.task);
+ *		sum_fn(&right.task);
+ *		tp_join(&left.task);
+ *		t->sum = left.sum + right.sum;
+ *	}
+ *
+ * Every forked task must be joined before the task that forked it returns,
+ * which is what lets tasks live on the stack.  Workers spin, yielding, while
+ * a computation runs and sleep between computations: a pool is meant for
+ * bulk jobs, not as a long-lived executor of independent work.
+ *
+ * Everything degrades to running inline: thread_pool_run() with a NULL pool
+ * and tp_fork() outside any pool run the task right away, so the parallel
+ * helpers built on top take a NULL pool for their serial version.
+ */
+
+#ifndef _LIBCOVE_THREAD_POOL_H
+#define _LIBCOVE_THREAD_POOL_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "compiler.h"
+#include "container_of.h"
+
+struct tp_task {
+    void (*func)(struct tp_task *task);
+    atomic_bool done;
+};
+
+struct tp_worker;
+
+struct thread_pool {
+    struct tp_worker *workers;
+    /* including the slot of the thread calling thread_pool_run() */
+    unsigned int nr_workers;
+
+    /* serializes thread_pool_run() callers */
+    pthread_mutex_t run_lock;
+
+    /* workers sleep on @wake while no computation is running */
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    atomic_bool active;
+    bool stopping;
+};
+
+extern int thread_pool_init(struct thread_pool *pool, unsigned int nr_threads);
+extern void thread_pool_destroy(struct thread_pool *pool);
+extern void thread_pool_run(struct thread_pool *pool, struct tp_task *task);
+extern void tp_fork(struct tp_task *task);
+extern void tp_join(struct tp_task *task);
+extern void thread_pool_for(
+    struct thread_pool *pool,
+    size_t begin,
+    size_t end,
+    size_t grain,
+    void (*fn)(size_t begin, size_t end, void *arg),
+    void *arg
+);
+
+static inline void tp_task_init(
+    struct tp_task *task,
+    void (*func)(struct tp_task *task)
+) {
+    task->func = func;
+    atomic_init(&task->done, false);
+}
+
+/**
+ * thread_pool_size - number of threads running a computation of @pool
+ * @pool: pool to look at, or NULL
+ *
+ * Counts the thread calling thread_pool_run(); 1 for a NULL pool.
+ */
+static inline unsigned int thread_pool_size(const struct thread_pool *pool) {
+    return pool ? pool->nr_workers : 1;
+}
+
+#endif /* _LIBCOVE_THREAD_POOL_H */
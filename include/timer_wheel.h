@@ -0,0 +1,154 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Hierarchical timer wheels
+ *
+ * Keeping timers in a struct rb_root_cached and popping rb_first_cached()
+ * costs O(log n) plus rebalancing for every arm and every cancel, which
+ * dominates when most timers are cancelled long before they expire, as
+ * connection timeouts are.  A timer wheel hashes each timer into a bucket
+ * by its expiry instead:
+ *
+ * Level l has TIMER_WHEEL_SIZE struct hlist_head slots, each spanning
+ * TIMER_WHEEL_SIZE^l ticks, and holds the timers that expire between
+ * TIMER_WHEEL_SIZE^l and TIMER_WHEEL_SIZE^(l + 1) ticks from now.  Arming,
+ * cancelling and re-arming a timer is an hlist operation plus a bit in a
+ * per-level bitmap of non-empty slots.  As time advances, whole level 0
+ * slots expire at once, and each time a level wraps, the next slot of the
+ * level above is cascaded down, so a timer is moved at most
+ * TIMER_WHEEL_LEVELS - 1 times before it fires, and not at all if it is
+ * cancelled first.
+ *
+ * Timers beyond the range of the wheel, TIMER_WHEEL_SIZE^TIMER_WHEEL_LEVELS
+ * ticks, are kept in an overflow struct rb_root_cached ordered by expiry
+ * and move into the wheel when the top level wraps.  Only far-future timers
+ * pay for the tree.
+ *
+ * Time is counted in ticks of the caller's choosing.  There is no internal
+ * locking; all operations on a wheel must be serialized by the caller.
+ */
+
+#ifndef _LIBCOVE_TIMER_WHEEL_H
+#define _LIBCOVE_TIMER_WHEEL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "compiler.h"
+#include "list.h"
+#include "rbtree_types.h"
+
+/* 64 slots, so that the non-empty slots of a level fit one word */
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SIZE (1U << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SIZE - 1)
+
+/*
+ * Number of levels.  The default of 4 covers 2^24 ticks, about 4.6 hours
+ * at 1ms per tick, in 2KB of slots.
+ */
+#ifndef TIMER_WHEEL_LEVELS
+    #define TIMER_WHEEL_LEVELS 4
+#endif
+
+#define TIMER_WHEEL_RANGE \
+    (UINT64_C(1) << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))
+#define TIMER_WHEEL_SLOTS (TIMER_WHEEL_LEVELS * TIMER_WHEEL_SIZE)
+
+/* Values of tw_timer->slot other than a slot index */
+#define TIMER_WHEEL_IDLE UINT32_MAX
+#define TIMER_WHEEL_OVERFLOW (UINT32_MAX - 1)
+
+struct tw_timer {
+    union {
+        /* in slot @slot of the wheel */
+        struct hlist_node entry;
+        /* in the overflow tree */
+        struct rb_node rb;
+    };
+    uint64_t expires;
+    uint32_t slot;
+};
+
+struct timer_wheel {
+    /* next tick to expire; every timer before it has fired */
+    uint64_t now;
+    /* nothing expires or cascades before this tick */
+    uint64_t next;
+    unsigned long nr;
+    uint64_t pending[TIMER_WHEEL_LEVELS];
+    struct hlist_head slots[TIMER_WHEEL_SLOTS];
+    struct rb_root_cached overflow;
+};
+
+typedef void (*tw_fn_t)(struct tw_timer *timer, void *priv);
+
+extern void timer_wheel_init(struct timer_wheel *wheel, uint64_t now);
+extern void timer_wheel_add(
+    struct timer_wheel *wheel,
+    struct tw_timer *timer,
+    uint64_t expires
+);
+extern bool timer_wheel_del(struct timer_wheel *wheel, struct tw_timer *timer);
+extern bool timer_wheel_mod(
+    struct timer_wheel *wheel,
+    struct tw_timer *timer,
+    uint64_t expires
+);
+extern unsigned long __timer_wheel_advance(
+    struct timer_wheel *wheel,
+    uint64_t now,
+    tw_fn_t fn,
+    void *priv
+);
+
+static inline void tw_timer_init(struct tw_timer *timer) {
+    timer->slot = TIMER_WHEEL_IDLE;
+}
+
+/**
+ * tw_timer_pending - check whether @timer is armed
+ * @timer: timer to check
+ */
+static inline bool tw_timer_pending(const struct tw_timer *timer) {
+    return timer->slot != TIMER_WHEEL_IDLE;
+}
+
+/**
+ * timer_wheel_count - number of armed timers
+ * @wheel: wheel to check
+ */
+static inline unsigned long timer_wheel_count(const struct timer_wheel *wheel) {
+    return wheel->nr;
+}
+
+/**
+ * timer_wheel_advance - fire every timer up to a tick
+ * @wheel: wheel to advance
+ * @now: current tick, at least the previous one
+ * @fn: called for each expired timer, which is no longer pending
+ * @priv: passed to @fn
+ *
+ * Timers fire in order of their expiry tick.  @fn may add, re-arm or cancel
+ * any timer; one added for @now or earlier still fires in this call, so a
+ * timer that keeps re-arming itself for @now never lets it return.  Ticks
+ * at which nothing expires or cascades are skipped, so calling this every
+ * tick is cheap.
+ *
+ * Returns the number of timers fired.
+ */
+static inline unsigned long timer_wheel_advance(
+    struct timer_wheel *wheel,
+    uint64_t now,
+    tw_fn_t fn,
+    void *priv
+) {
+    if (likely(wheel->next > now)) {
+        if (wheel->now <= now)
+            wheel->now = now + 1;
+        return 0;
+    }
+    return __timer_wheel_advance(wheel, now, fn, priv);
+}
+
+#endif /* _LIBCOVE_TIMER_WHEEL_H */
@@ -0,0 +1,172 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Chase-Lev work-stealing deques
+ *
+ * A deque of non-NULL pointers with one owner thread, which pushes and pops
+ * at the bottom, and any number of thieves, which steal from the top.  The
+ * owner works LIFO on its own items, which keeps them cache-hot, while
+ * thieves take the oldest ones, which in fork-join code are the biggest
+ * pieces of work.  Only the owner's pop of the last item and steals race,
+ * and they settle it with a cmpxchg on the top index.
+ *
+ * The memory orderings are those of Lê, Pop, Cohen and Zappa Nardelli,
+ * "Correct and Efficient Work-Stealing for Weak Memory Models" (PPoPP'13).
+ *
+ * The slot array grows when the owner finds it full.  Thieves may still be
+ * reading the old array, so it is kept until ws_deque_destroy() rather than
+ * freed: the arrays of a deque add up to less than twice its largest one.
+ */
+
+#ifndef _LIBCOVE_WS_DEQUE_H
+#define _LIBCOVE_WS_DEQUE_H
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "cache.h"
+#include "compiler.h"
+
+struct ws_deque_array {
+    struct ws_deque_array *retired;
+    long mask;
+    _Atomic(void *) slots[];
+};
+
+struct ws_deque {
+    /* stolen from, by anyone */
+    atomic_long top ____cacheline_aligned;
+
+    /* pushed to and popped from, by the owner only */
+    atomic_long bottom ____cacheline_aligned;
+    _Atomic(struct ws_deque_array *) array;
+};
+
+extern int ws_deque_init(struct ws_deque *deque, unsigned int size);
+extern void ws_deque_destroy(struct ws_deque *deque);
+extern int __ws_deque_grow(struct ws_deque *deque, long top, long bottom);
+
+/**
+ * ws_deque_push - add @item at the bottom of @deque
+ * @deque: deque owned by the calling thread
+ * @item: item to add, not NULL
+ *
+ * Returns 0, or -ENOMEM if the deque was full and could not grow.
+ */
+static inline int ws_deque_push(struct ws_deque *deque, void *item) {
+    struct ws_deque_array *array;
+    long bottom, top;
+
+    bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+    if (unlikely(bottom - top > array->mask)) {
+        if (__ws_deque_grow(deque, top, bottom))
+            return -ENOMEM;
+        array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+    }
+    atomic_store_explicit(
+        &array->slots[bottom & array->mask],
+        item,
+        memory_order_relaxed
+    );
+    /*
+     * release: a thief that sees the new bottom sees the item, and what it
+     * points to.  The paper's release fence before a relaxed store orders no
+     * more than this, which thread sanitizers can follow.
+     */
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_release);
+    return 0;
+}
+
+/**
+ * ws_deque_pop - take the item at the bottom of @deque
+ * @deque: deque owned by the calling thread
+ *
+ * Returns the item pushed last, or NULL if @deque is empty.
+ */
+static inline void *ws_deque_pop(struct ws_deque *deque) {
+    struct ws_deque_array *array;
+    long bottom, top;
+    void *item;
+
+    bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+    atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+    /* order the bottom store before the top load, against steals */
+    atomic_thread_fence(memory_order_seq_cst);
+    top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+    if (top > bottom) {
+        /* empty */
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+        return NULL;
+    }
+    item = atomic_load_explicit(
+        &array->slots[bottom & array->mask],
+        memory_order_relaxed
+    );
+    if (top == bottom) {
+        /* the last item: race the thieves for it */
+        if (!atomic_compare_exchange_strong_explicit(
+                &deque->top,
+                &top,
+                top + 1,
+                memory_order_seq_cst,
+                memory_order_relaxed
+            ))
+            item = NULL;
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    }
+    return item;
+}
+
+/**
+ * ws_deque_steal - take the item at the top of @deque
+ * @deque: deque owned by another thread
+ *
+ * Returns the oldest item, or NULL if @deque looked empty or another thread
+ * took that item first.  Either way the caller should look elsewhere.
+ */
+static inline void *ws_deque_steal(struct ws_deque *deque) {
+    struct ws_deque_array *array;
+    long bottom, top;
+    void *item;
+
+    top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+    if (top >= bottom)
+        return NULL;
+
+    /* acquire rather than consume, which compilers promote anyway */
+    array = atomic_load_explicit(&deque->array, memory_order_acquire);
+    item = atomic_load_explicit(
+        &array->slots[top & array->mask],
+        memory_order_relaxed
+    );
+    if (!atomic_compare_exchange_strong_explicit(
+            &deque->top,
+            &top,
+            top + 1,
+            memory_order_seq_cst,
+            memory_order_relaxed
+        ))
+        return NULL;
+    return item;
+}
+
+/**
+ * ws_deque_count - number of items in @deque, a snapshot
+ * @deque: deque to look at
+ */
+static inline long ws_deque_count(const struct ws_deque *deque) {
+    long top, bottom;
+
+    top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+    return bottom > top ? bottom - top : 0;
+}
+
+#endif /* _LIBCOVE_WS_DEQUE_H */
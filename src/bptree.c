@@ -0,0 +1,322 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Cache-conscious B+trees with 64-bit keys
+ *
+ * Inner node key i is a lower bound for the keys below child i, and an
+ * exclusive upper bound for those below child i - 1.  The bounds are not
+ * required to be the actual minimum, so removing the smallest key of a
+ * subtree never has to update its ancestors.
+ */
+
+#include "bptree.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "build_bug.h"
+
+static_assert(
+    BPTREE_SLOTS % 4 == 0 && BPTREE_SLOTS >= 4 && BPTREE_SLOTS <= 64,
+    "BPTREE_SLOTS must be a multiple of 4 between 4 and 64"
+);
+
+/* Nodes are at least half full, so a tree cannot get any taller */
+#define BPTREE_MAX_HEIGHT (sizeof(unsigned long) * CHAR_BIT)
+
+static struct bptree_node *bptree_alloc_node(void) {
+    struct bptree_node *node = aligned_alloc(SMP_CACHE_BYTES, sizeof(*node));
+
+    if (node)
+        memset(node, 0, sizeof(*node));
+    return node;
+}
+
+static void bptree_insert_slot(
+    struct bptree_node *node,
+    unsigned int pos,
+    uint64_t key,
+    void *slot
+) {
+    unsigned int nr = node->nr - pos;
+
+    memmove(&node->keys[pos + 1], &node->keys[pos], nr * sizeof(*node->keys));
+    memmove(
+        &node->slots[pos + 1],
+        &node->slots[pos],
+        nr * sizeof(*node->slots)
+    );
+    node->keys[pos] = key;
+    node->slots[pos] = slot;
+    node->nr++;
+}
+
+static void bptree_remove_slot(struct bptree_node *node, unsigned int pos) {
+    unsigned int nr = node->nr - pos - 1;
+
+    memmove(&node->keys[pos], &node->keys[pos + 1], nr * sizeof(*node->keys));
+    memmove(
+        &node->slots[pos],
+        &node->slots[pos + 1],
+        nr * sizeof(*node->slots)
+    );
+    node->nr--;
+}
+
+/* Move the upper half of full @node into the empty @right */
+static void bptree_split(struct bptree_node *node, struct bptree_node *right) {
+    unsigned int nr = BPTREE_SLOTS - BPTREE_MIN_SLOTS;
+
+    memcpy(
+        right->keys,
+        &node->keys[BPTREE_MIN_SLOTS],
+        nr * sizeof(*node->keys)
+    );
+    memcpy(
+        right->slots,
+        &node->slots[BPTREE_MIN_SLOTS],
+        nr * sizeof(*node->slots)
+    );
+    right->nr = nr;
+    right->level = node->level;
+    node->nr = BPTREE_MIN_SLOTS;
+
+    if (!node->level) {
+        right->next = node->next;
+        node->next = right;
+    }
+}
+
+/**
+ * bptree_insert - add a key to the tree
+ * @tree: tree to add to
+ * @key: key to add
+ * @val: value to store with @key, must not be NULL
+ *
+ * The nodes needed to split a full path are allocated up front, so a
+ * failed insertion leaves @tree untouched.
+ *
+ * Returns 0 on success, -EEXIST if @key is already present, -ENOMEM if a
+ * node could not be allocated, or -EINVAL if @val is NULL.
+ */
+int bptree_insert(struct bptree *tree, uint64_t key, void *val) {
+    struct bptree_node *path[BPTREE_MAX_HEIGHT];
+    struct bptree_node *spare[BPTREE_MAX_HEIGHT + 1];
+    unsigned int idx[BPTREE_MAX_HEIGHT];
+    struct bptree_node *node, *right;
+    unsigned int depth = 0, need = 0, pos, d, i;
+    void *slot = val;
+
+    if (!val)
+        return -EINVAL;
+
+    if (!tree->root) {
+        node = bptree_alloc_node();
+        if (!node)
+            return -ENOMEM;
+        bptree_insert_slot(node, 0, key, val);
+        tree->root = node;
+        tree->nr = 1;
+        return 0;
+    }
+
+    for (node = tree->root; node->level; node = node->slots[idx[depth++]]) {
+        path[depth] = node;
+        idx[depth] = __bptree_child(node, key);
+    }
+
+    pos = __bptree_rank(node, key);
+    if (pos < node->nr && node->keys[pos] == key)
+        return -EEXIST;
+
+    /* every full node from the leaf up splits, and a full root grows */
+    if (node->nr == BPTREE_SLOTS) {
+        need = 1;
+        for (d = depth; d && path[d - 1]->nr == BPTREE_SLOTS; d--)
+            need++;
+        if (!d)
+            need++;
+    }
+    for (i = 0; i < need; i++) {
+        spare[i] = bptree_alloc_node();
+        if (!spare[i]) {
+            while (i--)
+                free(spare[i]);
+            return -ENOMEM;
+        }
+    }
+
+    /* keys below every bound go into the first child, lower its bound */
+    for (d = 0; d < depth; d++)
+        if (key < path[d]->keys[0])
+            path[d]->keys[0] = key;
+
+    for (d = depth;; d--) {
+        if (node->nr < BPTREE_SLOTS) {
+            bptree_insert_slot(node, pos, key, slot);
+            break;
+        }
+
+        right = spare[--need];
+        bptree_split(node, right);
+        if (pos >= BPTREE_MIN_SLOTS)
+            bptree_insert_slot(right, pos - BPTREE_MIN_SLOTS, key, slot);
+        else
+            bptree_insert_slot(node, pos, key, slot);
+
+        key = right->keys[0];
+        slot = right;
+        if (!d) {
+            struct bptree_node *root = spare[--need];
+
+            root->level = node->level + 1;
+            bptree_insert_slot(root, 0, node->keys[0], node);
+            bptree_insert_slot(root, 1, key, slot);
+            tree->root = root;
+            break;
+        }
+
+        node = path[d - 1];
+        pos = idx[d - 1] + 1;
+    }
+
+    tree->nr++;
+    return 0;
+}
+
+/* Move the last entry of child @i - 1 of @parent to the front of child @i */
+static void bptree_borrow_left(struct bptree_node *parent, unsigned int i) {
+    struct bptree_node *left = parent->slots[i - 1];
+    struct bptree_node *node = parent->slots[i];
+    unsigned int last = left->nr - 1;
+
+    /* the old first child is now bounded by the separator */
+    if (node->level)
+        node->keys[0] = parent->keys[i];
+    bptree_insert_slot(node, 0, left->keys[last], left->slots[last]);
+    left->nr--;
+    parent->keys[i] = node->keys[0];
+}
+
+/* Move the first entry of child @i + 1 of @parent to the end of child @i */
+static void bptree_borrow_right(struct bptree_node *parent, unsigned int i) {
+    struct bptree_node *node = parent->slots[i];
+    struct bptree_node *right = parent->slots[i + 1];
+    uint64_t key = node->level ? parent->keys[i + 1] : right->keys[0];
+
+    bptree_insert_slot(node, node->nr, key, right->slots[0]);
+    bptree_remove_slot(right, 0);
+    parent->keys[i + 1] = right->keys[0];
+}
+
+/* Append child @i + 1 of @parent to child @i and free it */
+static void bptree_merge(struct bptree_node *parent, unsigned int i) {
+    struct bptree_node *node = parent->slots[i];
+    struct bptree_node *right = parent->slots[i + 1];
+
+    if (right->level)
+        right->keys[0] = parent->keys[i + 1];
+    memcpy(
+        &node->keys[node->nr],
+        right->keys,
+        right->nr * sizeof(*right->keys)
+    );
+    memcpy(
+        &node->slots[node->nr],
+        right->slots,
+        right->nr * sizeof(*right->slots)
+    );
+    node->nr += right->nr;
+    node->next = right->next;
+
+    bptree_remove_slot(parent, i + 1);
+    free(right);
+}
+
+/* Refill child @i of @parent, which dropped below BPTREE_MIN_SLOTS */
+static void bptree_rebalance(struct bptree_node *parent, unsigned int i) {
+    struct bptree_node *left = i ? parent->slots[i - 1] : NULL;
+    struct bptree_node *right =
+        i + 1 < parent->nr ? parent->slots[i + 1] : NULL;
+
+    if (left && left->nr > BPTREE_MIN_SLOTS)
+        bptree_borrow_left(parent, i);
+    else if (right && right->nr > BPTREE_MIN_SLOTS)
+        bptree_borrow_right(parent, i);
+    else if (left)
+        bptree_merge(parent, i - 1);
+    else
+        bptree_merge(parent, i);
+}
+
+/**
+ * bptree_remove - remove a key from the tree
+ * @tree: tree to remove from
+ * @key: key to remove
+ *
+ * Returns the value that was stored with @key, or NULL if @key was not
+ * present.
+ */
+void *bptree_remove(struct bptree *tree, uint64_t key) {
+    struct bptree_node *path[BPTREE_MAX_HEIGHT];
+    unsigned int idx[BPTREE_MAX_HEIGHT];
+    struct bptree_node *node, *root;
+    unsigned int depth = 0, pos;
+    void *val;
+
+    if (!tree->root)
+        return NULL;
+
+    for (node = tree->root; node->level; node = node->slots[idx[depth++]]) {
+        path[depth] = node;
+        idx[depth] = __bptree_child(node, key);
+    }
+
+    pos = __bptree_rank(node, key);
+    if (pos >= node->nr || node->keys[pos] != key)
+        return NULL;
+
+    val = node->slots[pos];
+    bptree_remove_slot(node, pos);
+    tree->nr--;
+
+    while (depth && node->nr < BPTREE_MIN_SLOTS) {
+        depth--;
+        bptree_rebalance(path[depth], idx[depth]);
+        node = path[depth];
+    }
+
+    root = tree->root;
+    if (root->level && root->nr == 1) {
+        tree->root = root->slots[0];
+        free(root);
+    } else if (!root->nr) {
+        tree->root = NULL;
+        free(root);
+    }
+
+    return val;
+}
+
+static void bptree_free_node(struct bptree_node *node) {
+    unsigned int i;
+
+    if (node->level)
+        for (i = 0; i < node->nr; i++)
+            bptree_free_node(node->slots[i]);
+    free(node);
+}
+
+/**
+ * bptree_destroy - free all nodes of the tree
+ * @tree: tree to destroy
+ *
+ * The values are not touched; free them beforehand if needed, e.g. with
+ * bptree_for_each().  @tree is empty afterwards.
+ */
+void bptree_destroy(struct bptree *tree) {
+    if (tree->root)
+        bptree_free_node(tree->root);
+    bptree_init(tree);
+}
@@ -0,0 +1,251 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Dynamically sized hash table with incremental rehashing
+ */
+
+#include "dhashtable.h"
+#include "prefetch.h"
+
+#include <errno.h>
+#include <stdlib.h>
+
+static struct hlist_head *dhash_alloc_buckets(unsigned int bits) {
+    struct hlist_head *buckets = malloc(sizeof(*buckets) << bits);
+
+    if (buckets)
+        __hash_init(buckets, 1U << bits);
+    return buckets;
+}
+
+static unsigned int dhash_clamp_bits(unsigned int bits) {
+    if (bits < DHASH_MIN_BITS)
+        return DHASH_MIN_BITS;
+    if (bits > DHASH_MAX_BITS)
+        return DHASH_MAX_BITS;
+    return bits;
+}
+
+/**
+ * dhash_init - initialize a dhashtable
+ * @ht: table to initialize
+ * @bits: log2 of the initial bucket count, the table never shrinks below it
+ *
+ * Returns 0 on success or -ENOMEM.
+ */
+int dhash_init(struct dhashtable *ht, unsigned int bits) {
+    bits = dhash_clamp_bits(bits);
+
+    ht->tbl[0].buckets = dhash_alloc_buckets(bits);
+    if (!ht->tbl[0].buckets)
+        return -ENOMEM;
+    ht->tbl[0].bits = bits;
+    ht->tbl[1].buckets = NULL;
+    ht->tbl[1].bits = 0;
+    ht->rehash_idx = 0;
+    ht->nelems = 0;
+    ht->min_bits = bits;
+    return 0;
+}
+
+/**
+ * dhash_destroy - release the bucket arrays of a dhashtable
+ * @ht: table to destroy
+ *
+ * The objects still linked into @ht are not touched.
+ */
+void dhash_destroy(struct dhashtable *ht) {
+    free(ht->tbl[0].buckets);
+    free(ht->tbl[1].buckets);
+    ht->tbl[0].buckets = ht->tbl[1].buckets = NULL;
+    ht->nelems = 0;
+}
+
+static void dhash_rehash_bucket(
+    struct dhashtable *ht,
+    struct hlist_head *head
+) {
+    struct dhash_table *new = &ht->tbl[1];
+    struct hlist_node *pos, *tmp;
+
+    hlist_for_each_safe(pos, tmp, head) {
+        struct dhash_node *node = hlist_entry(pos, struct dhash_node, node);
+
+        __hlist_del(pos);
+        hlist_add_head(pos, &new->buckets[hash_min(node->key, new->bits)]);
+    }
+}
+
+static void dhash_rehash_done(struct dhashtable *ht) {
+    free(ht->tbl[0].buckets);
+    ht->tbl[0] = ht->tbl[1];
+    ht->tbl[1].buckets = NULL;
+    ht->tbl[1].bits = 0;
+    ht->rehash_idx = 0;
+}
+
+/**
+ * dhash_rehash_step - migrate part of a running resize
+ * @ht: table to work on
+ * @n: maximum number of non-empty buckets to migrate
+ *
+ * At most 10 * @n empty buckets are skipped, which bounds the work done
+ * even on a sparse table.  This lets callers move resize work out of the
+ * update path, e.g. into idle time.
+ *
+ * Returns true while the resize is still in progress.
+ */
+bool dhash_rehash_step(struct dhashtable *ht, unsigned int n) {
+    unsigned long size = 1UL << ht->tbl[0].bits;
+    unsigned long empty_visits = n * 10UL;
+
+    if (!dhash_rehashing(ht))
+        return false;
+
+    while (n && ht->rehash_idx < size) {
+        struct hlist_head *head = &ht->tbl[0].buckets[ht->rehash_idx];
+
+        if (hlist_empty(head)) {
+            ht->rehash_idx++;
+            if (!--empty_visits)
+                break;
+            continue;
+        }
+
+        dhash_rehash_bucket(ht, head);
+        ht->rehash_idx++;
+        n--;
+    }
+
+    if (ht->rehash_idx < size)
+        return true;
+
+    dhash_rehash_done(ht);
+    return false;
+}
+
+/**
+ * dhash_rehash_finish - complete a running resize in one go
+ * @ht: table to work on
+ */
+void dhash_rehash_finish(struct dhashtable *ht) {
+    while (dhash_rehash_step(ht, ~0U))
+        ;
+}
+
+/*
+ * Pick the size to resize to: double on growth, and on shrink go straight
+ * to the smallest table that keeps the load factor at or below 1/2, so an
+ * idle table gives its memory back with a single resize.
+ */
+static unsigned int dhash_target_bits(const struct dhashtable *ht) {
+    unsigned int bits = ht->tbl[0].bits;
+
+    if (ht->nelems > (1UL << bits) * DHASH_GROW_LOAD)
+        return bits + 1;
+
+    bits = ht->min_bits;
+    while (bits < DHASH_MAX_BITS && (1UL << bits) < ht->nelems * 2)
+        bits++;
+    return bits;
+}
+
+void __dhash_maintain(struct dhashtable *ht) {
+    unsigned int bits;
+
+    if (dhash_rehashing(ht)) {
+        dhash_rehash_step(ht, DHASH_REHASH_STEP);
+        return;
+    }
+
+    if (!dhash_needs_resize(ht))
+        return;
+
+    bits = dhash_target_bits(ht);
+    if (bits == ht->tbl[0].bits)
+        return;
+
+    /* On allocation failure just keep running at the current size */
+    ht->tbl[1].buckets = dhash_alloc_buckets(bits);
+    if (!ht->tbl[1].buckets)
+        return;
+    ht->tbl[1].bits = bits;
+    ht->rehash_idx = 0;
+
+    dhash_rehash_step(ht, DHASH_REHASH_STEP);
+}
+
+/* A lookup of dhash_find_batch() in flight */
+struct dhash_probe {
+    struct hlist_head *head; /* bucket not read yet, or NULL */
+    struct hlist_node *pos;  /* chain entry to compare next */
+    size_t idx;              /* index in @keys, or SIZE_MAX once idle */
+};
+
+static inline void dhash_probe_start(
+    const struct dhashtable *ht,
+    struct dhash_probe *probe,
+    const uint64_t *keys,
+    size_t idx,
+    struct dhash_node **out
+) {
+    probe->head = dhash_bucket(ht, keys[idx]);
+    probe->idx = idx;
+    prefetch(probe->head);
+    out[idx] = NULL;
+}
+
+/**
+ * dhash_find_batch - find the first object of many keys at once
+ * @ht: table to search
+ * @keys: the keys to look for
+ * @nr: number of entries in @keys
+ * @out: receives the matching &struct dhash_node of each key, or NULL
+ *
+ * Same as calling dhash_find() for every key, but DHASH_FIND_BATCH lookups
+ * are kept in flight, each advanced by one step per round: read the bucket
+ * or compare one chain entry, then prefetch what it needs next.  A lookup
+ * that ends hands its slot to the next key right away, so the cache misses
+ * of independent lookups overlap instead of being paid one after the other.
+ */
+void dhash_find_batch(
+    const struct dhashtable *ht,
+    const uint64_t *keys,
+    size_t nr,
+    struct dhash_node **out
+) {
+    struct dhash_probe probes[DHASH_FIND_BATCH], *p;
+    struct dhash_node *node;
+    size_t slots, next, live, i;
+
+    slots = nr < DHASH_FIND_BATCH ? nr : DHASH_FIND_BATCH;
+    for (next = 0; next < slots; next++)
+        dhash_probe_start(ht, &probes[next], keys, next, out);
+
+    for (i = 0, live = slots; live; i = i + 1 < slots ? i + 1 : 0) {
+        p = &probes[i];
+        if (p->idx == SIZE_MAX)
+            continue;
+
+        if (p->head) {
+            p->pos = p->head->first;
+            p->head = NULL;
+        } else {
+            node = hlist_entry(p->pos, struct dhash_node, node);
+            if (node->key == keys[p->idx]) {
+                out[p->idx] = node;
+                p->pos = NULL;
+            } else {
+                p->pos = p->pos->next;
+            }
+        }
+
+        if (p->pos) {
+            prefetch(p->pos);
+        } else if (next < nr) {
+            dhash_probe_start(ht, p, keys, next++, out);
+        } else {
+            p->idx = SIZE_MAX;
+            live--;
+        }
+    }
+}
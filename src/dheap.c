@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Array-backed d-ary min-heaps
+ */
+
+#include "dheap.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cache.h"
+
+/*
+ * The array starts DHEAP_PAD slots into a cache-aligned block, so that the
+ * children of every node, from DHEAP_ARITY * idx + 1 on, start at a multiple
+ * of DHEAP_ARITY slots.  When that many pointers divide a cache line, as four
+ * 8-byte ones do, the children of a node never straddle two lines.
+ */
+#define DHEAP_PAD (DHEAP_ARITY - 1)
+
+static struct dheap_node **dheap_alloc(unsigned int size) {
+    size_t bytes = sizeof(struct dheap_node *) * ((size_t) size + DHEAP_PAD);
+    struct dheap_node **base;
+
+    bytes = (bytes + SMP_CACHE_BYTES - 1) & ~(size_t) (SMP_CACHE_BYTES - 1);
+    base = aligned_alloc(SMP_CACHE_BYTES, bytes);
+    return base ? base + DHEAP_PAD : NULL;
+}
+
+static void dheap_free(struct dheap_node **nodes) {
+    if (nodes)
+        free(nodes - DHEAP_PAD);
+}
+
+/**
+ * dheap_reserve - make room for @nr nodes
+ * @heap: heap to grow
+ * @nr: number of nodes @heap must be able to hold
+ *
+ * The array at least doubles when it grows, so that pushing n nodes one at
+ * a time reallocates O(log n) times.  Returns 0, or -ENOMEM with @heap
+ * unchanged.
+ */
+int dheap_reserve(struct dheap *heap, unsigned int nr) {
+    struct dheap_node **nodes;
+    unsigned int size;
+
+    if (nr <= heap->size)
+        return 0;
+    if (heap->size < 8)
+        size = 16;
+    else
+        size = heap->size > UINT_MAX / 2 ? UINT_MAX : heap->size * 2;
+    if (size < nr)
+        size = nr;
+
+    nodes = dheap_alloc(size);
+    if (!nodes)
+        return -ENOMEM;
+    /* all of it: dheap_heapify_list() fills slots past heap->nr first */
+    if (heap->size)
+        memcpy(nodes, heap->nodes, sizeof(*nodes) * heap->size);
+    dheap_free(heap->nodes);
+    heap->nodes = nodes;
+    heap->size = size;
+    return 0;
+}
+
+/**
+ * dheap_destroy - free the array of @heap
+ * @heap: heap to destroy
+ *
+ * The nodes are not touched.  @heap is empty afterwards.
+ */
+void dheap_destroy(struct dheap *heap) {
+    dheap_free(heap->nodes);
+    dheap_init(heap);
+}
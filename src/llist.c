@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Lock-less NULL terminated single linked list
+ *
+ * The basic atomic operation of this list is cmpxchg on a C11 atomic
+ * pointer.
+ *
+ * Based on the Linux kernel's lib/llist.c by Huang Ying.
+ */
+
+#include "llist.h"
+
+/**
+ * llist_del_first - delete the first entry of lock-less list
+ * @head:	the head for your lock-less list
+ *
+ * If list is empty, return NULL, otherwise, return the first entry
+ * deleted, this is the newest added one.
+ *
+ * Only one llist_del_first user can be used simultaneously with
+ * multiple llist_add users without lock.  Because otherwise
+ * llist_del_first, llist_add, llist_add (or llist_del_all, llist_add,
+ * llist_add) sequence in another user may change @head->first->next,
+ * but keep @head->first.  If multiple consumers are needed, please
+ * use llist_del_all or use lock between consumers.
+ */
+struct llist_node *llist_del_first(struct llist_head *head) {
+    struct llist_node *entry, *next;
+
+    /* acquire: pairs with the release in llist_add_batch() */
+    entry = atomic_load_explicit(&head->first, memory_order_acquire);
+    do {
+        if (entry == NULL)
+            return NULL;
+        next = READ_ONCE(entry->next);
+    } while (!atomic_compare_exchange_weak_explicit(
+        &head->first,
+        &entry,
+        next,
+        memory_order_acquire,
+        memory_order_acquire
+    ));
+
+    return entry;
+}
+
+/**
+ * llist_del_first_this - delete given entry of lock-less list if it is first
+ * @head:	the head for your lock-less list
+ * @this:	a list entry.
+ *
+ * If head of the list is given entry, delete and return %true else
+ * return %false.
+ *
+ * Multiple callers can safely call this concurrently with multiple
+ * llist_add() callers, providing all the callers offer a different @this.
+ */
+bool llist_del_first_this(struct llist_head *head, struct llist_node *this) {
+    struct llist_node *entry, *next;
+
+    /* acquire to ensure future accesses happen after reading this->next */
+    entry = atomic_load_explicit(&head->first, memory_order_acquire);
+    do {
+        if (entry != this)
+            return false;
+        next = READ_ONCE(entry->next);
+    } while (!atomic_compare_exchange_weak_explicit(
+        &head->first,
+        &entry,
+        next,
+        memory_order_acquire,
+        memory_order_acquire
+    ));
+
+    return true;
+}
+
+/**
+ * llist_reverse_order - reverse order of a llist chain
+ * @head:	first item of the list to be reversed
+ *
+ * Reverse the order of a chain of llist entries and return the
+ * new first entry.
+ */
+struct llist_node *llist_reverse_order(struct llist_node *head) {
+    struct llist_node *new_head = NULL;
+
+    while (head) {
+        struct llist_node *tmp = head;
+        head = head->next;
+        tmp->next = new_head;
+        new_head = tmp;
+    }
+
+    return new_head;
+}
@@ -0,0 +1,135 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Parallel traversals of the containers
+ */
+
+#include "parallel.h"
+
+struct hash_walk {
+    struct hlist_head *ht;
+    void (*fn)(struct hlist_node *node, void *arg);
+    void *arg;
+};
+
+static void hash_walk_buckets(size_t begin, size_t end, void *arg) {
+    struct hash_walk *walk = arg;
+    struct hlist_node *node, *tmp;
+    size_t bkt;
+
+    for (bkt = begin; bkt < end; bkt++)
+        hlist_for_each_safe(node, tmp, &walk->ht[bkt])
+            walk->fn(node, walk->arg);
+}
+
+/* Cheap as an empty bucket is, a piece should be worth stealing */
+#define HASH_PARALLEL_MIN_BUCKETS 64
+
+/**
+ * __hash_for_each_parallel - call @fn on every entry of a hashtable
+ * @pool: pool to run on, or NULL
+ * @ht: the buckets
+ * @sz: number of buckets
+ * @fn: called with each entry and @arg; may unhash or free it
+ * @arg: passed to @fn
+ */
+void __hash_for_each_parallel(
+    struct thread_pool *pool,
+    struct hlist_head *ht,
+    unsigned int sz,
+    void (*fn)(struct hlist_node *node, void *arg),
+    void *arg
+) {
+    struct hash_walk walk = { .ht = ht, .fn = fn, .arg = arg };
+    size_t grain = sz / (8 * thread_pool_size(pool));
+
+    if (grain < HASH_PARALLEL_MIN_BUCKETS)
+        grain = HASH_PARALLEL_MIN_BUCKETS;
+    thread_pool_for(pool, 0, sz, grain, hash_walk_buckets, &walk);
+}
+
+struct rb_postorder_task {
+    struct tp_task task;
+    struct rb_node *node;
+    unsigned int depth;
+    void (*fn)(struct rb_node *node, void *arg);
+    void *arg;
+};
+
+/* The postorder walk of the subtree under @top, ending with @top itself */
+static void rb_postorder_subtree(
+    struct rb_node *top,
+    void (*fn)(struct rb_node *node, void *arg),
+    void *arg
+) {
+    struct rb_root tmp = { top };
+    struct rb_node *node, *next;
+
+    for (node = rb_first_postorder(&tmp); node != top; node = next) {
+        next = rb_next_postorder(node);
+        fn(node, arg);
+    }
+    fn(top, arg);
+}
+
+/*
+ * Above ->depth levels from the bottom of the split, fork the left subtree
+ * and walk the right one; the node itself goes last, once both are done.
+ */
+static void rb_postorder_fn(struct tp_task *task) {
+    struct rb_postorder_task *t =
+        container_of(task, struct rb_postorder_task, task);
+    struct rb_postorder_task left = *t, right = *t;
+
+    if (!t->depth) {
+        rb_postorder_subtree(t->node, t->fn, t->arg);
+        return;
+    }
+    left.node = t->node->rb_left;
+    right.node = t->node->rb_right;
+    left.depth = right.depth = t->depth - 1;
+    tp_task_init(&left.task, rb_postorder_fn);
+    tp_task_init(&right.task, rb_postorder_fn);
+    if (left.node)
+        tp_fork(&left.task);
+    if (right.node)
+        rb_postorder_fn(&right.task);
+    if (left.node)
+        tp_join(&left.task);
+    t->fn(t->node, t->arg);
+}
+
+/**
+ * rb_postorder_parallel - call @fn on every node, children before parents
+ * @pool: pool to run on, or NULL
+ * @root: tree to walk
+ * @fn: called with each node and @arg; may free it
+ * @arg: passed to @fn
+ *
+ * As with rbtree_postorder_for_each_entry_safe(), @fn may free the node it
+ * is given, so that a tree is torn down with no rebalancing, but @root is
+ * left as it was: reinitialize it afterwards.  Subtrees are split off down
+ * to some 16 per worker, each walked serially.
+ */
+void rb_postorder_parallel(
+    struct thread_pool *pool,
+    struct rb_root *root,
+    void (*fn)(struct rb_node *node, void *arg),
+    void *arg
+) {
+    struct rb_postorder_task t = {
+        .node = root->rb_node,
+        .depth = 4,
+        .fn = fn,
+        .arg = arg,
+    };
+    unsigned int nr;
+
+    if (!t.node)
+        return;
+    for (nr = thread_pool_size(pool); nr > 1; nr >>= 1)
+        t.depth++;
+    if (!pool)
+        t.depth = 0;
+    tp_task_init(&t.task, rb_postorder_fn);
+    thread_pool_run(pool, &t.task);
+}
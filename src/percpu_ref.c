@@ -0,0 +1,209 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Sharded reference counts
+ *
+ * Based on the Linux kernel's lib/percpu-refcount.c by Kent Overstreet.
+ */
+
+#include "percpu_ref.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+_Thread_local unsigned int percpu_ref_shard_hint;
+
+static atomic_uint percpu_ref_next_hint;
+
+unsigned int __percpu_ref_assign_shard_hint(void) {
+    unsigned int hint;
+
+    /* skip 0, it marks a thread that has not been assigned a shard yet */
+    do {
+        hint = atomic_fetch_add_explicit(
+            &percpu_ref_next_hint,
+            1,
+            memory_order_relaxed
+        );
+    } while (!hint);
+
+    percpu_ref_shard_hint = hint;
+    return hint;
+}
+
+static unsigned int percpu_ref_nr_shards(void) {
+    long nr_cpus = sysconf(_SC_NPROCESSORS_CONF);
+    unsigned int nr = 1;
+
+    while (nr < nr_cpus && nr < PERCPU_REF_MAX_SHARDS)
+        nr <<= 1;
+    return nr;
+}
+
+/**
+ * percpu_ref_init - initialize a percpu refcount
+ * @ref: percpu_ref to initialize
+ * @release: function which will be called when refcount hits 0
+ * @flags: PERCPU_REF_INIT_* flags
+ *
+ * Initializes @ref.  @ref starts out in percpu mode with a refcount of 1
+ * unless @flags contains PERCPU_REF_INIT_ATOMIC.
+ *
+ * Note that @release must not sleep - it may potentially be called from any
+ * thread that drops the last reference.
+ *
+ * Return: 0 on success, -ENOMEM if the shards could not be allocated.
+ */
+int percpu_ref_init(
+    struct percpu_ref *ref,
+    percpu_ref_func_t *release,
+    unsigned int flags
+) {
+    unsigned int i, nr = percpu_ref_nr_shards();
+    bool atomic = flags & PERCPU_REF_INIT_ATOMIC;
+
+    ref->shards = aligned_alloc(SMP_CACHE_BYTES, sizeof(*ref->shards) * nr);
+    if (!ref->shards)
+        return -ENOMEM;
+
+    ref->shard_mask = nr - 1;
+    ref->release = release;
+    for (i = 0; i < nr; i++)
+        atomic_init(&ref->shards[i].count, atomic ? PERCPU_SHARD_DEAD : 0);
+    atomic_init(&ref->count, atomic ? 1 : 1 + PERCPU_COUNT_BIAS);
+    atomic_init(&ref->flags, atomic ? __PERCPU_REF_ATOMIC : 0);
+
+    return 0;
+}
+
+/**
+ * percpu_ref_exit - undo percpu_ref_init()
+ * @ref: percpu_ref to exit
+ *
+ * This function exits @ref.  The caller is responsible for ensuring that
+ * @ref is no longer in active use.  The usual places to invoke this
+ * function from are the @ref->release() callback or in init failure path
+ * where percpu_ref_init() succeeded but other parts of the initialization
+ * of the embedding object failed.
+ */
+void percpu_ref_exit(struct percpu_ref *ref) {
+    free(ref->shards);
+    ref->shards = NULL;
+}
+
+/*
+ * Retire every shard and move what it counted to the atomic counter, then
+ * drop the bias that kept the counter from reaching zero meanwhile.  The
+ * exchange orders the puts made on a shard before the final put of the
+ * release path.
+ */
+static void __percpu_ref_switch_to_atomic(struct percpu_ref *ref) {
+    long count = 0;
+    unsigned int i;
+
+    for (i = 0; i <= ref->shard_mask; i++)
+        count += atomic_exchange_explicit(
+            &ref->shards[i].count,
+            PERCPU_SHARD_DEAD,
+            memory_order_acq_rel
+        );
+
+    count -= PERCPU_COUNT_BIAS;
+    if (atomic_fetch_add_explicit(&ref->count, count, memory_order_acq_rel) ==
+        -count)
+        ref->release(ref);
+}
+
+/**
+ * percpu_ref_switch_to_atomic - switch a percpu_ref to atomic mode
+ * @ref: percpu_ref to switch to atomic mode
+ *
+ * Fold the shards of @ref into its atomic counter.  Afterwards gets and
+ * puts operate on the single counter, and percpu_ref_is_zero() is exact.
+ * This function is a no-op if @ref is already in atomic mode.
+ *
+ * Mode switches of the same @ref must be serialized by the caller; gets and
+ * puts may run concurrently.
+ */
+void percpu_ref_switch_to_atomic(struct percpu_ref *ref) {
+    unsigned int old = atomic_fetch_or_explicit(
+        &ref->flags,
+        __PERCPU_REF_ATOMIC,
+        memory_order_acq_rel
+    );
+
+    if (!(old & __PERCPU_REF_ATOMIC))
+        __percpu_ref_switch_to_atomic(ref);
+}
+
+/**
+ * percpu_ref_switch_to_percpu - switch a percpu_ref to percpu mode
+ * @ref: percpu_ref to switch to percpu mode
+ *
+ * Turn a ref initialized with PERCPU_REF_INIT_ATOMIC, or switched to atomic
+ * mode with percpu_ref_switch_to_atomic(), back to sharded counting.  This
+ * function is a no-op if @ref is already in percpu mode or has been killed.
+ *
+ * The count of @ref must be nonzero.  Mode switches of the same @ref must
+ * be serialized by the caller; gets and puts may run concurrently.
+ */
+void percpu_ref_switch_to_percpu(struct percpu_ref *ref) {
+    unsigned int i, flags;
+
+    flags = atomic_load_explicit(&ref->flags, memory_order_relaxed);
+    if (!(flags & __PERCPU_REF_ATOMIC) || (flags & __PERCPU_REF_DEAD))
+        return;
+
+    /* the bias must be in place before any shard can see a put */
+    atomic_fetch_add_explicit(
+        &ref->count,
+        PERCPU_COUNT_BIAS,
+        memory_order_relaxed
+    );
+    for (i = 0; i <= ref->shard_mask; i++)
+        atomic_store_explicit(&ref->shards[i].count, 0, memory_order_release);
+    atomic_fetch_and_explicit(
+        &ref->flags,
+        ~(unsigned int) __PERCPU_REF_ATOMIC,
+        memory_order_release
+    );
+}
+
+/**
+ * percpu_ref_kill - drop the initial ref
+ * @ref: percpu_ref to kill
+ *
+ * Must be used to drop the initial ref on a percpu refcount; must be called
+ * precisely once before shutdown.
+ *
+ * Switches @ref into atomic mode, marks it dead so that
+ * percpu_ref_tryget_live() fails from now on, and drops the initial
+ * reference.  @ref->release() is called once the remaining references are
+ * gone, possibly before this function returns.
+ */
+void percpu_ref_kill(struct percpu_ref *ref) {
+    unsigned int old = atomic_fetch_or_explicit(
+        &ref->flags,
+        __PERCPU_REF_ATOMIC | __PERCPU_REF_DEAD,
+        memory_order_acq_rel
+    );
+
+    if (!(old & __PERCPU_REF_ATOMIC))
+        __percpu_ref_switch_to_atomic(ref);
+    percpu_ref_put(ref);
+}
+
+/**
+ * percpu_ref_is_zero - test whether a percpu refcount reached zero
+ * @ref: percpu_ref to test
+ *
+ * Returns %true if @ref reached zero.  A ref in percpu mode always holds
+ * its initial reference, so this can only be true in atomic mode.
+ *
+ * This function is safe to call as long as @ref is between init and exit.
+ */
+bool percpu_ref_is_zero(struct percpu_ref *ref) {
+    if (__ref_is_percpu(ref))
+        return false;
+    return !atomic_load_explicit(&ref->count, memory_order_acquire);
+}
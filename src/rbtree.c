@@ -10,26 +10,7 @@
 */
 
 #include "rbtree_augmented.h"
-
-/*
- * red-black trees properties:  https://en.wikipedia.org/wiki/Rbtree
- *
- *  1) A node is either red or black
- *  2) The root is black
- *  3) All leaves (NULL) are black
- *  4) Both children of every red node are black
- *  5) Every simple path from root to leaves contains the same number
- *     of black nodes.
- *
- *  4 and 5 give the O(log n) guarantee, since 4 implies you cannot have two
- *  consecutive red nodes in a path and every red node is therefore followed by
- *  a black. So if B is the number of black nodes on every simple path (as per
- *  5), then the longest possible path due to 4 is 2B.
- *
- *  We shall indicate color with case, where black nodes are uppercase and red
- *  nodes will be lowercase. Unknown color nodes shall be drawn as red within
- *  parentheses and have some accompanying text comment.
- */
+#include "list.h"
 
 /*
  * Notes on lockless lookups:
@@ -55,348 +36,6 @@
  * pointers.
  */
 
-static inline void rb_set_black(struct rb_node *rb) {
-    rb->__rb_parent_color += RB_BLACK;
-}
-
-static inline struct rb_node *rb_red_parent(struct rb_node *red) {
-    return (struct rb_node *) red->__rb_parent_color;
-}
-
-/*
- * Helper function for rotations:
- * - old's parent and color get assigned to new
- * - old gets assigned new as a parent and 'color' as a color.
- */
-static inline void __rb_rotate_set_parents(
-    struct rb_node *old,
-    struct rb_node *new,
-    struct rb_root *root,
-    int color
-) {
-    struct rb_node *parent = rb_parent(old);
-    new->__rb_parent_color = old->__rb_parent_color;
-    rb_set_parent_color(old, new, color);
-    __rb_change_child(old, new, parent, root);
-}
-
-static __always_inline void __rb_insert(
-    struct rb_node *node,
-    struct rb_root *root,
-    void (*augment_rotate)(struct rb_node *old, struct rb_node *new)
-) {
-    struct rb_node *parent = rb_red_parent(node), *gparent, *tmp;
-
-    while (true) {
-        /*
-         * Loop invariant: node is red.
-         */
-        if (unlikely(!parent)) {
-            /*
-             * The inserted node is root. Either this is the
-             * first node, or we recursed at Case 1 below and
-             * are no longer violating 4).
-             */
-            rb_set_parent_color(node, NULL, RB_BLACK);
-            break;
-        }
-
-        /*
-         * If there is a black parent, we are done.
-         * Otherwise, take some corrective action as,
-         * per 4), we don't want a red root or two
-         * consecutive red nodes.
-         */
-        if (rb_is_black(parent))
-            break;
-
-        gparent = rb_red_parent(parent);
-
-        tmp = gparent->rb_right;
-        if (parent != tmp) { /* parent == gparent->rb_left */
-            if (tmp && rb_is_red(tmp)) {
-                /*
-                 * Case 1 - node's uncle is red (color flips).
-                 *
-                 *       G            g
-                 *      / \          / \
-                 *     p   u  -->   P   U
-                 *    /            /
-                 *   n            n
-                 *
-                 * However, since g's parent might be red, and
-                 * 4) does not allow this, we need to recurse
-                 * at g.
-                 */
-                rb_set_parent_color(tmp, gparent, RB_BLACK);
-                rb_set_parent_color(parent, gparent, RB_BLACK);
-                node = gparent;
-                parent = rb_parent(node);
-                rb_set_parent_color(node, parent, RB_RED);
-                continue;
-            }
-
-            tmp = parent->rb_right;
-            if (node == tmp) {
-                /*
-                 * Case 2 - node's uncle is black and node is
-                 * the parent's right child (left rotate at parent).
-                 *
-                 *      G             G
-                 *     / \           / \
-                 *    p   U  -->    n   U
-                 *     \           /
-                 *      n         p
-                 *
-                 * This still leaves us in violation of 4), the
-                 * continuation into Case 3 will fix that.
-                 */
-                tmp = node->rb_left;
-                WRITE_ONCE(parent->rb_right, tmp);
-                WRITE_ONCE(node->rb_left, parent);
-                if (tmp)
-                    rb_set_parent_color(tmp, parent, RB_BLACK);
-                rb_set_parent_color(parent, node, RB_RED);
-                augment_rotate(parent, node);
-                parent = node;
-                tmp = node->rb_right;
-            }
-
-            /*
-             * Case 3 - node's uncle is black and node is
-             * the parent's left child (right rotate at gparent).
-             *
-             *        G           P
-             *       / \         / \
-             *      p   U  -->  n   g
-             *     /                 \
-             *    n                   U
-             */
-            WRITE_ONCE(gparent->rb_left, tmp); /* == parent->rb_right */
-            WRITE_ONCE(parent->rb_right, gparent);
-            if (tmp)
-                rb_set_parent_color(tmp, gparent, RB_BLACK);
-            __rb_rotate_set_parents(gparent, parent, root, RB_RED);
-            augment_rotate(gparent, parent);
-            break;
-        } else {
-            tmp = gparent->rb_left;
-            if (tmp && rb_is_red(tmp)) {
-                /* Case 1 - color flips */
-                rb_set_parent_color(tmp, gparent, RB_BLACK);
-                rb_set_parent_color(parent, gparent, RB_BLACK);
-                node = gparent;
-                parent = rb_parent(node);
-                rb_set_parent_color(node, parent, RB_RED);
-                continue;
-            }
-
-            tmp = parent->rb_left;
-            if (node == tmp) {
-                /* Case 2 - right rotate at parent */
-                tmp = node->rb_right;
-                WRITE_ONCE(parent->rb_left, tmp);
-                WRITE_ONCE(node->rb_right, parent);
-                if (tmp)
-                    rb_set_parent_color(tmp, parent, RB_BLACK);
-                rb_set_parent_color(parent, node, RB_RED);
-                augment_rotate(parent, node);
-                parent = node;
-                tmp = node->rb_left;
-            }
-
-            /* Case 3 - left rotate at gparent */
-            WRITE_ONCE(gparent->rb_right, tmp); /* == parent->rb_left */
-            WRITE_ONCE(parent->rb_left, gparent);
-            if (tmp)
-                rb_set_parent_color(tmp, gparent, RB_BLACK);
-            __rb_rotate_set_parents(gparent, parent, root, RB_RED);
-            augment_rotate(gparent, parent);
-            break;
-        }
-    }
-}
-
-/*
- * Inline version for rb_erase() use - we want to be able to inline
- * and eliminate the dummy_rotate callback there
- */
-static __always_inline void ____rb_erase_color(
-    struct rb_node *parent,
-    struct rb_root *root,
-    void (*augment_rotate)(struct rb_node *old, struct rb_node *new)
-) {
-    struct rb_node *node = NULL, *sibling, *tmp1, *tmp2;
-
-    while (true) {
-        /*
-         * Loop invariants:
-         * - node is black (or NULL on first iteration)
-         * - node is not the root (parent is not NULL)
-         * - All leaf paths going through parent and node have a
-         *   black node count that is 1 lower than other leaf paths.
-         */
-        sibling = parent->rb_right;
-        if (node != sibling) { /* node == parent->rb_left */
-            if (rb_is_red(sibling)) {
-                /*
-                 * Case 1 - left rotate at parent
-                 *
-                 *     P               S
-                 *    / \             / \
-                 *   N   s    -->    p   Sr
-                 *      / \         / \
-                 *     Sl  Sr      N   Sl
-                 */
-                tmp1 = sibling->rb_left;
-                WRITE_ONCE(parent->rb_right, tmp1);
-                WRITE_ONCE(sibling->rb_left, parent);
-                rb_set_parent_color(tmp1, parent, RB_BLACK);
-                __rb_rotate_set_parents(parent, sibling, root, RB_RED);
-                augment_rotate(parent, sibling);
-                sibling = tmp1;
-            }
-            tmp1 = sibling->rb_right;
-            if (!tmp1 || rb_is_black(tmp1)) {
-                tmp2 = sibling->rb_left;
-                if (!tmp2 || rb_is_black(tmp2)) {
-                    /*
-                     * Case 2 - sibling color flip
-                     * (p could be either color here)
-                     *
-                     *    (p)           (p)
-                     *    / \           / \
-                     *   N   S    -->  N   s
-                     *      / \           / \
-                     *     Sl  Sr        Sl  Sr
-                     *
-                     * This leaves us violating 5) which
-                     * can be fixed by flipping p to black
-                     * if it was red, or by recursing at p.
-                     * p is red when coming from Case 1.
-                     */
-                    rb_set_parent_color(sibling, parent, RB_RED);
-                    if (rb_is_red(parent))
-                        rb_set_black(parent);
-                    else {
-                        node = parent;
-                        parent = rb_parent(node);
-                        if (parent)
-                            continue;
-                    }
-                    break;
-                }
-                /*
-                 * Case 3 - right rotate at sibling
-                 * (p could be either color here)
-                 *
-                 *   (p)           (p)
-                 *   / \           / \
-                 *  N   S    -->  N   sl
-                 *     / \             \
-                 *    sl  sr            S
-                 *                       \
-                 *                        sr
-                 *
-                 * Note: p might be red, and then both
-                 * p and sl are red after rotation(which
-                 * breaks property 4). This is fixed in
-                 * Case 4 (in __rb_rotate_set_parents()
-                 *         which set sl the color of p
-                 *         and set p RB_BLACK)
-                 *
-                 *   (p)            (sl)
-                 *   / \            /  \
-                 *  N   sl   -->   P    S
-                 *       \        /      \
-                 *        S      N        sr
-                 *         \
-                 *          sr
-                 */
-                tmp1 = tmp2->rb_right;
-                WRITE_ONCE(sibling->rb_left, tmp1);
-                WRITE_ONCE(tmp2->rb_right, sibling);
-                WRITE_ONCE(parent->rb_right, tmp2);
-                if (tmp1)
-                    rb_set_parent_color(tmp1, sibling, RB_BLACK);
-                augment_rotate(sibling, tmp2);
-                tmp1 = sibling;
-                sibling = tmp2;
-            }
-            /*
-             * Case 4 - left rotate at parent + color flips
-             * (p and sl could be either color here.
-             *  After rotation, p becomes black, s acquires
-             *  p's color, and sl keeps its color)
-             *
-             *      (p)             (s)
-             *      / \             / \
-             *     N   S     -->   P   Sr
-             *        / \         / \
-             *      (sl) sr      N  (sl)
-             */
-            tmp2 = sibling->rb_left;
-            WRITE_ONCE(parent->rb_right, tmp2);
-            WRITE_ONCE(sibling->rb_left, parent);
-            rb_set_parent_color(tmp1, sibling, RB_BLACK);
-            if (tmp2)
-                rb_set_parent(tmp2, parent);
-            __rb_rotate_set_parents(parent, sibling, root, RB_BLACK);
-            augment_rotate(parent, sibling);
-            break;
-        } else {
-            sibling = parent->rb_left;
-            if (rb_is_red(sibling)) {
-                /* Case 1 - right rotate at parent */
-                tmp1 = sibling->rb_right;
-                WRITE_ONCE(parent->rb_left, tmp1);
-                WRITE_ONCE(sibling->rb_right, parent);
-                rb_set_parent_color(tmp1, parent, RB_BLACK);
-                __rb_rotate_set_parents(parent, sibling, root, RB_RED);
-                augment_rotate(parent, sibling);
-                sibling = tmp1;
-            }
-            tmp1 = sibling->rb_left;
-            if (!tmp1 || rb_is_black(tmp1)) {
-                tmp2 = sibling->rb_right;
-                if (!tmp2 || rb_is_black(tmp2)) {
-                    /* Case 2 - sibling color flip */
-                    rb_set_parent_color(sibling, parent, RB_RED);
-                    if (rb_is_red(parent))
-                        rb_set_black(parent);
-                    else {
-                        node = parent;
-                        parent = rb_parent(node);
-                        if (parent)
-                            continue;
-                    }
-                    break;
-                }
-                /* Case 3 - left rotate at sibling */
-                tmp1 = tmp2->rb_left;
-                WRITE_ONCE(sibling->rb_right, tmp1);
-                WRITE_ONCE(tmp2->rb_left, sibling);
-                WRITE_ONCE(parent->rb_left, tmp2);
-                if (tmp1)
-                    rb_set_parent_color(tmp1, sibling, RB_BLACK);
-                augment_rotate(sibling, tmp2);
-                tmp1 = sibling;
-                sibling = tmp2;
-            }
-            /* Case 4 - right rotate at parent + color flips */
-            tmp2 = sibling->rb_right;
-            WRITE_ONCE(parent->rb_left, tmp2);
-            WRITE_ONCE(sibling->rb_right, parent);
-            rb_set_parent_color(tmp1, sibling, RB_BLACK);
-            if (tmp2)
-                rb_set_parent(tmp2, parent);
-            __rb_rotate_set_parents(parent, sibling, root, RB_BLACK);
-            augment_rotate(parent, sibling);
-            break;
-        }
-    }
-}
-
 /* Non-inline version for rb_erase_augmented() use */
 void __rb_erase_color(
     struct rb_node *parent,
@@ -615,3 +254,531 @@ struct rb_node *rb_first_postorder(const struct rb_root *root) {
 
     return rb_left_deepest_node(root->rb_node);
 }
+
+/*
+ * Bulk construction from sorted input.
+ *
+ * Splitting every range in the middle yields a tree in which the sizes of
+ * the two subtrees of any node differ by at most one, so all levels but the
+ * deepest are full.  Coloring the deepest level red (unless it is the root)
+ * and everything else black then satisfies all rbtree invariants, and each
+ * node is linked exactly once: O(n) instead of O(n log n) for n inserts.
+ *
+ * The nodes are consumed in order from either an array or a list_head.
+ */
+struct rb_build_cursor {
+    struct rb_node **nodes;
+    struct list_head *pos;
+    ptrdiff_t offset;
+    unsigned int red_depth;
+    const struct rb_augment_callbacks *augment;
+};
+
+static __always_inline struct rb_node *rb_build_next(struct rb_build_cursor *c
+) {
+    if (c->nodes)
+        return *c->nodes++;
+    c->pos = c->pos->next;
+    return (struct rb_node *) ((char *) c->pos + c->offset);
+}
+
+static struct rb_node *__rb_build(
+    struct rb_build_cursor *c,
+    size_t nr,
+    unsigned int depth
+) {
+    struct rb_node *node, *left, *right;
+    size_t nr_left = (nr - 1) / 2;
+
+    left = nr_left ? __rb_build(c, nr_left, depth + 1) : NULL;
+    node = rb_build_next(c);
+    right = nr - 1 - nr_left ? __rb_build(c, nr - 1 - nr_left, depth + 1)
+                             : NULL;
+
+    WRITE_ONCE(node->rb_left, left);
+    WRITE_ONCE(node->rb_right, right);
+    if (left)
+        rb_set_parent(left, node);
+    if (right)
+        rb_set_parent(right, node);
+    rb_set_parent_color(
+        node,
+        NULL,
+        depth && depth == c->red_depth ? RB_RED : RB_BLACK
+    );
+
+    /* the parent is set by the caller; propagate stops at the NULL one */
+    if (c->augment)
+        c->augment->propagate(node, NULL);
+    return node;
+}
+
+static void rb_build_cursor_run(
+    struct rb_build_cursor *c,
+    size_t nr,
+    struct rb_root *root
+) {
+    struct rb_node *node = NULL;
+
+    if (nr) {
+        /* depth of the deepest level: floor(log2(nr)) */
+        c->red_depth = 63 - __builtin_clzll(nr);
+        node = __rb_build(c, nr, 0);
+    }
+    WRITE_ONCE(root->rb_node, node);
+}
+
+/**
+ * rb_build - build a tree from sorted nodes in linear time
+ * @nodes: array of @nr nodes, in ascending order
+ * @nr: number of nodes
+ * @root: tree to build, its previous contents are discarded
+ */
+void rb_build(struct rb_node **nodes, size_t nr, struct rb_root *root) {
+    struct rb_build_cursor c = { .nodes = nodes };
+
+    rb_build_cursor_run(&c, nr, root);
+}
+
+void __rb_build_list(
+    struct list_head *head,
+    ptrdiff_t offset,
+    struct rb_root *root,
+    const struct rb_augment_callbacks *augment
+) {
+    struct rb_build_cursor c = {
+        .pos = head,
+        .offset = offset,
+        .augment = augment,
+    };
+    struct list_head *pos;
+    size_t nr = 0;
+
+    for (pos = head->next; pos != head; pos = pos->next)
+        nr++;
+    rb_build_cursor_run(&c, nr, root);
+}
+
+void rb_build_augmented(
+    struct rb_node **nodes,
+    size_t nr,
+    struct rb_root *root,
+    const struct rb_augment_callbacks *augment
+) {
+    struct rb_build_cursor c = { .nodes = nodes, .augment = augment };
+
+    rb_build_cursor_run(&c, nr, root);
+}
+
+/*
+ * Join-based bulk operations.
+ *
+ * Joining two trees around a pivot that orders between them walks down the
+ * spine of the taller tree to the first black node with the black height of
+ * the other tree, hangs the pivot there in red, with that node and the
+ * other tree as its children, and runs the insert fixup.  That costs the
+ * difference of the two black heights plus O(1) amortized rotations.
+ * Splitting takes a tree apart along the search path and joins the pieces
+ * on either side back together, which telescopes to O(log n).  The set
+ * operations recurse on the split pieces of both trees, for
+ * O(m log(n / m + 1)) with m <= n the sizes of the inputs.
+ *
+ * In between, subtrees are handed around detached: with a black root, a
+ * NULL parent and their black height, so nothing ever has to be measured.
+ */
+struct rb_subtree {
+    struct rb_node *root;
+    unsigned int bh;
+};
+
+struct rb_join_ctx {
+    int (*key_cmp)(const void *key, const struct rb_node *node);
+    int (*cmp)(struct rb_node *a, const struct rb_node *b);
+    void (*dispose)(struct rb_node *node, void *priv);
+    void *priv;
+    const struct rb_augment_callbacks *augment;
+};
+
+static struct rb_subtree rb_subtree_of(struct rb_root *root) {
+    struct rb_subtree t = { .root = root->rb_node };
+    struct rb_node *node;
+
+    for (node = t.root; node; node = node->rb_left)
+        t.bh += rb_is_black(node);
+    return t;
+}
+
+/* Detach @child of the root of a subtree of black height @bh */
+static inline struct rb_subtree rb_subtree_detach(
+    struct rb_node *child,
+    unsigned int bh
+) {
+    struct rb_subtree t = { .root = child, .bh = bh - 1 };
+
+    if (child) {
+        if (rb_is_red(child))
+            t.bh++;
+        rb_set_parent_color(child, NULL, RB_BLACK);
+    }
+    return t;
+}
+
+static inline void rb_subtree_expose(
+    struct rb_subtree t,
+    struct rb_subtree *left,
+    struct rb_subtree *right
+) {
+    *left = rb_subtree_detach(t.root->rb_left, t.bh);
+    *right = rb_subtree_detach(t.root->rb_right, t.bh);
+}
+
+static inline int rb_join_cmp(
+    const struct rb_join_ctx *ctx,
+    const void *key,
+    const struct rb_node *node
+) {
+    if (ctx->key_cmp)
+        return ctx->key_cmp(key, node);
+    return ctx->cmp((struct rb_node *) key, node);
+}
+
+static void rb_subtree_dispose(
+    struct rb_node *node,
+    const struct rb_join_ctx *ctx
+) {
+    struct rb_root tmp = { node };
+    struct rb_node *next;
+
+    if (!ctx->dispose)
+        return;
+    for (node = rb_first_postorder(&tmp); node; node = next) {
+        next = rb_next_postorder(node);
+        ctx->dispose(node, ctx->priv);
+    }
+}
+
+static struct rb_subtree rb_subtree_join(
+    struct rb_subtree left,
+    struct rb_node *pivot,
+    struct rb_subtree right,
+    const struct rb_augment_callbacks *augment
+) {
+    struct rb_node *parent = NULL, *node;
+    struct rb_root tmp;
+    unsigned int bh;
+
+    if (left.bh >= right.bh) {
+        tmp.rb_node = node = left.root;
+        for (bh = left.bh; node && (bh > right.bh || rb_is_red(node));) {
+            bh -= rb_is_black(node);
+            parent = node;
+            node = node->rb_right;
+        }
+        pivot->rb_left = node;
+        pivot->rb_right = right.root;
+        if (parent)
+            parent->rb_right = pivot;
+        bh = left.bh;
+    } else {
+        tmp.rb_node = node = right.root;
+        for (bh = right.bh; node && (bh > left.bh || rb_is_red(node));) {
+            bh -= rb_is_black(node);
+            parent = node;
+            node = node->rb_left;
+        }
+        pivot->rb_left = left.root;
+        pivot->rb_right = node;
+        if (parent)
+            parent->rb_left = pivot;
+        bh = right.bh;
+    }
+
+    if (pivot->rb_left)
+        rb_set_parent(pivot->rb_left, pivot);
+    if (pivot->rb_right)
+        rb_set_parent(pivot->rb_right, pivot);
+    rb_set_parent_color(pivot, parent, RB_RED);
+    if (!parent)
+        tmp.rb_node = pivot;
+
+    /*
+     * The stale value of @pivot may happen to match its new one, which
+     * would stop propagate before it reaches the ancestors, whose subtrees
+     * did change.  Compute @pivot on its own first.
+     */
+    if (augment) {
+        augment->propagate(pivot, parent);
+        if (parent)
+            augment->propagate(parent, NULL);
+    }
+
+    if (__rb_insert(pivot, &tmp, augment ? augment->rotate : dummy_rotate))
+        bh++;
+    return (struct rb_subtree){ .root = tmp.rb_node, .bh = bh };
+}
+
+/*
+ * Split @t into the nodes before and after @key.  With @exact, a node equal
+ * to @key is taken out and returned instead; otherwise nodes equal to @key
+ * go to @right.
+ */
+static struct rb_node *rb_subtree_split(
+    struct rb_subtree t,
+    const void *key,
+    const struct rb_join_ctx *ctx,
+    bool exact,
+    struct rb_subtree *left,
+    struct rb_subtree *right
+) {
+    struct rb_subtree l, r, tmp;
+    struct rb_node *node = t.root, *match;
+    int c;
+
+    if (!node) {
+        *left = *right = t;
+        return NULL;
+    }
+
+    rb_subtree_expose(t, &l, &r);
+    c = rb_join_cmp(ctx, key, node);
+    if (exact && !c) {
+        *left = l;
+        *right = r;
+        return node;
+    }
+
+    if (c <= 0) {
+        match = rb_subtree_split(l, key, ctx, exact, left, &tmp);
+        *right = rb_subtree_join(tmp, node, r, ctx->augment);
+    } else {
+        match = rb_subtree_split(r, key, ctx, exact, &tmp, right);
+        *left = rb_subtree_join(l, node, tmp, ctx->augment);
+    }
+    return match;
+}
+
+/* Take the last node out of non-empty @t and return it */
+static struct rb_node *rb_subtree_split_last(
+    struct rb_subtree t,
+    struct rb_subtree *rest,
+    const struct rb_augment_callbacks *augment
+) {
+    struct rb_node *last;
+    struct rb_subtree l, r;
+
+    rb_subtree_expose(t, &l, &r);
+    if (!r.root) {
+        *rest = l;
+        return t.root;
+    }
+    last = rb_subtree_split_last(r, &r, augment);
+    *rest = rb_subtree_join(l, t.root, r, augment);
+    return last;
+}
+
+static struct rb_subtree rb_subtree_concat(
+    struct rb_subtree left,
+    struct rb_subtree right,
+    const struct rb_augment_callbacks *augment
+) {
+    struct rb_node *pivot;
+
+    if (!left.root)
+        return right;
+    if (!right.root)
+        return left;
+    pivot = rb_subtree_split_last(left, &left, augment);
+    return rb_subtree_join(left, pivot, right, augment);
+}
+
+static struct rb_subtree rb_subtree_union(
+    struct rb_subtree a,
+    struct rb_subtree b,
+    const struct rb_join_ctx *ctx
+) {
+    struct rb_subtree al, ar, bl, br;
+    struct rb_node *pivot = b.root, *match;
+
+    if (!a.root)
+        return b;
+    if (!b.root)
+        return a;
+
+    rb_subtree_expose(b, &bl, &br);
+    match = rb_subtree_split(a, pivot, ctx, true, &al, &ar);
+    al = rb_subtree_union(al, bl, ctx);
+    ar = rb_subtree_union(ar, br, ctx);
+    if (match) {
+        if (ctx->dispose)
+            ctx->dispose(pivot, ctx->priv);
+        pivot = match;
+    }
+    return rb_subtree_join(al, pivot, ar, ctx->augment);
+}
+
+static struct rb_subtree rb_subtree_intersect(
+    struct rb_subtree a,
+    struct rb_subtree b,
+    const struct rb_join_ctx *ctx
+) {
+    struct rb_subtree al, ar, bl, br;
+    struct rb_node *pivot = b.root, *match;
+
+    if (!a.root || !b.root) {
+        rb_subtree_dispose(a.root, ctx);
+        rb_subtree_dispose(b.root, ctx);
+        return (struct rb_subtree){ 0 };
+    }
+
+    rb_subtree_expose(b, &bl, &br);
+    match = rb_subtree_split(a, pivot, ctx, true, &al, &ar);
+    al = rb_subtree_intersect(al, bl, ctx);
+    ar = rb_subtree_intersect(ar, br, ctx);
+    if (ctx->dispose)
+        ctx->dispose(pivot, ctx->priv);
+    if (match)
+        return rb_subtree_join(al, match, ar, ctx->augment);
+    return rb_subtree_concat(al, ar, ctx->augment);
+}
+
+static struct rb_subtree rb_subtree_difference(
+    struct rb_subtree a,
+    struct rb_subtree b,
+    const struct rb_join_ctx *ctx
+) {
+    struct rb_subtree al, ar, bl, br;
+    struct rb_node *pivot = b.root, *match;
+
+    if (!a.root || !b.root) {
+        rb_subtree_dispose(b.root, ctx);
+        return a;
+    }
+
+    rb_subtree_expose(b, &bl, &br);
+    match = rb_subtree_split(a, pivot, ctx, true, &al, &ar);
+    al = rb_subtree_difference(al, bl, ctx);
+    ar = rb_subtree_difference(ar, br, ctx);
+    if (ctx->dispose) {
+        ctx->dispose(pivot, ctx->priv);
+        if (match)
+            ctx->dispose(match, ctx->priv);
+    }
+    return rb_subtree_concat(al, ar, ctx->augment);
+}
+
+/**
+ * __rb_join - concatenate two trees
+ * @left: tree whose nodes all order before @pivot, receives the result
+ * @pivot: unlinked node ordering between the two trees, or NULL
+ * @right: tree whose nodes all order after @pivot, emptied
+ * @augment: callbacks of an augmented tree, or NULL
+ *
+ * O(log n), or just the difference of the tree heights with a @pivot.
+ */
+void __rb_join(
+    struct rb_root *left,
+    struct rb_node *pivot,
+    struct rb_root *right,
+    const struct rb_augment_callbacks *augment
+) {
+    struct rb_subtree l = rb_subtree_of(left), r = rb_subtree_of(right);
+
+    if (pivot)
+        l = rb_subtree_join(l, pivot, r, augment);
+    else
+        l = rb_subtree_concat(l, r, augment);
+    left->rb_node = l.root;
+    right->rb_node = NULL;
+}
+
+/**
+ * __rb_split - split a tree at a key in O(log n)
+ * @tree: tree to split, keeps the nodes ordered before @key
+ * @key: key to split at
+ * @right: receives the nodes ordered at or after @key, its previous
+ *	contents are discarded
+ * @cmp: comparison of @key against a node, as for rb_find()
+ * @augment: callbacks of an augmented tree, or NULL
+ */
+void __rb_split(
+    struct rb_root *tree,
+    const void *key,
+    struct rb_root *right,
+    int (*cmp)(const void *key, const struct rb_node *),
+    const struct rb_augment_callbacks *augment
+) {
+    struct rb_join_ctx ctx = { .key_cmp = cmp, .augment = augment };
+    struct rb_subtree l, r;
+
+    rb_subtree_split(rb_subtree_of(tree), key, &ctx, false, &l, &r);
+    tree->rb_node = l.root;
+    right->rb_node = r.root;
+}
+
+static void rb_set_op(
+    struct rb_root *a,
+    struct rb_root *b,
+    struct rb_subtree (*op)(
+        struct rb_subtree,
+        struct rb_subtree,
+        const struct rb_join_ctx *
+    ),
+    const struct rb_join_ctx *ctx
+) {
+    a->rb_node = op(rb_subtree_of(a), rb_subtree_of(b), ctx).root;
+    b->rb_node = NULL;
+}
+
+void __rb_union(
+    struct rb_root *a,
+    struct rb_root *b,
+    int (*cmp)(struct rb_node *, const struct rb_node *),
+    void (*dispose)(struct rb_node *, void *),
+    void *priv,
+    const struct rb_augment_callbacks *augment
+) {
+    struct rb_join_ctx ctx = {
+        .cmp = cmp,
+        .dispose = dispose,
+        .priv = priv,
+        .augment = augment,
+    };
+
+    rb_set_op(a, b, rb_subtree_union, &ctx);
+}
+
+void __rb_intersect(
+    struct rb_root *a,
+    struct rb_root *b,
+    int (*cmp)(struct rb_node *, const struct rb_node *),
+    void (*dispose)(struct rb_node *, void *),
+    void *priv,
+    const struct rb_augment_callbacks *augment
+) {
+    struct rb_join_ctx ctx = {
+        .cmp = cmp,
+        .dispose = dispose,
+        .priv = priv,
+        .augment = augment,
+    };
+
+    rb_set_op(a, b, rb_subtree_intersect, &ctx);
+}
+
+void __rb_difference(
+    struct rb_root *a,
+    struct rb_root *b,
+    int (*cmp)(struct rb_node *, const struct rb_node *),
+    void (*dispose)(struct rb_node *, void *),
+    void *priv,
+    const struct rb_augment_callbacks *augment
+) {
+    struct rb_join_ctx ctx = {
+        .cmp = cmp,
+        .dispose = dispose,
+        .priv = priv,
+        .augment = augment,
+    };
+
+    rb_set_op(a, b, rb_subtree_difference, &ctx);
+}
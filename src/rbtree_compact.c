@@ -0,0 +1,127 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Compact red-black trees
+ */
+
+#include "rbtree_compact.h"
+
+#include "build_bug.h"
+
+static_assert(
+    sizeof(struct rb_cnode) == 12,
+    "struct rb_cnode must stay three 32-bit words"
+);
+
+#define RB_RED 0
+#define RB_BLACK 1
+
+#define N(idx) rb_cnode(pool, idx)
+
+/* The rbtree.c rebalancing on pool indices, without augment callbacks */
+#define RBT_REF uint32_t
+#define RBT_NIL RB_CNIL
+#define RBT_ROOT struct rb_croot
+#define RBT_CTX const struct rb_cpool *pool,
+#define RBT_NODE(ref) N(ref)
+#define RBT_PC_PARENT(pc) ((pc) >> 1)
+#define RBT_PC_MAKE(p, color) ((p) << 1 | (color))
+#define RBT_STORE(x, v) ((x) = (v))
+#define RBT_AUGMENT_ROTATE
+#define RBT_ROTATE(old, new) do { } while (0)
+#define RBT_AUGMENT
+#define RBT_COPY(old, new) do { } while (0)
+#define RBT_PROPAGATE(node, stop) do { } while (0)
+#define RBT_INSERT __rb_cinsert
+#define RBT_ERASE_COLOR __rb_cerase_color
+#define RBT_ERASE __rb_cerase
+#include "rbtree_fixup.h"
+
+void rb_cinsert_color(
+    const struct rb_cpool *pool,
+    uint32_t node,
+    struct rb_croot *root
+) {
+    __rb_cinsert(pool, node, root);
+}
+
+void rb_cerase(
+    const struct rb_cpool *pool,
+    uint32_t node,
+    struct rb_croot *root
+) {
+    uint32_t rebalance = __rb_cerase(pool, node, root);
+
+    if (rebalance)
+        __rb_cerase_color(pool, rebalance, root);
+}
+
+uint32_t rb_cfirst(const struct rb_cpool *pool, const struct rb_croot *root) {
+    uint32_t n = root->rb_node;
+
+    if (!n)
+        return RB_CNIL;
+    while (N(n)->rb_left)
+        n = N(n)->rb_left;
+    return n;
+}
+
+uint32_t rb_clast(const struct rb_cpool *pool, const struct rb_croot *root) {
+    uint32_t n = root->rb_node;
+
+    if (!n)
+        return RB_CNIL;
+    while (N(n)->rb_right)
+        n = N(n)->rb_right;
+    return n;
+}
+
+uint32_t rb_cnext(const struct rb_cpool *pool, uint32_t node) {
+    uint32_t parent;
+
+    /*
+     * If we have a right-hand child, go down and then left as far
+     * as we can.
+     */
+    if (N(node)->rb_right) {
+        node = N(node)->rb_right;
+        while (N(node)->rb_left)
+            node = N(node)->rb_left;
+        return node;
+    }
+
+    /*
+     * No right-hand children. Everything down and left is smaller than us,
+     * so any 'next' node must be in the general direction of our parent.
+     * Go up the tree; any time the ancestor is a right-hand child of its
+     * parent, keep going up. First time it's a left-hand child of its
+     * parent, said parent is our 'next' node.
+     */
+    while ((parent = rb_cparent(N(node))) && node == N(parent)->rb_right)
+        node = parent;
+
+    return parent;
+}
+
+uint32_t rb_cprev(const struct rb_cpool *pool, uint32_t node) {
+    uint32_t parent;
+
+    /*
+     * If we have a left-hand child, go down and then right as far
+     * as we can.
+     */
+    if (N(node)->rb_left) {
+        node = N(node)->rb_left;
+        while (N(node)->rb_right)
+            node = N(node)->rb_right;
+        return node;
+    }
+
+    /*
+     * No left-hand children. Go up till we find an ancestor which
+     * is a right-hand child of its parent.
+     */
+    while ((parent = rb_cparent(N(node))) && node == N(parent)->rb_left)
+        node = parent;
+
+    return parent;
+}
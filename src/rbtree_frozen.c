@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Frozen rbtree snapshots
+ */
+
+#include "rbtree_frozen.h"
+
+#include <errno.h>
+#include <stdlib.h>
+
+#include "cache.h"
+
+struct rb_freeze_cursor {
+    struct rb_frozen *frozen;
+    struct rb_node *node;
+    uint64_t (*key)(const struct rb_node *);
+};
+
+/* Fill the subtree rooted at slot @k with the next nodes in order */
+static void rb_freeze_fill(struct rb_freeze_cursor *c, size_t k) {
+    if (k > c->frozen->nr)
+        return;
+
+    rb_freeze_fill(c, 2 * k);
+    c->frozen->keys[k] = c->key(c->node);
+    c->frozen->nodes[k] = c->node;
+    c->node = rb_next(c->node);
+    rb_freeze_fill(c, 2 * k + 1);
+}
+
+/**
+ * rb_freeze() - take a searchable snapshot of @root
+ * @frozen: snapshot to fill in
+ * @root: tree to take the snapshot of
+ * @key: returns the key of a node, in tree order
+ *
+ * Builds @frozen in O(n).  Release it with rb_frozen_destroy().
+ *
+ * Returns 0 on success or -ENOMEM.
+ */
+int rb_freeze(
+    struct rb_frozen *frozen,
+    const struct rb_root *root,
+    uint64_t (*key)(const struct rb_node *)
+) {
+    struct rb_freeze_cursor c = {
+        .frozen = frozen,
+        .node = rb_first(root),
+        .key = key,
+    };
+    struct rb_node *node;
+    size_t nr = 0, size;
+
+    for (node = c.node; node; node = rb_next(node))
+        nr++;
+
+    /* whole cache lines, so that slot 8k starts one */
+    size = ((nr + 1) * sizeof(*frozen->keys) + SMP_CACHE_BYTES - 1) &
+           ~(size_t) (SMP_CACHE_BYTES - 1);
+    frozen->keys = aligned_alloc(SMP_CACHE_BYTES, size);
+    frozen->nodes = malloc((nr + 1) * sizeof(*frozen->nodes));
+    if (!frozen->keys || !frozen->nodes) {
+        free(frozen->keys);
+        free(frozen->nodes);
+        return -ENOMEM;
+    }
+
+    frozen->nr = nr;
+    frozen->keys[0] = 0;
+    frozen->nodes[0] = NULL;
+    rb_freeze_fill(&c, 1);
+
+    return 0;
+}
+
+/**
+ * rb_frozen_destroy() - free a snapshot
+ * @frozen: snapshot taken with rb_freeze()
+ *
+ * The tree and its nodes are not touched.
+ */
+void rb_frozen_destroy(struct rb_frozen *frozen) {
+    free(frozen->keys);
+    free(frozen->nodes);
+    frozen->keys = NULL;
+    frozen->nodes = NULL;
+    frozen->nr = 0;
+}
@@ -0,0 +1,81 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Order-statistic red-black trees
+ */
+
+#include "rbtree_ost.h"
+
+static inline bool rb_ost_compute(struct rb_ost_node *node, bool exit) {
+    size_t size = 1 + __rb_ost_size(node->rb.rb_left) +
+                  __rb_ost_size(node->rb.rb_right);
+
+    if (exit && node->size == size)
+        return true;
+    node->size = size;
+    return false;
+}
+
+RB_DECLARE_CALLBACKS(
+    ,
+    rb_ost_callbacks,
+    struct rb_ost_node,
+    rb,
+    size,
+    rb_ost_compute
+)
+
+/**
+ * rb_ost_erase() - remove @node from the order-statistic tree @root
+ * @node: node to remove
+ * @root: tree to remove @node from
+ */
+void rb_ost_erase(struct rb_node *node, struct rb_root *root) {
+    rb_erase_augmented(node, root, &rb_ost_callbacks);
+}
+
+/**
+ * rb_select() - find the node of rank @k
+ * @root: order-statistic tree to search
+ * @k: 0-based position of the node in tree order
+ *
+ * Returns the @k-th smallest node, or NULL if @root has no more than @k
+ * nodes.
+ */
+struct rb_node *rb_select(const struct rb_root *root, size_t k) {
+    struct rb_node *node = root->rb_node;
+
+    while (node) {
+        size_t left = __rb_ost_size(node->rb_left);
+
+        if (k < left) {
+            node = node->rb_left;
+        } else if (k > left) {
+            k -= left + 1;
+            node = node->rb_right;
+        } else {
+            return node;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * rb_rank() - position of @node in its tree
+ * @node: node of an order-statistic tree
+ *
+ * Returns the number of nodes ordered before @node, so that
+ * rb_select(root, rb_rank(node)) == node.
+ */
+size_t rb_rank(const struct rb_node *node) {
+    size_t rank = __rb_ost_size(node->rb_left);
+    const struct rb_node *parent;
+
+    while ((parent = rb_parent(node))) {
+        if (node == parent->rb_right)
+            rank += __rb_ost_size(parent->rb_left) + 1;
+        node = parent;
+    }
+
+    return rank;
+}
@@ -0,0 +1,397 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Persistent red-black trees
+ *
+ * Without parent pointers, which could not be shared between versions, an
+ * update records the path from the root and makes every node on it private
+ * to this version before changing anything: a node is private if its count
+ * is 1 and its parent is private, otherwise it is replaced by a copy that
+ * takes references on both children.  The rebalancing then runs the usual
+ * insert and erase fixups along the recorded path, making each sibling or
+ * nephew private in the same way right before recoloring or rotating it.
+ */
+
+#include "rbtree_persistent.h"
+
+#include <errno.h>
+#include <stdlib.h>
+
+/*
+ * Private nodes an update may need: the search path, successor included,
+ * one sibling per level and a few around the final rotation.
+ */
+static unsigned int prb_reserve_nr(const struct prbtree *tree) {
+    unsigned int height = 2 * (64 - __builtin_clzll(tree->nr + 1));
+
+    return 2 * height + 4;
+}
+
+static int prb_reserve(struct prbtree *tree) {
+    unsigned int need = prb_reserve_nr(tree);
+    struct prb_node *node;
+
+    while (tree->nr_spare < need) {
+        node = malloc(sizeof(*node));
+        if (!node)
+            return -ENOMEM;
+        node->left = tree->spare;
+        tree->spare = node;
+        tree->nr_spare++;
+    }
+    return 0;
+}
+
+static struct prb_node *prb_alloc(struct prbtree *tree) {
+    struct prb_node *node = tree->spare;
+
+    tree->spare = node->left;
+    tree->nr_spare--;
+    arc_init(&node->ref);
+    arc_inc(&node->ref);
+    return node;
+}
+
+static void prb_put(struct prb_node *node) {
+    struct prb_node *right;
+
+    while (node && arc_dec(&node->ref)) {
+        right = node->right;
+        prb_put(node->left);
+        free(node);
+        node = right;
+    }
+}
+
+/*
+ * Make the node at @link, whose parent is private, private as well.  Its
+ * count may only drop concurrently, as other versions let go of it, and
+ * the acquire in arc_cmp() pairs with the release in arc_dec() so that
+ * their reads are done before we write.
+ */
+static struct prb_node *prb_own(struct prbtree *tree, struct prb_node **link) {
+    struct prb_node *old = *link, *node;
+
+    if (arc_cmp(&old->ref, 1))
+        return old;
+
+    node = prb_alloc(tree);
+    node->left = old->left;
+    node->right = old->right;
+    node->key = old->key;
+    node->val = old->val;
+    node->red = old->red;
+    if (node->left)
+        arc_inc(&node->left->ref);
+    if (node->right)
+        arc_inc(&node->right->ref);
+
+    *link = node;
+    prb_put(old);
+    return node;
+}
+
+static inline bool prb_is_red(const struct prb_node *node) {
+    return node && node->red;
+}
+
+static inline struct prb_node **prb_link(
+    struct prbtree *tree,
+    struct prb_node **path,
+    const bool *right,
+    int i
+) {
+    if (!i)
+        return &tree->root;
+    return right[i - 1] ? &path[i - 1]->right : &path[i - 1]->left;
+}
+
+static void prb_insert_fixup(
+    struct prbtree *tree,
+    struct prb_node **path,
+    bool *right,
+    int i
+) {
+    struct prb_node *node, *parent, *gparent, *uncle, **link;
+
+    while (true) {
+        node = path[i];
+        if (!i) {
+            node->red = false;
+            break;
+        }
+        parent = path[i - 1];
+        if (!parent->red)
+            break;
+
+        /* a red parent is not the root */
+        gparent = path[i - 2];
+        link = right[i - 2] ? &gparent->left : &gparent->right;
+        if (prb_is_red(*link)) {
+            /* Case 1 - the uncle is red: color flips */
+            uncle = prb_own(tree, link);
+            uncle->red = false;
+            parent->red = false;
+            gparent->red = true;
+            i -= 2;
+            continue;
+        }
+
+        if (!right[i - 2]) {
+            if (right[i - 1]) {
+                /* Case 2 - left rotate at parent */
+                parent->right = node->left;
+                node->left = parent;
+                gparent->left = node;
+                parent = node;
+            }
+            /* Case 3 - right rotate at gparent */
+            gparent->left = parent->right;
+            parent->right = gparent;
+        } else {
+            if (!right[i - 1]) {
+                /* Case 2 - right rotate at parent */
+                parent->left = node->right;
+                node->right = parent;
+                gparent->right = node;
+                parent = node;
+            }
+            /* Case 3 - left rotate at gparent */
+            gparent->right = parent->left;
+            parent->left = gparent;
+        }
+        parent->red = false;
+        gparent->red = true;
+        *prb_link(tree, path, right, i - 2) = parent;
+        break;
+    }
+}
+
+/**
+ * prbtree_insert - add a key to this version
+ * @tree: version to add to
+ * @key: key to add
+ * @val: value to store with @key, must not be NULL
+ *
+ * Other versions are not affected.  A failed insertion leaves @tree
+ * untouched.
+ *
+ * Returns 0 on success, -EEXIST if @key is already present, -ENOMEM if a
+ * node could not be allocated, or -EINVAL if @val is NULL.
+ */
+int prbtree_insert(struct prbtree *tree, uint64_t key, void *val) {
+    struct prb_node *path[PRBTREE_MAX_DEPTH + 1], **link, *node;
+    bool right[PRBTREE_MAX_DEPTH];
+    int depth = 0;
+
+    if (!val)
+        return -EINVAL;
+    if (prbtree_find(tree, key))
+        return -EEXIST;
+    if (prb_reserve(tree))
+        return -ENOMEM;
+
+    for (link = &tree->root; *link; depth++) {
+        node = prb_own(tree, link);
+        path[depth] = node;
+        right[depth] = key > node->key;
+        link = right[depth] ? &node->right : &node->left;
+    }
+
+    node = prb_alloc(tree);
+    node->left = node->right = NULL;
+    node->key = key;
+    node->val = val;
+    node->red = true;
+    *link = node;
+    path[depth] = node;
+
+    prb_insert_fixup(tree, path, right, depth);
+    tree->nr++;
+    return 0;
+}
+
+/*
+ * The subtree on side @side of path[@i] lost a black node.  Everything on
+ * the path is private.
+ */
+static void prb_erase_fixup(
+    struct prbtree *tree,
+    struct prb_node **path,
+    bool *right,
+    int i,
+    bool side
+) {
+    struct prb_node *parent, *sibling, *near, *far, **plink, **link;
+
+    while (true) {
+        parent = path[i];
+        link = side ? &parent->right : &parent->left;
+        if (prb_is_red(*link)) {
+            prb_own(tree, link)->red = false;
+            break;
+        }
+
+        plink = prb_link(tree, path, right, i);
+        link = side ? &parent->left : &parent->right;
+        sibling = prb_own(tree, link);
+        if (sibling->red) {
+            /* Case 1 - rotate the red sibling above parent */
+            sibling->red = false;
+            parent->red = true;
+            if (!side) {
+                parent->right = sibling->left;
+                sibling->left = parent;
+                plink = &sibling->left;
+            } else {
+                parent->left = sibling->right;
+                sibling->right = parent;
+                plink = &sibling->right;
+            }
+            *prb_link(tree, path, right, i) = sibling;
+            sibling = prb_own(tree, link);
+        }
+
+        near = side ? sibling->right : sibling->left;
+        far = side ? sibling->left : sibling->right;
+        if (!prb_is_red(near) && !prb_is_red(far)) {
+            /* Case 2 - recolor the sibling, and move up if parent is black */
+            sibling->red = true;
+            if (parent->red) {
+                parent->red = false;
+                break;
+            }
+            if (!i)
+                break;
+            side = right[--i];
+            continue;
+        }
+
+        if (!prb_is_red(far)) {
+            /* Case 3 - rotate the red near nephew above sibling */
+            near = prb_own(tree, side ? &sibling->right : &sibling->left);
+            near->red = false;
+            sibling->red = true;
+            if (!side) {
+                sibling->left = near->right;
+                near->right = sibling;
+            } else {
+                sibling->right = near->left;
+                near->left = sibling;
+            }
+            *link = near;
+            sibling = near;
+        }
+
+        /* Case 4 - rotate sibling above parent, blacken the far nephew */
+        far = prb_own(tree, side ? &sibling->left : &sibling->right);
+        far->red = false;
+        sibling->red = parent->red;
+        parent->red = false;
+        if (!side) {
+            parent->right = sibling->left;
+            sibling->left = parent;
+        } else {
+            parent->left = sibling->right;
+            sibling->right = parent;
+        }
+        *plink = sibling;
+        break;
+    }
+}
+
+/**
+ * prbtree_remove - remove a key from this version
+ * @tree: version to remove from
+ * @key: key to remove
+ * @val: if not NULL, receives the value that was stored with @key
+ *
+ * Other versions are not affected.  A failed removal leaves @tree
+ * untouched.
+ *
+ * Returns 0 on success, -ENOENT if @key is not present, or -ENOMEM if a
+ * node could not be allocated.
+ */
+int prbtree_remove(struct prbtree *tree, uint64_t key, void **val) {
+    struct prb_node *path[PRBTREE_MAX_DEPTH], **link, *node, *victim, *child;
+    bool right[PRBTREE_MAX_DEPTH];
+    int depth = 0, found;
+
+    if (!prbtree_find(tree, key))
+        return -ENOENT;
+    if (prb_reserve(tree))
+        return -ENOMEM;
+
+    for (link = &tree->root;; depth++) {
+        node = prb_own(tree, link);
+        path[depth] = node;
+        if (key == node->key)
+            break;
+        right[depth] = key > node->key;
+        link = right[depth] ? &node->right : &node->left;
+    }
+    found = depth;
+    if (val)
+        *val = node->val;
+
+    /* with two children, take the place of the successor instead */
+    if (node->left && node->right) {
+        right[depth] = true;
+        link = &node->right;
+        for (depth++;; depth++) {
+            path[depth] = prb_own(tree, link);
+            if (!path[depth]->left)
+                break;
+            right[depth] = false;
+            link = &path[depth]->left;
+        }
+        path[found]->key = path[depth]->key;
+        path[found]->val = path[depth]->val;
+    }
+
+    /* unlink the victim; its child, if any, moves up with its reference */
+    victim = path[depth];
+    child = victim->left ? victim->left : victim->right;
+    *link = child;
+    if (depth && !victim->red)
+        prb_erase_fixup(tree, path, right, depth - 1, right[depth - 1]);
+    else if (!depth && child)
+        prb_own(tree, &tree->root)->red = false;
+    free(victim);
+
+    tree->nr--;
+    return 0;
+}
+
+/**
+ * prbtree_snapshot - take an O(1) snapshot of a version
+ * @snap: receives the snapshot, its previous contents are discarded
+ * @tree: version to snapshot
+ *
+ * @snap is a version of its own: it can be read, updated or snapshotted
+ * independently of @tree, and must be released with prbtree_destroy().
+ */
+void prbtree_snapshot(struct prbtree *snap, const struct prbtree *tree) {
+    if (tree->root)
+        arc_inc(&tree->root->ref);
+    prbtree_init(snap);
+    snap->root = tree->root;
+    snap->nr = tree->nr;
+}
+
+/**
+ * prbtree_destroy - release a version
+ * @tree: version to release
+ *
+ * Frees the nodes no other version uses.  The values are not touched.
+ * @tree is empty afterwards.
+ */
+void prbtree_destroy(struct prbtree *tree) {
+    struct prb_node *node;
+
+    prb_put(tree->root);
+    while ((node = tree->spare)) {
+        tree->spare = node->left;
+        free(node);
+    }
+    prbtree_init(tree);
+}
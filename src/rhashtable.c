@@ -0,0 +1,453 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Resizable, Scalable, Concurrent Hash Table
+ *
+ * Based on the Linux kernel's lib/rhashtable.c:
+ * Copyright (c) 2015 Herbert Xu <herbert@gondor.apana.org.au>
+ * Copyright (c) 2014-2015 Thomas Graf <tgraf@suug.ch>
+ * Copyright (c) 2008-2014 Patrick McHardy <kaber@trash.net>
+ */
+
+#include "rhashtable.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+
+static pthread_spinlock_t *rht_bucket_lock(
+    const struct bucket_table *tbl,
+    unsigned int hash
+) {
+    return &tbl->locks[hash & tbl->locks_mask];
+}
+
+static void bucket_table_free(struct bucket_table *tbl) {
+    unsigned int i;
+
+    for (i = 0; i <= tbl->locks_mask; i++)
+        pthread_spin_destroy(&tbl->locks[i]);
+    free((void *) tbl->locks);
+    free(tbl);
+}
+
+static void bucket_table_free_rcu(struct rcu_head *head) {
+    bucket_table_free(caa_container_of(head, struct bucket_table, rcu));
+}
+
+/* The buckets are left for the caller to set up, see rht_init_buckets() */
+static struct bucket_table *bucket_table_alloc(unsigned int bits) {
+    struct bucket_table *tbl;
+    unsigned int i, nr_locks;
+
+    tbl = malloc(sizeof(*tbl) + (sizeof(tbl->buckets[0]) << bits));
+    if (!tbl)
+        return NULL;
+
+    tbl->size = 1U << bits;
+    tbl->bits = bits;
+    tbl->future_tbl = NULL;
+
+    nr_locks = tbl->size < RHT_LOCKS_MAX ? tbl->size : RHT_LOCKS_MAX;
+    tbl->locks = malloc(sizeof(*tbl->locks) * nr_locks);
+    if (!tbl->locks) {
+        free(tbl);
+        return NULL;
+    }
+    tbl->locks_mask = nr_locks - 1;
+    for (i = 0; i < nr_locks; i++)
+        pthread_spin_init(&tbl->locks[i], PTHREAD_PROCESS_PRIVATE);
+
+    return tbl;
+}
+
+/* Empty buckets [@start, @end) of @tbl */
+static void rht_init_buckets(
+    struct bucket_table *tbl,
+    unsigned int start,
+    unsigned int end
+) {
+    unsigned int i;
+
+    for (i = start; i < end; i++)
+        tbl->buckets[i] = RHT_NULLS_MARKER(&tbl->buckets[i]);
+}
+
+/**
+ * rhashtable_init - initialize a new hash table
+ * @ht: hash table to be initialized
+ * @bits: log2 of the initial bucket count, the table never shrinks below it
+ *
+ * Returns 0 on success or -ENOMEM.
+ */
+int rhashtable_init(struct rhashtable *ht, unsigned int bits) {
+    if (bits < RHT_MIN_BITS)
+        bits = RHT_MIN_BITS;
+    if (bits > RHT_MAX_BITS)
+        bits = RHT_MAX_BITS;
+
+    ht->tbl = bucket_table_alloc(bits);
+    if (!ht->tbl)
+        return -ENOMEM;
+    rht_init_buckets(ht->tbl, 0, ht->tbl->size);
+
+    atomic_init(&ht->nelems, 0);
+    ht->min_bits = bits;
+    pthread_mutex_init(&ht->mutex, NULL);
+    ht->new_tbl = NULL;
+    ht->rehash = 0;
+    atomic_init(&ht->resizing, false);
+    return 0;
+}
+
+/**
+ * rhashtable_free_and_destroy - free elements and destroy hash table
+ * @ht: the hash table to destroy
+ * @free_fn: callback to release resources of element, may be NULL
+ * @arg: pointer passed to free_fn
+ *
+ * The caller must make sure that no other thread is accessing the table.
+ * A resize left half done by the updates is dropped, its entries freed
+ * from both tables.  Tables retired by earlier resizes are still freed
+ * through call_rcu().
+ */
+void rhashtable_free_and_destroy(
+    struct rhashtable *ht,
+    void (*free_fn)(struct rhash_head *obj, void *arg),
+    void *arg
+) {
+    struct bucket_table *tbl = ht->tbl;
+    struct rhash_head *pos, *next;
+    unsigned int i;
+
+    if (free_fn) {
+        /* new_tbl only has entries once it is future_tbl */
+        for (; tbl; tbl = tbl->future_tbl) {
+            for (i = 0; i < tbl->size; i++) {
+                for (pos = tbl->buckets[i]; !rht_is_a_nulls(pos);
+                     pos = next) {
+                    next = pos->next;
+                    free_fn(pos, arg);
+                }
+            }
+        }
+    }
+
+    if (ht->new_tbl)
+        bucket_table_free(ht->new_tbl);
+    bucket_table_free(ht->tbl);
+    ht->tbl = NULL;
+    ht->new_tbl = NULL;
+    pthread_mutex_destroy(&ht->mutex);
+}
+
+void rhashtable_destroy(struct rhashtable *ht) {
+    rhashtable_free_and_destroy(ht, NULL, NULL);
+}
+
+/*
+ * Move the last entry of old bucket @old_hash into @new_tbl.
+ *
+ * Taking the tail keeps the rest of the old chain intact for readers: a
+ * reader standing on the moved entry follows it into the new chain, hits a
+ * nulls marker that is not the one it started from and restarts.
+ */
+static void rhashtable_rehash_one(
+    struct bucket_table *old_tbl,
+    unsigned int old_hash,
+    struct bucket_table *new_tbl
+) {
+    struct rhash_head **pprev = &old_tbl->buckets[old_hash];
+    struct rhash_head *entry = *pprev, *next;
+    pthread_spinlock_t *new_lock;
+    unsigned int new_hash;
+
+    while (!rht_is_a_nulls(next = entry->next)) {
+        pprev = &entry->next;
+        entry = next;
+    }
+
+    new_hash = rht_bucket_index(new_tbl, entry->key);
+    new_lock = rht_bucket_lock(new_tbl, new_hash);
+
+    pthread_spin_lock(new_lock);
+    rcu_assign_pointer(entry->next, new_tbl->buckets[new_hash]);
+    rcu_assign_pointer(new_tbl->buckets[new_hash], entry);
+    pthread_spin_unlock(new_lock);
+
+    rcu_assign_pointer(*pprev, next);
+}
+
+static void rhashtable_rehash_chain(
+    struct bucket_table *old_tbl,
+    unsigned int old_hash,
+    struct bucket_table *new_tbl
+) {
+    pthread_spinlock_t *old_lock = rht_bucket_lock(old_tbl, old_hash);
+
+    pthread_spin_lock(old_lock);
+    while (!rht_is_a_nulls(old_tbl->buckets[old_hash]))
+        rhashtable_rehash_one(old_tbl, old_hash, new_tbl);
+    pthread_spin_unlock(old_lock);
+}
+
+/* Start moving to a table of 2^@bits buckets; ht->mutex must be held */
+static int rht_resize_begin(struct rhashtable *ht, unsigned int bits) {
+    ht->new_tbl = bucket_table_alloc(bits);
+    if (!ht->new_tbl)
+        return -ENOMEM;
+    ht->rehash = 0;
+    atomic_store_explicit(&ht->resizing, true, memory_order_relaxed);
+    return 0;
+}
+
+/*
+ * Initialize or move up to @budget buckets of the resize in progress, then
+ * publish the new table once the last one is moved.  ht->mutex must be
+ * held.  Returns whether the resize is complete.
+ */
+static bool rht_resize_continue(struct rhashtable *ht, unsigned int budget) {
+    struct bucket_table *old_tbl = ht->tbl;
+    struct bucket_table *new_tbl = ht->new_tbl;
+    unsigned int end;
+
+    if (!old_tbl->future_tbl) {
+        end = new_tbl->size - ht->rehash > budget ? ht->rehash + budget
+                                                  : new_tbl->size;
+        rht_init_buckets(new_tbl, ht->rehash, end);
+        budget -= end - ht->rehash;
+        ht->rehash = end;
+        if (end < new_tbl->size)
+            return false;
+
+        /*
+         * Make insertions go into the new, empty table right away.
+         * Inserters read future_tbl under the bucket lock, so once we have
+         * taken and dropped a bucket lock no new entry can appear behind us
+         * in it.
+         */
+        rcu_assign_pointer(old_tbl->future_tbl, new_tbl);
+        cmm_smp_mb();
+        ht->rehash = 0;
+    }
+
+    for (; budget && ht->rehash < old_tbl->size; budget--)
+        rhashtable_rehash_chain(old_tbl, ht->rehash++, new_tbl);
+    if (ht->rehash < old_tbl->size)
+        return false;
+
+    /* Publish the new table pointer. */
+    rcu_assign_pointer(ht->tbl, new_tbl);
+    ht->new_tbl = NULL;
+    atomic_store_explicit(&ht->resizing, false, memory_order_relaxed);
+
+    /* Wait for readers. All new readers will see the new table. */
+    call_rcu(&old_tbl->rcu, bucket_table_free_rcu);
+    return true;
+}
+
+/**
+ * rhashtable_resize - resize the table to 2^@bits buckets
+ * @ht: hash table to resize
+ * @bits: log2 of the new bucket count
+ *
+ * Unlike the resizes triggered by the load factor, this moves every entry
+ * before returning, after completing any resize the updates left half
+ * done.  Readers are never blocked; concurrent inserts and removals only
+ * wait for the bucket currently being moved.
+ *
+ * Returns 0 on success, -ENOMEM on allocation failure.
+ */
+int rhashtable_resize(struct rhashtable *ht, unsigned int bits) {
+    int err = 0;
+
+    if (bits < ht->min_bits)
+        bits = ht->min_bits;
+    if (bits > RHT_MAX_BITS)
+        bits = RHT_MAX_BITS;
+
+    pthread_mutex_lock(&ht->mutex);
+    if (ht->new_tbl)
+        rht_resize_continue(ht, UINT_MAX);
+    if (bits != ht->tbl->bits) {
+        err = rht_resize_begin(ht, bits);
+        if (!err)
+            rht_resize_continue(ht, UINT_MAX);
+    }
+    pthread_mutex_unlock(&ht->mutex);
+
+    return err;
+}
+
+static bool rht_grow_above_75(struct rhashtable *ht, struct bucket_table *tbl) {
+    return rhashtable_count(ht) > (tbl->size / 4 * 3)
+        && tbl->bits < RHT_MAX_BITS;
+}
+
+static bool rht_shrink_below_30(
+    struct rhashtable *ht,
+    struct bucket_table *tbl
+) {
+    return rhashtable_count(ht) < (tbl->size * 3 / 10)
+        && tbl->bits > ht->min_bits;
+}
+
+/* Whether updates should help a resize along, a hint read without the mutex */
+static inline bool rht_resizing(struct rhashtable *ht) {
+    return atomic_load_explicit(&ht->resizing, memory_order_relaxed);
+}
+
+/*
+ * Start growing or shrinking the table if the load factor left the 30%-75%
+ * window, and take the resize in progress RHT_RESIZE_BATCH buckets further.
+ * An update that finds the mutex taken moves on instead of queueing up
+ * behind another one; a failed allocation is retried by the next update.
+ */
+static void rhashtable_resize_step(struct rhashtable *ht) {
+    struct bucket_table *tbl;
+    unsigned int bits;
+
+    if (pthread_mutex_trylock(&ht->mutex))
+        return;
+
+    if (!ht->new_tbl) {
+        tbl = ht->tbl;
+        bits = tbl->bits;
+        if (rht_grow_above_75(ht, tbl))
+            bits++;
+        else if (rht_shrink_below_30(ht, tbl))
+            bits--;
+        if (bits != tbl->bits)
+            rht_resize_begin(ht, bits);
+    }
+    if (ht->new_tbl)
+        rht_resize_continue(ht, RHT_RESIZE_BATCH);
+
+    pthread_mutex_unlock(&ht->mutex);
+}
+
+static bool rht_bucket_contains(
+    struct bucket_table *tbl,
+    unsigned int hash,
+    uint64_t key
+) {
+    struct rhash_head *he;
+
+    for (he = tbl->buckets[hash]; !rht_is_a_nulls(he); he = he->next) {
+        if (he->key == key)
+            return true;
+    }
+    return false;
+}
+
+/**
+ * rhashtable_insert - insert object into hash table
+ * @ht: hash table
+ * @obj: pointer to hash head inside object
+ * @key: key of the object, must not change while @obj is hashed
+ *
+ * Returns 0 on success, or -EEXIST if an entry with @key already exists.
+ */
+int rhashtable_insert(
+    struct rhashtable *ht,
+    struct rhash_head *obj,
+    uint64_t key
+) {
+    struct bucket_table *tbl, *new_tbl;
+    pthread_spinlock_t *lock;
+    unsigned int hash;
+    bool grow = false;
+    int err = 0;
+
+    obj->key = key;
+
+    rcu_read_lock();
+    tbl = rcu_dereference(ht->tbl);
+    for (;;) {
+        hash = rht_bucket_index(tbl, key);
+        lock = rht_bucket_lock(tbl, hash);
+        pthread_spin_lock(lock);
+
+        if (rht_bucket_contains(tbl, hash, key)) {
+            err = -EEXIST;
+            goto out_unlock;
+        }
+
+        /* Always insert into the newest table */
+        new_tbl = rcu_dereference(tbl->future_tbl);
+        if (!new_tbl)
+            break;
+
+        pthread_spin_unlock(lock);
+        tbl = new_tbl;
+    }
+
+    obj->next = tbl->buckets[hash];
+    rcu_assign_pointer(tbl->buckets[hash], obj);
+    atomic_fetch_add_explicit(&ht->nelems, 1, memory_order_relaxed);
+    grow = rht_grow_above_75(ht, tbl);
+
+out_unlock:
+    pthread_spin_unlock(lock);
+    rcu_read_unlock();
+
+    if (unlikely(grow || rht_resizing(ht)))
+        rhashtable_resize_step(ht);
+
+    return err;
+}
+
+static bool rhashtable_remove_one(
+    struct bucket_table *tbl,
+    struct rhash_head *obj
+) {
+    unsigned int hash = rht_bucket_index(tbl, obj->key);
+    pthread_spinlock_t *lock = rht_bucket_lock(tbl, hash);
+    struct rhash_head **pprev, *he;
+    bool found = false;
+
+    pthread_spin_lock(lock);
+    pprev = &tbl->buckets[hash];
+    for (he = *pprev; !rht_is_a_nulls(he); pprev = &he->next, he = *pprev) {
+        if (he == obj) {
+            rcu_assign_pointer(*pprev, obj->next);
+            found = true;
+            break;
+        }
+    }
+    pthread_spin_unlock(lock);
+
+    return found;
+}
+
+/**
+ * rhashtable_remove - remove object from hash table
+ * @ht: hash table
+ * @obj: pointer to hash head inside object
+ *
+ * Readers may still see @obj until a grace period has elapsed, so it must
+ * only be freed through call_rcu() or after synchronize_rcu().
+ *
+ * Returns 0 on success, -ENOENT if the entry could not be found.
+ */
+int rhashtable_remove(struct rhashtable *ht, struct rhash_head *obj) {
+    struct bucket_table *tbl;
+    bool found = false, shrink = false;
+
+    rcu_read_lock();
+    tbl = rcu_dereference(ht->tbl);
+    while (tbl && !(found = rhashtable_remove_one(tbl, obj)))
+        tbl = rcu_dereference(tbl->future_tbl);
+    if (found) {
+        atomic_fetch_sub_explicit(&ht->nelems, 1, memory_order_relaxed);
+        shrink = rht_shrink_below_30(ht, tbl);
+    }
+    rcu_read_unlock();
+
+    if (!found)
+        return -ENOENT;
+
+    if (unlikely(shrink || rht_resizing(ht)))
+        rhashtable_resize_step(ht);
+
+    return 0;
+}
@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Bounded lock-free ring buffers of pointers
+ */
+
+#include "ring.h"
+
+#include <stdlib.h>
+
+/* Slot arrays start on a cache line, so that no slot straddles two */
+static void *ring_alloc_slots(unsigned long nr, size_t size) {
+    return aligned_alloc(
+        SMP_CACHE_BYTES,
+        (nr * size + SMP_CACHE_BYTES - 1) & ~(size_t) (SMP_CACHE_BYTES - 1)
+    );
+}
+
+/**
+ * spsc_ring_init - set up an empty single-producer single-consumer ring
+ * @ring: ring to initialize
+ * @size: number of slots, a power of two up to 2^31
+ *
+ * Returns 0, -EINVAL for a bad @size, or -ENOMEM.
+ */
+int spsc_ring_init(struct spsc_ring *ring, unsigned int size) {
+    if (!size || size & (size - 1) || size > 1U << 31)
+        return -EINVAL;
+    ring->slots = ring_alloc_slots(size, sizeof(*ring->slots));
+    if (!ring->slots)
+        return -ENOMEM;
+    ring->mask = size - 1;
+    atomic_init(&ring->tail, 0);
+    ring->head_cache = 0;
+    atomic_init(&ring->head, 0);
+    ring->tail_cache = 0;
+    return 0;
+}
+
+void spsc_ring_destroy(struct spsc_ring *ring) {
+    free(ring->slots);
+    ring->slots = NULL;
+}
+
+/**
+ * mpmc_ring_init - set up an empty multi-producer multi-consumer ring
+ * @ring: ring to initialize
+ * @size: number of slots, a power of two
+ *
+ * Returns 0, -EINVAL for a bad @size, or -ENOMEM.
+ */
+int mpmc_ring_init(struct mpmc_ring *ring, unsigned long size) {
+    unsigned long i;
+
+    /* sequence numbers are compared as signed distances */
+    if (!size || size & (size - 1) ||
+        size > (~0UL >> 2) / sizeof(*ring->slots))
+        return -EINVAL;
+    ring->slots = ring_alloc_slots(size, sizeof(*ring->slots));
+    if (!ring->slots)
+        return -ENOMEM;
+    for (i = 0; i < size; i++)
+        atomic_init(&ring->slots[i].seq, i);
+    ring->mask = size - 1;
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->head, 0);
+    return 0;
+}
+
+void mpmc_ring_destroy(struct mpmc_ring *ring) {
+    free(ring->slots);
+    ring->slots = NULL;
+}
@@ -0,0 +1,291 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Fork-join thread pools
+ *
+ * Worker 0 is whichever thread calls thread_pool_run(): it runs the root
+ * task on its own deque, so a pool of n workers starts n - 1 threads.
+ */
+
+#include "thread_pool.h"
+
+#include <errno.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "cache.h"
+#include "ws_deque.h"
+
+struct tp_worker {
+    struct ws_deque deque;
+    struct thread_pool *pool;
+    pthread_t thread;
+    uint64_t seed;
+} ____cacheline_aligned;
+
+/* The worker the calling thread runs as, NULL outside a computation */
+static _Thread_local struct tp_worker *tp_current;
+
+static void tp_execute(struct tp_task *task) {
+    task->func(task);
+    /* release: the joiner sees everything the task did */
+    atomic_store_explicit(&task->done, true, memory_order_release);
+}
+
+/* Try every other worker once, starting from a random one */
+static struct tp_task *tp_steal(struct tp_worker *self) {
+    struct thread_pool *pool = self->pool;
+    unsigned int i, victim, nr = pool->nr_workers;
+    struct tp_task *task;
+
+    /* xorshift64 */
+    self->seed ^= self->seed << 13;
+    self->seed ^= self->seed >> 7;
+    self->seed ^= self->seed << 17;
+    victim = self->seed % nr;
+    for (i = 0; i < nr; i++) {
+        if (&pool->workers[victim] != self) {
+            task = ws_deque_steal(&pool->workers[victim].deque);
+            if (task)
+                return task;
+        }
+        if (++victim == nr)
+            victim = 0;
+    }
+    return NULL;
+}
+
+static void *tp_worker_fn(void *arg) {
+    struct tp_worker *self = arg;
+    struct thread_pool *pool = self->pool;
+    struct tp_task *task;
+
+    tp_current = self;
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        while (!atomic_load_explicit(&pool->active, memory_order_relaxed) &&
+               !pool->stopping)
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        if (pool->stopping) {
+            pthread_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+        pthread_mutex_unlock(&pool->lock);
+
+        while (atomic_load_explicit(&pool->active, memory_order_relaxed)) {
+            task = tp_steal(self);
+            if (task)
+                tp_execute(task);
+            else
+                sched_yield();
+        }
+    }
+}
+
+static void tp_stop_workers(struct thread_pool *pool, unsigned int nr) {
+    unsigned int i;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    for (i = 1; i < nr; i++)
+        pthread_join(pool->workers[i].thread, NULL);
+    for (i = 0; i < pool->nr_workers; i++)
+        ws_deque_destroy(&pool->workers[i].deque);
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_mutex_destroy(&pool->run_lock);
+    free(pool->workers);
+    pool->workers = NULL;
+}
+
+/**
+ * thread_pool_init - start the threads of a pool
+ * @pool: pool to initialize
+ * @nr_threads: number of threads computing, the caller of thread_pool_run()
+ *              included; 0 for one per online CPU
+ *
+ * Returns 0, -ENOMEM, or the negated error of pthread_create().
+ */
+int thread_pool_init(struct thread_pool *pool, unsigned int nr_threads) {
+    long nr_cpus;
+    unsigned int i;
+    int err;
+
+    if (!nr_threads) {
+        nr_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        nr_threads = nr_cpus > 0 ? nr_cpus : 1;
+    }
+    pool->workers =
+        aligned_alloc(SMP_CACHE_BYTES, sizeof(*pool->workers) * nr_threads);
+    if (!pool->workers)
+        return -ENOMEM;
+    for (i = 0; i < nr_threads; i++) {
+        if (ws_deque_init(&pool->workers[i].deque, 64)) {
+            while (i--)
+                ws_deque_destroy(&pool->workers[i].deque);
+            free(pool->workers);
+            return -ENOMEM;
+        }
+        pool->workers[i].pool = pool;
+        pool->workers[i].seed = 0x9e3779b97f4a7c15ULL * (i + 1);
+    }
+    pool->nr_workers = nr_threads;
+    pthread_mutex_init(&pool->run_lock, NULL);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    atomic_init(&pool->active, false);
+    pool->stopping = false;
+
+    for (i = 1; i < nr_threads; i++) {
+        err = pthread_create(
+            &pool->workers[i].thread,
+            NULL,
+            tp_worker_fn,
+            &pool->workers[i]
+        );
+        if (err) {
+            tp_stop_workers(pool, i);
+            return -err;
+        }
+    }
+    return 0;
+}
+
+/* Stop and free @pool; no computation may be running on it */
+void thread_pool_destroy(struct thread_pool *pool) {
+    tp_stop_workers(pool, pool->nr_workers);
+}
+
+/**
+ * thread_pool_run - run a fork-join computation to completion
+ * @pool: pool to run it on, or NULL to run it on the calling thread only
+ * @task: root task, initialized with tp_task_init()
+ *
+ * Returns once @task, and so every task it forked, is done.  Called from
+ * within a task, of any pool, it runs @task right away as part of the
+ * current computation.  Computations from different threads take turns.
+ */
+void thread_pool_run(struct thread_pool *pool, struct tp_task *task) {
+    if (!pool || tp_current) {
+        tp_execute(task);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->run_lock);
+    tp_current = &pool->workers[0];
+    pthread_mutex_lock(&pool->lock);
+    atomic_store_explicit(&pool->active, true, memory_order_relaxed);
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    tp_execute(task);
+
+    /* every task was joined: the deques are empty */
+    atomic_store_explicit(&pool->active, false, memory_order_relaxed);
+    tp_current = NULL;
+    pthread_mutex_unlock(&pool->run_lock);
+}
+
+/**
+ * tp_fork - make @task available to run in parallel with the caller
+ * @task: task initialized with tp_task_init()
+ *
+ * The caller must tp_join() @task before it returns.  Outside a computation,
+ * or if the deque cannot grow, @task runs right away.
+ */
+void tp_fork(struct tp_task *task) {
+    struct tp_worker *self = tp_current;
+
+    if (!self || ws_deque_push(&self->deque, task))
+        tp_execute(task);
+}
+
+/**
+ * tp_join - wait for a forked task, running other tasks meanwhile
+ * @task: task passed to tp_fork() by the caller
+ *
+ * If nobody stole @task, it is the newest task on the caller's deque and
+ * runs right here.
+ */
+void tp_join(struct tp_task *task) {
+    struct tp_worker *self = tp_current;
+    struct tp_task *other;
+
+    while (!atomic_load_explicit(&task->done, memory_order_acquire)) {
+        other = ws_deque_pop(&self->deque);
+        if (!other)
+            other = tp_steal(self);
+        if (other)
+            tp_execute(other);
+        else
+            sched_yield();
+    }
+}
+
+struct tp_for_task {
+    struct tp_task task;
+    size_t begin;
+    size_t end;
+    size_t grain;
+    void (*fn)(size_t begin, size_t end, void *arg);
+    void *arg;
+};
+
+static void tp_for_fn(struct tp_task *task) {
+    struct tp_for_task *t = container_of(task, struct tp_for_task, task);
+    struct tp_for_task left, right;
+    size_t mid;
+
+    if (t->end - t->begin <= t->grain) {
+        t->fn(t->begin, t->end, t->arg);
+        return;
+    }
+    mid = t->begin + (t->end - t->begin) / 2;
+    left = right = *t;
+    left.end = right.begin = mid;
+    tp_task_init(&left.task, tp_for_fn);
+    tp_task_init(&right.task, tp_for_fn);
+    tp_fork(&right.task);
+    tp_for_fn(&left.task);
+    tp_join(&right.task);
+}
+
+/**
+ * thread_pool_for - call @fn on pieces of a range, in parallel
+ * @pool: pool to run on, or NULL
+ * @begin: start of the range
+ * @end: end of the range, excluded
+ * @grain: largest piece passed to @fn, 0 to cut about 8 per worker
+ * @fn: function called on each piece [begin, end)
+ * @arg: passed to @fn
+ *
+ * The range is halved recursively, so that idle workers steal big pieces.
+ */
+void thread_pool_for(
+    struct thread_pool *pool,
+    size_t begin,
+    size_t end,
+    size_t grain,
+    void (*fn)(size_t begin, size_t end, void *arg),
+    void *arg
+) {
+    struct tp_for_task root = {
+        .begin = begin,
+        .end = end,
+        .grain = grain,
+        .fn = fn,
+        .arg = arg,
+    };
+
+    if (begin >= end)
+        return;
+    if (!root.grain)
+        root.grain = (end - begin) / (8 * thread_pool_size(pool));
+    if (!root.grain)
+        root.grain = 1;
+    tp_task_init(&root.task, tp_for_fn);
+    thread_pool_run(pool, &root.task);
+}
@@ -0,0 +1,295 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Hierarchical timer wheels
+ *
+ * A timer is placed relative to wheel->now: at the lowest level whose range
+ * covers its distance, in the slot its expiry falls into.  At level l > 0
+ * that slot is next visited, and cascaded, when now reaches the start of
+ * the slot's span, at which point the timer is less than one level l slot
+ * away and is placed again, lower.  Level 0 slots span a single tick, so
+ * every timer in one expires at the same tick, save for late arrivals whose
+ * expiry had already passed.
+ */
+
+#include "timer_wheel.h"
+
+#include "build_bug.h"
+#include "rbtree.h"
+
+static_assert(
+    TIMER_WHEEL_LEVELS >= 1 && TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS < 64,
+    "TIMER_WHEEL_LEVELS out of range"
+);
+
+static inline bool tw_less(struct rb_node *a, const struct rb_node *b) {
+    return rb_entry(a, struct tw_timer, rb)->expires <
+           rb_entry(b, struct tw_timer, rb)->expires;
+}
+
+/* Slot for a timer expiring at @expires, or TIMER_WHEEL_OVERFLOW */
+static inline uint32_t tw_slot(
+    const struct timer_wheel *wheel,
+    uint64_t expires
+) {
+    uint64_t delta;
+    unsigned int level;
+
+    /* late: fire at the next tick */
+    if (expires < wheel->now)
+        expires = wheel->now;
+    delta = expires - wheel->now;
+    if (delta >= TIMER_WHEEL_RANGE)
+        return TIMER_WHEEL_OVERFLOW;
+
+    level = delta ? (63 - __builtin_clzll(delta)) / TIMER_WHEEL_BITS : 0;
+    return level * TIMER_WHEEL_SIZE +
+           ((expires >> (level * TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK);
+}
+
+static void tw_enqueue(struct timer_wheel *wheel, struct tw_timer *timer) {
+    uint32_t slot = tw_slot(wheel, timer->expires);
+    unsigned int shift = slot / TIMER_WHEEL_SIZE * TIMER_WHEEL_BITS;
+    uint64_t event;
+
+    timer->slot = slot;
+    if (slot == TIMER_WHEEL_OVERFLOW) {
+        rb_add_cached(&timer->rb, &wheel->overflow, tw_less);
+        event = (wheel->now / TIMER_WHEEL_RANGE + 1) * TIMER_WHEEL_RANGE;
+    } else {
+        hlist_add_head(&timer->entry, &wheel->slots[slot]);
+        wheel->pending[slot / TIMER_WHEEL_SIZE] |=
+            UINT64_C(1) << (slot & TIMER_WHEEL_MASK);
+        /* the slot expires or cascades at the start of its span */
+        event = timer->expires > wheel->now ? timer->expires : wheel->now;
+        event = event >> shift << shift;
+    }
+    if (event < wheel->next)
+        wheel->next = event;
+}
+
+/* Take the timers of @slot off the wheel, onto @list */
+static inline void tw_detach(
+    struct timer_wheel *wheel,
+    uint32_t slot,
+    struct hlist_head *list
+) {
+    hlist_move_list(&wheel->slots[slot], list);
+    wheel->pending[slot / TIMER_WHEEL_SIZE] &=
+        ~(UINT64_C(1) << (slot & TIMER_WHEEL_MASK));
+}
+
+/*
+ * Spread the current slot of @level over the levels below.  Returns the
+ * index of that slot; the level above is due as well when it is 0.
+ */
+static unsigned int tw_cascade(struct timer_wheel *wheel, unsigned int level) {
+    unsigned int idx =
+        (wheel->now >> (level * TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK;
+    struct tw_timer *timer;
+    struct hlist_node *n;
+    struct hlist_head list;
+
+    if (!(wheel->pending[level] & (UINT64_C(1) << idx)))
+        return idx;
+
+    tw_detach(wheel, level * TIMER_WHEEL_SIZE + idx, &list);
+    hlist_for_each_entry_safe(timer, n, &list, entry)
+        tw_enqueue(wheel, timer);
+    return idx;
+}
+
+/* The top level wrapped: move the timers now in range into the wheel */
+static void tw_refill(struct timer_wheel *wheel) {
+    struct tw_timer *timer;
+    struct rb_node *rb;
+
+    while ((rb = rb_first_cached(&wheel->overflow))) {
+        timer = rb_entry(rb, struct tw_timer, rb);
+        if (timer->expires - wheel->now >= TIMER_WHEEL_RANGE)
+            break;
+        rb_erase_cached(rb, &wheel->overflow);
+        tw_enqueue(wheel, timer);
+    }
+}
+
+/*
+ * First tick from now on at which a level 0 slot expires or a non-empty
+ * slot is cascaded, UINT64_MAX if the wheel is empty.  Ticks before it need
+ * not be visited at all.
+ */
+static uint64_t tw_next_event(const struct timer_wheel *wheel) {
+    uint64_t next = UINT64_MAX, pos, bits, event;
+    unsigned int level, shift, rot;
+
+    for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        if (!wheel->pending[level])
+            continue;
+        /* the first slot whose span starts from now on, going round */
+        shift = level * TIMER_WHEEL_BITS;
+        pos = (wheel->now + (UINT64_C(1) << shift) - 1) >> shift;
+        rot = pos & TIMER_WHEEL_MASK;
+        bits = wheel->pending[level];
+        if (rot)
+            bits = bits >> rot | bits << (64 - rot);
+        event = (pos + __builtin_ctzll(bits)) << shift;
+        if (event < next)
+            next = event;
+    }
+
+    if (!RB_EMPTY_ROOT(&wheel->overflow.rb_root)) {
+        pos = (wheel->now + TIMER_WHEEL_RANGE - 1) / TIMER_WHEEL_RANGE *
+              TIMER_WHEEL_RANGE;
+        if (pos < next)
+            next = pos;
+    }
+    return next;
+}
+
+/**
+ * timer_wheel_init - initialize an empty wheel
+ * @wheel: wheel to initialize
+ * @now: current tick
+ */
+void timer_wheel_init(struct timer_wheel *wheel, uint64_t now) {
+    unsigned int i;
+
+    wheel->now = now;
+    wheel->next = UINT64_MAX;
+    wheel->nr = 0;
+    for (i = 0; i < TIMER_WHEEL_LEVELS; i++)
+        wheel->pending[i] = 0;
+    for (i = 0; i < TIMER_WHEEL_SLOTS; i++)
+        INIT_HLIST_HEAD(&wheel->slots[i]);
+    wheel->overflow = RB_ROOT_CACHED;
+}
+
+/**
+ * timer_wheel_add - arm a timer
+ * @wheel: wheel to add to
+ * @timer: timer to arm, which must not be pending
+ * @expires: tick to fire at
+ *
+ * A timer whose expiry has already passed fires at the next
+ * timer_wheel_advance().  O(1) unless @expires is beyond
+ * TIMER_WHEEL_RANGE ticks from now.
+ */
+void timer_wheel_add(
+    struct timer_wheel *wheel,
+    struct tw_timer *timer,
+    uint64_t expires
+) {
+    timer->expires = expires;
+    tw_enqueue(wheel, timer);
+    wheel->nr++;
+}
+
+/**
+ * timer_wheel_del - cancel a timer
+ * @wheel: wheel @timer was added to
+ * @timer: timer to cancel
+ *
+ * May be called from the expiry callback, for any timer.  Returns whether
+ * @timer was pending.
+ */
+bool timer_wheel_del(struct timer_wheel *wheel, struct tw_timer *timer) {
+    uint32_t slot = timer->slot;
+
+    if (slot == TIMER_WHEEL_IDLE)
+        return false;
+
+    if (slot == TIMER_WHEEL_OVERFLOW) {
+        rb_erase_cached(&timer->rb, &wheel->overflow);
+    } else {
+        __hlist_del(&timer->entry);
+        if (hlist_empty(&wheel->slots[slot]))
+            wheel->pending[slot / TIMER_WHEEL_SIZE] &=
+                ~(UINT64_C(1) << (slot & TIMER_WHEEL_MASK));
+    }
+    timer->slot = TIMER_WHEEL_IDLE;
+    wheel->nr--;
+    return true;
+}
+
+/**
+ * timer_wheel_mod - re-arm a timer, pending or not
+ * @wheel: wheel to add to
+ * @timer: timer to re-arm
+ * @expires: new tick to fire at
+ *
+ * A timer that stays in the same slot is not moved at all.  Returns whether
+ * @timer was pending.
+ */
+bool timer_wheel_mod(
+    struct timer_wheel *wheel,
+    struct tw_timer *timer,
+    uint64_t expires
+) {
+    uint32_t slot = tw_slot(wheel, expires);
+
+    /*
+     * Not at level 0, where the slot may be the one being expired, and the
+     * timer would fire with its old expiry.
+     */
+    if (slot == timer->slot && slot >= TIMER_WHEEL_SIZE &&
+        slot != TIMER_WHEEL_OVERFLOW) {
+        timer->expires = expires;
+        return true;
+    }
+    if (timer_wheel_del(wheel, timer)) {
+        timer_wheel_add(wheel, timer, expires);
+        return true;
+    }
+    timer_wheel_add(wheel, timer, expires);
+    return false;
+}
+
+/* Out of line part of timer_wheel_advance(), once something is due */
+unsigned long __timer_wheel_advance(
+    struct timer_wheel *wheel,
+    uint64_t now,
+    tw_fn_t fn,
+    void *priv
+) {
+    unsigned long fired = 0;
+    struct tw_timer *timer;
+    struct hlist_head list;
+    unsigned int idx, level;
+
+    while (wheel->next <= now) {
+        wheel->now = wheel->next;
+        idx = wheel->now & TIMER_WHEEL_MASK;
+        if (!idx) {
+            for (level = 1; level < TIMER_WHEEL_LEVELS; level++)
+                if (tw_cascade(wheel, level))
+                    break;
+            if (level == TIMER_WHEEL_LEVELS)
+                tw_refill(wheel);
+        }
+
+        /*
+         * Expire the whole slot, which @fn may cancel from.  The wheel stays
+         * at this tick meanwhile, so that a timer @fn arms for it, or for
+         * earlier, lands back in the slot and fires in this round too.
+         */
+        tw_detach(wheel, idx, &list);
+        for (;;) {
+            while (list.first) {
+                timer = hlist_entry(list.first, struct tw_timer, entry);
+                __hlist_del(&timer->entry);
+                timer->slot = TIMER_WHEEL_IDLE;
+                wheel->nr--;
+                fired++;
+                fn(timer, priv);
+            }
+            if (!(wheel->pending[0] & (UINT64_C(1) << idx)))
+                break;
+            tw_detach(wheel, idx, &list);
+        }
+        wheel->now++;
+        wheel->next = tw_next_event(wheel);
+    }
+
+    if (wheel->now <= now)
+        wheel->now = now + 1;
+    return fired;
+}
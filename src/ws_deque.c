@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Chase-Lev work-stealing deques
+ */
+
+#include "ws_deque.h"
+
+#include <stdlib.h>
+
+static struct ws_deque_array *ws_deque_alloc(long size) {
+    struct ws_deque_array *array;
+
+    array = malloc(sizeof(*array) + sizeof(array->slots[0]) * size);
+    if (!array)
+        return NULL;
+    array->retired = NULL;
+    array->mask = size - 1;
+    return array;
+}
+
+/**
+ * ws_deque_init - set up an empty deque
+ * @deque: deque to initialize
+ * @size: initial number of slots, rounded up to a power of two
+ *
+ * Returns 0, or -ENOMEM.
+ */
+int ws_deque_init(struct ws_deque *deque, unsigned int size) {
+    struct ws_deque_array *array;
+    long nr = 16;
+
+    while (nr < size)
+        nr <<= 1;
+    array = ws_deque_alloc(nr);
+    if (!array)
+        return -ENOMEM;
+    atomic_init(&deque->top, 0);
+    atomic_init(&deque->bottom, 0);
+    atomic_init(&deque->array, array);
+    return 0;
+}
+
+/* Free @deque's arrays; no thread may be using it any more */
+void ws_deque_destroy(struct ws_deque *deque) {
+    struct ws_deque_array *array, *retired;
+
+    array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+    while (array) {
+        retired = array->retired;
+        free(array);
+        array = retired;
+    }
+    atomic_store_explicit(&deque->array, NULL, memory_order_relaxed);
+}
+
+/*
+ * Called by the owner on a full deque: copy the items from @top to @bottom
+ * into an array twice as large.  The old one stays readable, for thieves
+ * that loaded it before the switch, until the deque is destroyed.
+ */
+int __ws_deque_grow(struct ws_deque *deque, long top, long bottom) {
+    struct ws_deque_array *old, *array;
+    void *item;
+    long i;
+
+    old = atomic_load_explicit(&deque->array, memory_order_relaxed);
+    if (old->mask > (long) (~0UL >> 2) / (long) sizeof(old->slots[0]))
+        return -ENOMEM;
+    array = ws_deque_alloc((old->mask + 1) * 2);
+    if (!array)
+        return -ENOMEM;
+    for (i = top; i < bottom; i++) {
+        item = atomic_load_explicit(
+            &old->slots[i & old->mask],
+            memory_order_relaxed
+        );
+        atomic_store_explicit(
+            &array->slots[i & array->mask],
+            item,
+            memory_order_relaxed
+        );
+    }
+    array->retired = old;
+    /* release: a thief that loads the new array sees its slots */
+    atomic_store_explicit(&deque->array, array, memory_order_release);
+    return 0;
+}
@@ -0,0 +1,203 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "bptree.h"
+#include "unity.h"
+
+void setUp(void) {
+    // set stuff up here
+}
+
+void tearDown(void) {
+    // clean stuff up here
+}
+
+#define NR_KEYS 20000
+#define KEY_SPACE (4 * NR_KEYS)
+
+/* present[k] tells whether key k is in the tree, its value is &present[k] */
+static bool present[KEY_SPACE];
+
+static void *val_of(uint64_t key) {
+    return &present[key];
+}
+
+/*
+ * Check the shape of the subtree at @node: fill, key order, the bounds of
+ * inner nodes, and that the leaves are linked in order.  Returns the
+ * number of keys below @node.
+ */
+static unsigned long check_node(
+    struct bptree_node *node,
+    bool is_root,
+    uint64_t lo,
+    uint64_t hi,
+    struct bptree_node **leaf
+) {
+    unsigned long count = 0;
+    unsigned int i;
+
+    TEST_ASSERT_TRUE(node->nr <= BPTREE_SLOTS);
+    TEST_ASSERT_TRUE(node->nr >= (is_root ? 1 : BPTREE_MIN_SLOTS));
+    for (i = 1; i < node->nr; i++)
+        TEST_ASSERT_TRUE(node->keys[i - 1] < node->keys[i]);
+
+    if (!node->level) {
+        TEST_ASSERT_EQUAL_PTR(*leaf, node);
+        *leaf = node->next;
+        for (i = 0; i < node->nr; i++) {
+            TEST_ASSERT_TRUE(lo <= node->keys[i] && node->keys[i] < hi);
+            TEST_ASSERT_EQUAL_PTR(val_of(node->keys[i]), node->slots[i]);
+        }
+        return node->nr;
+    }
+
+    for (i = 0; i < node->nr; i++) {
+        struct bptree_node *child = node->slots[i];
+        uint64_t clo = i ? node->keys[i] : lo;
+        uint64_t chi = i + 1 < node->nr ? node->keys[i + 1] : hi;
+
+        TEST_ASSERT_EQUAL_UINT(node->level - 1, child->level);
+        count += check_node(child, false, clo, chi, leaf);
+    }
+    return count;
+}
+
+static void check_tree(struct bptree *tree) {
+    struct bptree_node *leaf = tree->root;
+    unsigned long nr = 0;
+    uint64_t k;
+
+    while (leaf && leaf->level)
+        leaf = leaf->slots[0];
+    if (tree->root) {
+        TEST_ASSERT_EQUAL_UINT(
+            bptree_count(tree),
+            check_node(tree->root, true, 0, UINT64_MAX, &leaf)
+        );
+        TEST_ASSERT_NULL(leaf);
+    }
+
+    for (k = 0; k < KEY_SPACE; k++) {
+        TEST_ASSERT_EQUAL_PTR(
+            present[k] ? val_of(k) : NULL,
+            bptree_find(tree, k)
+        );
+        nr += present[k];
+    }
+    TEST_ASSERT_EQUAL_UINT(nr, bptree_count(tree));
+    TEST_ASSERT_EQUAL(!nr, bptree_empty(tree));
+}
+
+void test_bptree_insert_remove(void) {
+    struct bptree tree = BPTREE_INIT;
+    uint64_t key;
+    int i, ret;
+
+    srand(1);
+    for (i = 0; i < NR_KEYS; i++) {
+        key = rand() % KEY_SPACE;
+        ret = bptree_insert(&tree, key, val_of(key));
+        TEST_ASSERT_EQUAL_INT(present[key] ? -EEXIST : 0, ret);
+        present[key] = true;
+    }
+    TEST_ASSERT_EQUAL_INT(-EINVAL, bptree_insert(&tree, KEY_SPACE, NULL));
+    check_tree(&tree);
+
+    for (i = 0; i < NR_KEYS; i++) {
+        key = rand() % KEY_SPACE;
+        TEST_ASSERT_EQUAL_PTR(
+            present[key] ? val_of(key) : NULL,
+            bptree_remove(&tree, key)
+        );
+        present[key] = false;
+    }
+    check_tree(&tree);
+
+    /* ascending and descending runs split and merge at the edges */
+    for (key = 0; key < KEY_SPACE; key++)
+        if (!present[key])
+            TEST_ASSERT_EQUAL_INT(0, bptree_insert(&tree, key, val_of(key)));
+    for (key = 0; key < KEY_SPACE; key++)
+        present[key] = true;
+    check_tree(&tree);
+
+    for (key = KEY_SPACE; key-- > 0;) {
+        if (key % 3)
+            continue;
+        TEST_ASSERT_EQUAL_PTR(val_of(key), bptree_remove(&tree, key));
+        present[key] = false;
+    }
+    check_tree(&tree);
+
+    for (key = 0; key < KEY_SPACE; key++) {
+        if (!present[key])
+            continue;
+        TEST_ASSERT_EQUAL_PTR(val_of(key), bptree_remove(&tree, key));
+        present[key] = false;
+    }
+    check_tree(&tree);
+    TEST_ASSERT_NULL(tree.root);
+
+    bptree_destroy(&tree);
+}
+
+void test_bptree_iterate(void) {
+    struct bptree tree = BPTREE_INIT;
+    struct bptree_iter iter;
+    uint64_t key, lo, hi, expect;
+    int i;
+
+    TEST_ASSERT_FALSE(bptree_iter_seek(&iter, &tree, 0));
+    bptree_for_each(&iter, &tree)
+        TEST_FAIL();
+
+    for (key = 0; key < KEY_SPACE; key++)
+        present[key] = false;
+    for (key = 0; key < KEY_SPACE; key += 3) {
+        TEST_ASSERT_EQUAL_INT(0, bptree_insert(&tree, key, val_of(key)));
+        present[key] = true;
+    }
+    /* extreme keys exercise the unsigned compares of the SIMD search */
+    TEST_ASSERT_EQUAL_INT(0, bptree_insert(&tree, UINT64_MAX, val_of(0)));
+    TEST_ASSERT_EQUAL_INT(0, bptree_insert(&tree, 1ULL << 63, val_of(0)));
+    TEST_ASSERT_EQUAL_PTR(val_of(0), bptree_find(&tree, UINT64_MAX));
+    TEST_ASSERT_EQUAL_PTR(val_of(0), bptree_find(&tree, 1ULL << 63));
+    TEST_ASSERT_NULL(bptree_find(&tree, (1ULL << 63) - 1));
+
+    expect = 0;
+    bptree_for_each(&iter, &tree) {
+        if (expect >= KEY_SPACE)
+            break;
+        TEST_ASSERT_EQUAL_UINT64(expect, bptree_iter_key(&iter));
+        TEST_ASSERT_EQUAL_PTR(val_of(expect), bptree_iter_val(&iter));
+        expect += 3;
+    }
+    TEST_ASSERT_EQUAL_UINT64(1ULL << 63, bptree_iter_key(&iter));
+    TEST_ASSERT_TRUE(bptree_iter_next(&iter));
+    TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, bptree_iter_key(&iter));
+    TEST_ASSERT_FALSE(bptree_iter_next(&iter));
+
+    srand(2);
+    for (i = 0; i < 1000; i++) {
+        lo = rand() % (KEY_SPACE + 10);
+        hi = lo + rand() % 100;
+        expect = (lo + 2) / 3 * 3;
+        bptree_for_each_range(&iter, &tree, lo, hi) {
+            TEST_ASSERT_EQUAL_UINT64(expect, bptree_iter_key(&iter));
+            expect += 3;
+        }
+        TEST_ASSERT_TRUE(expect >= hi || expect >= KEY_SPACE);
+    }
+
+    bptree_destroy(&tree);
+    TEST_ASSERT_TRUE(bptree_empty(&tree));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_bptree_insert_remove);
+    RUN_TEST(test_bptree_iterate);
+    return UNITY_END();
+}
@@ -0,0 +1,175 @@
+#include <stdlib.h>
+
+#include "dhashtable.h"
+#include "unity.h"
+
+void setUp(void) {
+    // set stuff up here
+}
+
+void tearDown(void) {
+    // clean stuff up here
+}
+
+#define NR_OBJS 10000
+
+struct object {
+    struct dhash_node hnode;
+    int val;
+};
+
+static struct object *find(struct dhashtable *ht, uint64_t key) {
+    struct object *obj;
+
+    dhash_for_each_possible(ht, obj, hnode, key) {
+        if (obj->hnode.key == key)
+            return obj;
+    }
+    return NULL;
+}
+
+static unsigned long count_all(struct dhashtable *ht) {
+    struct object *obj;
+    unsigned long bkt, count = 0;
+
+    dhash_for_each(ht, bkt, obj, hnode) count++;
+
+    return count;
+}
+
+void test_dhash_grow_shrink(void) {
+    struct dhashtable ht;
+    struct object *objs = calloc(NR_OBJS, sizeof(*objs));
+    int i, j;
+
+    TEST_ASSERT_NOT_NULL(objs);
+    TEST_ASSERT_EQUAL_INT(0, dhash_init(&ht, 2));
+    TEST_ASSERT_TRUE(dhash_empty(&ht));
+
+    for (i = 0; i < NR_OBJS; i++) {
+        objs[i].val = i;
+        dhash_add(&ht, &objs[i].hnode, (uint64_t) i * 7919);
+
+        /* everything added so far must stay reachable mid-resize */
+        if (i % 997 == 0)
+            for (j = 0; j <= i; j++)
+                TEST_ASSERT_EQUAL_PTR(&objs[j], find(&ht, (uint64_t) j * 7919));
+    }
+    TEST_ASSERT_EQUAL_UINT(NR_OBJS, dhash_count(&ht));
+    TEST_ASSERT_EQUAL_UINT(NR_OBJS, count_all(&ht));
+
+    dhash_rehash_finish(&ht);
+    TEST_ASSERT_FALSE(dhash_rehashing(&ht));
+    TEST_ASSERT_GREATER_OR_EQUAL(NR_OBJS, 1UL << ht.tbl[0].bits);
+
+    for (i = 0; i < NR_OBJS; i++) {
+        TEST_ASSERT_EQUAL_PTR(
+            &objs[i].hnode,
+            dhash_find(&ht, (uint64_t) i * 7919)
+        );
+        TEST_ASSERT_NULL(dhash_find(&ht, (uint64_t) i * 7919 + 1));
+    }
+
+    for (i = 0; i < NR_OBJS - 10; i++) {
+        dhash_del(&ht, &objs[i].hnode);
+        TEST_ASSERT_FALSE(dhash_hashed(&objs[i].hnode));
+    }
+    for (i = NR_OBJS - 10; i < NR_OBJS; i++)
+        TEST_ASSERT_EQUAL_PTR(&objs[i], find(&ht, (uint64_t) i * 7919));
+
+    dhash_rehash_finish(&ht);
+    TEST_ASSERT_EQUAL_UINT(10, count_all(&ht));
+    TEST_ASSERT_LESS_OR_EQUAL(NR_OBJS / 64, 1UL << ht.tbl[0].bits);
+
+    dhash_destroy(&ht);
+    free(objs);
+}
+
+void test_dhash_for_each_safe(void) {
+    struct dhashtable ht;
+    struct object *objs = calloc(NR_OBJS, sizeof(*objs));
+    struct object *obj;
+    struct hlist_node *tmp;
+    unsigned long bkt;
+    int i;
+
+    TEST_ASSERT_NOT_NULL(objs);
+    TEST_ASSERT_EQUAL_INT(0, dhash_init(&ht, 4));
+
+    /* stop mid-resize so iteration has to cover both tables */
+    for (i = 0; i < NR_OBJS; i++)
+        dhash_add(&ht, &objs[i].hnode, i);
+    TEST_ASSERT_EQUAL_UINT(NR_OBJS, count_all(&ht));
+
+    dhash_for_each_safe(&ht, bkt, tmp, obj, hnode) {
+        __dhash_del(&ht, &obj->hnode);
+    }
+
+    TEST_ASSERT_TRUE(dhash_empty(&ht));
+    TEST_ASSERT_EQUAL_UINT(0, count_all(&ht));
+
+    dhash_destroy(&ht);
+    free(objs);
+}
+
+#define NR_BATCH (2 * NR_OBJS + 1)
+
+static void check_find_batch(
+    struct dhashtable *ht,
+    const uint64_t *keys,
+    int nr,
+    struct dhash_node **out
+) {
+    int i;
+
+    dhash_find_batch(ht, keys, nr, out);
+    for (i = 0; i < nr; i++)
+        TEST_ASSERT_EQUAL_PTR(dhash_find(ht, keys[i]), out[i]);
+}
+
+void test_dhash_find_batch(void) {
+    struct dhashtable ht;
+    struct object *objs = calloc(NR_OBJS, sizeof(*objs));
+    struct dhash_node **out = calloc(NR_BATCH, sizeof(*out));
+    uint64_t *keys = calloc(NR_BATCH, sizeof(*keys));
+    bool checked = false;
+    int i;
+
+    TEST_ASSERT_NOT_NULL(objs);
+    TEST_ASSERT_NOT_NULL(out);
+    TEST_ASSERT_NOT_NULL(keys);
+    TEST_ASSERT_EQUAL_INT(0, dhash_init(&ht, 2));
+
+    /* hits and misses interleaved, and a batch that does not divide evenly */
+    for (i = 0; i < NR_BATCH; i++)
+        keys[i] = (uint64_t) (i / 2) * 7919 + (i & 1);
+
+    /* every key twice, so that some chains hold duplicates */
+    for (i = 0; i < NR_OBJS; i++) {
+        dhash_add(&ht, &objs[i].hnode, (uint64_t) (i / 2) * 7919);
+        if (!checked && i > NR_OBJS / 4 && dhash_rehashing(&ht)) {
+            check_find_batch(&ht, keys, NR_BATCH, out);
+            checked = true;
+        }
+    }
+    TEST_ASSERT_TRUE(checked);
+
+    dhash_rehash_finish(&ht);
+    check_find_batch(&ht, keys, NR_BATCH, out);
+    /* fewer keys than lookups kept in flight */
+    check_find_batch(&ht, keys, DHASH_FIND_BATCH / 2 + 1, out);
+    dhash_find_batch(&ht, keys, 0, out);
+
+    dhash_destroy(&ht);
+    free(keys);
+    free(out);
+    free(objs);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_dhash_grow_shrink);
+    RUN_TEST(test_dhash_for_each_safe);
+    RUN_TEST(test_dhash_find_batch);
+    return UNITY_END();
+}
@@ -0,0 +1,303 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "dheap.h"
+#include "pairing_heap.h"
+#include "unity.h"
+
+void setUp(void) {
+    // set stuff up here
+}
+
+void tearDown(void) {
+    // clean stuff up here
+}
+
+#define NR_ITEMS 2000
+#define NR_OPS 50000
+
+struct item {
+    uint64_t key;
+    bool queued;
+    struct list_head list;
+    struct pheap_node ph;
+    struct dheap_node dh;
+};
+
+static struct item items[NR_ITEMS];
+
+static bool ph_less(struct pheap_node *a, const struct pheap_node *b) {
+    return pheap_entry(a, struct item, ph)->key <
+           pheap_entry(b, struct item, ph)->key;
+}
+
+static bool dh_less(struct dheap_node *a, const struct dheap_node *b) {
+    return dheap_entry(a, struct item, dh)->key <
+           dheap_entry(b, struct item, dh)->key;
+}
+
+static void init_items(void) {
+    int i;
+
+    for (i = 0; i < NR_ITEMS; i++) {
+        items[i].key = rand() % 1000;
+        items[i].queued = false;
+    }
+}
+
+/* Smallest key of the queued items, UINT64_MAX if none */
+static uint64_t min_key(void) {
+    uint64_t min = UINT64_MAX;
+    int i;
+
+    for (i = 0; i < NR_ITEMS; i++)
+        if (items[i].queued && items[i].key < min)
+            min = items[i].key;
+    return min;
+}
+
+static unsigned int nr_queued(void) {
+    unsigned int nr = 0;
+    int i;
+
+    for (i = 0; i < NR_ITEMS; i++)
+        nr += items[i].queued;
+    return nr;
+}
+
+/* Returns the number of nodes below and including @node */
+static unsigned int pheap_check_node(const struct pheap_node *node) {
+    const struct pheap_node *child, *prev = node;
+    unsigned int nr = 1;
+
+    for (child = node->child; child; child = child->next) {
+        TEST_ASSERT_EQUAL_PTR(prev, child->prev);
+        TEST_ASSERT_FALSE(ph_less((struct pheap_node *) child, node));
+        nr += pheap_check_node(child);
+        prev = child;
+    }
+    return nr;
+}
+
+static void pheap_check(const struct pheap_root *root) {
+    unsigned int nr = 0;
+
+    if (root->node) {
+        TEST_ASSERT_NULL(root->node->next);
+        TEST_ASSERT_NULL(root->node->prev);
+        nr = pheap_check_node(root->node);
+        TEST_ASSERT_EQUAL_UINT64(
+            min_key(),
+            pheap_entry(root->node, struct item, ph)->key
+        );
+    }
+    TEST_ASSERT_EQUAL_UINT(nr_queued(), nr);
+}
+
+static void dheap_check(const struct dheap *heap) {
+    unsigned int i;
+
+    TEST_ASSERT_EQUAL_UINT(nr_queued(), dheap_count(heap));
+    /* every group of children starts where the first one does */
+    if (heap->nodes)
+        TEST_ASSERT_EQUAL_UINT(
+            0,
+            (uintptr_t) &heap->nodes[1] % (DHEAP_ARITY * sizeof(void *))
+        );
+    for (i = 0; i < heap->nr; i++) {
+        TEST_ASSERT_EQUAL_UINT(i, heap->nodes[i]->idx);
+        TEST_ASSERT_TRUE(dheap_entry(heap->nodes[i], struct item, dh)->queued);
+        if (i)
+            TEST_ASSERT_FALSE(dh_less(
+                heap->nodes[i],
+                heap->nodes[(i - 1) / DHEAP_ARITY]
+            ));
+    }
+}
+
+void test_pairing_heap(void) {
+    struct pheap_root root = PHEAP_ROOT, other = PHEAP_ROOT;
+    struct pheap_node *node;
+    struct item *item;
+    int i, j;
+
+    srand(42);
+    init_items();
+    TEST_ASSERT_NULL(pheap_pop(&root, ph_less));
+
+    for (i = 0; i < NR_OPS; i++) {
+        item = &items[rand() % NR_ITEMS];
+        switch (rand() % 6) {
+        case 0:
+        case 1:
+            if (item->queued)
+                break;
+            item->key = rand() % 1000;
+            pheap_add(&item->ph, &root, ph_less);
+            item->queued = true;
+            break;
+        case 2:
+            node = pheap_pop(&root, ph_less);
+            if (!node)
+                break;
+            item = pheap_entry(node, struct item, ph);
+            TEST_ASSERT_TRUE(item->queued);
+            item->queued = false;
+            TEST_ASSERT_TRUE(item->key <= min_key());
+            break;
+        case 3:
+            if (!item->queued || !item->key)
+                break;
+            item->key -= rand() % item->key + 1;
+            pheap_decrease(&item->ph, &root, ph_less);
+            break;
+        case 4:
+            if (!item->queued)
+                break;
+            item->key = rand() % 1000;
+            pheap_update(&item->ph, &root, ph_less);
+            break;
+        default:
+            if (!item->queued)
+                break;
+            pheap_del(&item->ph, &root, ph_less);
+            item->queued = false;
+            break;
+        }
+        if (i % 101 == 0)
+            pheap_check(&root);
+    }
+    pheap_check(&root);
+
+    /* meld in a second heap of the remaining items */
+    for (j = 0; j < NR_ITEMS; j++) {
+        if (!items[j].queued) {
+            pheap_add(&items[j].ph, &other, ph_less);
+            items[j].queued = true;
+        }
+    }
+    pheap_meld(&root, &other, ph_less);
+    TEST_ASSERT_TRUE(PHEAP_EMPTY_ROOT(&other));
+    pheap_check(&root);
+
+    for (j = 0; j < NR_ITEMS; j++) {
+        item = pheap_entry_safe(pheap_pop(&root, ph_less), struct item, ph);
+        TEST_ASSERT_NOT_NULL(item);
+        TEST_ASSERT_EQUAL_UINT64(min_key(), item->key);
+        item->queued = false;
+    }
+    TEST_ASSERT_TRUE(PHEAP_EMPTY_ROOT(&root));
+}
+
+void test_dheap(void) {
+    struct dheap heap = DHEAP_INIT;
+    struct dheap_node *node;
+    struct item *item;
+    int i;
+
+    srand(4242);
+    init_items();
+    TEST_ASSERT_NULL(dheap_pop(&heap, dh_less));
+
+    for (i = 0; i < NR_OPS; i++) {
+        item = &items[rand() % NR_ITEMS];
+        switch (rand() % 6) {
+        case 0:
+        case 1:
+            if (item->queued)
+                break;
+            item->key = rand() % 1000;
+            TEST_ASSERT_EQUAL_INT(0, dheap_push(&heap, &item->dh, dh_less));
+            item->queued = true;
+            break;
+        case 2:
+            node = dheap_pop(&heap, dh_less);
+            if (!node)
+                break;
+            item = dheap_entry(node, struct item, dh);
+            TEST_ASSERT_TRUE(item->queued);
+            item->queued = false;
+            TEST_ASSERT_TRUE(item->key <= min_key());
+            break;
+        case 3:
+            if (!item->queued || !item->key)
+                break;
+            item->key -= rand() % item->key + 1;
+            dheap_decrease(&heap, &item->dh, dh_less);
+            break;
+        case 4:
+            if (!item->queued)
+                break;
+            item->key = rand() % 1000;
+            dheap_update(&heap, &item->dh, dh_less);
+            break;
+        default:
+            if (!item->queued)
+                break;
+            dheap_del(&heap, &item->dh, dh_less);
+            item->queued = false;
+            break;
+        }
+        if (i % 101 == 0)
+            dheap_check(&heap);
+    }
+    dheap_check(&heap);
+
+    while ((node = dheap_pop(&heap, dh_less))) {
+        item = dheap_entry(node, struct item, dh);
+        TEST_ASSERT_EQUAL_UINT64(min_key(), item->key);
+        item->queued = false;
+    }
+    TEST_ASSERT_EQUAL_UINT(0, nr_queued());
+    dheap_destroy(&heap);
+}
+
+void test_heap_build_list(void) {
+    struct pheap_root root = PHEAP_ROOT;
+    struct dheap heap = DHEAP_INIT;
+    struct pheap_node *node;
+    struct item *item;
+    LIST_HEAD(list);
+    int i, nr;
+
+    srand(7);
+    init_items();
+    for (nr = 0; nr <= NR_ITEMS; nr = nr ? nr * 3 : 1) {
+        INIT_LIST_HEAD(&list);
+        for (i = 0; i < nr; i++) {
+            list_add_tail(&items[i].list, &list);
+            items[i].queued = true;
+        }
+
+        pheap_build_list(&list, &root, struct item, list, ph, ph_less);
+        pheap_check(&root);
+        TEST_ASSERT_EQUAL_INT(
+            0,
+            dheap_heapify_list(&heap, &list, struct item, list, dh, dh_less)
+        );
+        dheap_check(&heap);
+
+        /* both pop every item in order */
+        for (i = 0; i < nr; i++) {
+            node = pheap_pop(&root, ph_less);
+            item = pheap_entry(node, struct item, ph);
+            TEST_ASSERT_EQUAL_UINT64(min_key(), item->key);
+            TEST_ASSERT_EQUAL_UINT64(
+                item->key,
+                dheap_entry(dheap_pop(&heap, dh_less), struct item, dh)->key
+            );
+            item->queued = false;
+        }
+        TEST_ASSERT_TRUE(PHEAP_EMPTY_ROOT(&root));
+        TEST_ASSERT_EQUAL_UINT(0, dheap_count(&heap));
+    }
+    dheap_destroy(&heap);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_pairing_heap);
+    RUN_TEST(test_dheap);
+    RUN_TEST(test_heap_build_list);
+    return UNITY_END();
+}
@@ -0,0 +1,184 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "interval_tree.h"
+#include "interval_tree_generic.h"
+#include "unity.h"
+
+void setUp(void) {
+    // set stuff up here
+}
+
+void tearDown(void) {
+    // clean stuff up here
+}
+
+#define NR_NODES 1000
+#define NR_QUERIES 1000
+#define MAX_ENDPOINT 10000
+
+static struct interval_tree_node nodes[NR_NODES];
+static unsigned long queries[NR_QUERIES][2];
+
+static void init_nodes(void) {
+    int i;
+
+    srand(42);
+    for (i = 0; i < NR_NODES; i++) {
+        unsigned long a = rand() % MAX_ENDPOINT, b = rand() % MAX_ENDPOINT;
+
+        nodes[i].start = a < b ? a : b;
+        nodes[i].last = a < b ? b : a;
+    }
+    for (i = 0; i < NR_QUERIES; i++) {
+        unsigned long a = rand() % MAX_ENDPOINT, b = rand() % MAX_ENDPOINT;
+
+        queries[i][0] = a < b ? a : b;
+        queries[i][1] = a < b ? b : a;
+    }
+}
+
+static int brute_count(unsigned long start, unsigned long last, int nr) {
+    int i, count = 0;
+
+    for (i = 0; i < nr; i++)
+        if (nodes[i].start <= last && start <= nodes[i].last)
+            count++;
+    return count;
+}
+
+/* count matches, checking they overlap and come in ascending start order */
+static int tree_count(
+    struct rb_root_cached *root,
+    unsigned long start,
+    unsigned long last
+) {
+    struct interval_tree_node *node;
+    unsigned long prev_start = 0;
+    int count = 0;
+
+    interval_tree_for_each_overlap(node, root, start, last) {
+        TEST_ASSERT_TRUE(node->start <= last && start <= node->last);
+        TEST_ASSERT_TRUE(prev_start <= node->start);
+        prev_start = node->start;
+        count++;
+    }
+    return count;
+}
+
+void test_interval_tree_query(void) {
+    struct rb_root_cached root = RB_ROOT_CACHED;
+    int i;
+
+    init_nodes();
+    TEST_ASSERT_NULL(interval_tree_iter_first(&root, 0, MAX_ENDPOINT));
+
+    for (i = 0; i < NR_NODES; i++)
+        interval_tree_insert(&nodes[i], &root);
+
+    for (i = 0; i < NR_QUERIES; i++) {
+        unsigned long start = queries[i][0], last = queries[i][1];
+
+        TEST_ASSERT_EQUAL_INT(
+            brute_count(start, last, NR_NODES),
+            tree_count(&root, start, last)
+        );
+        /* stabbing query */
+        TEST_ASSERT_EQUAL_INT(
+            brute_count(start, start, NR_NODES),
+            tree_count(&root, start, start)
+        );
+    }
+
+    /* ranges outside of every interval hit the O(1) fast path */
+    TEST_ASSERT_NULL(
+        interval_tree_iter_first(&root, MAX_ENDPOINT, 2 * MAX_ENDPOINT)
+    );
+}
+
+void test_interval_tree_remove(void) {
+    struct rb_root_cached root = RB_ROOT_CACHED;
+    int i, j;
+
+    init_nodes();
+    for (i = 0; i < NR_NODES; i++)
+        interval_tree_insert(&nodes[i], &root);
+
+    /* remove from the back so nodes[0..i) stay in the tree */
+    for (i = NR_NODES; i > 0; i--) {
+        interval_tree_remove(&nodes[i - 1], &root);
+        if (i % 100)
+            continue;
+        for (j = 0; j < NR_QUERIES; j += 10)
+            TEST_ASSERT_EQUAL_INT(
+                brute_count(queries[j][0], queries[j][1], i - 1),
+                tree_count(&root, queries[j][0], queries[j][1])
+            );
+    }
+    TEST_ASSERT_TRUE(RB_EMPTY_ROOT(&root.rb_root));
+}
+
+/* a custom instance: half-open byte ranges keyed by 32-bit addresses */
+struct region {
+    struct rb_node rb;
+    uint32_t base;
+    uint32_t size;
+    uint32_t subtree_last;
+};
+
+#define REGION_START(r) ((r)->base)
+#define REGION_LAST(r) ((r)->base + (r)->size - 1)
+
+INTERVAL_TREE_DEFINE(
+    struct region,
+    rb,
+    uint32_t,
+    subtree_last,
+    REGION_START,
+    REGION_LAST,
+    static,
+    region_tree
+)
+
+void test_interval_tree_generic(void) {
+    struct rb_root_cached root = RB_ROOT_CACHED;
+    struct region regions[] = {
+        {.base = 0x1000, .size = 0x1000},
+        {.base = 0x4000, .size = 0x100},
+        {.base = 0x3000, .size = 0x2000},
+        {.base = 0x8000, .size = 0x10},
+    };
+    struct region *r;
+    size_t i;
+
+    for (i = 0; i < sizeof(regions) / sizeof(regions[0]); i++)
+        region_tree_insert(&regions[i], &root);
+
+    TEST_ASSERT_EQUAL_PTR(
+        &regions[0],
+        region_tree_iter_first(&root, 0x1fff, 0x1fff)
+    );
+    TEST_ASSERT_NULL(region_tree_iter_first(&root, 0x2000, 0x2fff));
+    TEST_ASSERT_NULL(region_tree_iter_first(&root, 0x8010, 0xffff));
+
+    r = region_tree_iter_first(&root, 0x4080, 0x4080);
+    TEST_ASSERT_EQUAL_PTR(&regions[2], r);
+    r = region_tree_iter_next(r, 0x4080, 0x4080);
+    TEST_ASSERT_EQUAL_PTR(&regions[1], r);
+    TEST_ASSERT_NULL(region_tree_iter_next(r, 0x4080, 0x4080));
+
+    region_tree_remove(&regions[2], &root);
+    TEST_ASSERT_EQUAL_PTR(
+        &regions[1],
+        region_tree_iter_first(&root, 0x3000, 0x8000)
+    );
+    TEST_ASSERT_NULL(region_tree_iter_first(&root, 0x4100, 0x7fff));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_interval_tree_query);
+    RUN_TEST(test_interval_tree_remove);
+    RUN_TEST(test_interval_tree_generic);
+    return UNITY_END();
+}
@@ -1,5 +1,10 @@
+#include <stdlib.h>
+
 #include "unity.h"
 #include "list.h"
+#include "rculist.h"
+#include "hashtable.h"
+#include "list_sort.h"
 
 void setUp(void) {
     // set stuff up here
@@ -39,8 +44,256 @@ void test_list_add_del(void) {
     TEST_ASSERT_TRUE(list_empty(&head));
 }
 
+void test_list_rcu(void) {
+    LIST_HEAD(head);
+
+    struct node n1 = { .a = 1 };
+    struct node n2 = { .a = 2 };
+    struct node n3 = { .a = 3 };
+    struct node n4 = { .a = 4 };
+
+    list_add_rcu(&n2.list, &head);
+    list_add_rcu(&n1.list, &head);
+    list_add_tail_rcu(&n3.list, &head);
+
+    struct node *iter;
+    int i = 1;
+    rcu_read_lock();
+    list_for_each_entry_rcu(iter, &head, list) {
+        TEST_ASSERT_EQUAL_INT(i, iter->a);
+        i += 1;
+    }
+    iter = list_first_or_null_rcu(&head, struct node, list);
+    TEST_ASSERT_EQUAL_PTR(&n1, iter);
+    rcu_read_unlock();
+    TEST_ASSERT_EQUAL_INT(4, i);
+
+    list_replace_rcu(&n2.list, &n4.list);
+    list_del_rcu(&n1.list);
+
+    /* a deleted entry still leads readers back into the list */
+    TEST_ASSERT_EQUAL_PTR(&n4.list, n1.list.next);
+
+    i = 0;
+    rcu_read_lock();
+    list_for_each_entry_rcu(iter, &head, list)
+        i += iter->a;
+    iter = list_next_or_null_rcu(&head, &n3.list, struct node, list);
+    TEST_ASSERT_NULL(iter);
+    rcu_read_unlock();
+    TEST_ASSERT_EQUAL_INT(7, i);
+}
+
+struct hnode {
+    struct hlist_node node;
+    int key;
+};
+
+void test_hlist_rcu(void) {
+    HLIST_HEAD(head);
+
+    struct hnode n1 = { .key = 1 };
+    struct hnode n2 = { .key = 2 };
+    struct hnode n3 = { .key = 3 };
+    struct hnode n4 = { .key = 4 };
+    struct hnode n5 = { .key = 5 };
+
+    hlist_add_head_rcu(&n2.node, &head);
+    hlist_add_before_rcu(&n1.node, &n2.node);
+    hlist_add_behind_rcu(&n3.node, &n2.node);
+    hlist_add_tail_rcu(&n4.node, &head);
+
+    struct hnode *iter;
+    int i = 1;
+    rcu_read_lock();
+    hlist_for_each_entry_rcu(iter, &head, node) {
+        TEST_ASSERT_EQUAL_INT(i, iter->key);
+        i += 1;
+    }
+    rcu_read_unlock();
+    TEST_ASSERT_EQUAL_INT(5, i);
+
+    hlist_replace_rcu(&n3.node, &n5.node);
+    hlist_del_rcu(&n1.node);
+    hlist_del_init_rcu(&n4.node);
+    TEST_ASSERT_TRUE(hlist_unhashed(&n4.node));
+
+    i = 0;
+    rcu_read_lock();
+    hlist_for_each_entry_rcu(iter, &head, node)
+        i += iter->key;
+    iter = &n2;
+    hlist_for_each_entry_continue_rcu(iter, node)
+        TEST_ASSERT_EQUAL_INT(5, iter->key);
+    rcu_read_unlock();
+    TEST_ASSERT_EQUAL_INT(7, i);
+}
+
+void test_hash_rcu(void) {
+    DEFINE_HASHTABLE(table, 3);
+    struct hnode nodes[32];
+    struct hnode *obj;
+    unsigned int bkt;
+    int i, found, sum;
+
+    for (i = 0; i < 32; i++) {
+        nodes[i].key = i;
+        hash_add_rcu(table, &nodes[i].node, nodes[i].key);
+    }
+
+    rcu_read_lock();
+    for (i = 0; i < 32; i++) {
+        found = 0;
+        hash_for_each_possible_rcu(table, obj, node, i)
+            if (obj->key == i)
+                found++;
+        TEST_ASSERT_EQUAL_INT(1, found);
+    }
+    rcu_read_unlock();
+
+    for (i = 0; i < 32; i += 2)
+        hash_del_rcu(&nodes[i].node);
+
+    sum = 0;
+    rcu_read_lock();
+    hash_for_each_rcu(table, bkt, obj, node)
+        sum += obj->key;
+    rcu_read_unlock();
+    TEST_ASSERT_EQUAL_INT(16 * 16, sum);
+}
+
+struct nnode {
+    struct hlist_nulls_node node;
+    int key;
+};
+
+void test_hash_nulls_rcu(void) {
+    struct hlist_nulls_head table[8];
+    struct nnode nodes[32];
+    struct hlist_nulls_node *pos;
+    struct nnode *obj, *moved;
+    int i, key, found;
+
+    hash_init_nulls(table);
+    for (i = 0; i < 8; i++)
+        TEST_ASSERT_TRUE(hlist_nulls_empty(&table[i]));
+
+    for (i = 0; i < 32; i++) {
+        nodes[i].key = i;
+        hash_add_nulls_rcu(table, &nodes[i].node, nodes[i].key);
+    }
+
+    rcu_read_lock();
+    for (i = 0; i < 32; i++) {
+        found = 0;
+        hash_for_each_possible_nulls_rcu(table, obj, pos, node, i)
+            if (obj->key == i)
+                found++;
+        TEST_ASSERT_EQUAL_INT(1, found);
+        TEST_ASSERT_FALSE(hash_nulls_retry(table, pos, i));
+    }
+    rcu_read_unlock();
+
+    /*
+     * Recycle the object a reader is standing on into a bucket that sorts
+     * after it: the reader finishes its walk on the wrong chain, which the
+     * nulls marker betrays.
+     */
+    moved = &nodes[0];
+    for (key = 32; hash_nulls_slot(table, key) == hash_nulls_slot(table, 0);
+         key++)
+        ;
+
+    rcu_read_lock();
+    found = 0;
+    hash_for_each_possible_nulls_rcu(table, obj, pos, node, 0) {
+        if (obj == moved) {
+            hash_del_nulls_rcu(&moved->node);
+            moved->key = key;
+            hlist_nulls_add_tail_rcu(
+                &moved->node,
+                &table[hash_nulls_slot(table, key)]
+            );
+        }
+        if (obj->key == 0)
+            found++;
+    }
+    TEST_ASSERT_TRUE(hash_nulls_retry(table, pos, 0));
+    rcu_read_unlock();
+    TEST_ASSERT_EQUAL_INT(0, found);
+    TEST_ASSERT_EQUAL_UINT(
+        hash_nulls_slot(table, key),
+        get_nulls_value(pos)
+    );
+
+    hash_del_nulls_rcu(&moved->node);
+    TEST_ASSERT_TRUE(hlist_nulls_unhashed(&moved->node));
+}
+
+#define NR_SORT 10000
+
+static int sort_cmp(
+    void *priv,
+    const struct list_head *a,
+    const struct list_head *b
+) {
+    const struct node *na = list_entry(a, struct node, list);
+    const struct node *nb = list_entry(b, struct node, list);
+
+    (*(int *) priv)++;
+    /* sort by a / 16 only, so that stability is observable */
+    return na->a / 16 > nb->a / 16;
+}
+
+void test_list_sort(void) {
+    LIST_HEAD(head);
+    struct node *nodes, *iter, *prev = NULL;
+    int i, calls = 0, n = 0;
+
+    nodes = calloc(NR_SORT, sizeof(*nodes));
+    TEST_ASSERT_NOT_NULL(nodes);
+    srand(42);
+    for (i = 0; i < NR_SORT; i++) {
+        nodes[i].a = rand() % (NR_SORT * 4);
+        list_add_tail(&nodes[i].list, &head);
+    }
+
+    list_sort(&calls, &head, sort_cmp);
+
+    list_for_each_entry(iter, &head, list) {
+        if (prev) {
+            TEST_ASSERT_TRUE(prev->a / 16 <= iter->a / 16);
+            /* equal keys keep their input (array) order */
+            if (prev->a / 16 == iter->a / 16)
+                TEST_ASSERT_TRUE(prev < iter);
+        }
+        TEST_ASSERT_EQUAL_PTR(&iter->list, iter->list.next->prev);
+        prev = iter;
+        n++;
+    }
+    TEST_ASSERT_EQUAL_INT(NR_SORT, n);
+    TEST_ASSERT_EQUAL_PTR(&prev->list, head.prev);
+    /* n log2 n upper bound on the comparisons */
+    TEST_ASSERT_LESS_THAN(NR_SORT * 14, calls);
+
+    /* trivial lists are left alone */
+    INIT_LIST_HEAD(&head);
+    list_sort(&calls, &head, sort_cmp);
+    TEST_ASSERT_TRUE(list_empty(&head));
+    list_add(&nodes[0].list, &head);
+    list_sort(&calls, &head, sort_cmp);
+    TEST_ASSERT_TRUE(list_is_singular(&head));
+
+    free(nodes);
+}
+
 int main(void) {
     UNITY_BEGIN();
     RUN_TEST(test_list_add_del);
+    RUN_TEST(test_list_rcu);
+    RUN_TEST(test_hlist_rcu);
+    RUN_TEST(test_hash_rcu);
+    RUN_TEST(test_hash_nulls_rcu);
+    RUN_TEST(test_list_sort);
     return UNITY_END();
 }
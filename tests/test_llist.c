@@ -0,0 +1,164 @@
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "llist.h"
+#include "unity.h"
+
+void setUp(void) {
+    // set stuff up here
+}
+
+void tearDown(void) {
+    // clean stuff up here
+}
+
+#define NR_PRODUCERS 4
+#define NR_PER_PRODUCER 100000
+#define BATCH 8
+
+struct work {
+    unsigned int producer;
+    unsigned int seq;
+    bool seen;
+    struct llist_node node;
+};
+
+void test_llist_basic(void) {
+    static const unsigned int oldest_first[] = {0, 1, 4};
+    static const unsigned int newest_first[] = {4, 1, 0};
+    struct work works[10], *pos, *n;
+    struct llist_node *first;
+    LLIST_HEAD(head);
+    int i;
+
+    TEST_ASSERT_TRUE(llist_empty(&head));
+    TEST_ASSERT_NULL(llist_del_first(&head));
+    TEST_ASSERT_NULL(llist_del_all(&head));
+
+    for (i = 0; i < 10; i++) {
+        works[i].seq = i;
+        init_llist_node(&works[i].node);
+        TEST_ASSERT_FALSE(llist_on_list(&works[i].node));
+    }
+
+    TEST_ASSERT_TRUE(llist_add(&works[0].node, &head));
+    TEST_ASSERT_FALSE(llist_add(&works[1].node, &head));
+    TEST_ASSERT_TRUE(llist_on_list(&works[0].node));
+    TEST_ASSERT_FALSE(llist_empty(&head));
+
+    /* a batch linked 2 -> 3 -> 4 is added in that order */
+    works[2].node.next = &works[3].node;
+    works[3].node.next = &works[4].node;
+    TEST_ASSERT_FALSE(llist_add_batch(&works[2].node, &works[4].node, &head));
+
+    /* newest first: 2 3 4 1 0 */
+    TEST_ASSERT_FALSE(llist_del_first_this(&head, &works[3].node));
+    TEST_ASSERT_TRUE(llist_del_first_this(&head, &works[2].node));
+    TEST_ASSERT_EQUAL_PTR(&works[3].node, llist_del_first_init(&head));
+    TEST_ASSERT_FALSE(llist_on_list(&works[3].node));
+
+    /* oldest first after reversing: 0 1 4 */
+    first = llist_reverse_order(llist_del_all(&head));
+    TEST_ASSERT_TRUE(llist_empty(&head));
+    i = 0;
+    llist_for_each_entry_safe(pos, n, first, node) {
+        TEST_ASSERT_EQUAL_UINT(oldest_first[i], pos->seq);
+        /* requeueing from the _safe walk must not break it */
+        __llist_add(&pos->node, &head);
+        i++;
+    }
+    TEST_ASSERT_EQUAL_INT(3, i);
+
+    i = 0;
+    llist_for_each_entry(pos, __llist_del_all(&head), node)
+        TEST_ASSERT_EQUAL_UINT(newest_first[i++], pos->seq);
+    TEST_ASSERT_EQUAL_INT(3, i);
+    TEST_ASSERT_TRUE(llist_empty(&head));
+    TEST_ASSERT_NULL(llist_reverse_order(NULL));
+}
+
+static struct llist_head queue;
+static struct work works[NR_PRODUCERS][NR_PER_PRODUCER];
+static atomic_int producers_done;
+
+/* Add one work at a time, or BATCH linked up front */
+static void *producer_fn(void *arg) {
+    unsigned int id = (uintptr_t) arg, i, j;
+    struct work *w = works[id];
+
+    for (i = 0; i < NR_PER_PRODUCER; i++) {
+        w[i].producer = id;
+        w[i].seq = i;
+        w[i].seen = false;
+    }
+    for (i = 0; i < NR_PER_PRODUCER; i += BATCH) {
+        if (id % 2 == 0) {
+            for (j = i; j < i + BATCH; j++)
+                llist_add(&w[j].node, &queue);
+            continue;
+        }
+        /* newest first, like the list itself */
+        for (j = i; j < i + BATCH - 1; j++)
+            w[j + 1].node.next = &w[j].node;
+        llist_add_batch(&w[i + BATCH - 1].node, &w[i].node, &queue);
+    }
+    atomic_fetch_add(&producers_done, 1);
+    return NULL;
+}
+
+/*
+ * One consumer drains the queue while the producers are adding, with
+ * llist_del_all() or, as the single such user, llist_del_first(), and must
+ * get every work exactly once.  Each llist_del_all() batch, reversed, has
+ * the works of a producer oldest first.
+ */
+void test_llist_mpsc(void) {
+    unsigned int last[NR_PRODUCERS], total = 0, round = 0;
+    pthread_t threads[NR_PRODUCERS];
+    struct llist_node *node;
+    struct work *pos;
+    uintptr_t i;
+    bool done;
+
+    init_llist_head(&queue);
+    atomic_store(&producers_done, 0);
+    for (i = 0; i < NR_PRODUCERS; i++)
+        pthread_create(&threads[i], NULL, producer_fn, (void *) i);
+
+    do {
+        done = atomic_load(&producers_done) == NR_PRODUCERS;
+        if (round++ % 4 == 0) {
+            while ((node = llist_del_first(&queue))) {
+                pos = llist_entry(node, struct work, node);
+                TEST_ASSERT_FALSE(pos->seen);
+                pos->seen = true;
+                total++;
+            }
+            continue;
+        }
+        for (i = 0; i < NR_PRODUCERS; i++)
+            last[i] = UINT_MAX;
+        node = llist_reverse_order(llist_del_all(&queue));
+        llist_for_each_entry(pos, node, node) {
+            TEST_ASSERT_FALSE(pos->seen);
+            if (last[pos->producer] != UINT_MAX)
+                TEST_ASSERT_TRUE(pos->seq > last[pos->producer]);
+            last[pos->producer] = pos->seq;
+            pos->seen = true;
+            total++;
+        }
+    } while (!done || !llist_empty(&queue));
+
+    for (i = 0; i < NR_PRODUCERS; i++)
+        pthread_join(threads[i], NULL);
+    TEST_ASSERT_EQUAL_UINT(NR_PRODUCERS * NR_PER_PRODUCER, total);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_llist_basic);
+    RUN_TEST(test_llist_mpsc);
+    return UNITY_END();
+}
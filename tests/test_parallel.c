@@ -0,0 +1,222 @@
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#include "list_sort.h"
+#include "parallel.h"
+#include "unity.h"
+
+void setUp(void) {
+    // set stuff up here
+}
+
+void tearDown(void) {
+    // clean stuff up here
+}
+
+#define NR_NODES 50000
+#define NR_SORT 100000
+
+struct item {
+    struct hlist_node hnode;
+    struct rb_node rb;
+    unsigned int key;
+    atomic_uint visits;
+};
+
+static struct thread_pool pool;
+
+static void visit_hnode(struct hlist_node *node, void *arg) {
+    struct item *item = hlist_entry(node, struct item, hnode);
+
+    atomic_fetch_add(&item->visits, 1);
+    /* odd keys leave the table: removal is safe during the walk */
+    if (item->key & 1)
+        hash_del(node);
+    atomic_fetch_add((atomic_uint *) arg, 1);
+}
+
+static void check_hash(struct thread_pool *p) {
+    DEFINE_HASHTABLE(table, 12);
+    atomic_uint total;
+    struct item *items, *item;
+    unsigned int i, bkt;
+
+    items = calloc(NR_NODES, sizeof(*items));
+    TEST_ASSERT_NOT_NULL(items);
+    for (i = 0; i < NR_NODES; i++) {
+        items[i].key = i;
+        hash_add(table, &items[i].hnode, i);
+    }
+
+    atomic_store(&total, 0);
+    hash_for_each_parallel(p, table, visit_hnode, &total);
+    TEST_ASSERT_EQUAL_UINT(NR_NODES, atomic_load(&total));
+    for (i = 0; i < NR_NODES; i++)
+        TEST_ASSERT_EQUAL_UINT(1, atomic_load(&items[i].visits));
+
+    i = 0;
+    hash_for_each(table, bkt, item, hnode) {
+        TEST_ASSERT_EQUAL_UINT(0, item->key & 1);
+        i++;
+    }
+    TEST_ASSERT_EQUAL_UINT(NR_NODES / 2, i);
+    free(items);
+}
+
+void test_hash_for_each_parallel(void) {
+    check_hash(NULL);
+    check_hash(&pool);
+}
+
+static bool item_less(struct rb_node *a, const struct rb_node *b) {
+    return rb_entry(a, struct item, rb)->key <
+           rb_entry(b, struct item, rb)->key;
+}
+
+static atomic_uint misordered;
+
+static bool rb_visited(const struct rb_node *node) {
+    return !node || atomic_load(&rb_entry(node, struct item, rb)->visits);
+}
+
+/* Count rather than assert: this runs on the workers too */
+static void visit_rb(struct rb_node *node, void *arg) {
+    struct item *item = rb_entry(node, struct item, rb);
+
+    if (!rb_visited(node->rb_left) || !rb_visited(node->rb_right))
+        atomic_fetch_add(&misordered, 1);
+    atomic_fetch_add(&item->visits, 1);
+    atomic_fetch_add((atomic_uint *) arg, 1);
+}
+
+static void free_rb(struct rb_node *node, void *arg) {
+    (void) arg;
+    free(rb_entry(node, struct item, rb));
+}
+
+static void check_postorder(struct thread_pool *p, unsigned int nr) {
+    struct rb_root root = RB_ROOT;
+    struct item *items;
+    atomic_uint total;
+    unsigned int i;
+
+    items = calloc(nr ? nr : 1, sizeof(*items));
+    TEST_ASSERT_NOT_NULL(items);
+    for (i = 0; i < nr; i++) {
+        items[i].key = (i * 7919) % nr;
+        rb_add(&items[i].rb, &root, item_less);
+    }
+
+    atomic_store(&total, 0);
+    atomic_store(&misordered, 0);
+    rb_postorder_parallel(p, &root, visit_rb, &total);
+    TEST_ASSERT_EQUAL_UINT(nr, atomic_load(&total));
+    TEST_ASSERT_EQUAL_UINT(0, atomic_load(&misordered));
+    for (i = 0; i < nr; i++)
+        TEST_ASSERT_EQUAL_UINT(1, atomic_load(&items[i].visits));
+    free(items);
+}
+
+void test_rb_postorder_parallel(void) {
+    struct rb_root root = RB_ROOT;
+    struct item *item;
+    unsigned int i;
+
+    check_postorder(NULL, NR_NODES);
+    check_postorder(&pool, 0);
+    check_postorder(&pool, 1);
+    check_postorder(&pool, 3);
+    check_postorder(&pool, NR_NODES);
+
+    /* teardown: every node freed, under ASan no use after free */
+    for (i = 0; i < NR_NODES; i++) {
+        item = calloc(1, sizeof(*item));
+        TEST_ASSERT_NOT_NULL(item);
+        item->key = i;
+        rb_add(&item->rb, &root, item_less);
+    }
+    rb_postorder_parallel(&pool, &root, free_rb, NULL);
+    root = RB_ROOT;
+    TEST_ASSERT_TRUE(RB_EMPTY_ROOT(&root));
+}
+
+struct sort_node {
+    struct list_head list;
+    unsigned int a;
+};
+
+static int sort_cmp(
+    void *priv,
+    const struct list_head *a,
+    const struct list_head *b
+) {
+    const struct sort_node *na = list_entry(a, struct sort_node, list);
+    const struct sort_node *nb = list_entry(b, struct sort_node, list);
+
+    atomic_fetch_add((atomic_uint *) priv, 1);
+    /* sort by a / 16 only, so that stability is observable */
+    return na->a / 16 > nb->a / 16;
+}
+
+static void check_sort(struct thread_pool *p, unsigned int nr) {
+    struct sort_node *nodes, *iter, *prev = NULL;
+    atomic_uint calls;
+    unsigned int i, n = 0;
+    LIST_HEAD(head);
+
+    nodes = calloc(nr ? nr : 1, sizeof(*nodes));
+    TEST_ASSERT_NOT_NULL(nodes);
+    srand(nr);
+    for (i = 0; i < nr; i++) {
+        nodes[i].a = rand() % (nr * 4 + 1);
+        list_add_tail(&nodes[i].list, &head);
+    }
+
+    atomic_store(&calls, 0);
+    list_sort_parallel(p, &calls, &head, sort_cmp);
+
+    list_for_each_entry(iter, &head, list) {
+        if (prev) {
+            TEST_ASSERT_TRUE(prev->a / 16 <= iter->a / 16);
+            /* equal keys keep their input (array) order */
+            if (prev->a / 16 == iter->a / 16)
+                TEST_ASSERT_TRUE(prev < iter);
+        }
+        TEST_ASSERT_EQUAL_PTR(&iter->list, iter->list.next->prev);
+        prev = iter;
+        n++;
+    }
+    TEST_ASSERT_EQUAL_UINT(nr, n);
+    if (nr)
+        TEST_ASSERT_EQUAL_PTR(&prev->list, head.prev);
+    else
+        TEST_ASSERT_TRUE(list_empty(&head));
+    /* the chunks cost no more than n log2 n comparisons either */
+    TEST_ASSERT_TRUE(atomic_load(&calls) <= nr * 17 + 1);
+    free(nodes);
+}
+
+void test_list_sort_parallel(void) {
+    check_sort(NULL, NR_SORT);
+    check_sort(&pool, 0);
+    check_sort(&pool, 1);
+    check_sort(&pool, 1000);
+    /* uneven chunks, down to just two */
+    check_sort(&pool, 2 * 4096 + 5);
+    check_sort(&pool, NR_SORT);
+    check_sort(&pool, NR_SORT + 13);
+}
+
+int main(void) {
+    int ret;
+
+    if (thread_pool_init(&pool, 4))
+        return 1;
+    UNITY_BEGIN();
+    RUN_TEST(test_hash_for_each_parallel);
+    RUN_TEST(test_rb_postorder_parallel);
+    RUN_TEST(test_list_sort_parallel);
+    ret = UNITY_END();
+    thread_pool_destroy(&pool);
+    return ret;
+}
@@ -0,0 +1,147 @@
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "percpu_ref.h"
+#include "unity.h"
+
+void setUp(void) {
+    // set stuff up here
+}
+
+void tearDown(void) {
+    // clean stuff up here
+}
+
+#define NR_THREADS 8
+#define NR_LOOPS 200000
+
+static struct percpu_ref ref;
+static atomic_int released;
+static struct percpu_ref *_Atomic released_ref;
+static atomic_int active;
+static int active_at_release;
+
+/* Record rather than assert: the last put may come from a worker */
+static void release_fn(struct percpu_ref *r) {
+    atomic_store(&released_ref, r);
+    active_at_release = atomic_load(&active);
+    atomic_fetch_add(&released, 1);
+}
+
+void test_percpu_ref_basic(void) {
+    int i;
+
+    atomic_store(&released, 0);
+    atomic_store(&released_ref, NULL);
+    TEST_ASSERT_EQUAL_INT(0, percpu_ref_init(&ref, release_fn, 0));
+    TEST_ASSERT_FALSE(percpu_ref_is_dying(&ref));
+    TEST_ASSERT_FALSE(percpu_ref_is_zero(&ref));
+
+    for (i = 0; i < 10; i++)
+        percpu_ref_get(&ref);
+    percpu_ref_get_many(&ref, 5);
+    TEST_ASSERT_TRUE(percpu_ref_tryget(&ref));
+    TEST_ASSERT_TRUE(percpu_ref_tryget_live(&ref));
+    percpu_ref_put_many(&ref, 7);
+
+    percpu_ref_kill(&ref);
+    TEST_ASSERT_TRUE(percpu_ref_is_dying(&ref));
+    TEST_ASSERT_FALSE(percpu_ref_tryget_live(&ref));
+    TEST_ASSERT_EQUAL_INT(0, atomic_load(&released));
+
+    /* 10 + 5 + 2 - 7 = 10 references are left */
+    TEST_ASSERT_TRUE(percpu_ref_tryget(&ref));
+    for (i = 0; i < 10; i++)
+        percpu_ref_put(&ref);
+    TEST_ASSERT_EQUAL_INT(0, atomic_load(&released));
+    TEST_ASSERT_FALSE(percpu_ref_is_zero(&ref));
+
+    percpu_ref_put(&ref);
+    TEST_ASSERT_EQUAL_INT(1, atomic_load(&released));
+    TEST_ASSERT_EQUAL_PTR(&ref, atomic_load(&released_ref));
+    TEST_ASSERT_TRUE(percpu_ref_is_zero(&ref));
+    TEST_ASSERT_FALSE(percpu_ref_tryget(&ref));
+
+    percpu_ref_exit(&ref);
+}
+
+void test_percpu_ref_switch(void) {
+    atomic_store(&released, 0);
+    atomic_store(&released_ref, NULL);
+    TEST_ASSERT_EQUAL_INT(
+        0,
+        percpu_ref_init(&ref, release_fn, PERCPU_REF_INIT_ATOMIC)
+    );
+
+    percpu_ref_get(&ref);
+    percpu_ref_switch_to_percpu(&ref);
+    percpu_ref_get(&ref);
+    percpu_ref_put(&ref);
+    percpu_ref_put(&ref);
+    TEST_ASSERT_FALSE(percpu_ref_is_zero(&ref));
+
+    percpu_ref_get(&ref);
+    percpu_ref_switch_to_atomic(&ref);
+    percpu_ref_switch_to_atomic(&ref);
+    percpu_ref_put(&ref);
+    percpu_ref_switch_to_percpu(&ref);
+
+    percpu_ref_kill(&ref);
+    TEST_ASSERT_EQUAL_INT(1, atomic_load(&released));
+    TEST_ASSERT_EQUAL_PTR(&ref, atomic_load(&released_ref));
+    percpu_ref_exit(&ref);
+}
+
+/*
+ * Every thread takes its own reference up front and churns gets and puts
+ * while the main thread kills the ref halfway through.  The release function
+ * must run exactly once, after every thread dropped its last reference.
+ */
+static void *worker_fn(void *arg) {
+    int i;
+
+    (void) arg;
+    for (i = 0; i < NR_LOOPS; i++) {
+        percpu_ref_get(&ref);
+        if (percpu_ref_tryget(&ref))
+            percpu_ref_put(&ref);
+        percpu_ref_put(&ref);
+    }
+    atomic_fetch_sub(&active, 1);
+    percpu_ref_put(&ref);
+    return NULL;
+}
+
+void test_percpu_ref_concurrent_kill(void) {
+    pthread_t threads[NR_THREADS];
+    int i;
+
+    atomic_store(&released, 0);
+    atomic_store(&released_ref, NULL);
+    atomic_store(&active, NR_THREADS);
+    TEST_ASSERT_EQUAL_INT(0, percpu_ref_init(&ref, release_fn, 0));
+
+    for (i = 0; i < NR_THREADS; i++) {
+        percpu_ref_get(&ref);
+        pthread_create(&threads[i], NULL, worker_fn, NULL);
+    }
+
+    percpu_ref_kill(&ref);
+
+    for (i = 0; i < NR_THREADS; i++)
+        pthread_join(threads[i], NULL);
+
+    TEST_ASSERT_EQUAL_INT(1, atomic_load(&released));
+    TEST_ASSERT_EQUAL_PTR(&ref, atomic_load(&released_ref));
+    TEST_ASSERT_EQUAL_INT(0, active_at_release);
+    TEST_ASSERT_TRUE(percpu_ref_is_zero(&ref));
+    percpu_ref_exit(&ref);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_percpu_ref_basic);
+    RUN_TEST(test_percpu_ref_switch);
+    RUN_TEST(test_percpu_ref_concurrent_kill);
+    return UNITY_END();
+}
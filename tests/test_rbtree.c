@@ -1,13 +1,21 @@
 // SPDX-License-Identifier: GPL-2.0-only
 
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
+#include "list.h"
 #include "rbtree.h"
 #include "rbtree_augmented.h"
+#include "rbtree_compact.h"
+#include "rbtree_frozen.h"
+#include "rbtree_latch.h"
+#include "rbtree_ost.h"
 #include "unity.h"
 
 // Simple PRNG wrapper
@@ -435,9 +443,853 @@ void test_rbtree_functionality(void)
 	free(nodes);
 }
 
+static int node_cmp(struct rb_node *a, const struct rb_node *b)
+{
+	uint32_t ka = rb_entry(a, struct test_node, rb)->key;
+	uint32_t kb = rb_entry(b, struct test_node, rb)->key;
+
+	return ka < kb ? -1 : ka > kb;
+}
+
+static int key_cmp(const void *key, const struct rb_node *b)
+{
+	uint32_t ka = *(const uint32_t *)key;
+	uint32_t kb = rb_entry(b, struct test_node, rb)->key;
+
+	return ka < kb ? -1 : ka > kb;
+}
+
+void test_rbtree_find_rcu(void)
+{
+	struct rb_root tree = RB_ROOT;
+	uint32_t key;
+	int i;
+
+	nodes = calloc(nnodes, sizeof(*nodes));
+	TEST_ASSERT_NOT_NULL(nodes);
+	for (i = 0; i < nnodes; i++) {
+		nodes[i].key = 2 * i;
+		TEST_ASSERT_NULL(rb_find_add_rcu(&nodes[i].rb, &tree, node_cmp));
+	}
+
+	rcu_read_lock();
+	for (i = 0; i < nnodes; i++) {
+		key = 2 * i;
+		TEST_ASSERT_EQUAL_PTR(&nodes[i].rb, rb_find_rcu(&key, &tree, key_cmp));
+		key = 2 * i + 1;
+		TEST_ASSERT_NULL(rb_find_rcu(&key, &tree, key_cmp));
+	}
+	rcu_read_unlock();
+
+	free(nodes);
+}
+
+#define BOUNDS_KEYS 64
+
+/* index into @sorted of the first node the predicate fails for */
+static int bound_index(struct rb_node **sorted, int n, uint32_t key,
+		       bool inclusive)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		uint32_t k = rb_entry(sorted[i], struct test_node, rb)->key;
+
+		if (inclusive ? k > key : k >= key)
+			break;
+	}
+	return i;
+}
+
+void test_rbtree_bounds(void)
+{
+	struct rb_root_cached tree = RB_ROOT_CACHED;
+	struct rb_node **sorted, *rb;
+	uint32_t lo, hi;
+	int i, n, ge, gt;
+
+	nodes = calloc(nnodes, sizeof(*nodes));
+	sorted = calloc(nnodes, sizeof(*sorted));
+	TEST_ASSERT_NOT_NULL(nodes);
+	TEST_ASSERT_NOT_NULL(sorted);
+
+	/* small keys with gaps and duplicates */
+	for (i = 0; i < nnodes; i++) {
+		nodes[i].key = 2 * (prandom_u32_state(&rnd) % (BOUNDS_KEYS / 2));
+		insert(nodes + i, &tree);
+	}
+	n = 0;
+	for (rb = rb_first(&tree.rb_root); rb; rb = rb_next(rb))
+		sorted[n++] = rb;
+	TEST_ASSERT_EQUAL_INT(nnodes, n);
+
+	for (lo = 0; lo <= BOUNDS_KEYS; lo++) {
+		ge = bound_index(sorted, n, lo, false);
+		gt = bound_index(sorted, n, lo, true);
+
+		TEST_ASSERT_EQUAL_PTR(ge < n ? sorted[ge] : NULL,
+				      rb_find_ge(&lo, &tree.rb_root, key_cmp));
+		TEST_ASSERT_EQUAL_PTR(gt < n ? sorted[gt] : NULL,
+				      rb_find_gt(&lo, &tree.rb_root, key_cmp));
+		TEST_ASSERT_EQUAL_PTR(gt ? sorted[gt - 1] : NULL,
+				      rb_find_le(&lo, &tree.rb_root, key_cmp));
+		TEST_ASSERT_EQUAL_PTR(ge ? sorted[ge - 1] : NULL,
+				      rb_find_lt(&lo, &tree.rb_root, key_cmp));
+
+		for (hi = 0; hi <= BOUNDS_KEYS; hi += 3) {
+			i = ge;
+			rb_for_each_range(rb, &lo, &hi, &tree.rb_root, key_cmp)
+				TEST_ASSERT_EQUAL_PTR(sorted[i++], rb);
+			TEST_ASSERT_EQUAL_INT(lo < hi ?
+					      bound_index(sorted, n, hi, false) :
+					      ge, i);
+		}
+	}
+
+	free(sorted);
+	free(nodes);
+}
+
+void test_rbtree_find_batch(void)
+{
+	struct rb_root tree = RB_ROOT;
+	const void **keys;
+	struct rb_node **out;
+	uint32_t *vals;
+	int i, nr = 2 * nnodes + 1;
+
+	nodes = calloc(nnodes, sizeof(*nodes));
+	keys = calloc(nr, sizeof(*keys));
+	vals = calloc(nr, sizeof(*vals));
+	out = calloc(nr, sizeof(*out));
+	TEST_ASSERT_NOT_NULL(nodes);
+	TEST_ASSERT_NOT_NULL(keys);
+	TEST_ASSERT_NOT_NULL(vals);
+	TEST_ASSERT_NOT_NULL(out);
+
+	for (i = 0; i < nnodes; i++) {
+		nodes[i].key = 2 * i;
+		TEST_ASSERT_NULL(rb_find_add(&nodes[i].rb, &tree, node_cmp));
+	}
+	/* hits and misses interleaved, and a batch that does not divide evenly */
+	for (i = 0; i < nr; i++) {
+		vals[i] = (prandom_u32_state(&rnd) % nnodes) * 2 + (i & 1);
+		keys[i] = &vals[i];
+	}
+
+	rb_find_batch(keys, nr, &tree, key_cmp, out);
+	for (i = 0; i < nr; i++)
+		TEST_ASSERT_EQUAL_PTR(rb_find(keys[i], &tree, key_cmp), out[i]);
+
+	free(out);
+	free(vals);
+	free(keys);
+	free(nodes);
+}
+
+static uint64_t test_node_key(const struct rb_node *rb)
+{
+	return rb_entry(rb, struct test_node, rb)->key;
+}
+
+void test_rbtree_frozen(void)
+{
+	struct rb_root_cached tree = RB_ROOT_CACHED;
+	struct rb_frozen frozen;
+	uint32_t key;
+	int i, n;
+
+	nodes = calloc(nnodes, sizeof(*nodes));
+	TEST_ASSERT_NOT_NULL(nodes);
+
+	/* every size up to nnodes, so that all shapes of last level occur */
+	for (n = 0; n <= nnodes; n++) {
+		tree = RB_ROOT_CACHED;
+		for (i = 0; i < n; i++) {
+			nodes[i].key = 2 * (prandom_u32_state(&rnd) % nnodes);
+			insert(nodes + i, &tree);
+		}
+
+		TEST_ASSERT_EQUAL_INT(0, rb_freeze(&frozen, &tree.rb_root,
+						   test_node_key));
+		TEST_ASSERT_EQUAL_UINT(n, frozen.nr);
+		for (key = 0; key <= 2 * (uint32_t)nnodes; key++) {
+			TEST_ASSERT_EQUAL_PTR(rb_find_ge(&key, &tree.rb_root,
+							 key_cmp),
+					      rb_frozen_find_ge(&frozen, key));
+			TEST_ASSERT_EQUAL_PTR(rb_find_first(&key,
+							    &tree.rb_root,
+							    key_cmp),
+					      rb_frozen_find(&frozen, key));
+		}
+		rb_frozen_destroy(&frozen);
+	}
+
+	free(nodes);
+}
+
+static int test_node_cmp(const void *a, const void *b)
+{
+	uint32_t ka = ((const struct test_node *)a)->key;
+	uint32_t kb = ((const struct test_node *)b)->key;
+
+	return ka < kb ? -1 : ka > kb;
+}
+
+struct list_test_node {
+	struct list_head list;
+	struct test_node node;
+};
+
+void test_rbtree_build(void)
+{
+	struct list_test_node *lnodes;
+	struct rb_node **array;
+	LIST_HEAD(head);
+	int i, n;
+
+	nodes = calloc(nnodes, sizeof(*nodes));
+	array = calloc(nnodes, sizeof(*array));
+	lnodes = calloc(nnodes, sizeof(*lnodes));
+	TEST_ASSERT_NOT_NULL(nodes);
+	TEST_ASSERT_NOT_NULL(array);
+	TEST_ASSERT_NOT_NULL(lnodes);
+
+	for (n = 0; n <= nnodes; n++) {
+		init();
+		qsort(nodes, n, sizeof(*nodes), test_node_cmp);
+		for (i = 0; i < n; i++)
+			array[i] = &nodes[i].rb;
+
+		rb_build_cached(array, n, &root);
+		check(n);
+		TEST_ASSERT_EQUAL_PTR(rb_first(&root.rb_root),
+				      rb_first_cached(&root));
+
+		/* the result must stay a valid tree under further updates */
+		for (i = 0; i < n; i += 3)
+			erase(nodes + i, &root);
+		for (i = 0; i < n; i += 3)
+			insert(nodes + i, &root);
+		check(n);
+
+		rb_build_augmented(array, n, &root.rb_root, &augment_callbacks);
+		check_augmented(n);
+		for (i = 0; i < n; i += 3)
+			erase_augmented(nodes + i, &root);
+		for (i = 0; i < n; i += 3)
+			insert_augmented(nodes + i, &root);
+		check_augmented(n);
+
+		INIT_LIST_HEAD(&head);
+		for (i = 0; i < n; i++) {
+			lnodes[i].node = nodes[i];
+			list_add_tail(&lnodes[i].list, &head);
+		}
+		rb_build_list_cached(&head, &root, struct list_test_node, list,
+				     node.rb);
+		check(n);
+		TEST_ASSERT_EQUAL_PTR(n ? &lnodes[0].node.rb : NULL,
+				      rb_first_cached(&root));
+
+		rb_build_list_augmented(&head, &root.rb_root,
+					struct list_test_node, list, node.rb,
+					&augment_callbacks);
+		check_augmented(n);
+	}
+
+	root = RB_ROOT_CACHED;
+	free(lnodes);
+	free(array);
+	free(nodes);
+}
+
+struct ost_test_node {
+	uint32_t key;
+	struct rb_ost_node ost;
+};
+
+#define ost_key(node) rb_entry(node, struct ost_test_node, ost.rb)->key
+
+static bool ost_less(struct rb_node *a, const struct rb_node *b)
+{
+	return ost_key(a) < ost_key(b);
+}
+
+static int ost_cmp(const void *key, const struct rb_node *b)
+{
+	uint32_t ka = *(const uint32_t *)key, kb = ost_key(b);
+
+	return ka < kb ? -1 : ka > kb;
+}
+
+static size_t ost_check_sizes(struct rb_node *rb)
+{
+	size_t size;
+
+	if (!rb)
+		return 0;
+	size = 1 + ost_check_sizes(rb->rb_left) + ost_check_sizes(rb->rb_right);
+	TEST_ASSERT_EQUAL_size_t(size, rb_ost_entry(rb)->size);
+	return size;
+}
+
+static void ost_check(struct rb_root_cached *tree, struct ost_test_node *onodes,
+		      bool *present, int n)
+{
+	struct rb_node *rb;
+	uint32_t lo, hi;
+	size_t k = 0, count;
+	int i, j;
+
+	TEST_ASSERT_EQUAL_size_t(ost_check_sizes(tree->rb_root.rb_node),
+				 rb_ost_count(&tree->rb_root));
+	TEST_ASSERT_EQUAL_PTR(rb_first(&tree->rb_root), rb_first_cached(tree));
+
+	for (rb = rb_first(&tree->rb_root); rb; rb = rb_next(rb), k++) {
+		TEST_ASSERT_EQUAL_PTR(rb, rb_select(&tree->rb_root, k));
+		TEST_ASSERT_EQUAL_size_t(k, rb_rank(rb));
+	}
+	TEST_ASSERT_EQUAL_size_t(k, rb_ost_count(&tree->rb_root));
+	TEST_ASSERT_NULL(rb_select(&tree->rb_root, k));
+
+	for (i = 0; i < 50; i++) {
+		lo = prandom_u32_state(&rnd) % 128;
+		hi = prandom_u32_state(&rnd) % 128;
+		for (count = 0, j = 0; j < n; j++)
+			count += present[j] && lo <= onodes[j].key &&
+				 onodes[j].key <= hi;
+		TEST_ASSERT_EQUAL_size_t(count,
+			rb_count_range(&lo, &hi, &tree->rb_root, ost_cmp));
+	}
+}
+
+void test_rbtree_ost(void)
+{
+	struct rb_root_cached tree = RB_ROOT_CACHED;
+	struct ost_test_node *onodes;
+	struct rb_node **array, *rb;
+	bool *present;
+	int i;
+
+	onodes = calloc(nnodes, sizeof(*onodes));
+	array = calloc(nnodes, sizeof(*array));
+	present = calloc(nnodes, sizeof(*present));
+	TEST_ASSERT_NOT_NULL(onodes);
+	TEST_ASSERT_NOT_NULL(array);
+	TEST_ASSERT_NOT_NULL(present);
+
+	/* a small key space, so that there are plenty of duplicates */
+	for (i = 0; i < nnodes; i++)
+		onodes[i].key = prandom_u32_state(&rnd) % 128;
+
+	for (i = 0; i < nnodes; i++) {
+		rb_ost_add_cached(&onodes[i].ost.rb, &tree, ost_less);
+		present[i] = true;
+	}
+	ost_check(&tree, onodes, present, nnodes);
+
+	for (i = 0; i < nnodes; i += 2) {
+		rb_ost_erase_cached(&onodes[i].ost.rb, &tree);
+		present[i] = false;
+	}
+	ost_check(&tree, onodes, present, nnodes);
+
+	for (i = 0; i < nnodes; i += 4) {
+		rb_ost_add_cached(&onodes[i].ost.rb, &tree, ost_less);
+		present[i] = true;
+	}
+	ost_check(&tree, onodes, present, nnodes);
+
+	/* bulk construction computes the sizes through the callbacks */
+	i = 0;
+	for (rb = rb_first_cached(&tree); rb; rb = rb_next(rb))
+		array[i++] = rb;
+	rb_build_augmented_cached(array, i, &tree, &rb_ost_callbacks);
+	ost_check(&tree, onodes, present, nnodes);
+
+	free(present);
+	free(array);
+	free(onodes);
+}
+
+static bool node_less(struct rb_node *a, const struct rb_node *b)
+{
+	return rb_entry(a, struct test_node, rb)->key <
+	       rb_entry(b, struct test_node, rb)->key;
+}
+
+static unsigned long nr_less;
+
+static bool node_less_count(struct rb_node *a, const struct rb_node *b)
+{
+	nr_less++;
+	return node_less(a, b);
+}
+
+/* Equal keys must come out in insertion order, i.e. array order */
+static void check_hint_order(int nr_nodes)
+{
+	struct test_node *prev = NULL, *node;
+	struct rb_node *rb;
+
+	check(nr_nodes);
+	for (rb = rb_first(&root.rb_root); rb; rb = rb_next(rb)) {
+		node = rb_entry(rb, struct test_node, rb);
+		TEST_ASSERT_TRUE(!prev || prev->key != node->key || prev < node);
+		prev = node;
+	}
+}
+
+void test_rbtree_add_hint(void)
+{
+	struct rb_root_rcached rtree;
+	struct rb_node *hint;
+	int i, j;
+
+	nodes = calloc(nnodes, sizeof(*nodes));
+	TEST_ASSERT_NOT_NULL(nodes);
+
+	for (j = 0; j < check_loops; j++) {
+		/* random keys, with any node of the tree as the hint */
+		root = RB_ROOT_CACHED;
+		init();
+		for (i = 0; i < nnodes; i++) {
+			hint = i ? &nodes[prandom_u32_state(&rnd) % i].rb : NULL;
+			rb_add_hint(&nodes[i].rb, hint, &root.rb_root, node_less);
+		}
+		check(nnodes);
+
+		/* nearly sorted with duplicates, hinted by the last insert */
+		root = RB_ROOT_CACHED;
+		for (i = 0; i < nnodes; i++) {
+			nodes[i].key = i / 2 + prandom_u32_state(&rnd) % 4;
+			hint = i ? &nodes[i - 1].rb : NULL;
+			rb_add_hint(&nodes[i].rb, hint, &root.rb_root, node_less);
+		}
+		check_hint_order(nnodes);
+
+		/* appending after the maximum takes a single comparison */
+		root = RB_ROOT_CACHED;
+		nr_less = 0;
+		for (i = 0; i < nnodes; i++) {
+			nodes[i].key = i;
+			hint = i ? &nodes[i - 1].rb : NULL;
+			rb_add_hint(&nodes[i].rb, hint, &root.rb_root,
+				    node_less_count);
+		}
+		TEST_ASSERT_EQUAL_UINT(nnodes - 1, nr_less);
+		check_hint_order(nnodes);
+
+		rtree = RB_ROOT_RCACHED;
+		for (i = 0; i < nnodes; i++) {
+			nodes[i].key = i / 2 + prandom_u32_state(&rnd) % 4;
+			if (rb_add_rcached(&nodes[i].rb, &rtree, node_less))
+				TEST_ASSERT_EQUAL_PTR(&nodes[i].rb,
+						      rtree.rb_rightmost);
+			TEST_ASSERT_EQUAL_PTR(rb_last(&rtree.rb_root),
+					      rb_last_rcached(&rtree));
+		}
+		root.rb_root = rtree.rb_root;
+		check_hint_order(nnodes);
+
+		for (i = nnodes - 1; i >= 0; i -= 2) {
+			rb_erase_rcached(&nodes[i].rb, &rtree);
+			TEST_ASSERT_EQUAL_PTR(rb_last(&rtree.rb_root),
+					      rb_last_rcached(&rtree));
+		}
+		root.rb_root = rtree.rb_root;
+		check(nnodes / 2);
+	}
+
+	root = RB_ROOT_CACHED;
+	free(nodes);
+}
+
+/* Augmented tree of @nr nodes from @array, with keys (i * step) */
+static struct rb_root join_build(struct test_node *array, int nr, int step)
+{
+	struct rb_root_cached tree = RB_ROOT_CACHED;
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		array[i].key = i * step;
+		array[i].val = prandom_u32_state(&rnd);
+		insert_augmented(&array[i], &tree);
+	}
+	return tree.rb_root;
+}
+
+/* Check @tree as the global root, which check() works on */
+static void join_check(struct rb_root *tree, int nr_nodes, bool augmented)
+{
+	root.rb_root = *tree;
+	root.rb_leftmost = rb_first(tree);
+	if (augmented)
+		check_augmented(nr_nodes);
+	else
+		check(nr_nodes);
+	root = (struct rb_root_cached) RB_ROOT_CACHED;
+}
+
+static void join_dispose(struct rb_node *rb, void *priv)
+{
+	(*(int *)priv)++;
+	rb->rb_left = rb->rb_right = NULL;
+}
+
+static int join_key_count(struct rb_root *tree, uint32_t key)
+{
+	struct rb_node *rb;
+	int count = 0;
+
+	for (rb = rb_first(tree); rb; rb = rb_next(rb))
+		count += rb_entry(rb, struct test_node, rb)->key == key;
+	return count;
+}
+
+void test_rbtree_join(void)
+{
+	struct test_node *na, *nb;
+	struct rb_root a, b;
+	struct rb_node *rb;
+	int i, j, nr_a, nr_b, expect, disposed;
+	uint32_t key;
+
+	na = calloc(nnodes, sizeof(*na));
+	nb = calloc(nnodes, sizeof(*nb));
+	TEST_ASSERT_NOT_NULL(na);
+	TEST_ASSERT_NOT_NULL(nb);
+
+	for (j = 0; j < check_loops; j++) {
+		/* join trees of very different heights, with a pivot */
+		nr_a = prandom_u32_state(&rnd) % nnodes;
+		nr_b = prandom_u32_state(&rnd) % (nnodes - nr_a);
+		a = join_build(na, nr_a, 1);
+		b = join_build(nb, nr_b, 1);
+		for (i = 0; i < nr_b; i++)
+			nb[i].key += nr_a + 1;
+		na[nr_a].key = nr_a;
+		na[nr_a].val = prandom_u32_state(&rnd);
+		rb_join_augmented(&a, &na[nr_a].rb, &b, &augment_callbacks);
+		TEST_ASSERT_NULL(b.rb_node);
+		join_check(&a, nr_a + nr_b + 1, true);
+
+		/* split it anywhere, including past either end */
+		key = prandom_u32_state(&rnd) % (nr_a + nr_b + 3);
+		rb_split_augmented(&a, &key, &b, key_cmp, &augment_callbacks);
+		expect = key < (uint32_t)(nr_a + nr_b + 1) ?
+			 (int)key : nr_a + nr_b + 1;
+		join_check(&a, expect, true);
+		join_check(&b, nr_a + nr_b + 1 - expect, true);
+		if (a.rb_node)
+			TEST_ASSERT_TRUE(key >
+				rb_entry(rb_last(&a), struct test_node, rb)->key);
+		if (b.rb_node)
+			TEST_ASSERT_EQUAL_UINT32(key,
+				rb_entry(rb_first(&b), struct test_node, rb)->key);
+
+		/* and concatenate the halves again without a pivot */
+		rb_join_augmented(&a, NULL, &b, &augment_callbacks);
+		join_check(&a, nr_a + nr_b + 1, true);
+	}
+
+	for (j = 0; j < check_loops; j++) {
+		/* multiples of 2 against multiples of 3 */
+		nr_a = prandom_u32_state(&rnd) % nnodes;
+		nr_b = prandom_u32_state(&rnd) % nnodes;
+		expect = 0;
+		for (i = 0; i < nr_a; i++)
+			expect += i * 2 % 3 == 0 && i * 2 / 3 < nr_b;
+
+		a = join_build(na, nr_a, 2);
+		b = join_build(nb, nr_b, 3);
+		disposed = 0;
+		rb_union_augmented(&a, &b, node_cmp, join_dispose, &disposed,
+				   &augment_callbacks);
+		TEST_ASSERT_NULL(b.rb_node);
+		TEST_ASSERT_EQUAL_INT(expect, disposed);
+		join_check(&a, nr_a + nr_b - expect, true);
+		/* keys present in both keep the node of the first tree */
+		for (rb = rb_first(&a); rb; rb = rb_next(rb)) {
+			key = rb_entry(rb, struct test_node, rb)->key;
+			TEST_ASSERT_TRUE(key % 2 || key / 2 >= (uint32_t)nr_a ||
+				rb_entry(rb, struct test_node, rb) == &na[key / 2]);
+		}
+
+		a = join_build(na, nr_a, 2);
+		b = join_build(nb, nr_b, 3);
+		disposed = 0;
+		rb_intersect_augmented(&a, &b, node_cmp, join_dispose,
+				       &disposed, &augment_callbacks);
+		TEST_ASSERT_NULL(b.rb_node);
+		TEST_ASSERT_EQUAL_INT(nr_a + nr_b - expect, disposed);
+		join_check(&a, expect, true);
+		for (rb = rb_first(&a); rb; rb = rb_next(rb)) {
+			key = rb_entry(rb, struct test_node, rb)->key;
+			TEST_ASSERT_EQUAL_PTR(&na[key / 2],
+					      rb_entry(rb, struct test_node, rb));
+			TEST_ASSERT_EQUAL_UINT32(0, key % 6);
+		}
+
+		a = join_build(na, nr_a, 2);
+		b = join_build(nb, nr_b, 3);
+		disposed = 0;
+		rb_difference_augmented(&a, &b, node_cmp, join_dispose,
+					&disposed, &augment_callbacks);
+		TEST_ASSERT_NULL(b.rb_node);
+		TEST_ASSERT_EQUAL_INT(nr_b + expect, disposed);
+		join_check(&a, nr_a - expect, true);
+		for (i = 0; i < nr_b; i++)
+			TEST_ASSERT_EQUAL_INT(0, join_key_count(&a, i * 3));
+	}
+
+	/* the plain variants work on unaugmented trees */
+	a = join_build(na, nnodes / 2, 2);
+	b = join_build(nb, nnodes / 2, 3);
+	rb_union(&a, &b, node_cmp, NULL, NULL);
+	key = nnodes / 2;
+	rb_split(&a, &key, &b, key_cmp);
+	rb_difference(&b, &a, node_cmp, NULL, NULL);
+	TEST_ASSERT_NULL(a.rb_node);
+	rb_join(&a, NULL, &b);
+	for (rb = rb_first(&a), i = 0; rb; rb = rb_next(rb), i++)
+		TEST_ASSERT_TRUE(key <= rb_entry(rb, struct test_node, rb)->key);
+	join_check(&a, i, false);
+
+	free(nb);
+	free(na);
+}
+
+struct compact_test_node {
+	uint32_t key;
+	struct rb_cnode rb;
+};
+
+static bool compact_less(struct rb_cnode *a, const struct rb_cnode *b)
+{
+	return container_of(a, struct compact_test_node, rb)->key <
+	       container_of(b, struct compact_test_node, rb)->key;
+}
+
+static int compact_cmp(const void *key, const struct rb_cnode *b)
+{
+	uint32_t ka = *(const uint32_t *)key;
+	uint32_t kb = container_of(b, struct compact_test_node, rb)->key;
+
+	return ka < kb ? -1 : ka > kb;
+}
+
+/* Returns the black height of the subtree at @idx */
+static int compact_check_subtree(const struct rb_cpool *pool, uint32_t idx,
+				 uint32_t parent)
+{
+	struct rb_cnode *node;
+	int left, right;
+
+	if (!idx)
+		return 0;
+	node = rb_cnode(pool, idx);
+	TEST_ASSERT_EQUAL_UINT32(parent, rb_cparent(node));
+	if (!(node->__rb_parent_color & 1)) {
+		TEST_ASSERT_TRUE(parent);
+		TEST_ASSERT_TRUE(rb_cnode(pool, parent)->__rb_parent_color & 1);
+	}
+	left = compact_check_subtree(pool, node->rb_left, idx);
+	right = compact_check_subtree(pool, node->rb_right, idx);
+	TEST_ASSERT_EQUAL_INT(left, right);
+	return left + (node->__rb_parent_color & 1);
+}
+
+static void compact_check(const struct rb_cpool *pool,
+			  const struct rb_croot *tree, bool *present, int n)
+{
+	struct compact_test_node *cnodes = pool->base;
+	uint32_t idx, key, prev = 0;
+	int i, count = 0;
+
+	compact_check_subtree(pool, tree->rb_node, RB_CNIL);
+	for (idx = rb_cfirst(pool, tree); idx; idx = rb_cnext(pool, idx)) {
+		key = rb_centry(pool, idx, struct compact_test_node, rb)->key;
+		TEST_ASSERT_TRUE(!count || prev <= key);
+		TEST_ASSERT_TRUE(present[idx - 1]);
+		prev = key;
+		count++;
+	}
+	for (idx = rb_clast(pool, tree); idx; idx = rb_cprev(pool, idx))
+		count--;
+	TEST_ASSERT_EQUAL_INT(0, count);
+
+	for (i = 0; i < n; i++) {
+		idx = rb_cfind(pool, &cnodes[i].key, tree, compact_cmp);
+		if (present[i])
+			TEST_ASSERT_EQUAL_UINT32(cnodes[i].key,
+				rb_centry(pool, idx, struct compact_test_node,
+					  rb)->key);
+	}
+}
+
+void test_rbtree_compact(void)
+{
+	struct compact_test_node *bufs[2];
+	struct rb_croot tree = RB_CROOT;
+	struct rb_cpool pool;
+	size_t size = nnodes * sizeof(**bufs);
+	bool *present;
+	int i, j, cur = 0;
+
+	bufs[0] = calloc(nnodes, sizeof(**bufs));
+	bufs[1] = calloc(nnodes, sizeof(**bufs));
+	present = calloc(nnodes, sizeof(*present));
+	TEST_ASSERT_NOT_NULL(bufs[0]);
+	TEST_ASSERT_NOT_NULL(bufs[1]);
+	TEST_ASSERT_NOT_NULL(present);
+	pool = RB_CPOOL(bufs[0], struct compact_test_node, rb);
+
+	/* a small key space, so that there are plenty of duplicates */
+	for (i = 0; i < nnodes; i++)
+		bufs[0][i].key = prandom_u32_state(&rnd) % (nnodes / 2 + 1);
+
+	for (j = 0; j < check_loops; j++) {
+		for (i = 0; i < nnodes; i++) {
+			if (present[i])
+				continue;
+			rb_cadd(&pool, i + 1, &tree, compact_less);
+			present[i] = true;
+		}
+		compact_check(&pool, &tree, present, nnodes);
+
+		for (i = 0; i < nnodes; i++) {
+			if (prandom_u32_state(&rnd) % 2)
+				continue;
+			rb_cerase(&pool, i + 1, &tree);
+			present[i] = false;
+		}
+		compact_check(&pool, &tree, present, nnodes);
+
+		/* relocating the pool only changes its base */
+		memcpy(bufs[!cur], bufs[cur], size);
+		memset(bufs[cur], 0xa5, size);
+		cur = !cur;
+		pool.base = bufs[cur];
+		compact_check(&pool, &tree, present, nnodes);
+	}
+
+	free(present);
+	free(bufs[1]);
+	free(bufs[0]);
+}
+
+struct latch_test_node {
+	uint32_t key;
+	struct latch_tree_node lt;
+};
+
+static bool latch_less(struct latch_tree_node *a, struct latch_tree_node *b)
+{
+	return container_of(a, struct latch_test_node, lt)->key <
+	       container_of(b, struct latch_test_node, lt)->key;
+}
+
+static int latch_comp(void *key, struct latch_tree_node *b)
+{
+	uint32_t ka = *(uint32_t *)key;
+	uint32_t kb = container_of(b, struct latch_test_node, lt)->key;
+
+	return ka < kb ? -1 : ka > kb;
+}
+
+static const struct latch_tree_ops latch_ops = {
+	.less = latch_less,
+	.comp = latch_comp,
+};
+
+static struct latch_tree_root latch_root = LATCH_TREE_ROOT;
+static struct latch_test_node *latch_nodes;
+static atomic_bool latch_stop;
+
+/* Even keys stay in the tree; a lookup for them must never miss. */
+static void *latch_reader(void *arg)
+{
+	unsigned long *misses = arg;
+	uint32_t key;
+	int i;
+
+	rcu_register_thread();
+	while (!atomic_load(&latch_stop)) {
+		rcu_read_lock();
+		for (i = 0; i < nnodes; i += 2) {
+			key = i;
+			if (latch_tree_find(&key, &latch_root, &latch_ops) !=
+			    &latch_nodes[i].lt)
+				(*misses)++;
+		}
+		rcu_read_unlock();
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+void test_rbtree_latch(void)
+{
+	unsigned long misses = 0;
+	pthread_t reader;
+	uint32_t key;
+	int i, j;
+
+	latch_nodes = calloc(nnodes, sizeof(*latch_nodes));
+	TEST_ASSERT_NOT_NULL(latch_nodes);
+	for (i = 0; i < nnodes; i++)
+		latch_nodes[i].key = i;
+	for (i = 0; i < nnodes; i += 2)
+		latch_tree_insert(&latch_nodes[i].lt, &latch_root, &latch_ops);
+
+	rcu_register_thread();
+	atomic_store(&latch_stop, false);
+	pthread_create(&reader, NULL, latch_reader, &misses);
+
+	/* churn the odd keys to force rotations under the reader */
+	for (j = 0; j < check_loops; j++) {
+		for (i = 1; i < nnodes; i += 2)
+			latch_tree_insert(&latch_nodes[i].lt, &latch_root,
+					  &latch_ops);
+		for (i = 1; i < nnodes; i += 2) {
+			key = i;
+			TEST_ASSERT_EQUAL_PTR(&latch_nodes[i].lt,
+				latch_tree_find(&key, &latch_root, &latch_ops));
+			latch_tree_erase(&latch_nodes[i].lt, &latch_root,
+					 &latch_ops);
+		}
+		/* the erased nodes go back in next round */
+		synchronize_rcu();
+	}
+
+	atomic_store(&latch_stop, true);
+	pthread_join(reader, NULL);
+	rcu_unregister_thread();
+	TEST_ASSERT_EQUAL_UINT(0, misses);
+
+	for (i = 0; i < nnodes; i += 2)
+		latch_tree_erase(&latch_nodes[i].lt, &latch_root, &latch_ops);
+	TEST_ASSERT_TRUE(RB_EMPTY_ROOT(&latch_root.tree[0]));
+	TEST_ASSERT_TRUE(RB_EMPTY_ROOT(&latch_root.tree[1]));
+
+	free(latch_nodes);
+}
+
 int main(void) {
     UNITY_BEGIN();
     RUN_TEST(test_rbtree_functionality);
+    RUN_TEST(test_rbtree_find_rcu);
+    RUN_TEST(test_rbtree_bounds);
+    RUN_TEST(test_rbtree_find_batch);
+    RUN_TEST(test_rbtree_frozen);
+    RUN_TEST(test_rbtree_build);
+    RUN_TEST(test_rbtree_ost);
+    RUN_TEST(test_rbtree_join);
+    RUN_TEST(test_rbtree_add_hint);
+    RUN_TEST(test_rbtree_compact);
+    RUN_TEST(test_rbtree_latch);
     RUN_TEST(rbtree_test_init);
     return UNITY_END();
 }
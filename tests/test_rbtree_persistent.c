@@ -0,0 +1,258 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rbtree_persistent.h"
+#include "unity.h"
+
+void setUp(void) {
+    // set stuff up here
+}
+
+void tearDown(void) {
+    // clean stuff up here
+}
+
+#define NR_KEYS 512
+#define NR_OPS 20000
+#define NR_VERSIONS 16
+
+#define VAL(x) ((void *) (uintptr_t) (x))
+
+/* Returns the black height, checking order, colors and counts on the way */
+static int check_node(
+    const struct prb_node *node,
+    uint64_t lo,
+    uint64_t hi,
+    unsigned long *nr
+) {
+    int left, right;
+
+    if (!node)
+        return 1;
+    TEST_ASSERT_TRUE(node->key >= lo && node->key <= hi);
+    TEST_ASSERT_TRUE(atomic_load(&node->ref.ref) >= 1);
+    if (node->red) {
+        TEST_ASSERT_FALSE(node->left && node->left->red);
+        TEST_ASSERT_FALSE(node->right && node->right->red);
+    }
+    left = check_node(node->left, lo, node->key - 1, nr);
+    right = check_node(node->right, node->key + 1, hi, nr);
+    TEST_ASSERT_EQUAL_INT(left, right);
+    (*nr)++;
+    return left + !node->red;
+}
+
+/* @ref[key] is the value expected for key, 0 if absent */
+static void check(const struct prbtree *tree, const uintptr_t *ref) {
+    unsigned long nr = 0, expect = 0;
+    int key;
+
+    TEST_ASSERT_FALSE(tree->root && tree->root->red);
+    check_node(tree->root, 0, UINT64_MAX, &nr);
+    TEST_ASSERT_EQUAL_UINT64(nr, prbtree_count(tree));
+    for (key = 0; key < NR_KEYS; key++) {
+        TEST_ASSERT_EQUAL_PTR(VAL(ref[key]), prbtree_find(tree, key));
+        expect += ref[key] != 0;
+    }
+    TEST_ASSERT_EQUAL_UINT64(expect, nr);
+}
+
+/* One random insert or remove, applied to both @tree and @ref */
+static void random_op(struct prbtree *tree, uintptr_t *ref, uintptr_t tag) {
+    uint64_t key = rand() % NR_KEYS;
+    void *val;
+
+    if (ref[key]) {
+        TEST_ASSERT_EQUAL_INT(0, prbtree_remove(tree, key, &val));
+        TEST_ASSERT_EQUAL_PTR(VAL(ref[key]), val);
+        ref[key] = 0;
+    } else {
+        TEST_ASSERT_EQUAL_INT(0, prbtree_insert(tree, key, VAL(tag)));
+        ref[key] = tag;
+    }
+}
+
+void test_prbtree_basic(void) {
+    struct prbtree tree = PRBTREE_INIT;
+    uintptr_t ref[NR_KEYS] = {0};
+    void *val;
+    int i;
+
+    TEST_ASSERT_EQUAL_INT(-EINVAL, prbtree_insert(&tree, 1, NULL));
+    TEST_ASSERT_EQUAL_INT(-ENOENT, prbtree_remove(&tree, 1, &val));
+    TEST_ASSERT_EQUAL_INT(0, prbtree_insert(&tree, 1, VAL(10)));
+    TEST_ASSERT_EQUAL_INT(-EEXIST, prbtree_insert(&tree, 1, VAL(11)));
+    TEST_ASSERT_EQUAL_PTR(VAL(10), prbtree_find(&tree, 1));
+    TEST_ASSERT_EQUAL_INT(0, prbtree_remove(&tree, 1, NULL));
+    TEST_ASSERT_NULL(tree.root);
+
+    srand(42);
+    for (i = 0; i < NR_OPS; i++) {
+        random_op(&tree, ref, i + 1);
+        if (i % 97 == 0)
+            check(&tree, ref);
+    }
+    check(&tree, ref);
+
+    /* ascending and descending runs exercise every rotation */
+    prbtree_destroy(&tree);
+    memset(ref, 0, sizeof(ref));
+    for (i = 0; i < NR_KEYS; i++) {
+        TEST_ASSERT_EQUAL_INT(0, prbtree_insert(&tree, i, VAL(i + 1)));
+        ref[i] = i + 1;
+    }
+    check(&tree, ref);
+    for (i = NR_KEYS - 1; i >= 0; i--) {
+        TEST_ASSERT_EQUAL_INT(0, prbtree_remove(&tree, i, NULL));
+        ref[i] = 0;
+    }
+    check(&tree, ref);
+    prbtree_destroy(&tree);
+}
+
+void test_prbtree_snapshot(void) {
+    static uintptr_t refs[NR_VERSIONS][NR_KEYS];
+    struct prbtree versions[NR_VERSIONS];
+    int order[NR_VERSIONS], i, j, v, tmp;
+
+    srand(1234);
+    memset(refs, 0, sizeof(refs));
+    prbtree_init(&versions[0]);
+    for (i = 0; i < NR_OPS / 4; i++)
+        random_op(&versions[0], refs[0], i + 1);
+
+    /* every version forks off the previous one and keeps changing */
+    for (v = 1; v < NR_VERSIONS; v++) {
+        prbtree_snapshot(&versions[v], &versions[v - 1]);
+        memcpy(refs[v], refs[v - 1], sizeof(refs[v]));
+        for (i = 0; i < 200; i++) {
+            random_op(&versions[v - 1], refs[v - 1], v * NR_OPS + i + 1);
+            random_op(&versions[v], refs[v], v * NR_OPS + i + 101);
+        }
+    }
+    for (v = 0; v < NR_VERSIONS; v++)
+        check(&versions[v], refs[v]);
+
+    /* versions stay intact as others are updated and dropped */
+    for (v = 0; v < NR_VERSIONS; v++)
+        order[v] = v;
+    for (v = NR_VERSIONS - 1; v > 0; v--) {
+        j = rand() % (v + 1);
+        tmp = order[v];
+        order[v] = order[j];
+        order[j] = tmp;
+    }
+    for (i = 0; i < NR_VERSIONS; i++) {
+        v = order[i];
+        for (j = 0; j < 100; j++)
+            random_op(&versions[v], refs[v], (i + 1) * NR_OPS + j + 1);
+        prbtree_destroy(&versions[v]);
+        TEST_ASSERT_EQUAL_UINT64(0, prbtree_count(&versions[v]));
+        for (j = i + 1; j < NR_VERSIONS; j++)
+            check(&versions[order[j]], refs[order[j]]);
+    }
+}
+
+void test_prbtree_iter(void) {
+    struct prbtree tree = PRBTREE_INIT, snap;
+    struct prbtree_iter iter;
+    uint64_t key, prev;
+    unsigned long nr = 0;
+    int i;
+
+    prbtree_for_each(&iter, &tree) TEST_FAIL();
+    for (i = 0; i < 1000; i++)
+        TEST_ASSERT_EQUAL_INT(0, prbtree_insert(&tree, 3 * i, VAL(i + 1)));
+    prbtree_snapshot(&snap, &tree);
+
+    /* seek to each present and absent key */
+    for (key = 0; key <= 2997; key++) {
+        TEST_ASSERT_TRUE(prbtree_iter_seek(&iter, &snap, key));
+        TEST_ASSERT_EQUAL_UINT64((key + 2) / 3 * 3, prbtree_iter_key(&iter));
+        TEST_ASSERT_EQUAL_PTR(VAL((key + 2) / 3 + 1), prbtree_iter_val(&iter));
+    }
+    TEST_ASSERT_FALSE(prbtree_iter_seek(&iter, &snap, 2998));
+
+    /* the snapshot still walks all keys while the tree is emptied */
+    prev = 0;
+    prbtree_for_each(&iter, &snap) {
+        key = prbtree_iter_key(&iter);
+        TEST_ASSERT_TRUE(!nr || key > prev);
+        TEST_ASSERT_EQUAL_INT(0, prbtree_remove(&tree, key, NULL));
+        prev = key;
+        nr++;
+    }
+    TEST_ASSERT_EQUAL_UINT64(1000, nr);
+    TEST_ASSERT_EQUAL_UINT64(0, prbtree_count(&tree));
+    TEST_ASSERT_EQUAL_UINT64(1000, prbtree_count(&snap));
+
+    prbtree_destroy(&tree);
+    prbtree_destroy(&snap);
+}
+
+struct reader_arg {
+    struct prbtree snap;
+    uintptr_t ref[NR_KEYS];
+    unsigned long bad;
+};
+
+/* Walks and destroys its own version while the writer keeps going */
+static void *reader(void *data) {
+    struct reader_arg *arg = data;
+    struct prbtree_iter iter;
+    int round;
+
+    for (round = 0; round < 20; round++) {
+        prbtree_for_each(&iter, &arg->snap) {
+            uint64_t key = prbtree_iter_key(&iter);
+
+            arg->bad += prbtree_iter_val(&iter) != VAL(arg->ref[key]);
+        }
+    }
+    prbtree_destroy(&arg->snap);
+    return NULL;
+}
+
+void test_prbtree_concurrent(void) {
+    static struct reader_arg args[4];
+    static uintptr_t ref[NR_KEYS];
+    struct prbtree tree = PRBTREE_INIT;
+    pthread_t threads[4];
+    int i, t;
+
+    srand(7);
+    memset(ref, 0, sizeof(ref));
+    for (i = 0; i < NR_KEYS; i++)
+        random_op(&tree, ref, i + 1);
+
+    for (t = 0; t < 4; t++) {
+        prbtree_snapshot(&args[t].snap, &tree);
+        memcpy(args[t].ref, ref, sizeof(ref));
+        args[t].bad = 0;
+        TEST_ASSERT_EQUAL_INT(
+            0,
+            pthread_create(&threads[t], NULL, reader, &args[t])
+        );
+        for (i = 0; i < 1000; i++)
+            random_op(&tree, ref, (t + 1) * NR_OPS + i + 1);
+    }
+    for (t = 0; t < 4; t++) {
+        pthread_join(threads[t], NULL);
+        TEST_ASSERT_EQUAL_UINT64(0, args[t].bad);
+    }
+
+    check(&tree, ref);
+    prbtree_destroy(&tree);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_prbtree_basic);
+    RUN_TEST(test_prbtree_snapshot);
+    RUN_TEST(test_prbtree_iter);
+    RUN_TEST(test_prbtree_concurrent);
+    return UNITY_END();
+}
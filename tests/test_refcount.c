@@ -0,0 +1,115 @@
+#include <pthread.h>
+
+#include "refcount.h"
+#include "unity.h"
+
+void setUp(void) {
+    // set stuff up here
+}
+
+void tearDown(void) {
+    // clean stuff up here
+}
+
+#define NR_THREADS 4
+#define NR_LOOPS 100000
+
+void test_rc(void) {
+    struct rc rc;
+
+    rc_init(&rc);
+    rc_inc(&rc);
+    rc_inc(&rc);
+    TEST_ASSERT_TRUE(rc_cmp(&rc, 2));
+    TEST_ASSERT_FALSE(rc_dec(&rc));
+    TEST_ASSERT_TRUE(rc_dec(&rc));
+    TEST_ASSERT_TRUE(rc_cmp(&rc, 0));
+
+    /* underflow saturates and never reports the last drop again */
+    TEST_ASSERT_FALSE(rc_dec(&rc));
+    TEST_ASSERT_TRUE(rc_cmp(&rc, REFCOUNT_SATURATED));
+    rc_inc(&rc);
+    TEST_ASSERT_FALSE(rc_dec(&rc));
+    TEST_ASSERT_TRUE(rc_cmp(&rc, REFCOUNT_SATURATED));
+
+    rc.ref = INT32_MAX;
+    rc_inc(&rc);
+    TEST_ASSERT_TRUE(rc_cmp(&rc, REFCOUNT_SATURATED));
+}
+
+void test_arc(void) {
+    struct arc arc;
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+    arc_init(&arc);
+    TEST_ASSERT_FALSE(arc_inc_not_zero(&arc));
+    arc_inc(&arc);
+    TEST_ASSERT_TRUE(arc_inc_not_zero(&arc));
+    TEST_ASSERT_TRUE(arc_cmp(&arc, 2));
+
+    TEST_ASSERT_TRUE(arc_dec_not_one(&arc));
+    TEST_ASSERT_FALSE(arc_dec_not_one(&arc));
+    TEST_ASSERT_TRUE(arc_cmp(&arc, 1));
+
+    arc_inc(&arc);
+    TEST_ASSERT_FALSE(arc_dec_and_lock(&arc, &lock));
+    TEST_ASSERT_EQUAL_INT(0, pthread_mutex_trylock(&lock));
+    pthread_mutex_unlock(&lock);
+    TEST_ASSERT_TRUE(arc_dec_and_lock(&arc, &lock));
+    TEST_ASSERT_NOT_EQUAL(0, pthread_mutex_trylock(&lock));
+    pthread_mutex_unlock(&lock);
+    TEST_ASSERT_TRUE(arc_cmp(&arc, 0));
+
+    TEST_ASSERT_FALSE(arc_dec(&arc));
+    TEST_ASSERT_TRUE(arc_cmp(&arc, REFCOUNT_SATURATED));
+    TEST_ASSERT_TRUE(arc_inc_not_zero(&arc));
+    TEST_ASSERT_FALSE(arc_dec(&arc));
+    TEST_ASSERT_TRUE(arc_cmp(&arc, REFCOUNT_SATURATED));
+
+    atomic_store(&arc.ref, INT32_MAX);
+    arc_inc(&arc);
+    TEST_ASSERT_TRUE(arc_cmp(&arc, REFCOUNT_SATURATED));
+}
+
+static struct arc shared;
+
+static void *worker_fn(void *arg) {
+    int *last = arg;
+    int i;
+
+    for (i = 0; i < NR_LOOPS; i++) {
+        arc_inc(&shared);
+        if (arc_dec(&shared))
+            (*last)++;
+    }
+    if (arc_dec(&shared))
+        (*last)++;
+    return NULL;
+}
+
+void test_arc_concurrent(void) {
+    pthread_t threads[NR_THREADS];
+    int last[NR_THREADS] = { 0 };
+    int i, total = 0;
+
+    arc_init(&shared);
+    for (i = 0; i < NR_THREADS; i++)
+        arc_inc(&shared);
+    for (i = 0; i < NR_THREADS; i++)
+        pthread_create(&threads[i], NULL, worker_fn, &last[i]);
+    for (i = 0; i < NR_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        total += last[i];
+    }
+
+    TEST_ASSERT_EQUAL_INT(1, total);
+    TEST_ASSERT_TRUE(arc_cmp(&shared, 0));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_rc);
+    RUN_TEST(test_arc);
+    RUN_TEST(test_arc_concurrent);
+    return UNITY_END();
+}
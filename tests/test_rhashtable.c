@@ -0,0 +1,212 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#include "container_of.h"
+#include "rhashtable.h"
+#include "unity.h"
+
+void setUp(void) {
+    // set stuff up here
+}
+
+void tearDown(void) {
+    // clean stuff up here
+}
+
+#define NR_OBJS 20000
+#define NR_READERS 4
+
+struct object {
+    struct rhash_head node;
+    int val;
+};
+
+static struct rhashtable ht;
+static struct object *objs;
+static atomic_bool stop;
+
+static struct object *lookup(uint64_t key) {
+    struct rhash_head *he = rhashtable_lookup(&ht, key);
+
+    return he ? container_of(he, struct object, node) : NULL;
+}
+
+void test_rhashtable_basic(void) {
+    int i;
+
+    objs = calloc(NR_OBJS, sizeof(*objs));
+    TEST_ASSERT_NOT_NULL(objs);
+    TEST_ASSERT_EQUAL_INT(0, rhashtable_init(&ht, 2));
+    rcu_register_thread();
+
+    for (i = 0; i < NR_OBJS; i++) {
+        objs[i].val = i;
+        TEST_ASSERT_EQUAL_INT(0, rhashtable_insert(&ht, &objs[i].node, i));
+    }
+    TEST_ASSERT_EQUAL_UINT(NR_OBJS, rhashtable_count(&ht));
+    TEST_ASSERT_GREATER_THAN(NR_OBJS, ht.tbl->size);
+    TEST_ASSERT_EQUAL_INT(-EEXIST, rhashtable_insert(&ht, &objs[0].node, 0));
+
+    rcu_read_lock();
+    for (i = 0; i < NR_OBJS; i++)
+        TEST_ASSERT_EQUAL_PTR(&objs[i], lookup(i));
+    TEST_ASSERT_NULL(lookup(NR_OBJS));
+    rcu_read_unlock();
+
+    for (i = 0; i < NR_OBJS; i += 2)
+        TEST_ASSERT_EQUAL_INT(0, rhashtable_remove(&ht, &objs[i].node));
+    TEST_ASSERT_EQUAL_INT(-ENOENT, rhashtable_remove(&ht, &objs[0].node));
+
+    rcu_read_lock();
+    for (i = 0; i < NR_OBJS; i++)
+        TEST_ASSERT_EQUAL_PTR(i % 2 ? &objs[i] : NULL, lookup(i));
+    rcu_read_unlock();
+
+    for (i = 1; i < NR_OBJS; i += 2)
+        TEST_ASSERT_EQUAL_INT(0, rhashtable_remove(&ht, &objs[i].node));
+    TEST_ASSERT_EQUAL_UINT(0, rhashtable_count(&ht));
+    TEST_ASSERT_LESS_THAN(NR_OBJS, ht.tbl->size);
+
+    rcu_unregister_thread();
+    rcu_barrier();
+    rhashtable_destroy(&ht);
+    free(objs);
+}
+
+static void count_freed(struct rhash_head *obj, void *arg) {
+    (void) obj;
+    (*(unsigned long *) arg)++;
+}
+
+/*
+ * A resize crossing the load factor is spread over the following updates,
+ * which find every entry meanwhile; destroying the table halfway frees the
+ * entries of both tables.
+ */
+void test_rhashtable_incremental_resize(void) {
+    unsigned int size, resizes = 0;
+    unsigned long freed = 0;
+    int i, started = -1;
+
+    objs = calloc(NR_OBJS, sizeof(*objs));
+    TEST_ASSERT_NOT_NULL(objs);
+    TEST_ASSERT_EQUAL_INT(0, rhashtable_init(&ht, 10));
+    rcu_register_thread();
+
+    for (i = 0; i < NR_OBJS; i++) {
+        size = ht.tbl->size;
+        TEST_ASSERT_EQUAL_INT(0, rhashtable_insert(&ht, &objs[i].node, i));
+        if (ht.new_tbl && started < 0)
+            started = i;
+        if (ht.tbl->size != size) {
+            /*
+             * One batch per update: initialize the 2 * size new buckets,
+             * then move the size old ones.
+             */
+            TEST_ASSERT_TRUE(started >= 0);
+            TEST_ASSERT_EQUAL_INT(
+                3 * size / RHT_RESIZE_BATCH,
+                i - started + 1
+            );
+            started = -1;
+            resizes++;
+        }
+        if (i % 97 == 0) {
+            rcu_read_lock();
+            TEST_ASSERT_EQUAL_PTR(&objs[i / 2], lookup(i / 2));
+            rcu_read_unlock();
+        }
+    }
+    TEST_ASSERT_GREATER_THAN(2, resizes);
+
+    /* stop mid-move, with entries in both tables */
+    for (i = 0; i < NR_OBJS; i++)
+        TEST_ASSERT_EQUAL_INT(0, rhashtable_remove(&ht, &objs[i].node));
+    for (i = 0; !ht.tbl->future_tbl; i++) {
+        TEST_ASSERT_LESS_THAN(NR_OBJS, i);
+        TEST_ASSERT_EQUAL_INT(0, rhashtable_insert(&ht, &objs[i].node, i));
+    }
+    TEST_ASSERT_EQUAL_INT(0, rhashtable_insert(&ht, &objs[i].node, i));
+    rcu_read_lock();
+    TEST_ASSERT_EQUAL_PTR(&objs[0], lookup(0));
+    TEST_ASSERT_EQUAL_PTR(&objs[i], lookup(i));
+    rcu_read_unlock();
+
+    rcu_unregister_thread();
+    rcu_barrier();
+    rhashtable_free_and_destroy(&ht, count_freed, &freed);
+    TEST_ASSERT_EQUAL_UINT(i + 1, freed);
+    free(objs);
+}
+
+/*
+ * Readers continuously look up the even keys, which stay in the table the
+ * whole time, while the writer churns odd keys through enough inserts and
+ * removals to force several grow and shrink cycles.
+ */
+static void *reader_fn(void *arg) {
+    unsigned long *misses = arg;
+    int i;
+
+    rcu_register_thread();
+    while (!atomic_load(&stop)) {
+        rcu_read_lock();
+        for (i = 0; i < NR_OBJS; i += 2) {
+            if (lookup(i) != &objs[i])
+                (*misses)++;
+        }
+        rcu_read_unlock();
+    }
+    rcu_unregister_thread();
+    return NULL;
+}
+
+void test_rhashtable_concurrent_resize(void) {
+    pthread_t readers[NR_READERS];
+    unsigned long misses[NR_READERS] = { 0 };
+    int i, round;
+
+    objs = calloc(NR_OBJS, sizeof(*objs));
+    TEST_ASSERT_NOT_NULL(objs);
+    TEST_ASSERT_EQUAL_INT(0, rhashtable_init(&ht, 2));
+    rcu_register_thread();
+
+    for (i = 0; i < NR_OBJS; i += 2)
+        TEST_ASSERT_EQUAL_INT(0, rhashtable_insert(&ht, &objs[i].node, i));
+
+    atomic_store(&stop, false);
+    for (i = 0; i < NR_READERS; i++)
+        pthread_create(&readers[i], NULL, reader_fn, &misses[i]);
+
+    for (round = 0; round < 4; round++) {
+        for (i = 1; i < NR_OBJS; i += 2)
+            TEST_ASSERT_EQUAL_INT(0, rhashtable_insert(&ht, &objs[i].node, i));
+        for (i = 1; i < NR_OBJS; i += 2)
+            TEST_ASSERT_EQUAL_INT(0, rhashtable_remove(&ht, &objs[i].node));
+        /* readers may still be walking the removed objects */
+        synchronize_rcu();
+        TEST_ASSERT_EQUAL_INT(0, rhashtable_resize(&ht, 16));
+        TEST_ASSERT_EQUAL_INT(0, rhashtable_resize(&ht, 4));
+    }
+
+    atomic_store(&stop, true);
+    for (i = 0; i < NR_READERS; i++) {
+        pthread_join(readers[i], NULL);
+        TEST_ASSERT_EQUAL_UINT(0, misses[i]);
+    }
+
+    rcu_unregister_thread();
+    rcu_barrier();
+    rhashtable_destroy(&ht);
+    free(objs);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_rhashtable_basic);
+    RUN_TEST(test_rhashtable_incremental_resize);
+    RUN_TEST(test_rhashtable_concurrent_resize);
+    return UNITY_END();
+}
@@ -0,0 +1,251 @@
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "ring.h"
+#include "unity.h"
+
+void setUp(void) {
+    // set stuff up here
+}
+
+void tearDown(void) {
+    // clean stuff up here
+}
+
+#define NR_THREADS 4
+#define NR_OBJS 200000
+#define MAX_BATCH 16
+
+#define OBJ(v) ((void *) (uintptr_t) (v))
+#define VAL(obj) ((uintptr_t) (obj))
+
+void test_spsc_ring_basic(void) {
+    void *objs[12], *out[12], *obj;
+    struct spsc_ring ring;
+    unsigned int i, lap;
+
+    TEST_ASSERT_EQUAL_INT(-EINVAL, spsc_ring_init(&ring, 0));
+    TEST_ASSERT_EQUAL_INT(-EINVAL, spsc_ring_init(&ring, 12));
+    TEST_ASSERT_EQUAL_INT(0, spsc_ring_init(&ring, 8));
+    TEST_ASSERT_EQUAL_UINT(8, spsc_ring_size(&ring));
+    TEST_ASSERT_FALSE(spsc_ring_pop(&ring, &obj));
+
+    /* start just below the wrap of the free-running indices */
+    atomic_store(&ring.tail, UINT_MAX - 5);
+    atomic_store(&ring.head, UINT_MAX - 5);
+    ring.head_cache = ring.tail_cache = UINT_MAX - 5;
+
+    for (i = 0; i < 12; i++)
+        objs[i] = OBJ(i + 1);
+    for (lap = 0; lap < 3; lap++) {
+        TEST_ASSERT_TRUE(spsc_ring_push(&ring, objs[0]));
+        TEST_ASSERT_EQUAL_UINT(0, spsc_ring_enqueue_bulk(&ring, objs + 1, 8));
+        TEST_ASSERT_EQUAL_UINT(1, spsc_ring_count(&ring));
+        TEST_ASSERT_EQUAL_UINT(7, spsc_ring_enqueue_bulk(&ring, objs + 1, 7));
+        TEST_ASSERT_FALSE(spsc_ring_push(&ring, objs[8]));
+        TEST_ASSERT_EQUAL_UINT(0, spsc_ring_enqueue_burst(&ring, objs, 4));
+        TEST_ASSERT_EQUAL_UINT(8, spsc_ring_count(&ring));
+
+        TEST_ASSERT_TRUE(spsc_ring_pop(&ring, &obj));
+        TEST_ASSERT_EQUAL_PTR(OBJ(1), obj);
+        TEST_ASSERT_EQUAL_UINT(2, spsc_ring_dequeue_bulk(&ring, out, 2));
+        TEST_ASSERT_EQUAL_UINT(3, spsc_ring_enqueue_burst(&ring, objs + 8, 4));
+        TEST_ASSERT_EQUAL_UINT(0, spsc_ring_dequeue_bulk(&ring, out, 10));
+        TEST_ASSERT_EQUAL_UINT(8, spsc_ring_dequeue_burst(&ring, out, 12));
+        for (i = 0; i < 8; i++)
+            TEST_ASSERT_EQUAL_PTR(OBJ(i + 4), out[i]);
+        TEST_ASSERT_EQUAL_UINT(0, spsc_ring_count(&ring));
+    }
+    TEST_ASSERT_TRUE(atomic_load(&ring.tail) < 100);
+    spsc_ring_destroy(&ring);
+}
+
+void test_mpmc_ring_basic(void) {
+    void *objs[12], *out[12], *obj;
+    struct mpmc_ring ring;
+    unsigned long base;
+    unsigned int i, lap;
+
+    TEST_ASSERT_EQUAL_INT(-EINVAL, mpmc_ring_init(&ring, 0));
+    TEST_ASSERT_EQUAL_INT(-EINVAL, mpmc_ring_init(&ring, 12));
+    TEST_ASSERT_EQUAL_INT(0, mpmc_ring_init(&ring, 8));
+    TEST_ASSERT_EQUAL_UINT(8, mpmc_ring_size(&ring));
+    TEST_ASSERT_FALSE(mpmc_ring_pop(&ring, &obj));
+    TEST_ASSERT_EQUAL_UINT(0, mpmc_ring_dequeue_burst(&ring, objs, 4));
+
+    /* start just below the wrap of the indices and sequence numbers */
+    base = ULONG_MAX - 5;
+    atomic_store(&ring.tail, base);
+    atomic_store(&ring.head, base);
+    for (i = 0; i < 8; i++)
+        atomic_store(&ring.slots[(base + i) & ring.mask].seq, base + i);
+
+    for (i = 0; i < 12; i++)
+        objs[i] = OBJ(i + 1);
+    for (lap = 0; lap < 3; lap++) {
+        TEST_ASSERT_TRUE(mpmc_ring_push(&ring, objs[0]));
+        TEST_ASSERT_EQUAL_UINT(0, mpmc_ring_enqueue_bulk(&ring, objs + 1, 8));
+        TEST_ASSERT_EQUAL_UINT(1, mpmc_ring_count(&ring));
+        TEST_ASSERT_EQUAL_UINT(7, mpmc_ring_enqueue_bulk(&ring, objs + 1, 7));
+        TEST_ASSERT_FALSE(mpmc_ring_push(&ring, objs[8]));
+        TEST_ASSERT_EQUAL_UINT(0, mpmc_ring_enqueue_burst(&ring, objs, 4));
+        TEST_ASSERT_EQUAL_UINT(8, mpmc_ring_count(&ring));
+
+        TEST_ASSERT_TRUE(mpmc_ring_pop(&ring, &obj));
+        TEST_ASSERT_EQUAL_PTR(OBJ(1), obj);
+        TEST_ASSERT_EQUAL_UINT(2, mpmc_ring_dequeue_bulk(&ring, out, 2));
+        TEST_ASSERT_EQUAL_UINT(3, mpmc_ring_enqueue_burst(&ring, objs + 8, 4));
+        TEST_ASSERT_EQUAL_UINT(0, mpmc_ring_dequeue_bulk(&ring, out, 10));
+        TEST_ASSERT_EQUAL_UINT(8, mpmc_ring_dequeue_burst(&ring, out, 12));
+        for (i = 0; i < 8; i++)
+            TEST_ASSERT_EQUAL_PTR(OBJ(i + 4), out[i]);
+        TEST_ASSERT_EQUAL_UINT(0, mpmc_ring_count(&ring));
+    }
+    TEST_ASSERT_TRUE(atomic_load(&ring.tail) < 100);
+    mpmc_ring_destroy(&ring);
+}
+
+static struct spsc_ring spsc;
+
+/*
+ * Values 1..NR_OBJS, in batches of 1 to MAX_BATCH.  Both sides yield when
+ * the ring is full or empty, so that the test still runs on a single CPU.
+ */
+static void *spsc_producer_fn(void *arg) {
+    unsigned int next = 1, n, i, done, batch = 0;
+    void *objs[MAX_BATCH];
+
+    (void) arg;
+    while (next <= NR_OBJS) {
+        n = batch++ % MAX_BATCH + 1;
+        if (n > NR_OBJS - next + 1)
+            n = NR_OBJS - next + 1;
+        for (i = 0; i < n; i++)
+            objs[i] = OBJ(next + i);
+        if (batch % 3 == 0)
+            done = spsc_ring_enqueue_bulk(&spsc, objs, n);
+        else
+            done = spsc_ring_enqueue_burst(&spsc, objs, n);
+        if (!done)
+            sched_yield();
+        next += done;
+    }
+    return NULL;
+}
+
+void test_spsc_ring_threads(void) {
+    unsigned int expect = 1, n, i, batch = 0;
+    void *objs[MAX_BATCH];
+    pthread_t producer;
+
+    TEST_ASSERT_EQUAL_INT(0, spsc_ring_init(&spsc, 64));
+    pthread_create(&producer, NULL, spsc_producer_fn, NULL);
+    while (expect <= NR_OBJS) {
+        n = batch++ % MAX_BATCH + 1;
+        if (batch % 5 == 0)
+            n = spsc_ring_dequeue_bulk(&spsc, objs, n);
+        else
+            n = spsc_ring_dequeue_burst(&spsc, objs, n);
+        if (!n)
+            sched_yield();
+        for (i = 0; i < n; i++)
+            TEST_ASSERT_EQUAL_UINT(expect++, VAL(objs[i]));
+    }
+    pthread_join(producer, NULL);
+    TEST_ASSERT_EQUAL_UINT(0, spsc_ring_count(&spsc));
+    spsc_ring_destroy(&spsc);
+}
+
+static struct mpmc_ring mpmc;
+static atomic_uint consumed;
+static atomic_uint seen[NR_THREADS][NR_OBJS];
+
+/* Producer @id queues (@id << 24) + 1..NR_OBJS */
+static void *mpmc_producer_fn(void *arg) {
+    unsigned int id = (uintptr_t) arg, next = 1, n, i, done, batch = id;
+    void *objs[MAX_BATCH];
+
+    while (next <= NR_OBJS) {
+        n = batch++ % MAX_BATCH + 1;
+        if (n > NR_OBJS - next + 1)
+            n = NR_OBJS - next + 1;
+        for (i = 0; i < n; i++)
+            objs[i] = OBJ(((uintptr_t) id << 24) + next + i);
+        switch (batch % 3) {
+        case 0:
+            done = mpmc_ring_enqueue_bulk(&mpmc, objs, n);
+            break;
+        case 1:
+            done = mpmc_ring_enqueue_burst(&mpmc, objs, n);
+            break;
+        default:
+            done = mpmc_ring_push(&mpmc, objs[0]);
+            break;
+        }
+        if (!done)
+            sched_yield();
+        next += done;
+    }
+    return NULL;
+}
+
+/* Each consumer must see the values of a producer in increasing order */
+static void *mpmc_consumer_fn(void *arg) {
+    unsigned int last[NR_THREADS] = {0}, n, i, id, val, batch;
+    void *objs[MAX_BATCH];
+
+    batch = (uintptr_t) arg;
+    while (atomic_load(&consumed) < NR_THREADS * NR_OBJS) {
+        n = batch++ % MAX_BATCH + 1;
+        if (batch % 2 == 0)
+            n = mpmc_ring_dequeue_bulk(&mpmc, objs, n);
+        else
+            n = mpmc_ring_dequeue_burst(&mpmc, objs, n);
+        if (!n)
+            sched_yield();
+        for (i = 0; i < n; i++) {
+            id = VAL(objs[i]) >> 24;
+            val = VAL(objs[i]) & ((1U << 24) - 1);
+            TEST_ASSERT_TRUE(id < NR_THREADS);
+            TEST_ASSERT_TRUE(val > last[id]);
+            last[id] = val;
+            atomic_fetch_add(&seen[id][val - 1], 1);
+        }
+        atomic_fetch_add(&consumed, n);
+    }
+    return NULL;
+}
+
+void test_mpmc_ring_threads(void) {
+    pthread_t producers[NR_THREADS], consumers[NR_THREADS];
+    uintptr_t i, j;
+
+    TEST_ASSERT_EQUAL_INT(0, mpmc_ring_init(&mpmc, 64));
+    atomic_store(&consumed, 0);
+    for (i = 0; i < NR_THREADS; i++) {
+        pthread_create(&consumers[i], NULL, mpmc_consumer_fn, (void *) i);
+        pthread_create(&producers[i], NULL, mpmc_producer_fn, (void *) i);
+    }
+    for (i = 0; i < NR_THREADS; i++) {
+        pthread_join(producers[i], NULL);
+        pthread_join(consumers[i], NULL);
+    }
+
+    for (i = 0; i < NR_THREADS; i++)
+        for (j = 0; j < NR_OBJS; j++)
+            TEST_ASSERT_EQUAL_UINT(1, atomic_load(&seen[i][j]));
+    TEST_ASSERT_EQUAL_UINT(0, mpmc_ring_count(&mpmc));
+    mpmc_ring_destroy(&mpmc);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_spsc_ring_basic);
+    RUN_TEST(test_mpmc_ring_basic);
+    RUN_TEST(test_spsc_ring_threads);
+    RUN_TEST(test_mpmc_ring_threads);
+    return UNITY_END();
+}
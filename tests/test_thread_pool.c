@@ -0,0 +1,216 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "thread_pool.h"
+#include "unity.h"
+#include "ws_deque.h"
+
+void setUp(void) {
+    // set stuff up here
+}
+
+void tearDown(void) {
+    // clean stuff up here
+}
+
+#define NR_THIEVES 3
+#define NR_ITEMS 200000
+
+#define ITEM(v) ((void *) (uintptr_t) (v))
+#define VAL(item) ((uintptr_t) (item))
+
+void test_ws_deque_basic(void) {
+    struct ws_deque deque;
+    unsigned int i;
+
+    TEST_ASSERT_EQUAL_INT(0, ws_deque_init(&deque, 4));
+    TEST_ASSERT_NULL(ws_deque_pop(&deque));
+    TEST_ASSERT_NULL(ws_deque_steal(&deque));
+
+    /* past the 16 initial slots, twice */
+    for (i = 1; i <= 40; i++)
+        TEST_ASSERT_EQUAL_INT(0, ws_deque_push(&deque, ITEM(i)));
+    TEST_ASSERT_EQUAL_INT(40, ws_deque_count(&deque));
+
+    /* the owner takes the newest, thieves the oldest */
+    TEST_ASSERT_EQUAL_UINT(40, VAL(ws_deque_pop(&deque)));
+    TEST_ASSERT_EQUAL_UINT(1, VAL(ws_deque_steal(&deque)));
+    TEST_ASSERT_EQUAL_UINT(2, VAL(ws_deque_steal(&deque)));
+    TEST_ASSERT_EQUAL_UINT(39, VAL(ws_deque_pop(&deque)));
+    for (i = 38; i >= 3; i--)
+        TEST_ASSERT_EQUAL_UINT(i, VAL(ws_deque_pop(&deque)));
+    TEST_ASSERT_NULL(ws_deque_pop(&deque));
+    TEST_ASSERT_NULL(ws_deque_steal(&deque));
+    TEST_ASSERT_EQUAL_INT(0, ws_deque_count(&deque));
+
+    /* still usable once emptied */
+    TEST_ASSERT_EQUAL_INT(0, ws_deque_push(&deque, ITEM(7)));
+    TEST_ASSERT_EQUAL_UINT(7, VAL(ws_deque_steal(&deque)));
+    ws_deque_destroy(&deque);
+}
+
+static struct ws_deque shared;
+static atomic_uchar seen[NR_ITEMS + 1];
+static atomic_bool owner_done;
+
+static void *thief_fn(void *arg) {
+    void *item;
+
+    (void) arg;
+    for (;;) {
+        item = ws_deque_steal(&shared);
+        if (item) {
+            atomic_fetch_add(&seen[VAL(item)], 1);
+        } else if (atomic_load(&owner_done) && !ws_deque_count(&shared)) {
+            return NULL;
+        } else {
+            sched_yield();
+        }
+    }
+}
+
+/* The owner pushes and pops in bursts while thieves steal */
+void test_ws_deque_threads(void) {
+    pthread_t thieves[NR_THIEVES];
+    unsigned int i, j, next = 1;
+    void *item;
+
+    TEST_ASSERT_EQUAL_INT(0, ws_deque_init(&shared, 16));
+    atomic_store(&owner_done, false);
+    for (i = 0; i < NR_THIEVES; i++)
+        pthread_create(&thieves[i], NULL, thief_fn, NULL);
+
+    while (next <= NR_ITEMS) {
+        for (j = 0; j < 64 && next <= NR_ITEMS; j++)
+            TEST_ASSERT_EQUAL_INT(0, ws_deque_push(&shared, ITEM(next++)));
+        for (j = 0; j < 40; j++) {
+            item = ws_deque_pop(&shared);
+            if (!item)
+                break;
+            atomic_fetch_add(&seen[VAL(item)], 1);
+        }
+        if (next % 1024 < 64)
+            sched_yield();
+    }
+    while ((item = ws_deque_pop(&shared)))
+        atomic_fetch_add(&seen[VAL(item)], 1);
+    atomic_store(&owner_done, true);
+    for (i = 0; i < NR_THIEVES; i++)
+        pthread_join(thieves[i], NULL);
+
+    for (i = 1; i <= NR_ITEMS; i++)
+        TEST_ASSERT_EQUAL_UINT(1, atomic_load(&seen[i]));
+    ws_deque_destroy(&shared);
+}
+
+struct fib_task {
+    struct tp_task task;
+    unsigned int n;
+    unsigned long result;
+};
+
+static void fib_fn(struct tp_task *task) {
+    struct fib_task *t = container_of(task, struct fib_task, task);
+    struct fib_task a = { .n = t->n - 1 }, b = { .n = t->n - 2 };
+
+    if (t->n < 2) {
+        t->result = t->n;
+        return;
+    }
+    tp_task_init(&a.task, fib_fn);
+    tp_task_init(&b.task, fib_fn);
+    tp_fork(&a.task);
+    fib_fn(&b.task);
+    tp_join(&a.task);
+    t->result = a.result + b.result;
+}
+
+static unsigned long run_fib(struct thread_pool *pool, unsigned int n) {
+    struct fib_task t = { .n = n };
+
+    tp_task_init(&t.task, fib_fn);
+    thread_pool_run(pool, &t.task);
+    TEST_ASSERT_TRUE(atomic_load(&t.task.done));
+    return t.result;
+}
+
+void test_thread_pool_fork_join(void) {
+    struct thread_pool pool;
+    unsigned int nr;
+
+    /* a NULL pool, and tp_fork() outside any pool, run inline */
+    TEST_ASSERT_EQUAL_UINT(1, thread_pool_size(NULL));
+    TEST_ASSERT_EQUAL_UINT(6765, run_fib(NULL, 20));
+
+    for (nr = 1; nr <= 4; nr++) {
+        TEST_ASSERT_EQUAL_INT(0, thread_pool_init(&pool, nr));
+        TEST_ASSERT_EQUAL_UINT(nr, thread_pool_size(&pool));
+        TEST_ASSERT_EQUAL_UINT(6765, run_fib(&pool, 20));
+        /* again, after the workers went back to sleep */
+        TEST_ASSERT_EQUAL_UINT(75025, run_fib(&pool, 25));
+        thread_pool_destroy(&pool);
+    }
+
+    TEST_ASSERT_EQUAL_INT(0, thread_pool_init(&pool, 0));
+    TEST_ASSERT_TRUE(thread_pool_size(&pool) >= 1);
+    TEST_ASSERT_EQUAL_UINT(832040, run_fib(&pool, 30));
+    thread_pool_destroy(&pool);
+}
+
+#define FOR_SIZE 100003
+
+static atomic_uchar hits[FOR_SIZE];
+
+static void count_range(size_t begin, size_t end, void *arg) {
+    atomic_size_t *calls = arg;
+
+    atomic_fetch_add(calls, 1);
+    while (begin < end)
+        atomic_fetch_add(&hits[begin++], 1);
+}
+
+static void check_for(struct thread_pool *pool, size_t grain) {
+    atomic_size_t calls;
+    size_t i;
+
+    for (i = 0; i < FOR_SIZE; i++)
+        atomic_store(&hits[i], 0);
+    atomic_store(&calls, 0);
+    thread_pool_for(pool, 3, FOR_SIZE, grain, count_range, &calls);
+
+    for (i = 0; i < FOR_SIZE; i++)
+        TEST_ASSERT_EQUAL_UINT(i >= 3, atomic_load(&hits[i]));
+    if (grain)
+        TEST_ASSERT_TRUE(atomic_load(&calls) >= (FOR_SIZE - 3) / grain);
+}
+
+void test_thread_pool_for(void) {
+    struct thread_pool pool;
+    atomic_size_t calls;
+
+    check_for(NULL, 0);
+    check_for(NULL, 1000);
+
+    TEST_ASSERT_EQUAL_INT(0, thread_pool_init(&pool, 4));
+    check_for(&pool, 0);
+    check_for(&pool, 1);
+    check_for(&pool, 1000);
+    check_for(&pool, FOR_SIZE);
+
+    /* an empty range never calls back */
+    atomic_store(&calls, 0);
+    thread_pool_for(&pool, 5, 5, 0, count_range, &calls);
+    TEST_ASSERT_EQUAL_UINT(0, atomic_load(&calls));
+    thread_pool_destroy(&pool);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_ws_deque_basic);
+    RUN_TEST(test_ws_deque_threads);
+    RUN_TEST(test_thread_pool_fork_join);
+    RUN_TEST(test_thread_pool_for);
+    return UNITY_END();
+}
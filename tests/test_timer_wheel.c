@@ -0,0 +1,290 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "timer_wheel.h"
+#include "unity.h"
+
+void setUp(void) {
+    // set stuff up here
+}
+
+void tearDown(void) {
+    // clean stuff up here
+}
+
+#define NR_TIMERS 20000
+#define NR_ROUNDS 400
+
+struct test_timer {
+    struct tw_timer timer;
+    /* expiry the timer was last armed for, 0 if not armed */
+    uint64_t armed;
+    unsigned int fired;
+    /* fire again this many ticks later */
+    uint64_t period;
+};
+
+static struct test_timer timers[NR_TIMERS];
+
+struct expire_ctx {
+    struct timer_wheel *wheel;
+    uint64_t prev, now;
+    uint64_t last;
+    unsigned long nr;
+};
+
+static void expire(struct tw_timer *timer, void *priv) {
+    struct test_timer *t = container_of(timer, struct test_timer, timer);
+    struct expire_ctx *ctx = priv;
+
+    /* on time: not before its tick, nor later than the advance covering it */
+    TEST_ASSERT_EQUAL_UINT64(t->armed, timer->expires);
+    TEST_ASSERT_TRUE(timer->expires <= ctx->now);
+    TEST_ASSERT_TRUE(timer->expires > ctx->prev);
+    TEST_ASSERT_TRUE(timer->expires >= ctx->last);
+    TEST_ASSERT_FALSE(tw_timer_pending(timer));
+    ctx->last = timer->expires;
+    ctx->nr++;
+    t->fired++;
+    t->armed = 0;
+
+    if (t->period) {
+        t->armed = timer->expires + t->period;
+        timer_wheel_add(ctx->wheel, timer, t->armed);
+    }
+}
+
+static void advance(struct timer_wheel *wheel, uint64_t now) {
+    struct expire_ctx ctx = {
+        .wheel = wheel,
+        .prev = wheel->now - 1,
+        .now = now,
+        .last = 0,
+        .nr = 0,
+    };
+    unsigned long fired;
+
+    fired = timer_wheel_advance(wheel, now, expire, &ctx);
+    TEST_ASSERT_EQUAL_UINT64(ctx.nr, fired);
+    TEST_ASSERT_EQUAL_UINT64(now + 1, wheel->now);
+}
+
+static void check_armed(const struct timer_wheel *wheel) {
+    unsigned long nr = 0;
+    int i;
+
+    for (i = 0; i < NR_TIMERS; i++) {
+        TEST_ASSERT_EQUAL(
+            !!timers[i].armed,
+            tw_timer_pending(&timers[i].timer)
+        );
+        nr += !!timers[i].armed;
+    }
+    TEST_ASSERT_EQUAL_UINT64(nr, timer_wheel_count(wheel));
+}
+
+/* Mostly near timers, some a few levels up, a few beyond the wheel */
+static uint64_t random_delay(void) {
+    switch (rand() % 8) {
+    case 0:
+        return (uint64_t) rand() * rand() % (4 * TIMER_WHEEL_RANGE);
+    case 1:
+    case 2:
+        return rand() % (1 << 18);
+    default:
+        return rand() % 256;
+    }
+}
+
+void test_timer_wheel_basic(void) {
+    struct expire_ctx ctx = {0};
+    struct timer_wheel wheel;
+    int i;
+
+    timer_wheel_init(&wheel, 1000);
+    for (i = 0; i < NR_TIMERS; i++) {
+        tw_timer_init(&timers[i].timer);
+        timers[i].armed = 0;
+        timers[i].fired = 0;
+        timers[i].period = 0;
+    }
+
+    timers[0].armed = 1010;
+    timer_wheel_add(&wheel, &timers[0].timer, 1010);
+    timers[1].armed = 1000 + TIMER_WHEEL_RANGE * 3;
+    timer_wheel_add(&wheel, &timers[1].timer, timers[1].armed);
+    timers[2].armed = 5000;
+    timer_wheel_add(&wheel, &timers[2].timer, 5000);
+    TEST_ASSERT_EQUAL_UINT64(3, timer_wheel_count(&wheel));
+
+    /* cancel and re-arm, in the wheel and in the overflow tree */
+    TEST_ASSERT_TRUE(timer_wheel_del(&wheel, &timers[2].timer));
+    TEST_ASSERT_FALSE(timer_wheel_del(&wheel, &timers[2].timer));
+    timers[2].armed = 0;
+    TEST_ASSERT_FALSE(timer_wheel_mod(&wheel, &timers[3].timer, 1020));
+    timers[3].armed = 1020;
+    TEST_ASSERT_TRUE(timer_wheel_mod(&wheel, &timers[3].timer, 1030));
+    timers[3].armed = 1030;
+    TEST_ASSERT_TRUE(timer_wheel_mod(
+        &wheel,
+        &timers[1].timer,
+        1000 + TIMER_WHEEL_RANGE * 2
+    ));
+    timers[1].armed = 1000 + TIMER_WHEEL_RANGE * 2;
+    check_armed(&wheel);
+
+    advance(&wheel, 1009);
+    TEST_ASSERT_EQUAL_UINT(0, timers[0].fired);
+    advance(&wheel, 1010);
+    TEST_ASSERT_EQUAL_UINT(1, timers[0].fired);
+    advance(&wheel, 1000 + TIMER_WHEEL_RANGE * 2 - 1);
+    TEST_ASSERT_EQUAL_UINT(1, timers[3].fired);
+    TEST_ASSERT_EQUAL_UINT(0, timers[1].fired);
+    advance(&wheel, 1000 + TIMER_WHEEL_RANGE * 2);
+    TEST_ASSERT_EQUAL_UINT(1, timers[1].fired);
+    TEST_ASSERT_EQUAL_UINT(0, timers[2].fired);
+    TEST_ASSERT_EQUAL_UINT64(0, timer_wheel_count(&wheel));
+
+    /* late timers fire at the next advance */
+    ctx.wheel = &wheel;
+    ctx.now = wheel.now;
+    timers[0].armed = 10;
+    timer_wheel_add(&wheel, &timers[0].timer, 10);
+    TEST_ASSERT_EQUAL_UINT64(
+        1,
+        timer_wheel_advance(&wheel, ctx.now, expire, &ctx)
+    );
+    TEST_ASSERT_EQUAL_UINT(2, timers[0].fired);
+}
+
+struct rearm_ctx {
+    struct timer_wheel *wheel;
+    uint64_t now;
+    unsigned int nr;
+};
+
+/* timers[0] re-arms timers[1] for the tick being advanced to, then earlier */
+static void rearm_now(struct tw_timer *timer, void *priv) {
+    struct test_timer *t = container_of(timer, struct test_timer, timer);
+    struct rearm_ctx *ctx = priv;
+
+    ctx->nr++;
+    t->fired++;
+    if (t == &timers[0])
+        timer_wheel_add(ctx->wheel, &timers[1].timer, ctx->now);
+    else if (t->fired == 1)
+        timer_wheel_add(ctx->wheel, &timers[1].timer, ctx->now - 50);
+}
+
+void test_timer_wheel_rearm_now(void) {
+    struct timer_wheel wheel;
+    struct rearm_ctx ctx = { .wheel = &wheel, .now = 100 };
+
+    timer_wheel_init(&wheel, 0);
+    tw_timer_init(&timers[0].timer);
+    tw_timer_init(&timers[1].timer);
+    timers[0].fired = timers[1].fired = 0;
+    timer_wheel_add(&wheel, &timers[0].timer, 70);
+
+    TEST_ASSERT_EQUAL_UINT64(
+        3,
+        timer_wheel_advance(&wheel, 100, rearm_now, &ctx)
+    );
+    TEST_ASSERT_EQUAL_UINT(3, ctx.nr);
+    TEST_ASSERT_EQUAL_UINT(1, timers[0].fired);
+    TEST_ASSERT_EQUAL_UINT(2, timers[1].fired);
+    TEST_ASSERT_FALSE(tw_timer_pending(&timers[1].timer));
+    TEST_ASSERT_EQUAL_UINT64(0, timer_wheel_count(&wheel));
+    TEST_ASSERT_EQUAL_UINT64(101, wheel.now);
+
+    /* the same at the very tick being advanced to */
+    ctx.nr = timers[0].fired = timers[1].fired = 0;
+    ctx.now = 200;
+    timer_wheel_add(&wheel, &timers[0].timer, 200);
+    TEST_ASSERT_EQUAL_UINT64(
+        3,
+        timer_wheel_advance(&wheel, 200, rearm_now, &ctx)
+    );
+    TEST_ASSERT_EQUAL_UINT(2, timers[1].fired);
+    TEST_ASSERT_EQUAL_UINT64(0, timer_wheel_count(&wheel));
+}
+
+void test_timer_wheel_random(void) {
+    struct timer_wheel wheel;
+    uint64_t now = 12345, step;
+    int round, i, j;
+
+    srand(42);
+    timer_wheel_init(&wheel, now);
+    for (i = 0; i < NR_TIMERS; i++) {
+        tw_timer_init(&timers[i].timer);
+        timers[i].armed = 0;
+        timers[i].fired = 0;
+        timers[i].period = i % 64 ? 0 : 1 + rand() % (1 << 16);
+    }
+
+    for (round = 0; round < NR_ROUNDS; round++) {
+        /* arm, re-arm and cancel, mostly cancel */
+        for (j = 0; j < NR_TIMERS / 8; j++) {
+            struct test_timer *t = &timers[rand() % NR_TIMERS];
+            uint64_t expires = now + 1 + random_delay();
+
+            switch (rand() % 4) {
+            case 0:
+                TEST_ASSERT_EQUAL(
+                    !!t->armed,
+                    timer_wheel_mod(&wheel, &t->timer, expires)
+                );
+                t->armed = expires;
+                break;
+            case 1:
+                if (!t->armed) {
+                    timer_wheel_add(&wheel, &t->timer, expires);
+                    t->armed = expires;
+                    break;
+                }
+                /* fall through */
+            default:
+                TEST_ASSERT_EQUAL(
+                    !!t->armed,
+                    timer_wheel_del(&wheel, &t->timer)
+                );
+                t->armed = 0;
+                break;
+            }
+        }
+        check_armed(&wheel);
+
+        switch (rand() % 4) {
+        case 0:
+            step = (uint64_t) rand() * rand() % TIMER_WHEEL_RANGE;
+            break;
+        case 1:
+            step = rand() % 100000;
+            break;
+        default:
+            step = rand() % 300;
+            break;
+        }
+        now += step;
+        advance(&wheel, now);
+        check_armed(&wheel);
+        for (i = 0; i < NR_TIMERS; i++)
+            TEST_ASSERT_TRUE(!timers[i].armed || timers[i].armed > now);
+    }
+
+    /* drain: every timer left fires exactly when due */
+    for (i = 0; i < NR_TIMERS; i++)
+        timers[i].period = 0;
+    advance(&wheel, now + 5 * TIMER_WHEEL_RANGE);
+    TEST_ASSERT_EQUAL_UINT64(0, timer_wheel_count(&wheel));
+    check_armed(&wheel);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_timer_wheel_basic);
+    RUN_TEST(test_timer_wheel_rearm_now);
+    RUN_TEST(test_timer_wheel_random);
+    return UNITY_END();
+}